@@ -105,8 +105,9 @@ namespace {
 	 *
 	 * @return CStream representing inline image.
 	 */
+	template<typename Container>
 	CInlineImage*
-	getInlineImage (CStreamsXpdfReader<CContentStream::CStreams>& streamreader) 
+	getInlineImage (CStreamsXpdfReader<Container>& streamreader) 
 	{
 		kernelPrintDbg (DBG_DBG, "");
 		::Object dict;
@@ -180,476 +181,1490 @@ namespace {
 	}
 
 	/**
-	 * Create simple operator and its operands.
+	 * Does the stream start with our change tag.
 	 *
-	 * @return True if everything ok, false if end of stream reached.
+	 * Streams created by pdfedit start with a contents change tag (see
+	 * ContentsChangeTag) and form a content stream of their own. Only the
+	 * first object of the stream is read.
 	 */
 	bool
-	createOperandsFromStream (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, 
-					PdfOperator::Operands& operands,
-					boost::shared_ptr< ::Object>& o)
+	isChangeStream (boost::shared_ptr<CStream> stream)
 	{
-		// Get first object
-		streamreader.getXpdfObject (*o);
-
-		//
-		// Loop through all object, if it is an operator create pdfoperator else assume it is an operand
-		//
-		while (!streamreader.eof()) 
+		CStreamsXpdfReader<CContentStream::CStreams> streamreader (stream);
+		streamreader.open ();
+		boost::shared_ptr< ::Object> o (XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+		bool change = false;
+		try {
+			streamreader.getXpdfObject (*o);
+			change = o->isName (ContentsChangeTag::CHANGE_TAG_ID);
+		}catch (MalformedFormatExeption&)
 		{
-			if (o->isCmd ())
-			{// We have an OPERATOR
-				return true;
-			
-			}else 
-			{// We have an OPERAND
-				
-				boost::shared_ptr<IProperty> pIp (createObjFromXpdfObj (*o));
-				operands.push_back (pIp);
-			}
+			kernelPrintDbg (debug::DBG_ERR, "Invalid content stream...");
+		}
+		streamreader.close ();
+		return change;
+	}
 
-			o->free ();
-			// Grab the next object
-			streamreader.getXpdfObject (*o);
+	//==========================================================
+	// Gfx state updater functors
+	//==========================================================
 
-		} // while
-		
-		return false;
-	}
-	
 	/**
-	 * Create operator from xpdf object.
-	 *
-	 * @param streamreader CStreams parser from which we get an xpdf object.
-	 * @param operands Operands of operator. They are shared through subcalls.
+ 	 * BBox updater.
 	 */
-	boost::shared_ptr<PdfOperator>
-	createOperatorFromStream (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, 
-					PdfOperator::Operands& operands)
+	struct BBoxUpdater 
 	{
-		// Get operands
-		boost::shared_ptr< ::Object> o(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-		if (!createOperandsFromStream (streamreader, operands, o))
-			return boost::shared_ptr<PdfOperator> ();
-		
-		//
-		// SPECIAL CASE for inline image (stream within a text stream)
-		//
-		if ( 0 == strncmp (o->getCmd(), "BI", 2))
+		typedef PdfOperator::BBox BBox;
+
+		// Init resources
+		void operator() (boost::shared_ptr<GfxResources>) const {}
+
+		// Loop through operators
+		void operator() (boost::shared_ptr<PdfOperator> op, BBox rc, const GfxState&) const
 		{
-			utilsPrintDbg (debug::DBG_DBG, "");
-			const StateUpdater::CheckTypes* chcktp = StateUpdater::findOp (o->getCmd());
-			assert(chcktp);
-			if (!checkAndFixOperator (*chcktp, operands))
-			{
-				//assert (!"Content stream bad operator type.");
-				throw ElementBadTypeException ("Content stream operator has incorrect operand type.");
-			}
-			
-			boost::shared_ptr<CInlineImage> inimg (getInlineImage (streamreader));
-			return boost::shared_ptr<PdfOperator> (new InlineImageCompositePdfOperator (inimg, chcktp->name, chcktp->endTag));
+			// If not initialized, means an error occured (missing font etc..)
+			if (!BBox::isInitialized (rc))
+				rc.xleft = rc.xright = rc.yleft = rc.yright = 0;
+			op->setBBox (rc);
 		}
+	};
 
-		// factory function for all other operators
-		std::string name = o->getCmd();
-		return createOperator(name, operands);
+	/**
+	 * Delete graphical state with all saved states.
+	 */
+	void
+	deleteGfxState (GfxState* state)
+	{
+		// Saved states share the path with the current one
+		while (state->hasSaves())
+			state = state->restore ();
+		delete state;
 	}
-	
+
 	/**
-	 * Create an operator from a stream. 
-	 *
-	 * First read its operands, then the operator itself. Inline image is a
-	 * special case.
-	 *
-	 * This function is called recursively to create the tree like structure of
-	 * pdf operators
-	 *
-	 * @param streamreader CStreams parser from which we get an xpdf object.
-	 * @param operands Operands of operator. They are shared through subcalls.
-	 *
-	 * @return New pdf operator.
+	 * Are transformation matrices equal.
 	 */
-	boost::shared_ptr<PdfOperator>
-	parseOp (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, PdfOperator::Operands& operands)
+	bool
+	sameMatrix (const double* m1, const double* m2)
 	{
-		// Create operator with its operands
-		boost::shared_ptr<PdfOperator> result = createOperatorFromStream (streamreader, operands);
+		for (size_t i = 0; i < 6; ++i)
+			if (m1[i] != m2[i])
+				return false;
+		return true;
+	}
 	
-		if (result && isCompositeOp (result) && !isInlineImageOp (result))
+	/**
+	 * Are parts of graphical states used by bounding boxes equal. 
+	 * Saved states are compared too.
+	 */
+	bool
+	sameBBoxState (const GfxState* state1, const GfxState* state2)
+	{
+		for (; state1 && state2; state1 = state1->getSaved(), state2 = state2->getSaved())
 		{
-			string opname;
-			result->getOperatorName (opname);
-			string endtag = StateUpdater::getEndTag (opname);
-			bool foundEndTag = false;
-			
-			// The same as in (re)parse
-			boost::shared_ptr<PdfOperator> newop, previousLast = result;
-
-			//
-			// Use recursion to get all operators
-			//
-			while (newop=parseOp (streamreader, operands))
-			{
-				result->push_back (newop, previousLast);
-
-				// Is it the end tag?
-				string tag;
-				newop->getOperatorName (tag);
-				if (tag == endtag)
-				{
-					foundEndTag = true;
-					break;
-				}
-				
-				// Save last as previous
-				previousLast = getLastOperator (newop);
-			}
-
-			if (!foundEndTag)
-			{
-				//assert (!"Bad content stream while reparsing. End tag was not found.");
-				throw CObjInvalidObject ();
-			}
+			if (!sameMatrix (state1->getCTM(), state2->getCTM())
+					|| !sameMatrix (state1->getTextMat(), state2->getTextMat())
+					|| state1->getFont() != state2->getFont()
+					|| state1->getFontSize() != state2->getFontSize()
+					|| state1->getCharSpace() != state2->getCharSpace()
+					|| state1->getWordSpace() != state2->getWordSpace()
+					|| state1->getHorizScaling() != state2->getHorizScaling()
+					|| state1->getLeading() != state2->getLeading()
+					|| state1->getRise() != state2->getRise()
+					|| state1->getLineWidth() != state2->getLineWidth()
+					|| state1->getCurX() != state2->getCurX()
+					|| state1->getCurY() != state2->getCurY()
+					|| state1->getLineX() != state2->getLineX()
+					|| state1->getLineY() != state2->getLineY())
+				return false;
 		}
-		
-		return result;
+		// Same number of saved states
+		return (state1 == state2);
 	}
 
 	/**
-	 * Parse the stream for the first time into pdf operators. 
+	 * Separate the content from a part which did not follow it.
 	 *
-	 * Problem with content stream is, that it can be splitted in many streams
-	 * and the split points are really insane. And moreover some pdf creators 
-	 * produce even more insane split points. So we try to parse a valid stream
-	 * (all composite objects are ended with their ending tags) and look if we
-	 * are at the end of one of the streams. If positive, we claim this content
-	 * stream to be a valid one.
-	 * 
-	 * @param operators Operator stack.
-	 * @param streams 	Streams to be parsed.
-	 * @param cs 		Content stream in which operators belong
-	 * @param observer 	Operand observer.
-	 * @param parsedstreams Streams that have been really parsed.
+	 * @param str Content.
+	 * @param newline Use a newline (the content can end with a comment).
 	 */
 	void
-	parse (CContentStream::Operators& operators, 
-						CContentStream::CStreams& streams, 
-						CContentStream& cs,
-						boost::shared_ptr<IPropertyObserver> observer,
-						CContentStream::CStreams* parsedstreams = NULL)
+	separateContent (std::string& str, bool newline)
 	{
-		// Clear operators
-		operators.clear ();
-	
-		// Check if streams are in a valid pdf
-		for (CContentStream::CStreams::const_iterator it = streams.begin(); it != streams.end(); ++it)
-		{
-			assert (hasValidPdf (*it) && hasValidRef (*it));
-			if (!hasValidPdf (*it) || !hasValidRef (*it))
-				throw CObjInvalidObject ();
-		}
-		boost::weak_ptr<CPdf> pdf = streams.front()->getPdf ();
-		assert (pdf.lock());
-		IndiRef rf = streams.front()->getIndiRef ();
+		if (str.empty())
+			return;
+		char c = str[str.size() - 1];
+		if ('\n' == c || '\r' == c)
+			return;
+		if (newline)
+			str += '\n';
+		else if (' ' != c && '\t' != c && '\f' != c && '\0' != c)
+			str += ' ';
+	}
+
+	/** Part of the source replaced by operators when saving. */
+	struct SourceEdit
+	{
+		/** End of the replaced part. */
+		size_t end;
+		/** Operators written instead. */
+		std::list<boost::shared_ptr<PdfOperator> > ops;
+	};
+	typedef std::map<size_t, SourceEdit> SourceEdits;
+
+	/**
+	 * Append an operator followed by a space. Children of a composite follow
+	 * it in the iterator list, so only the name of a composite is appended.
+	 */
+	void
+	appendOperator (std::string& str, const PdfOperator& op)
+	{
+		std::string tmp;
+		if (isCompositeOp (&op) && !isInlineImageOp (&op))
+			op.getOperatorName (tmp);
+		else
+			op.getStringRepresentation (tmp);
+		str += tmp; str += " ";
+	}
 
-		assert (!streams.empty());
-		CStreamsXpdfReader<CContentStream::CStreams> streamreader (streams);
-		streamreader.open ();
 	
-		PdfOperator::Operands operands;
-		boost::shared_ptr<PdfOperator> topoperator (new UnknownCompositePdfOperator ("",""));	
-		boost::shared_ptr<PdfOperator> newop, previousLast = topoperator;
+//==========================================================
+} // namespace
+//==========================================================
+
+//==========================================================
+// CompactPdfOperators
+//==========================================================
+
+//
+// Parsing
+//
+
+//
+//
+//
+void
+CompactPdfOperators::parse (const CStreams& streams)
+{
+	// Clear operators
+	clear ();
+
+	// Check if streams are in a valid pdf
+	for (CStreams::const_iterator it = streams.begin(); it != streams.end(); ++it)
+	{
+		assert (hasValidPdf (*it) && hasValidRef (*it));
+		if (!hasValidPdf (*it) || !hasValidRef (*it))
+			throw CObjInvalidObject ();
+	}
+
+	assert (!streams.empty());
+	CStreamsXpdfReader<const CStreams> streamreader (streams);
+	streamreader.open (true);
+
+	boost::shared_ptr< ::Object> o(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	// Composites waiting for their end tags
+	std::vector<size_t> composites;
+	// First operand slot and operand count of the next operator
+	size_t first = 0, count = 0;
+	// Sizes of arrays after the last complete first level operator
+	size_t validOperators = 0, validOperands = 0, validPool = 0, validImages = 0;
+	// Source positions of the current object and of the first operand
+	size_t objpos = 0, start = 0;
+	bool complete = false;
+
+	//
+	// Parsing can throw, if so the stream is invalid
+	//
+	try 
+	{
+		// Get first object
+		objpos = streamreader.getObjPos ();
+		streamreader.getXpdfObject (*o);
 
 		//
-		// Parsing can throw, if so the stream is invalid
-		// 	-- copy them to parsed streams any way
+		// Loop through all object, if it is an operator store it else assume it is an operand
 		//
-		try 
+		while (!streamreader.eof()) 
 		{
-			bool our_change = false;
-			while (newop=parseOp (streamreader, operands))
-			{
+			complete = false;
+			if (!o->isCmd ())
+			{// We have an OPERAND
+				if (0 == count)
+					start = objpos;
+				addOperand (*o);
+				++count;
+			
+			}else
+			{// We have an OPERATOR
+				Operator op;
+				op.opcode = StateUpdater::findOpCode (o->getCmd());
+				op.operandCount = count;
+				op.operand = first;
+				op.data = 0;
+				op.end = operators.size() + 1;
+				op.start = (0 == count) ? objpos : start;
+
+				if (UNKNOWN_OPCODE == op.opcode)
+				{
+					op.data = addString (o->getCmd(), strlen (o->getCmd()));
+				
+				}else if (!checkOperands (op.opcode, first, count))
+				{
+					//assert (!"Content stream bad operator type.");
+					throw ElementBadTypeException ("Content stream operator has incorrect operand type.");
+				}
+				
 				//
-				// Is it our change
+				// SPECIAL CASE for inline image (stream within a text stream)
 				//
-				if (isPdfOp (*newop,ContentsChangeTag::CHANGE_TAG_NAME))
-				{	
-					PdfOperator::Operands ops;
-					newop->getParameters (ops);
-					if (!ops.empty())
-					{
-						try {
-							if (ContentsChangeTag::CHANGE_TAG_ID == getNameFromIProperty(ops.front()))
-								our_change = true;
-						}catch (ElementBadTypeException&)
-							{}
-					}
+				if (isInlineImage (op))
+				{
+					op.data = images.size();
+					images.push_back (boost::shared_ptr<CInlineImage> (getInlineImage (streamreader)));
 				}
+				
+				size_t pos = operators.size();
+				operators.push_back (op);
+				first = operands.size();
+				count = 0;
 
-				topoperator->push_back (newop, previousLast);
-				previousLast = getLastOperator (newop);
-
-				if (parsedstreams)
-				{ // FIRST PARSE
-					//
-					// We have found complete and correct content stream.
-					//  BUT this can be tricky -- e.g. 
-					//  Tf ...
-					//  <<END>>
-					//  Tj 
-					// if we want to do something with all operators (xml
-					// output) we have a problem
-					//
-					if (streamreader.eofOfActualStream())
+				//
+				// Composite operators contain all operators up to their end tags
+				//
+				if (isComposite (op))
+				{
+					composites.push_back (pos);
+				
+				}else if (!composites.empty() && UNKNOWN_OPCODE != op.opcode)
+				{
+					Operator& composite = operators[composites.back()];
+					if (0 == strcmp (StateUpdater::getOp (op.opcode).name, StateUpdater::getOp (composite.opcode).endTag))
 					{
-						if (our_change)
-							break;
-						boost::shared_ptr< ::Object> o(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-						streamreader.lookXpdfObject (*o);
-						if (o->isName (ContentsChangeTag::CHANGE_TAG_ID))
-							break;
+						composite.end = operators.size();
+						composites.pop_back ();
 					}
 				}
+
+				//
+				// First level operator is complete
+				//
+				if (composites.empty())
+				{
+					validOperators = operators.size();
+					validOperands = operands.size();
+					validPool = pool.size();
+					validImages = images.size();
+					complete = true;
+				}
 			}
 
-		}catch (CObjectException&)
+			o->free ();
+			// Grab the next object
+			objpos = streamreader.getObjPos ();
+			if (complete)
+				sourceEnd = objpos;
+			streamreader.getXpdfObject (*o);
+
+		} // while
+
+		if (!composites.empty())
 		{
-			kernelPrintDbg (debug::DBG_ERR, "Invalid content stream...");
-			operands.clear ();
-			//operators.clear ();
+			//assert (!"Bad content stream while parsing. End tag was not found.");
+			throw CObjInvalidObject ();
+		}
+
+	}catch (CObjectException&)
+	{
+		kernelPrintDbg (debug::DBG_ERR, "Invalid content stream...");
+	}
+
+	//
+	// Keep only complete first level operators (and drop operands without
+	// an operator)
+	//
+	operators.resize (validOperators);
+	operands.resize (validOperands);
+	pool.resize (validPool);
+	images.resize (validImages);
+
+	// Drop data behind the last complete operator
+	streamreader.getReadData (source);
+	if (source.size() > sourceEnd)
+		source.resize (sourceEnd);
+	streamreader.close ();
+}
+
+//
+//
+//
+void
+CompactPdfOperators::clear ()
+{
+	// Release the memory
+	std::vector<Operator> ().swap (operators);
+	std::vector<Operand> ().swap (operands);
+	std::vector<char> ().swap (pool);
+	std::vector<boost::shared_ptr<CInlineImage> > ().swap (images);
+	std::string ().swap (source);
+	sourceEnd = 0;
+}
+
+//
+//
+//
+void
+CompactPdfOperators::addOperand (::Object& obj)
+{
+	size_t slot = operands.size();
+	Operand operand;
+	// Property types have the same values as xpdf object types
+	operand.type = static_cast<unsigned char> (obj.getType());
+	operand.size = 0;
+	operand.value.offset = 0;
+
+	switch (obj.getType())
+	{
+		case objBool:
+			operand.value.boolean = (gTrue == obj.getBool());
+			break;
+
+		case objInt:
+			operand.value.integer = obj.getInt();
+			break;
+
+		case objReal:
+			operand.value.real = obj.getReal();
+			break;
+
+		case objString:
+			operand.size = obj.getString()->getLength();
+			operand.value.offset = addString (obj.getString()->getCString(), operand.size);
+			break;
+
+		case objName:
+			operand.size = strlen (obj.getName());
+			operand.value.offset = addString (obj.getName(), operand.size);
+			break;
+
+		case objRef:
+			operand.value.ref.num = obj.getRefNum();
+			operand.value.ref.gen = obj.getRefGen();
+			break;
+
+		case objNull:
+		case objArray:
+		case objDict:
+			break;
+
+		default:
+			throw ElementBadTypeException ("createObjFromXpdfObj: Xpdf object has bad type.");
+	}
+	operands.push_back (operand);
+
+	//
+	// Store items of complex objects after the object
+	//
+	boost::shared_ptr< ::Object> item(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	if (obj.isArray())
+	{
+		for (int i = 0; i < obj.arrayGetLength(); ++i)
+		{
+			obj.arrayGetNF (i, item.get());
+			addOperand (*item);
+			item->free ();
+		}
+		operands[slot].size = operands.size() - slot - 1;
+	
+	}else if (obj.isDict())
+	{
+		for (int i = 0; i < obj.dictGetLength(); ++i)
+		{
+			// Key
+			Operand key;
+			key.type = pName;
+			key.size = strlen (obj.dictGetKey (i));
+			key.value.offset = addString (obj.dictGetKey (i), key.size);
+			operands.push_back (key);
+			// Value
+			obj.dictGetValNF (i, item.get());
+			addOperand (*item);
+			item->free ();
 		}
+		operands[slot].size = operands.size() - slot - 1;
+	}
+}
+
+//
+//
+//
+size_t
+CompactPdfOperators::addString (const char* str, size_t len)
+{
+	size_t offset = pool.size();
+	pool.insert (pool.end(), str, str + len);
+	// Names are used as c strings
+	pool.push_back ('\0');
+	return offset;
+}
+
+//
+//
+//
+bool
+CompactPdfOperators::checkOperands (int opcode, size_t first, size_t count)
+{
+	const StateUpdater::CheckTypes& ops = StateUpdater::getOp (opcode);
+	size_t argNum = static_cast<size_t> ((ops.argNum > 0) ? ops.argNum : -ops.argNum);
 		
-		//
-		// Copy operands
-		//
-		topoperator->getChildren (operators);
-		// Set prev of first valid operator to NULL
-		if (!operators.empty())
-			PdfOperator::getIterator (topoperator).next().getCurrent()->setPrev (PdfOperator::ListItem ());
+	//
+	// Check operator size if > 0 than it is the exact size, maximum
+	// otherwise
+	//
+	if (((ops.argNum >= 0) && (count != argNum)) 
+		 || ((ops.argNum <  0) && (count > argNum)) )
+	{
+		utilsPrintDbg (DBG_ERR, "Number of operands mismatch.. expected " << ops.argNum << " got: " << count);
+		return false;
+	}
+	
+	//
+	// Check arguments
+	//
+	size_t slot = first;
+	for (size_t pos = 0; pos < count; ++pos, slot = nextOperand (slot))
+	{
+		Operand& operand = operands[slot];
+		if (pos >= sizeof (ops.types) / sizeof (ops.types[0]) 
+				|| !isBitSet(ops.types[pos], static_cast<PropertyType> (operand.type)))
+		{
+			utilsPrintDbg (DBG_ERR, "Bad " << pos << "-th operand type [" << (int)operand.type << "]");
+			return false;
+		}
 
-		// Delete topoperator
-		topoperator.reset();
+		// 
+		// If xpdf returned an Int, but the operand can be a real convert it
+		// 
+		if (pInt == operand.type && isBitSet(ops.types[pos], pReal))
+		{
+			double dval = operand.value.integer;
+			operand.type = pReal;
+			operand.value.real = dval;
+		}
+	}
 
-		if (parsedstreams)  // Save which streams were parsed and close
-			streamreader.close (*parsedstreams);
-		else
-			streamreader.close ();
+	return true;
+}
+
+//
+// Accessors
+//
+
+//
+//
+//
+const char*
+CompactPdfOperators::getString (size_t offset) const
+{
+	assert (offset < pool.size());
+	return &pool[offset];
+}
+
+//
+//
+//
+const char*
+CompactPdfOperators::getName (const Operator& op) const
+{
+	if (UNKNOWN_OPCODE == op.opcode)
+		return getString (op.data);
+	else
+		return StateUpdater::getOp (op.opcode).name;
+}
+
+//
+//
+//
+bool
+CompactPdfOperators::isComposite (const Operator& op) const
+{
+	return UNKNOWN_OPCODE != op.opcode 
+		&& !isSimpleOp (StateUpdater::getOp (op.opcode)) 
+		&& !isInlineImage (op);
+}
+
+//
+//
+//
+bool
+CompactPdfOperators::isInlineImage (const Operator& op) const
+{
+	return UNKNOWN_OPCODE != op.opcode 
+		&& 0 == strcmp (StateUpdater::getOp (op.opcode).name, "BI");
+}
+
+//
+//
+//
+void
+CompactPdfOperators::getOperatorName (size_t pos, std::string& name) const
+{
+	assert (pos < operators.size());
+	name = getName (operators[pos]);
+}
+
+//
+//
+//
+size_t
+CompactPdfOperators::findLast (const std::string& name) const
+{
+	for (size_t pos = operators.size(); 0 < pos; --pos)
+	{
+		if (name == getName (operators[pos - 1]))
+			return pos - 1;
+	}
+	return operators.size();
+}
+
+//
+//
+//
+void
+CompactPdfOperators::createOperands (size_t pos, PdfOperator::Operands& ops) const
+{
+	assert (pos < operators.size());
+	const Operator& op = operators[pos];
+
+	// Inline image is the only parameter of its operator
+	if (isInlineImage (op))
+	{
+		boost::shared_ptr<IProperty> ip = images[op.data];
+		ops.push_back (ip);
+		return;
+	}
+
+	size_t slot = op.operand;
+	for (size_t i = 0; i < op.operandCount; ++i, slot = nextOperand (slot))
+		ops.push_back (boost::shared_ptr<IProperty> (createProperty (slot)));
+}
+
+//
+//
+//
+IProperty*
+CompactPdfOperators::createProperty (size_t slot) const
+{
+	const Operand& operand = operands[slot];
+	switch (operand.type)
+	{
+		case pNull:
+			return CNullFactory::getInstance ();
+
+		case pBool:
+			return CBoolFactory::getInstance (operand.value.boolean);
+
+		case pInt:
+			return CIntFactory::getInstance (operand.value.integer);
+
+		case pReal:
+			return CRealFactory::getInstance (operand.value.real);
+
+		case pString:
+			return CStringFactory::getInstance (std::string (getString (operand.value.offset), operand.size));
+
+		case pName:
+			return CNameFactory::getInstance (std::string (getString (operand.value.offset), operand.size));
+
+		case pRef:
+			return CRefFactory::getInstance (IndiRef (operand.value.ref.num, operand.value.ref.gen));
+
+		case pArray:
+		case pDict:
+		{
+			boost::shared_ptr< ::Object> obj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+			createXpdfObject (slot, *obj);
+			return createObjFromXpdfObj (*obj);
+		}
+
+		default:
+			assert (!"Bad type.");
+			throw ElementBadTypeException ("Bad compact operand type.");
+	}
+}
+
+//
+//
+//
+void
+CompactPdfOperators::createXpdfObject (size_t slot, ::Object& obj) const
+{
+	const Operand& operand = operands[slot];
+	switch (operand.type)
+	{
+		case pNull:
+			obj.initNull ();
+			break;
+
+		case pBool:
+			obj.initBool (operand.value.boolean ? gTrue : gFalse);
+			break;
+
+		case pInt:
+			obj.initInt (operand.value.integer);
+			break;
+
+		case pReal:
+			obj.initReal (operand.value.real);
+			break;
+
+		case pString:
+			obj.initString (new GooString (getString (operand.value.offset), static_cast<int> (operand.size)));
+			break;
+
+		case pName:
+			obj.initName (getString (operand.value.offset));
+			break;
+
+		case pRef:
+			obj.initRef (operand.value.ref.num, operand.value.ref.gen);
+			break;
+
+		case pArray:
+		{
+			obj.initArray ((XRef*)NULL);
+			size_t end = slot + 1 + operand.size;
+			for (size_t item = slot + 1; item < end; item = nextOperand (item))
+			{
+				::Object tmp;
+				createXpdfObject (item, tmp);
+				// Array takes the content of the object
+				obj.arrayAdd (&tmp);
+			}
+			break;
+		}
+
+		case pDict:
+		{
+			obj.initDict ((XRef*)NULL);
+			size_t end = slot + 1 + operand.size;
+			for (size_t key = slot + 1; key < end; key = nextOperand (key + 1))
+			{
+				::Object tmp;
+				createXpdfObject (key + 1, tmp);
+				// Dictionary takes the key and the content of the object
+				obj.dictAdd (::copyString (getString (operands[key].value.offset)), &tmp);
+			}
+			break;
+		}
+
+		default:
+			assert (!"Bad type.");
+			throw ElementBadTypeException ("Bad compact operand type.");
+	}
+}
+
+//
+//
+//
+boost::shared_ptr<PdfOperator>
+CompactPdfOperators::createPdfOperator (size_t pos) const
+{
+	const Operator& op = operators[pos];
+
+	if (isInlineImage (op))
+	{
+		const StateUpdater::CheckTypes& chcktp = StateUpdater::getOp (op.opcode);
+		return boost::shared_ptr<PdfOperator> (new InlineImageCompositePdfOperator (images[op.data], chcktp.name, chcktp.endTag));
+	}
+
+	// Operands were checked when parsing
+	PdfOperator::Operands ops;
+	createOperands (pos, ops);
+	boost::shared_ptr<PdfOperator> result = createOperator (getName (op), ops);
+
+	if (isComposite (op))
+	{
+		// The same as in createPdfOperators
+		boost::shared_ptr<PdfOperator> previousLast = result;
+		for (size_t child = pos + 1; child < op.end; child = operators[child].end)
+		{
+			boost::shared_ptr<PdfOperator> newop = createPdfOperator (child);
+			result->push_back (newop, previousLast);
+			previousLast = getLastOperator (newop);
+		}
+	}
+
+	return result;
+}
+
+//
+//
+//
+void
+CompactPdfOperators::createPdfOperators (Operators& ops) const
+{
+	ops.clear ();
+	if (operators.empty())
+		return;
+
+	boost::shared_ptr<PdfOperator> topoperator (new UnknownCompositePdfOperator ("",""));	
+	boost::shared_ptr<PdfOperator> previousLast = topoperator;
+	for (size_t pos = 0; pos < operators.size(); pos = operators[pos].end)
+	{
+		boost::shared_ptr<PdfOperator> newop = createPdfOperator (pos);
+		topoperator->push_back (newop, previousLast);
+		previousLast = getLastOperator (newop);
+	}
+
+	topoperator->getChildren (ops);
+	// Set prev of first valid operator to NULL
+	PdfOperator::getIterator (topoperator).next().getCurrent()->setPrev (PdfOperator::ListItem ());
+}
+
+//
+//
+//
+void
+CompactPdfOperators::getStringRepresentation (std::string& str) const
+{
+	str.clear ();
+	for (size_t pos = 0; pos < operators.size(); pos = operators[pos].end)
+	{
+		getOperatorString (pos, str);
+		str += " ";
+	}
+}
+
+//
+//
+//
+void
+CompactPdfOperators::getOperatorString (size_t pos, std::string& str) const
+{
+	const Operator& op = operators[pos];
+
+	// The same as InlineImageCompositePdfOperator
+	if (isInlineImage (op))
+	{
+		const StateUpdater::CheckTypes& chcktp = StateUpdater::getOp (op.opcode);
+		str += chcktp.name; str += "\n";
+		if (images[op.data])
+		{
+			std::string tmp;
+			images[op.data]->getStringRepresentation (tmp);	
+			str += tmp;
+		}else
+		{
+			assert (!"Bad inline image.");
+			throw CObjInvalidObject ();
+		}
+		str += chcktp.endTag; str += "\n";
+		return;
+	}
+
+	// The same as UnknownCompositePdfOperator
+	if (isComposite (op))
+	{
+		str += getName (op); str += " ";
+		for (size_t child = pos + 1; child < op.end; child = operators[child].end)
+		{
+			getOperatorString (child, str);
+			str += " ";
+		}
+		return;
+	}
+
+	// The same as SimpleGenericOperator
+	size_t slot = op.operand;
+	for (size_t i = 0; i < op.operandCount; ++i, slot = nextOperand (slot))
+	{
+		getOperandString (slot, str);
+		str += " ";
+	}
+	str += getName (op);
+}
+
+//
+//
+//
+void
+CompactPdfOperators::getOperandString (size_t slot, std::string& str) const
+{
+	const Operand& operand = operands[slot];
+	std::string tmp;
+	switch (operand.type)
+	{
+		case pNull:
+			simpleValueToString<pNull> (NullType (), tmp);
+			break;
+
+		case pBool:
+			simpleValueToString<pBool> (operand.value.boolean, tmp);
+			break;
+
+		case pInt:
+			simpleValueToString<pInt> (operand.value.integer, tmp);
+			break;
+
+		case pReal:
+			simpleValueToString<pReal> (operand.value.real, tmp);
+			break;
+
+		case pString:
+			simpleValueToString<pString> (std::string (getString (operand.value.offset), operand.size), tmp);
+			break;
+
+		case pName:
+			simpleValueToString<pName> (std::string (getString (operand.value.offset), operand.size), tmp);
+			break;
+
+		case pRef:
+			simpleValueToString<pRef> (IndiRef (operand.value.ref.num, operand.value.ref.gen), tmp);
+			break;
+
+		case pArray:
+		{
+			// The same as CArray
+			str += Specification::CARRAY_PREFIX;
+			size_t end = slot + 1 + operand.size;
+			for (size_t item = slot + 1; item < end; item = nextOperand (item))
+			{
+				str += Specification::CARRAY_MIDDLE;
+				getOperandString (item, str);
+			}
+			str += Specification::CARRAY_SUFFIX;
+			return;
+		}
+
+		case pDict:
+		{
+			// The same as CDict
+			str += Specification::CDICT_PREFIX;
+			size_t end = slot + 1 + operand.size;
+			for (size_t key = slot + 1; key < end; key = nextOperand (key + 1))
+			{
+				const char* name = getString (operands[key].value.offset);
+				str += Specification::CDICT_MIDDLE + makeNamePdfValid (name, name + operands[key].size)
+					+ Specification::CDICT_BETWEEN_NAMES;
+				getOperandString (key + 1, str);
+			}
+			str += Specification::CDICT_SUFFIX;
+			return;
+		}
+
+		default:
+			assert (!"Bad type.");
+			throw ElementBadTypeException ("Bad compact operand type.");
+	}
+	str += tmp;
+}
+
+
+//==========================================================
+// Observer interface
+//==========================================================
+
+//
+// CContentStream observer
+//
+
+//
+//
+//
+void 
+CContentStream::CStreamObserver::notify (boost::shared_ptr<IProperty> newValue, 
+									boost::shared_ptr<const IProperty::ObserverContext>) const 
+throw ()
+{
+	try {
+
+	utilsPrintDbg (debug::DBG_DBG, "");
+	// Check if the property has correct values if it exists (it could be
+	// deleted and newValue is NULL
+	if (newValue)
+	{
+		assert (hasValidPdf (newValue));
+		assert (hasValidRef (newValue));
+	}
+
+	// Stream has changed, reparse it
+	contentstream->reparse ();
+	
+	}catch (...)
+	{
+		assert (!"This is very very bad because this function can't throw according to the interface.");
+	}
+}
+
+//
+// Operand observer
+//
+
+//
+//
+//
+void 
+CContentStream::OperandObserver::notify (boost::shared_ptr<IProperty> newValue, 
+										  boost::shared_ptr<const IProperty::ObserverContext>) const 
+throw ()
+{
+		if (_locked) 
+			return;
+
+	try {
+
+		utilsPrintDbg (debug::DBG_DBG, "");
+		
+		assert (newValue);
+		if (!isNull(newValue)) 
+		{ // We could have deleted a property
+			assert (hasValidPdf (newValue));
+			assert (hasValidRef (newValue));
+		}
+
+		// Stream has changed, save it
+		contentstream->_operandChanged (newValue);
+		contentstream->saveChange ();
+		
+	}catch (ReadOnlyDocumentException&)
+	{
+		kernelPrintDbg (debug::DBG_WARN, "Catching read-only exception...");
+	}catch (...)
+	{
+		assert (!"This is very very bad because this function can't throw according to the interface.");
+	}
+}
+
+
+//==========================================================
+// CContentStream
+//==========================================================
+
+//
+// Constructors
+//
+CContentStream::CContentStream (boost::shared_ptr<GfxState> state, 
+		boost::shared_ptr<GfxResources> res) : parsed (false), bboxes (false), gfxstate (state), gfxres (res) {
+}
+
+CContentStream::CContentStream (CStreams& strs, 
+								boost::shared_ptr<GfxState> state, 
+								boost::shared_ptr<GfxResources> res) 
+	: parsed (false), bboxes (false), gfxstate (state), gfxres (res)
+{
+	kernelPrintDbg (DBG_DBG, "");
+	setStreams(strs);
+}
+
+void CContentStream::setStreams (CStreams& strs) {
+	
+	// cleanup
+	if (cstreamobserver)
+		unregisterCStreamObservers();
+
+	// If streams are empty return
+	if (strs.empty())
+		return;
+
+	// Check if streams are in a valid pdf
+	for (CStreams::const_iterator it = strs.begin(); it != strs.end(); ++it)
+	{
+		assert (hasValidPdf(*it) && hasValidRef(*it));
+		if (!hasValidPdf(*it) || !hasValidRef(*it))
+			throw CObjInvalidObject ();
+	}
+	
+	// Parse it into small objects
+	assert (gfxres);
+	assert (gfxstate);
+	
+	// Create cstream observer and register it on all operands
+	cstreamobserver = boost::shared_ptr<CStreamObserver> (new CStreamObserver (this));
+	// Create operand observer
+	operandobserver = boost::shared_ptr<OperandObserver> (new OperandObserver (this));
+	
+	// Move streams of this content stream from strs to cstreams
+	// 	-- our change is a content stream of its own, other streams are
+	// 	   taken up to the next change
+	// 	-- streams are parsed when needed
+	bool our_change = isChangeStream (strs.front());
+	do {
+		cstreams.push_back (strs.front());
+		strs.pop_front ();
+	}while (!our_change && !strs.empty() && !isChangeStream (strs.front()));
+	operators.clear ();
+	compact.clear ();
+	std::string ().swap (source);
+	edits.clear ();
+	operandOperators.clear ();
+	parsed = bboxes = false;
+	checkpoints.clear ();
+	changed.clear ();
+
+	// Register observer on all cstream
+	registerCStreamObservers ();
+}
+
+
+//
+// Helper methods
+//
+
+//
+//
+//
+void
+CContentStream::reparse (bool bboxOnly, boost::shared_ptr<GfxState> state, boost::shared_ptr<GfxResources> res)
+{
+	// Save resources if new
+	if (state)
+		gfxstate = state;
+	if (res)
+		gfxres = res;
+	
+	assert (gfxres);
+	assert (gfxstate);
+	
+	// Reparse it if needed
+	// 	-- streams are parsed when needed
+	if (!bboxOnly)
+	{
+		// Clear operators	
+		operators.clear ();
+		compact.clear ();
+		std::string ().swap (source);
+		edits.clear ();
+		operandOperators.clear ();
+		parsed = bboxes = false;
+		checkpoints.clear ();
+		changed.clear ();
+		return;
+	}
+	
+	// Save bounding boxes if somebody uses them
+	if (bboxes)
+	{
+		bboxes = false;
+		_updateBBoxes ();
+	}
+}
+
+//
+//
+//
+void
+CContentStream::_parse () const
+{
+	if (parsed)
+		return;
+	
+	if (!cstreams.empty())
+	{
+		kernelPrintDbg (DBG_DBG, "Parsing " << cstreams.size() << " stream(s).");
+		try {
+			compact.parse (cstreams);
+		}catch (...)
+		{
+			compact.clear ();
+			throw;
+		}
+	}
+	parsed = true;
+}
+
+//
+//
+//
+void
+CContentStream::_createPdfOperators () const
+{
+	_parse ();
+	if (compact.empty())
+		return;
+	
+	kernelPrintDbg (DBG_DBG, "Creating " << compact.size() << " pdf operators.");
+	assert (operators.empty());
+	assert (!cstreams.empty());
+	assert (gfxres);
+	assert (gfxstate);
+	
+	compact.createPdfOperators (operators);
+	
+	// Remember where the operators are in the source, so that unchanged
+	// operators can be saved verbatim
+	compact.swapSource (source);
+	size_t pos = 0;
+	for (OperatorIterator it = PdfOperator::getIterator (operators.front()); !it.isEnd(); it = it.next(), ++pos)
+	{
+		PdfOperator& op = *it.getCurrent();
+		compact.getSourceRange (pos, op._sourceBegin, op._sourceEnd);
+	}
+	assert (pos == compact.size());
+	compact.clear ();
+	bboxes = false;
+
+	// Set pdf ref and cs
+	boost::weak_ptr<CPdf> pdf = cstreams.front()->getPdf ();
+	assert (pdf.lock());
+	IndiRef rf = cstreams.front()->getIndiRef ();
+	opsSetPdfRefCs (operators.front(), pdf, rf, const_cast<CContentStream&> (*this), operandobserver);
+}
+
+//
+//
+//
+void
+CContentStream::_updateBBoxes () const
+{
+	_createPdfOperators ();
+	if (bboxes)
+		return;
+	
+	assert (gfxres);
+	assert (gfxstate);
+	assert (!gfxstate->isPath());
+	
+	// Save bounding boxes and checkpoints
+	checkpoints.clear ();
+	changed.clear ();
+	if (!operators.empty())
+		_updateBBoxes (PdfOperator::getIterator (operators.front()), gfxstate->copy (false), PdfOperator::BBox (), 0, NULL);
+	bboxes = true;
+}
+
+//
+//
+//
+void
+CContentStream::_updateBBoxes (OperatorIterator it, GfxState* state, PdfOperator::BBox rc, 
+							   size_t next, const PdfOperator* until) const
+{
+	assert (state);
+	utilsPrintDbg (debug::DBG_DBG, "");
+	
+	// Can we stop at a checkpoint
+	bool reached = false;
+	// Operators since the last checkpoint
+	size_t count = 0;
+
+	try {
+		
+		for (; !it.isEnd(); it = it.next())
+		{
+			boost::shared_ptr<PdfOperator> op = it.getCurrent ();
+
+			if (next < checkpoints.size() && checkpoints[next].op == op)
+			{ // Saved checkpoint
+				StateCheckpoint& cp = checkpoints[next];
+				if (reached && cp.rc == rc && sameBBoxState (state, cp.state.get()))
+				{ // Nothing changes from here
+					kernelPrintDbg (DBG_DBG, "State matches checkpoint " << next << " of " << checkpoints.size());
+					deleteGfxState (state);
+					return;
+				}
+				if (state->isCurPt())
+				{ // Path can not be saved
+					checkpoints.erase (checkpoints.begin() + next);
+				}else
+				{
+					cp.state.reset (state->copyWithSaves ());
+					cp.rc = rc;
+					++next;
+					count = 0;
+				}
+
+			}else if (CHECKPOINT_DISTANCE <= count && !state->isCurPt())
+			{ // New checkpoint
+				StateCheckpoint cp;
+				cp.op = op;
+				cp.state.reset (state->copyWithSaves ());
+				cp.rc = rc;
+				checkpoints.insert (checkpoints.begin() + next, cp);
+				++next;
+				count = 0;
+			}
+
+			// Update the state and bounding box
+			state = StateUpdater::updatePdfOperator (state, gfxres, op, rc);
+			assert (state);
+			BBoxUpdater () (op, rc, *state);
+			
+			++count;
+			if (op.get() == until)
+				reached = true;
+		}
+	
+	}catch (CObjInvalidObject&)
+	{
+		deleteGfxState (state);
+		throw;
+	}
+
+	// Remaining checkpoints are not in the stream anymore
+	checkpoints.erase (checkpoints.begin() + next, checkpoints.end());
+	deleteGfxState (state);
+}
+
+//
+//
+//
+void
+CContentStream::_updateChangedBBoxes () const
+{
+	if (!bboxes)
+	{
+		changed.clear ();
+		return;
+	}
+	
+	// Unknown changes
+	if (changed.empty() || changed.end() != std::find (changed.begin(), changed.end(), boost::shared_ptr<PdfOperator> ()))
+	{
+		kernelPrintDbg (DBG_DBG, "Updating all bounding boxes.");
+		bboxes = false;
+		_updateBBoxes ();
+		return;
+	}
+	
+	if (operators.empty())
+	{
+		checkpoints.clear ();
+		changed.clear ();
+		return;
+	}
 
+	// Checkpoint operators
+	std::set<const PdfOperator*> cpops;
+	for (StateCheckpoints::const_iterator it = checkpoints.begin(); it != checkpoints.end(); ++it)
+		cpops.insert (it->op.get());
 
-		if (parsedstreams)
-		{ // FIRST PARSE
-	
-			// Check if they match the input streams and delete them
-			CContentStream::CStreams::iterator itparsed = parsedstreams->begin (); 
-			for (; itparsed != parsedstreams->end(); ++itparsed)
-			{			
-				assert (*(streams.begin()) == *itparsed);
-				//streams.erase (streams.begin());
-				streams.pop_front();
+	//
+	// Find the last checkpoint before the first changed operator and the last
+	// changed operator (changed operators could have been removed meanwhile)
+	//
+	size_t next = checkpoints.size();
+	size_t lastnext = 0;
+	std::set<const PdfOperator*> lastops;
+	for (Operators::const_iterator ch = changed.begin(); ch != changed.end(); ++ch)
+	{
+		// Go back to the previous checkpoint or to the beginning
+		size_t cpnext = 0;
+		boost::shared_ptr<PdfOperator> first = *ch;
+		OperatorIterator it = PdfOperator::getIterator (*ch);
+		for (it.prev(); !it.isBegin(); it.prev())
+		{
+			first = it.getCurrent ();
+			if (cpops.end() != cpops.find (first.get()))
+			{
+				while (checkpoints[cpnext].op != first)
+					++cpnext;
+				++cpnext;
+				break;
 			}
 		}
-
-			assert (operands.empty());
-			assert (observer);
-		// Set pdf ref and cs
-		if (!operators.empty())
-			opsSetPdfRefCs (operators.front(), pdf, rf, cs, observer);
+		// Not in the stream anymore
+		if (0 == cpnext && first != operators.front())
+			continue;
+		
+		next = std::min (next, cpnext);
+		if (lastops.empty() || lastnext < cpnext)
+		{
+			lastnext = cpnext;
+			lastops.clear ();
+		}
+		if (lastnext == cpnext)
+			lastops.insert (ch->get());
 	}
-
-
-	//==========================================================
-	// Gfx state updater functors
-	//==========================================================
-
-	/**
- 	 * BBox updater.
-	 */
-	struct BBoxUpdater 
+	if (lastops.empty())
 	{
-		typedef PdfOperator::BBox BBox;
-
-		// Init resources
-		void operator() (boost::shared_ptr<GfxResources>) const {}
-
-		// Loop through operators
-		void operator() (boost::shared_ptr<PdfOperator> op, BBox rc, const GfxState&) const
+		changed.clear ();
+		return;
+	}
+	boost::shared_ptr<PdfOperator> last;
+	OperatorIterator it = PdfOperator::getIterator ((0 == lastnext) ? operators.front() : checkpoints[lastnext - 1].op);
+	for (size_t found = 0; !it.isEnd() && found < lastops.size(); it = it.next())
+	{
+		if (lastops.end() != lastops.find (it.getCurrent().get()))
 		{
-			// If not initialized, means an error occured (missing font etc..)
-			if (!BBox::isInitialized (rc))
-				rc.xleft = rc.xright = rc.yleft = rc.yright = 0;
-			op->setBBox (rc);
+			last = it.getCurrent ();
+			++found;
 		}
-	};
-
+	}
+	changed.clear ();
+	assert (last);
 	
-//==========================================================
-} // namespace
-//==========================================================
-
-//==========================================================
-// Observer interface
-//==========================================================
-
-//
-// CContentStream observer
-//
+	// Update from the checkpoint and stop behind the last changed operator
+	// where the state matches again
+	const PdfOperator* until = getLastOperator (last).get();
+	kernelPrintDbg (DBG_DBG, "Updating bounding boxes from checkpoint " << next << " of " << checkpoints.size());
+	try {
+		if (0 == next)
+		{
+			_updateBBoxes (PdfOperator::getIterator (operators.front()), gfxstate->copy (false), PdfOperator::BBox (), 0, until);
+		}else
+		{
+			const StateCheckpoint& cp = checkpoints[next - 1];
+			_updateBBoxes (PdfOperator::getIterator (cp.op), cp.state->copyWithSaves (), cp.rc, next, until);
+		}
+	
+	}catch (...)
+	{
+		bboxes = false;
+		checkpoints.clear ();
+		throw;
+	}
+}
 
 //
 //
 //
-void 
-CContentStream::CStreamObserver::notify (boost::shared_ptr<IProperty> newValue, 
-									boost::shared_ptr<const IProperty::ObserverContext>) const 
-throw ()
+void
+CContentStream::_operandChanged (boost::shared_ptr<IProperty> operand)
 {
-	try {
+	if (operators.empty())
+		return;
 
-	utilsPrintDbg (debug::DBG_DBG, "");
-	// Check if the property has correct values if it exists (it could be
-	// deleted and newValue is NULL
-	if (newValue)
+	// Map operands to their operators
+	PdfOperator::Operands ops;
+	if (operandOperators.empty())
 	{
-		assert (hasValidPdf (newValue));
-		assert (hasValidRef (newValue));
+		for (OperatorIterator it = PdfOperator::getIterator (operators.front()); !it.isEnd(); it = it.next())
+		{
+			if (0 == it.getCurrent()->getParametersCount())
+				continue;
+			ops.clear ();
+			it.getCurrent()->getParameters (ops);
+			for (PdfOperator::Operands::const_iterator o = ops.begin(); o != ops.end(); ++o)
+				operandOperators[o->get()] = it.getCurrent();
+		}
 	}
 
-	// Stream has changed, reparse it
-	contentstream->reparse ();
-	
-	}catch (...)
+	// Find the operator of the operand
+	OperandOperators::const_iterator found = operandOperators.find (operand.get());
+	if (operandOperators.end() != found)
 	{
-		assert (!"This is very very bad because this function can't throw according to the interface.");
+		boost::shared_ptr<PdfOperator> op = found->second.lock ();
+		ops.clear ();
+		if (op)
+			op->getParameters (ops);
+		if (ops.end() != std::find (ops.begin(), ops.end(), operand))
+		{
+			_clearSource (op);
+			_operatorChanged (op);
+			return;
+		}
 	}
-}
 
-//
-// Operand observer
-//
+	// Not found, update everything
+	_operatorChanged (boost::shared_ptr<PdfOperator> ());
+}
 
 //
 //
 //
-void 
-CContentStream::OperandObserver::notify (boost::shared_ptr<IProperty> newValue, 
-										  boost::shared_ptr<const IProperty::ObserverContext>) const 
-throw ()
+void
+CContentStream::_forgetOperator (boost::shared_ptr<PdfOperator> op)
 {
-		if (_locked) 
-			return;
-
-	try {
-
-		utilsPrintDbg (debug::DBG_DBG, "");
-		
-		assert (newValue);
-		if (!isNull(newValue)) 
-		{ // We could have deleted a property
-			assert (hasValidPdf (newValue));
-			assert (hasValidRef (newValue));
+	// Operator and its children
+	std::set<const PdfOperator*> ops;
+	PdfOperator::Operands operands;
+	boost::shared_ptr<PdfOperator> lastop = getLastOperator (op);
+	for (OperatorIterator it = PdfOperator::getIterator (op); !it.isEnd(); it = it.next())
+	{
+		ops.insert (it.getCurrent().get());
+		edits.erase (it.getCurrent());
+		if (!operandOperators.empty())
+		{
+			operands.clear ();
+			it.getCurrent()->getParameters (operands);
+			for (PdfOperator::Operands::const_iterator o = operands.begin(); o != operands.end(); ++o)
+				operandOperators.erase (o->get());
 		}
+		if (it.getCurrent() == lastop)
+			break;
+	}
 
-		// Stream has changed, reparse it
-		contentstream->saveChange ();
-		
-	}catch (ReadOnlyDocumentException&)
+	StateCheckpoints::iterator it = checkpoints.begin();
+	while (it != checkpoints.end())
 	{
-		kernelPrintDbg (debug::DBG_WARN, "Catching read-only exception...");
-	}catch (...)
-	{
-		assert (!"This is very very bad because this function can't throw according to the interface.");
+		if (ops.end() != ops.find (it->op.get()))
+			it = checkpoints.erase (it);
+		else
+			++it;
 	}
 }
 
-
-//==========================================================
-// CContentStream
-//==========================================================
-
 //
-// Constructors
 //
-CContentStream::CContentStream (boost::shared_ptr<GfxState> state, 
-		boost::shared_ptr<GfxResources> res) : gfxstate (state), gfxres (res) {
-}
-
-CContentStream::CContentStream (CStreams& strs, 
-								boost::shared_ptr<GfxState> state, 
-								boost::shared_ptr<GfxResources> res) 
-	: gfxstate (state), gfxres (res)
+//
+void
+CContentStream::_clearSource (boost::shared_ptr<PdfOperator> op)
 {
-	kernelPrintDbg (DBG_DBG, "");
-	setStreams(strs);
+	boost::shared_ptr<PdfOperator> lastop = getLastOperator (op);
+	for (OperatorIterator it = PdfOperator::getIterator (op); !it.isEnd(); it = it.next())
+	{
+		it.getCurrent()->_sourceBegin = it.getCurrent()->_sourceEnd = 0;
+		if (it.getCurrent() == lastop)
+			break;
+	}
 }
 
-void CContentStream::setStreams (CStreams& strs) {
-	
-	// cleanup
-	if (cstreamobserver)
-		unregisterCStreamObservers();
-
-	// If streams are empty return
-	if (strs.empty())
+//
+//
+//
+void
+CContentStream::_mapOperands (boost::shared_ptr<PdfOperator> op)
+{
+	if (operandOperators.empty())
 		return;
 
-	// Check if streams are in a valid pdf
-	for (CStreams::const_iterator it = strs.begin(); it != strs.end(); ++it)
+	PdfOperator::Operands ops;
+	boost::shared_ptr<PdfOperator> lastop = getLastOperator (op);
+	for (OperatorIterator it = PdfOperator::getIterator (op); !it.isEnd(); it = it.next())
 	{
-		assert (hasValidPdf(*it) && hasValidRef(*it));
-		if (!hasValidPdf(*it) || !hasValidRef(*it))
-			throw CObjInvalidObject ();
+		ops.clear ();
+		it.getCurrent()->getParameters (ops);
+		for (PdfOperator::Operands::const_iterator o = ops.begin(); o != ops.end(); ++o)
+			operandOperators[o->get()] = it.getCurrent();
+		if (it.getCurrent() == lastop)
+			break;
 	}
-	
-	// Parse it into small objects
-	assert (gfxres);
-	assert (gfxstate);
-	
-	// Create cstream observer and register it on all operands
-	cstreamobserver = boost::shared_ptr<CStreamObserver> (new CStreamObserver (this));
-	// Create operand observer
-	operandobserver = boost::shared_ptr<OperandObserver> (new OperandObserver (this));
-	
-	// Parse it, move parsed streams from strs to cstreams
-	parse (operators, strs, *this, operandobserver, &cstreams);
-	
-	// Save bounding boxes
-	if (!operators.empty()) 
-		StateUpdater::updatePdfOperators (PdfOperator::getIterator (operators.front()), gfxres, *gfxstate, BBoxUpdater());
-
-	// Register observer on all cstream
-	registerCStreamObservers ();
 }
 
-
-//
-// Helper methods
-//
-
 //
 //
 //
-void
-CContentStream::reparse (bool bboxOnly, boost::shared_ptr<GfxState> state, boost::shared_ptr<GfxResources> res)
+bool
+CContentStream::getLastOperands (const std::string& name, PdfOperator::Operands& ops) const
 {
-	// Save resources if new
-	if (state)
-		gfxstate = state;
-	if (res)
-		gfxres = res;
-	
-	assert (gfxres);
-	assert (gfxstate);
-	
-	// Reparse it if needed
-	if (!bboxOnly)
+	// Pdf operators are not needed
+	_parse ();
+	if (!compact.empty())
 	{
-		// Clear operators	
-		operators.clear ();
-		parse (operators, cstreams, *this, operandobserver);
+		size_t pos = compact.findLast (name);
+		if (pos == compact.size())
+			return false;
+		ops.clear ();
+		compact.createOperands (pos, ops);
+		return true;
 	}
-	
-	// Save bounding boxes
-	if (!operators.empty()) 
-		StateUpdater::updatePdfOperators (PdfOperator::getIterator (operators.front()), gfxres, *gfxstate, BBoxUpdater());
+
+	if (operators.empty())
+		return false;
+
+	bool found = false;
+	OperatorIterator it = PdfOperator::getIterator (operators.front());
+	while (!it.isEnd())
+	{
+		if (isPdfOp (*it.getCurrent(), name))
+		{
+			ops.clear ();
+			it.getCurrent()->getParameters (ops);
+			found = true;
+		}
+		it.next();
+	}
+	return found;
 }
 
 //
@@ -659,6 +1674,7 @@ void
 CContentStream::replaceText (const std::string& what, const std::string& with)
 {
 	bool dirty = false;
+	_createPdfOperators ();
 		if (operators.empty())
 			return;
 
@@ -685,10 +1701,110 @@ CContentStream::replaceText (const std::string& what, const std::string& with)
 
 	operandobserver->unlock();
 	if (dirty)
+	{
+		_operatorChanged (boost::shared_ptr<PdfOperator> ());
 		_objectChanged();
+	}
 }
 
 
+//
+//
+//
+void
+CContentStream::_serialize (std::string& str) const
+{
+	str.clear ();
+	if (operators.empty())
+	{
+		getStringRepresentation (str);
+		std::string ().swap (source);
+		edits.clear ();
+		return;
+	}
+
+	//
+	// Unknown changes, write all operators and use them as the source
+	//
+	if (source.empty() || changed.empty() 
+			|| changed.end() != std::find (changed.begin(), changed.end(), boost::shared_ptr<PdfOperator> ()))
+	{
+		kernelPrintDbg (DBG_DBG, "Saving all operators.");
+		for (OperatorIterator it = PdfOperator::getIterator (operators.front()); !it.isEnd(); it = it.next())
+		{
+			PdfOperator& op = *it.getCurrent();
+			op._sourceBegin = str.size();
+			appendOperator (str, op);
+			op._sourceEnd = str.size();
+		}
+		source = str;
+		edits.clear ();
+		return;
+	}
+
+	//
+	// Find unchanged operators around edited ones, the source between them
+	// is replaced by operators in between
+	//
+	kernelPrintDbg (DBG_DBG, "Saving " << edits.size() << " edited operators.");
+	typedef std::pair<boost::shared_ptr<PdfOperator>, boost::shared_ptr<PdfOperator> > Bounds;
+	std::vector<Bounds> bounds;
+	for (std::set<boost::shared_ptr<PdfOperator> >::const_iterator ed = edits.begin(); ed != edits.end(); ++ed)
+	{
+		boost::shared_ptr<PdfOperator> prev, next;
+		OperatorIterator it = PdfOperator::getIterator (*ed);
+		for (it.prev(); !it.isBegin(); it.prev())
+		{
+			if (_hasSource (*it.getCurrent()))
+				{ prev = it.getCurrent(); break; }
+		}
+		it = PdfOperator::getIterator (*ed);
+		for (it.next(); !it.isEnd(); it.next())
+		{
+			if (_hasSource (*it.getCurrent()))
+				{ next = it.getCurrent(); break; }
+		}
+		if (_hasSource (**ed))
+		{ // Operators next to it could have been removed
+			bounds.push_back (Bounds (prev, *ed));
+			bounds.push_back (Bounds (*ed, next));
+		}else
+			bounds.push_back (Bounds (prev, next));
+	}
+
+	SourceEdits replaced;
+	for (std::vector<Bounds>::const_iterator bd = bounds.begin(); bd != bounds.end(); ++bd)
+	{
+		size_t begin = (bd->first) ? bd->first->_sourceEnd : 0;
+		if (replaced.end() != replaced.find (begin))
+			continue;
+		SourceEdit& edit = replaced[begin];
+		edit.end = (bd->second) ? bd->second->_sourceBegin : source.size();
+		OperatorIterator it = PdfOperator::getIterator ((bd->first) ? bd->first : operators.front());
+		if (bd->first)
+			it.next ();
+		for (; !it.isEnd() && it.getCurrent() != bd->second; it.next())
+			edit.ops.push_back (it.getCurrent());
+	}
+
+	//
+	// Copy the source and write edited operators
+	//
+	str.reserve (source.size());
+	size_t pos = 0;
+	for (SourceEdits::const_iterator edit = replaced.begin(); edit != replaced.end(); ++edit)
+	{
+		if (edit->first == edit->second.end && edit->second.ops.empty())
+			continue;
+		str.append (source, pos, edit->first - pos);
+		separateContent (str, edit->first == source.size());
+		for (Operators::const_iterator op = edit->second.ops.begin(); op != edit->second.ops.end(); ++op)
+			appendOperator (str, **op);
+		pos = edit->second.end;
+	}
+	str.append (source, pos, std::string::npos);
+}
+
 //
 //
 //
@@ -719,7 +1835,7 @@ CContentStream::_objectChanged ()
 	try {
 		// Save it
 		string tmp;
-		getStringRepresentation (tmp);
+		_serialize (tmp);
 		assert (!cstreams.empty());
 		CStreams::iterator it = cstreams.begin();
 		assert (it != cstreams.end());
@@ -743,8 +1859,8 @@ CContentStream::_objectChanged ()
 	// 
 	registerCStreamObservers ();
 	
-	// Update bboxes
-	reparse (true);
+	// Update bboxes of changed operators
+	_updateChangedBBoxes ();
 
 	// Notify observers
 	boost::shared_ptr<CContentStream> current (this, EmptyDeallocator<CContentStream> ());
@@ -765,14 +1881,17 @@ void
 CContentStream::deleteOperator (OperatorIterator it, bool indicateChange)
 {
 	kernelPrintDbg (debug::DBG_DBG, "");
-	assert (!operators.empty());
 	assert (!cstreams.empty());
 
 	// Check whether we can make the change
 	cstreams.front()->canChange();
+	// operators are created lazily, so they can be checked only now
+	_createPdfOperators ();
+	assert (!operators.empty());
 	
 	// Be sure that the operator won't get deallocated along the way
 	boost::shared_ptr<PdfOperator> toDel = it.getCurrent ();
+	_forgetOperator (toDel);
 	
 	//
 	// Remove it from operators or composite
@@ -820,6 +1939,8 @@ CContentStream::deleteOperator (OperatorIterator it, bool indicateChange)
 		itNxt.getCurrent()->setPrev (prv);
 	if (!itPrv.isBegin())
 		itPrv.getCurrent()->setNext (nxt);
+	// State changes before the next operator
+	_operatorChanged (nxt ? nxt : prv);
 
 	//
 	// To be sure
@@ -854,24 +1975,30 @@ CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperat
 
 	// Check whether we can make the change
 	cstreams.front()->canChange();
+	_createPdfOperators ();
+
+	// Set correct IndiRef, CPdf and cs to inserted operator
+	assert (hasValidRef (cstreams.front()));
+	assert (hasValidPdf (cstreams.front()));
+	boost::weak_ptr<CPdf> pdf = cstreams.front()->getPdf();
+	assert (pdf.lock());
+	IndiRef rf = cstreams.front()->getIndiRef ();
+	opsSetPdfRefCs (newOper, pdf, rf, *this, operandobserver);
 
 	// Insert into empty contentstream
 	if (operators.empty ())
 	{
 		assert (!it.valid());
 		operators.push_back (newOper);
+		_clearSource (newOper);
+		_mapOperands (newOper);
+		_operatorChanged (newOper);
+		// notify observers and dispatch the change
+		if (indicateChange)
+			_objectChanged ();
 		return;
 	}
 	assert (!it.isEnd());
-	assert (!cstreams.empty());
-
-	// Set correct IndiRef, CPdf and cs to inserted operator
-	assert (hasValidRef (cstreams.front()));
-	assert (hasValidPdf (cstreams.front()));
-	boost::weak_ptr<CPdf> pdf = cstreams.front()->getPdf();
-	assert (pdf.lock());
-	IndiRef rf = cstreams.front()->getIndiRef ();
-	opsSetPdfRefCs (newOper, pdf, rf, *this, operandobserver);
 
 	//
 	// Insert into operators or composite
@@ -913,11 +2040,16 @@ CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperat
 	itCur.getCurrent()->setNext (newOper);
 	newOper->setPrev (itCur.getCurrent());
 	
+	// Children of a composite stay between it and the next operator
+	boost::shared_ptr<PdfOperator> lastOfNew = getLastOperator (newOper);
 	if (!itNxt.isEnd())
 	{
-		itNxt.getCurrent()->setPrev (newOper);
-		newOper->setNext (itNxt.getCurrent());
+		itNxt.getCurrent()->setPrev (lastOfNew);
+		lastOfNew->setNext (itNxt.getCurrent());
 	}
+	_clearSource (newOper);
+	_mapOperands (newOper);
+	_operatorChanged (newOper);
 
 	// If indicateChange is true, pdf&rf&contenstream is set when reparsing
 	if (indicateChange)
@@ -948,6 +2080,7 @@ CContentStream::frontInsertOperator (boost::shared_ptr<PdfOperator> newoper,
 
 	// Check whether we can make the change
 	cstreams.front()->canChange();
+	_createPdfOperators ();
 	IndiRef rf = cstreams.front()->getIndiRef ();
 	boost::weak_ptr<CPdf> pdf = cstreams.front()->getPdf();
 	assert (pdf.lock());
@@ -967,6 +2100,9 @@ CContentStream::frontInsertOperator (boost::shared_ptr<PdfOperator> newoper,
 		secondoper->setPrev (lastofnew);
 		lastofnew->setNext (secondoper);
 	}
+	_clearSource (newoper);
+	_mapOperands (newoper);
+	_operatorChanged (newoper);
 
 	// If indicateChange is true, pdf&rf&contenstream is set when reparsing
 	if (indicateChange)
@@ -992,14 +2128,17 @@ CContentStream::replaceOperator (OperatorIterator it,
 		bool indicateChange)
 {
 	kernelPrintDbg (debug::DBG_DBG, "");
-	assert (!operators.empty());
 	assert (!cstreams.empty());
 
 	// Check whether we can make the change
 	cstreams.front()->canChange();
+	// operators are created lazily, so they can be checked only now
+	_createPdfOperators ();
+	assert (!operators.empty());
 
 	// Be sure that the operator won't get deallocated along the way
 	boost::shared_ptr<PdfOperator> toReplace = it.getCurrent ();
+	_forgetOperator (toReplace);
 	
 	// Set correct IndiRef, CPdf and cs to inserted operator
 	assert (hasValidRef (cstreams.front()));
@@ -1069,6 +2208,9 @@ CContentStream::replaceOperator (OperatorIterator it,
 	//
 	toReplace->setPrev (PdfOperator::ListItem());
 	getLastOperator(toReplace)->setNext (PdfOperator::ListItem());
+	_clearSource (newOper);
+	_mapOperands (newOper);
+	_operatorChanged (newOper);
 	
 	// If indicateChange is true, pdf&rf&contenstream is set when reparsing
 	if (indicateChange)
@@ -41,8 +41,208 @@ namespace pdfobjects {
 //
 class CContentStream;
 class CStream;
+class CInlineImage;
 typedef observer::ObserverHandler<CContentStream> CContentStreamObserverSubject;
 
+
+//==========================================================
+// CompactPdfOperators
+//==========================================================
+
+/**
+ * Compact representation of parsed content stream operators.
+ *
+ * Creating a PdfOperator with IProperty operands for every operator is
+ * expensive (a map page can contain hundreds of thousands of path operators).
+ * Content stream is parsed into this structure instead and pdf operators are
+ * created from it only when somebody asks for them.
+ *
+ * Operators and operands are stored in arrays which serve as an arena (there is
+ * no allocation per object). An operator is identified by its code (index in
+ * StateUpdater::KNOWN_OPERATORS), its operands are stored inline and strings
+ * and names are kept in a character pool. Composite operator is followed by
+ * its children including its end tag, array and dictionary operands are
+ * followed by their items (key and value for dictionaries).
+ *
+ * Operators are in the same order as pdf operators returned by iterators.
+ */
+class CompactPdfOperators
+{
+public:
+	typedef std::list<boost::shared_ptr<PdfOperator> > Operators;
+	typedef std::list<boost::shared_ptr<CStream> > CStreams;
+
+	/** Code of an operator which is not in the known operators. */
+	static const int UNKNOWN_OPCODE = -1;
+
+	/** Operand stored inline. */
+	struct Operand
+	{
+		unsigned char type;		/**< Property type of the operand. */
+		unsigned int size;		/**< String length or number of slots taken by items of a complex operand. */
+		union
+		{
+			bool boolean;
+			int integer;
+			double real;
+			size_t offset;		/**< Offset of a string or a name in the pool. */
+			struct { int num; int gen; } ref;
+		} value;
+	};
+
+	/** Operator stored in the arena. */
+	struct Operator
+	{
+		int opcode;					/**< Operator code or UNKNOWN_OPCODE. */
+		unsigned int operandCount;	/**< Number of operands (items of complex operands not included). */
+		size_t operand;				/**< Slot of the first operand. */
+		size_t data;				/**< Name offset in the pool for unknown operators, image index for inline images. */
+		size_t end;					/**< Index of the operator following this operator and all its children. */
+		size_t start;				/**< Position of the operator (or its first operand) in the source. */
+	};
+
+private:
+	/** Operators. */
+	std::vector<Operator> operators;
+	/** Operand slots. */
+	std::vector<Operand> operands;
+	/** Pool of strings and names. */
+	std::vector<char> pool;
+	/** Inline images. They are rare, so they are parsed immediately. */
+	std::vector<boost::shared_ptr<CInlineImage> > images;
+	/** Decoded data of the parsed streams. */
+	std::string source;
+	/** End of the last operator in the source. */
+	size_t sourceEnd;
+
+	//
+	// Parsing
+	//
+public:
+	/** Constructor. */
+	CompactPdfOperators () : sourceEnd (0) {}
+
+	/**
+	 * Parse streams into compact operators.
+	 *
+	 * Parsing follows the rules of pdf operator parsing. If the content stream
+	 * is invalid, only the complete first level operators before the error are
+	 * kept.
+	 *
+	 * @param streams Streams to be parsed.
+	 */
+	void parse (const CStreams& streams);
+
+	/** Remove all operators and release the memory. */
+	void clear ();
+
+private:
+	/** Store xpdf object as an operand. Items of complex objects are stored recursively. */
+	void addOperand (::Object& obj);
+	/** Store string to the pool and return its offset. */
+	size_t addString (const char* str, size_t len);
+	/** 
+	 * Check operand count and types against the specification and convert 
+	 * integers to reals where reals are expected (see checkAndFixOperator).
+	 */
+	bool checkOperands (int opcode, size_t first, size_t count);
+	
+	//
+	// Accessors
+	//
+public:
+	/** Is there any operator. */
+	bool empty () const
+		{ return operators.empty (); }
+
+	/** Get number of operators (including children of composites). */
+	size_t size () const
+		{ return operators.size (); }
+
+	/** Get compact operator. */
+	const Operator& getOperator (size_t pos) const
+		{ return operators[pos]; }
+
+	/** 
+	 * Get source range of an operator. 
+	 *
+	 * The range contains the operator with its operands and all whitespace
+	 * and comments up to the next operator. The first operator starts at the
+	 * beginning of the source. Children of a composite are not included in
+	 * the range of the composite.
+	 */
+	void getSourceRange (size_t pos, size_t& begin, size_t& end) const
+	{
+		begin = (0 == pos) ? 0 : operators[pos].start;
+		end = (pos + 1 < operators.size()) ? operators[pos + 1].start : sourceEnd;
+	}
+
+	/** Exchange the source with the string. */
+	void swapSource (std::string& str)
+		{ source.swap (str); }
+
+	/** Get operator name. */
+	void getOperatorName (size_t pos, std::string& name) const;
+
+	/**
+	 * Find the last operator with the name.
+	 *
+	 * @return Position of the operator, size() if not found.
+	 */
+	size_t findLast (const std::string& name) const;
+
+	/**
+	 * Create operands of an operator.
+	 *
+	 * @param pos Position of the operator.
+	 * @param ops Output container. New objects are appended.
+	 */
+	void createOperands (size_t pos, PdfOperator::Operands& ops) const;
+
+	/**
+	 * Create first level pdf operators. 
+	 *
+	 * Operators are linked to the iterator queue, children are added to their
+	 * composites.
+	 *
+	 * @param ops Output container.
+	 */
+	void createPdfOperators (Operators& ops) const;
+
+	/**
+	 * Get the string representation of all operators.
+	 *
+	 * It is the same as the representation of pdf operators created from this
+	 * object.
+	 *
+	 * @param str Output string.
+	 */
+	void getStringRepresentation (std::string& str) const;
+
+private:
+	/** Slot of the operand following the operand in the slot. */
+	size_t nextOperand (size_t slot) const
+		{ return slot + 1 + ((pArray == operands[slot].type || pDict == operands[slot].type) ? operands[slot].size : 0); }
+	/** Create property from the operand in the slot. */
+	IProperty* createProperty (size_t slot) const;
+	/** Initialize xpdf object from the operand in the slot. */
+	void createXpdfObject (size_t slot, ::Object& obj) const;
+	/** Create pdf operator (including its children). */
+	boost::shared_ptr<PdfOperator> createPdfOperator (size_t pos) const;
+	/** Append the string representation of an operand. */
+	void getOperandString (size_t slot, std::string& str) const;
+	/** Append the string representation of an operator. */
+	void getOperatorString (size_t pos, std::string& str) const;
+	/** Get string from the pool. */
+	const char* getString (size_t offset) const;
+	/** Get operator name. */
+	const char* getName (const Operator& op) const;
+	/** Is the operator a composite with children. */
+	bool isComposite (const Operator& op) const;
+	/** Is the operator an inline image. */
+	bool isInlineImage (const Operator& op) const;
+};
+
 //==========================================================
 // CContentStream
 //==========================================================
@@ -69,7 +269,16 @@ typedef observer::ObserverHandler<CContentStream> CContentStreamObserverSubject;
  * Operators form a tree-like structure consisting of Simple and Composite objects. 
  * 
  * Only first level operators are stored.
- * 
+ *
+ * Streams are parsed when the content stream is used for the first time, into
+ * compact operators (see CompactPdfOperators). Pdf operator objects are created
+ * when the first operator is requested or the content stream is changed.
+ * Bounding boxes are computed only for getPdfOperators and
+ * getOperatorsAtPosition and then kept up to date. Graphical states are saved
+ * every few operators, so after a change the state is updated only from the
+ * saved state before the changed operator until the state matches a saved one
+ * again.
+ *
  * The pdf feature that a content stream can consist of several streams means we
  * can not derive from CStream object. Due to this limitation we do not have 
  * Observer interface so we need to implement it.
@@ -102,8 +311,61 @@ private:
 	/** Underlying cstream objects. */
 	CStreams cstreams;
 
-	/** Parsed first level content stream operators. */
-	Operators operators;
+	/** 
+	 * Parsed first level content stream operators. 
+	 * They are created from compact operators when needed. 
+	 */
+	mutable Operators operators;
+	/** Compact operators. Empty after pdf operators have been created. */
+	mutable CompactPdfOperators compact;
+	/** 
+	 * Decoded data the pdf operators were parsed from (or saved to if all of
+	 * them had to be written again). Unchanged operators are saved by copying
+	 * their ranges of this data.
+	 */
+	mutable std::string source;
+	/**
+	 * Operators edited since the source was set: changed and inserted
+	 * operators and neighbours of removed ones. Only the source around them
+	 * is replaced when saving.
+	 */
+	mutable std::set<boost::shared_ptr<PdfOperator> > edits;
+	/** Operators of operands. Created when an operand changes. */
+	typedef std::map<const IProperty*, boost::weak_ptr<PdfOperator> > OperandOperators;
+	OperandOperators operandOperators;
+	/** True if cstreams have been parsed. */
+	mutable bool parsed;
+	/** True if bounding boxes of pdf operators are valid. */
+	mutable bool bboxes;
+
+	/**
+	 * Graphical state before an operator.
+	 *
+	 * Saved when bounding boxes are set (never inside a path) so that the
+	 * state update can be restarted near a changed operator.
+	 */
+	struct StateCheckpoint
+	{
+		/** Operator before which the state is saved. */
+		boost::shared_ptr<PdfOperator> op;
+		/** Graphical state including saved (q) states. */
+		boost::shared_ptr<GfxState> state;
+		/** Bounding box carried from the previous operator. */
+		PdfOperator::BBox rc;
+	};
+	typedef std::vector<StateCheckpoint> StateCheckpoints;
+	
+	/** Minimal number of operators between two checkpoints. */
+	static const size_t CHECKPOINT_DISTANCE = 64;
+
+	/** Checkpoints in the iterator order. Valid only if bboxes is true. */
+	mutable StateCheckpoints checkpoints;
+	/** 
+	 * Operators changed since the last save or since bounding boxes were set.
+	 * Empty pointer means that the change is not known and everything has to
+	 * be updated.
+	 */
+	mutable Operators changed;
 
 	/** Graphical state. */
 	boost::shared_ptr<GfxState> gfxstate;
@@ -254,6 +516,7 @@ public:
 	{
 		kernelPrintDbg (debug::DBG_DBG, "");
 
+		_createPdfOperators ();
 		if (operators.empty ())
 			return;
 
@@ -281,6 +544,13 @@ public:
 	{
 		utilsPrintDbg (debug::DBG_DBG, "");
 
+		// Pdf operators are not needed
+		_parse ();
+		if (!compact.empty ())
+		{
+			compact.getStringRepresentation (str);
+			return;
+		}
 		if (operators.empty ())
 			return;
 
@@ -310,6 +580,7 @@ public:
 	void getOperatorsAtPosition (OpContainer& opContainer, const PdfOpPosComparator& cmp) const
 	{
 		utilsPrintDbg (debug::DBG_DBG, "");
+		_updateBBoxes ();
 		if (operators.empty())
 			return;
 			
@@ -349,13 +620,14 @@ public:
 	 * Get first level pdf operators.
 	 *
 	 * Operators form a tree-like structure. We store all root operands in a
-	 * container.
+	 * container. Bounding boxes of the operators are set.
 	 * 
 	 * @param container Output container.
 	 */
 	template<typename T>
 	void getPdfOperators (T& container) const
 	{ 
+		_updateBBoxes ();
 		container.clear ();
 		std::copy (operators.begin(), operators.end(), std::back_inserter (container));
 	}
@@ -455,11 +727,27 @@ public:
 	 * 
 	 * @return True if the contentstream is empty, false otherwise.
 	 */
-	bool empty () const {return operators.empty ();}
+	bool empty () const {_parse (); return operators.empty () && compact.empty ();}
+
+	/**
+	 * Get operands of the last operator with the specified name.
+	 *
+	 * Operators are searched in the iterator order. If pdf operators have not
+	 * been created yet, only the operands are created.
+	 *
+	 * @param name Operator name.
+	 * @param ops Output container.
+	 *
+	 * @return True if the operator was found, false otherwise.
+	 */
+	bool getLastOperands (const std::string& name, PdfOperator::Operands& ops) const;
 
 	/**
 	 * Reparse pdf operators and set their bounding boxes.
 	 *
+	 * Operators are parsed again when they are needed. Bounding boxes are set
+	 * only if they have been used.
+	 *
 	 * @param bboxOnly If true only bounding boxes are set, if false operators
 	 * are also reparsed.
 	 * @param state Graphical state, if changed.
@@ -476,6 +764,8 @@ public:
 	{
 		gfxstate = state;
 		gfxres = res;
+		// Saved states can use old resources
+		checkpoints.clear ();
 	}
 
 	/** Returns resources used by this content stream.
@@ -489,7 +779,11 @@ public:
 	/**
 	 * Save content stream to underlying cstream(s) and notify all observers. 
 	 *
-	 * Does not reparse anything. 
+	 * Does not reparse anything. Bounding boxes are updated only from
+	 * operators changed by methods of this class (e.g. when indicateChange
+	 * was false), or all of them if no such change has been made. Likewise
+	 * only these operators are written again, the rest is copied from the
+	 * previous content.
 	 */
 	void saveChange () 
 		{ _objectChanged(); }
@@ -523,6 +817,104 @@ private:
 	 */
 	void _objectChanged ();
 
+	/**
+	 * Get the content of the stream for saving.
+	 *
+	 * Unchanged operators are copied verbatim from the source, only the
+	 * source between unchanged operators around edits is replaced. 
+	 * Everything is written again if the changes are not known, the result
+	 * becomes the new source then.
+	 *
+	 * @param str Output string.
+	 */
+	void _serialize (std::string& str) const;
+
+	/** Has the operator a source range (it has not been changed). */
+	static bool _hasSource (const PdfOperator& op)
+		{ return op._sourceBegin < op._sourceEnd; }
+
+	/**
+	 * Parse cstreams into compact operators if they have not been parsed yet.
+	 */
+	void _parse () const;
+
+	/**
+	 * Create pdf operators from compact operators if they have not been
+	 * created yet.
+	 */
+	void _createPdfOperators () const;
+
+	/**
+	 * Create pdf operators if needed and set their bounding boxes if they are
+	 * not valid.
+	 */
+	void _updateBBoxes () const;
+
+	/**
+	 * Update bounding boxes after changes of operators.
+	 *
+	 * The update starts at the last checkpoint before the first changed
+	 * operator and stops at the first checkpoint after the last changed
+	 * operator where the graphical state is the same as before the change.
+	 * Everything is updated if the changes are not known.
+	 */
+	void _updateChangedBBoxes () const;
+
+	/**
+	 * Update graphical state and bounding boxes of operators from a position
+	 * until the end or until the state matches a checkpoint.
+	 *
+	 * @param it Iterator of the first operator.
+	 * @param state Graphical state before the first operator, it is deleted.
+	 * @param rc Bounding box carried from the previous operator.
+	 * @param next Index of the first checkpoint at or after the first operator.
+	 * @param until Last changed operator, the update can not stop before it.
+	 * If NULL, the update does not stop before the end.
+	 */
+	void _updateBBoxes (OperatorIterator it, GfxState* state, PdfOperator::BBox rc, 
+						size_t next, const PdfOperator* until) const;
+
+	/**
+	 * Remember that an operator has changed.
+	 *
+	 * @param op Changed operator (or neighbour of a removed one), empty
+	 * pointer if not known.
+	 */
+	void _operatorChanged (boost::shared_ptr<PdfOperator> op)
+		{ changed.push_back (op); if (op) edits.insert (op); }
+
+	/**
+	 * Forget source ranges of an operator and its children, so that they are
+	 * written again.
+	 *
+	 * @param op Changed or inserted operator.
+	 */
+	void _clearSource (boost::shared_ptr<PdfOperator> op);
+
+	/**
+	 * Add operands of an inserted operator and its children to the operand
+	 * map if it has been created.
+	 *
+	 * @param op Inserted operator.
+	 */
+	void _mapOperands (boost::shared_ptr<PdfOperator> op);
+
+	/**
+	 * Remember the operator having the operand as changed.
+	 *
+	 * @param operand Changed operand.
+	 */
+	void _operandChanged (boost::shared_ptr<IProperty> operand);
+
+	/**
+	 * Remove checkpoints, edits and operands of an operator and its children. 
+	 *
+	 * Must be called before the operator is removed from the iterator list.
+	 *
+	 * @param op Operator being removed.
+	 */
+	void _forgetOperator (boost::shared_ptr<PdfOperator> op);
+
 	//
 	// Observers
 	//
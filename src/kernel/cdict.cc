@@ -46,19 +46,22 @@ using namespace boost;
 //
 // Protected constructor
 //
-CDict::CDict (boost::weak_ptr<CPdf> p, const Object& o, const IndiRef& rf) : IProperty (p,rf) 
+CDict::CDict (boost::weak_ptr<CPdf> p, const Object& o, const IndiRef& rf) 
+	: IProperty (p,rf), revision (0), indexRevision (0)
 {
 	// Build the tree from xpdf object
 	utils::complexValueFromXpdfObj<pDict,Value&> (*this, o, value);
+	_valueChanged ();
 }
 
 //
 // Protected constructor
 //
-CDict::CDict (const Object& o)
+CDict::CDict (const Object& o) : revision (0), indexRevision (0)
 {
 	// Build the tree from xpdf object
 	utils::complexValueFromXpdfObj<pDict,Value&> (*this, o, value);
+	_valueChanged ();
 }
 
 
@@ -83,13 +86,7 @@ CDict::containsProperty (const string& name) const
 {
 	//kernelPrintDbg (debug::DBG_DBG, "getAllPropertyNames()");
 
-	for ( Value::const_iterator it = value.begin(); it != value.end(); ++it)
-	{
-		if ((*it).first == name)
-			return true;
-	}
-
-	return false;
+	return _findItem (name) != value.end();
 }
 
 //
@@ -99,19 +96,11 @@ boost::shared_ptr<IProperty>
 CDict::getProperty (PropertyId id) const
 {
 	//kernelPrintDbg (debug::DBG_DBG,"getProperty() " << id);
-	//
-	// BEWARE using find_if with stateful functors !!!!!
-	//
-	DictIdxComparator cmp (id);
-	Value::const_iterator it = value.begin();
-	for (; it != value.end(); ++it)
-		if (cmp (*it))
-			break;
-
+	Value::const_iterator it = _findItem (id);
 	if (it == value.end())
 		throw ElementNotFoundException ("", "");
 	
-	boost::shared_ptr<IProperty> ip = cmp.getIProperty ();
+	boost::shared_ptr<IProperty> ip = (*it).second;
 
 	// Set mode only if pdf is valid
 	_setMode (ip,id);
@@ -146,6 +135,7 @@ void
 CDict::init (const CDict& dict)
 {
 	std::copy (dict.value.begin(), dict.value.end(), std::back_inserter (value));
+	_valueChanged ();
 }
 
 //
@@ -175,23 +165,16 @@ CDict::delProperty (PropertyId id)
 	// Check whether we can make the change
 	this->canChange();
 
-	//
-	// BEWARE using find_if with stateful functors !!!!!
 	// We could have used getProperty but we also need the iterator
-	//
-	DictIdxComparator cmp (id);
-	Value::iterator oldit = value.begin();
-	for (; oldit != value.end(); ++oldit)
-		if (cmp (*oldit))
-			break;
-	
+	Value::iterator oldit = _findItem (id);
 	if (oldit == value.end())
 		throw ElementNotFoundException ("CDict", "item not found");
 	
-	boost::shared_ptr<IProperty> oldip = cmp.getIProperty ();
+	boost::shared_ptr<IProperty> oldip = (*oldit).second;
 	
-	// Delete that item	
+	// Delete that item	(index refers to it)
 	value.erase (oldit);
+	_valueChanged ();
 
 	if (hasValidPdf (this))
 	{
@@ -246,8 +229,9 @@ CDict::addProperty (const string& propertyName, const IProperty& newIp)
 		newIpClone->setIndiRef (this->getIndiRef());
 		newIpClone->setPdf (this->getPdf());
 	
-		// Store it
+		// Store it and keep the index up to date if it is used
 		value.push_back (make_pair (propertyName,newIpClone));
+		_itemAdded (--value.end ());
 		
 	}else
 		throw CObjInvalidObject ();
@@ -295,20 +279,15 @@ CDict::setProperty (PropertyId id, IProperty& newIp)
 
 	//
 	// Find the item we want
-	// BEWARE using find_if with stateful functors !!!!!
 	//
-	DictIdxComparator cmp (id);
-	Value::iterator it = value.begin();
-	for (; it != value.end(); ++it)
-		if (cmp (*it))
-			break;
+	Value::iterator it = _findItem (id);
 
 	// Check the bounds, if fails add it
 	if (it == value.end())
 		return addProperty (id, newIp);
 
 	// Save the old one
-	boost::shared_ptr<IProperty> oldIp = cmp.getIProperty ();
+	boost::shared_ptr<IProperty> oldIp = (*it).second;
 	// Clone the added property
 	boost::shared_ptr<IProperty> newIpClone = newIp.clone ();
 	assert (newIpClone);
@@ -472,6 +451,114 @@ CDict::_setMode (boost::shared_ptr<IProperty> ip, PropertyId id) const
 
 
 
+//
+// Key index
+//
+
+//
+// FNV-1a
+//
+size_t
+CDict::_hashKey (const std::string& key)
+{
+	size_t hash = 2166136261U;
+	for (std::string::const_iterator it = key.begin(); it != key.end(); ++it)
+	{
+		hash ^= static_cast<unsigned char> (*it);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+//
+//
+//
+CDict::Value::iterator
+CDict::_findItem (PropertyId id) const
+{
+	// Lookup doesn't change the list, we just need non const iterators
+	Value& val = const_cast<Value&> (value);
+
+	// Small dictionaries (or those with out of date index) are searched 
+	// linearly
+	if (index.empty () || indexRevision != revision)
+	{
+		Value::iterator it = val.begin();
+		for (; it != val.end(); ++it)
+			if ((*it).first == id)
+				break;
+		return it;
+	}
+
+	size_t hash = _hashKey (id);
+	size_t mask = index.size () - 1;
+	for (size_t pos = hash & mask; index[pos].used; pos = (pos + 1) & mask)
+	{
+		const IndexSlot& slot = index[pos];
+		if (slot.hash == hash && (*slot.it).first == id)
+			return slot.it;
+	}
+	return val.end ();
+}
+
+//
+//
+//
+void
+CDict::_buildIndex ()
+{
+	index.clear ();
+	indexRevision = revision;
+	if (value.size () < INDEX_THRESHOLD)
+		return;
+
+	// Size has to be power of 2 and at least twice the number of items
+	size_t size = 2 * INDEX_THRESHOLD;
+	while (size < 2 * value.size ())
+		size *= 2;
+	index.resize (size);
+
+	for (Value::iterator it = value.begin(); it != value.end(); ++it)
+		_indexItem (it, _hashKey ((*it).first));
+}
+
+//
+//
+//
+void
+CDict::_itemAdded (Value::iterator it)
+{
+	bool upToDate = (indexRevision == revision);
+	++revision;
+	if (upToDate && !index.empty () && 2 * value.size () <= index.size ())
+	{
+		_indexItem (it, _hashKey ((*it).first));
+		indexRevision = revision;
+	}else
+		_buildIndex ();
+}
+
+//
+//
+//
+void
+CDict::_indexItem (Value::iterator it, size_t hash)
+{
+	assert (!index.empty ());
+	size_t mask = index.size () - 1;
+	size_t pos = hash & mask;
+	for (; index[pos].used; pos = (pos + 1) & mask)
+	{
+		// Keep the first item with the same key
+		if (index[pos].hash == hash && (*index[pos].it).first == (*it).first)
+			return;
+	}
+	index[pos].hash = hash;
+	index[pos].it = it;
+	index[pos].used = true;
+}
+
+
 //
 // Clone method
 //
@@ -490,6 +577,7 @@ CDict::doClone () const
 	 Value::const_iterator it = value.begin ();
 	for (; it != value.end (); ++it)
 		clone_->value.push_back (make_pair ((*it).first, (*it).second->clone()));
+	clone_->_valueChanged ();
 
 	return clone_;
 }
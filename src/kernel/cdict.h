@@ -84,6 +84,42 @@ private:
 	/** Dictionary representation. */
 	Value value;
 
+	/** Minimal number of entries for which the key index is used.
+	 * Smaller dictionaries are searched linearly.
+	 */
+	static const size_t INDEX_THRESHOLD = 8;
+
+	/** Slot of the key index. */
+	struct IndexSlot
+	{
+		/** Hash of the key (valid only if used). */
+		size_t hash;
+		/** Item with the key (valid only if used). */
+		Value::iterator it;
+		/** Flag whether slot is occupied. */
+		bool used;
+		IndexSlot () : hash (0), used (false) {}
+	};
+	typedef std::vector<IndexSlot> Index;
+
+	/** Open addressing (linear probing) index of keys.
+	 * Size is always power of 2 and at least twice the number of items. 
+	 * Kept up to date by methods changing the value list when dictionary 
+	 * has at least INDEX_THRESHOLD items, so lookups only read it and 
+	 * concurrent readers of the same dictionary are safe. Insertion order 
+	 * is still kept by the value list.
+	 * 
+	 * REMARK: Slots refer to items of this value list. CDict is noncopyable
+	 * so the index never outlives its list.
+	 */
+	Index index;
+	/** Number of changes of the value list. */
+	size_t revision;
+	/** Value of revision the index was built for.
+	 * Index is out of date (and is not used) if this differs from revision.
+	 */
+	size_t indexRevision;
+
 
 	//
 	// Constructors
@@ -111,7 +147,7 @@ public:
 	/** 
 	 * Public constructor. This object will not be associated with a pdf.
 	 */
-	CDict () {}
+	CDict () : revision (0), indexRevision (0) {}
 
 
 	//
@@ -397,6 +433,62 @@ protected:
 	 */
 	void _setMode (boost::shared_ptr<IProperty> ip, PropertyId id) const;
 
+	//
+	// Key index
+	//
+private:
+	/**
+	 * Computes hash of a dictionary key.
+	 *
+	 * @param key Key to hash.
+	 * @return Hash value.
+	 */
+	static size_t _hashKey (const std::string& key);
+
+	/**
+	 * Finds first item with given key.
+	 *
+	 * Uses the key index for bigger dictionaries if it is up to date and
+	 * linear search otherwise. Never changes the dictionary.
+	 *
+	 * @param id Key of the item.
+	 * @return Iterator of the item or value.end() if not found.
+	 */
+	Value::iterator _findItem (PropertyId id) const;
+
+	/**
+	 * Builds key index from scratch.
+	 * Index is dropped if dictionary is smaller than INDEX_THRESHOLD.
+	 */
+	void _buildIndex ();
+
+	/**
+	 * Inserts item to the key index.
+	 * Does nothing if there already is an item with the same key (the first
+	 * one has to be found).
+	 *
+	 * @param it Item to insert.
+	 * @param hash Hash of the item key.
+	 */
+	void _indexItem (Value::iterator it, size_t hash);
+
+	/**
+	 * Indicates that the value list has changed.
+	 * Has to be called whenever items are added to or removed from the value
+	 * list. Rebuilds the key index.
+	 */
+	void _valueChanged ()
+		{ ++revision; _buildIndex (); }
+
+	/**
+	 * Indicates that an item was appended to the value list.
+	 * Adds the item to the key index if it is up to date and large enough,
+	 * rebuilds the index otherwise.
+	 *
+	 * @param it Appended item.
+	 */
+	void _itemAdded (Value::iterator it);
+
 public:
 	/**
 	 * Return all child objects.
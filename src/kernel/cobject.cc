@@ -107,9 +107,13 @@ parseStreamToContainer (T& container, const ::Object& obj)
 	rawstr->reset ();
 
 	// Save chars
-	int c;
-	while (container.size() < len && EOF != (c = rawstr->getChar())) 
-		container.push_back (static_cast<typename T::value_type> (c));
+	char chunk[4096];
+	int n = 1;
+	while (container.size() < len && 0 < n)
+	{
+		n = rawstr->getBlock (chunk, std::min (sizeof (chunk), len - container.size()));
+		container.insert (container.end(), chunk, chunk + n);
+	}
 	
 	utilsPrintDbg (debug::DBG_DBG, "Container length: " << container.size());
 	
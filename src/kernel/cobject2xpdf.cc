@@ -905,27 +905,22 @@ unsigned char* bufferFromStream(Stream& str, size_t dictLength, size_t& size)
 		return NULL;
 	}
 	str.reset();
-	int ch;
 	size_t i = 0;
-	while((ch=str.getChar())!=EOF)
+	for(;;)
 	{
-		if(i == streamLength)
+		// read as much as fits into the buffer
+		i += str.getBlock((char *)buffer + i, streamLength - i);
+		if(i < streamLength || str.lookChar() == EOF)
+			break;
+		streamLength = (streamLength) ? 2 * streamLength : 1024;
+		unsigned char *buf = (unsigned char*)realloc(buffer, sizeof(unsigned char)*streamLength);
+		if(!buf)
 		{
-			streamLength *= 2;
-			unsigned char *buf = (unsigned char*)realloc(buffer, sizeof(unsigned char)*streamLength);
-			if(!buf)
-			{
-				utilsPrintDbg(debug::DBG_CRIT, "Allocation failure");
-				free(buffer);
-				return NULL;
-			}
-			buffer = buf;
+			utilsPrintDbg(debug::DBG_CRIT, "Allocation failure");
+			free(buffer);
+			return NULL;
 		}
-		// NOTE that we are reducing int -> char here, so multi-bytes
-		// returned from a stream will be stripped to 1B
-		if((unsigned char)ch != ch)
-			utilsPrintDbg(debug::DBG_DBG, "Too wide character("<<(int)ch<<") in the stream at pos="<<i);
-		buffer[i++]=(unsigned char)ch;
+		buffer = buf;
 	}
 
 	// restore stream object to the begining
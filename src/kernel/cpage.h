@@ -504,6 +504,12 @@ public:
 	 */
 	void getText (std::string& text, const std::string* encoding = NULL, const libs::Rectangle* rc = NULL) const
 		{ _contents->getText (text, encoding, rc); }
+
+	/**
+	 * Returns xpdf text page of this page (see CPageContents::getTextPage).
+	 */
+	boost::shared_ptr<TextPage> getTextPage () const
+		{ return _contents->getTextPage (); }
  
 	 /**
 	  * Find all occurences of a text on this page.
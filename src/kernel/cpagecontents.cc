@@ -87,6 +87,9 @@ CPageContents::ContentsWatchDog::notify (boost::shared_ptr<IProperty> newValue,
 	//		OK 2.2.3 -- changed entry
 	//
 
+	// Any change of the page can change its text
+	_cnt->_invalidate_text ();
+
 	// Switch type
 	switch(context->getType())
 	{
@@ -236,7 +239,8 @@ namespace {
 // CPageContents
 //==========================================================
 
-CPageContents::CPageContents (CPage* page) : _page(page), _wd (new ContentsWatchDog (this))
+CPageContents::CPageContents (CPage* page) : 
+	_page(page), _wd (new ContentsWatchDog (this)), _text_changes (0), _text_wd (new TextWatchDog (this))
 {
 	if (_page)
 		_dict = _page->getDictionary();
@@ -423,17 +427,13 @@ size_t CPageContents::findText (std::string text,
 					  RectangleContainer& recs, 
 					  const TextSearchParams&) const
 {
-	// Create text output device
-	boost::scoped_ptr<TextOutputDev> textDev (new ::TextOutputDev (NULL, gFalse, gFalse, gFalse));
-		assert (textDev->isOk());
-		if (!textDev->isOk())
-			throw CObjInvalidOperation ();
-
 	// Get the text
-	_page->display()->displayPage (*textDev);	
+	TextPage& textPage = _text_page ();
 
+	// Last find of the cached text is not used for the first search
 	GBool startAtTop, stopAtBottom, startAtLast, stopAtLast, caseSensitive, backward;
-	startAtTop = stopAtBottom = startAtLast = stopAtLast = gTrue;
+	startAtTop = stopAtBottom = gTrue;
+	startAtLast = stopAtLast = gFalse;
 	caseSensitive = backward = gFalse;
 	
 	double xMin = 0, yMin = 0, xMax = 0, yMax = 0;
@@ -444,15 +444,16 @@ size_t CPageContents::findText (std::string text,
 	for (int i = 0; i < length; ++i)
 	    utext[i] = static_cast<Unicode> (text[i] & 0xff);
 	
-	if (textDev->findText(utext, length, startAtTop, stopAtBottom, 
+	if (textPage.findText(utext, length, startAtTop, stopAtBottom, 
 				startAtLast,stopAtLast, caseSensitive, backward,
 				&xMin, &yMin, &xMax, &yMax))
 	{
 		startAtTop = gFalse;
+		startAtLast = stopAtLast = gTrue;
 		
 		recs.push_back (libs::Rectangle (xMin, yMin, xMax, yMax));
 		// Get all text objects
-		while (textDev->findText (utext, length,
+		while (textPage.findText (utext, length,
 								  startAtTop, stopAtBottom, 
 								  startAtLast, stopAtLast, 
 								  caseSensitive, backward,
@@ -475,6 +476,64 @@ template size_t CPageContents::findText<std::vector<libs::Rectangle> >
 	 std::vector<libs::Rectangle>& recs, 
 	 const TextSearchParams& params) const;
 
+//
+//
+//
+boost::shared_ptr<TextPage>
+CPageContents::getTextPage () const
+{
+	_text_page ();
+	return _text;
+}
+
+//
+//
+//
+TextPage&
+CPageContents::_text_page () const
+{
+	const DisplayParams& params = _page->display()->getDisplayParams ();
+	// Raw changes of content streams or resources are not seen by watchdogs,
+	// but all of them are indirect changes counted by the render context
+	boost::shared_ptr<CPdf> pdf = _dict->getPdf().lock ();
+	size_t changes = (pdf) ? pdf->getRenderContext().getChangeCount () : 0;
+	if (_text && _text_params == params && _text_changes == changes)
+		return *_text;
+	_invalidate_text ();
+
+	// Create text output device
+	boost::scoped_ptr<TextOutputDev> textDev (new ::TextOutputDev (NULL, gFalse, gFalse, gFalse));
+		assert (textDev->isOk());
+		if (!textDev->isOk())
+			throw CObjInvalidOperation ();
+
+	// Display the page and keep its text
+	_page->display()->displayPage (*textDev);	
+	_text = boost::shared_ptr<TextPage> (textDev->takeText ());
+	_text_params = params;
+	_text_changes = changes;
+
+	// Operators of parsed content streams can be changed directly, content
+	// streams parsed later are created by parse which invalidates the text
+	_text_ccs = _ccs;
+	for (CCs::iterator it = _text_ccs.begin(); it != _text_ccs.end(); ++it)
+		REGISTER_SHAREDPTR_OBSERVER((*it), _text_wd);
+
+	return *_text;
+}
+
+//
+//
+//
+void
+CPageContents::_invalidate_text () const
+{
+	_text.reset ();
+	for (CCs::iterator it = _text_ccs.begin(); it != _text_ccs.end(); ++it)
+		UNREGISTER_SHAREDPTR_OBSERVER((*it), _text_wd);
+	_text_ccs.clear ();
+}
+
 //
 //
 //
@@ -519,6 +578,19 @@ CPageContents::addText (const std::string& what,
     q->push_back(BT,q);
     BT->push_back(createOperator("Tf", fontOperands), getLastOperator(BT));
     
+	// uff, go through the content operators and find out the text orientation
+	// - the last Tm wins, so only content streams from the back up to the
+	//   first one containing Tm are parsed
+	for (CCs::reverse_iterator it = _ccs.rbegin(); it != _ccs.rend(); ++it)
+	{
+		PdfOperator::Operands operands;
+		if ((*it)->getLastOperands ("Tm", operands))
+		{
+				kernelPrintDbg (debug::DBG_WARN, "Using non default different Tm");
+			_likely_tm = operands;
+			break;
+		}
+	}
 	_likely_tm.set_position(where);
 	PdfOperator::Operands posOperands = _likely_tm;
     BT->push_back(createOperator("Tm", posOperands), getLastOperator(BT));
@@ -888,35 +960,6 @@ CPageContents::parse ()
 		_ccs.push_back (cc);
 	}
 
-	// uff, go through the first content operators and find out usefull information
-	// - for now the text orientation
-	// - pdfoperators will be reimplemented anyway
-	for (CCs::const_iterator it = _ccs.begin(); 
-			it != _ccs.end(); 
-			++it)
-	{
-		CContentStream::Operators ops;
-		(*it)->getPdfOperators (ops);
-		if (ops.empty())
-			continue;
-		PdfOperator::Iterator opit = PdfOperator::getIterator (ops.front());
-		while (!opit.isEnd())
-		{
-			std::string tmp;
-			opit.getCurrent()->getOperatorName (tmp);
-			PdfOperator::Operands operands;
-			if (tmp == "Tm")
-			{
-					kernelPrintDbg (debug::DBG_WARN, "Using non default different Tm");
-				opit.getCurrent()->getParameters (operands);
-				_likely_tm = operands;
-			}
-			opit.next();
-		}
-	}
-
-
-
 	// Indicate change
 	change ();
 
@@ -971,6 +1014,7 @@ CPageContents::unreg_observer (boost::shared_ptr<IProperty> ip) const
 void 
 CPageContents::change (bool invalid)
 { 
+	_invalidate_text ();
 	_page->_objectChanged (invalid); 
 }
 
@@ -1074,10 +1118,12 @@ CPageContents::reset ()
 		// we already made a reset
 		if (!_page)
 			return;
+	_invalidate_text ();
 	unreg_observer ();
 	_page = NULL;
 	_dict.reset ();
 	_wd.reset ();
+	_text_wd.reset ();
 		assert (!_wd.use_count());
 }
 
@@ -35,6 +35,7 @@
 #include "kernel/cstream.h"
 #include "kernel/textoutput.h"
 #include "kernel/textsearchparams.h"
+#include "kernel/displayparams.h"
 #include "kernel/stateupdater.h"
 #include "kernel/cobjectsimple.h"
 
@@ -81,6 +82,25 @@ private:
 	
 	};	// class ContentsWatchDog
 
+	/** 
+	 * Observer of content streams invalidating cached text of the page when
+	 * operators change. Registered only while the text is cached.
+	 */
+	class TextWatchDog: public observer::IObserver<CContentStream>
+	{
+	private:
+		CPageContents* _cnt;
+	public:
+		TextWatchDog (CPageContents* cnt) : _cnt(cnt) { assert(_cnt); }
+		virtual ~TextWatchDog() throw() {}
+		// IObserver Interface
+		virtual void notify (boost::shared_ptr<CContentStream>, boost::shared_ptr<const observer::IChangeContext<CContentStream> >) const throw()
+			{ _cnt->_text.reset (); }
+		virtual priority_t getPriority() const throw() 
+			{ return 0;	}
+	
+	};	// class TextWatchDog
+
 	//==========================================================
 
 	/** 
@@ -124,6 +144,16 @@ private:
 	boost::shared_ptr<CDict> _dict;	// pages
 	boost::shared_ptr<ContentsWatchDog> _wd;
 	Tm _likely_tm;
+	// text of the page displayed by xpdf (cached for text search)
+	mutable boost::shared_ptr<TextPage> _text;
+	// display parameters used for the cached text
+	mutable DisplayParams _text_params;
+	// document change count (RenderContext::getChangeCount) of the cached 
+	// text, covers changes of streams and resources which are not observed
+	mutable size_t _text_changes;
+	// content streams observed by _text_wd
+	mutable CCs _text_ccs;
+	boost::shared_ptr<TextWatchDog> _text_wd;
 
 
 	// Ctor & Dtor
@@ -214,6 +244,8 @@ public:
 	 * Find all occurences of a text on this page.
 	 *
 	 * It uses xpdf TextOutputDevice to get the bounding box of found text.
+	 * The text of the page is kept for next searches until the page
+	 * contents or display parameters change.
 	 *
 	 * @param text Text to find.
 	 * @param recs Output container of rectangles of all occurences of the text.
@@ -347,6 +379,14 @@ public:
 	void getText (std::string& text, 
 				  const std::string* encoding = NULL, 
 				  const libs::Rectangle* rc = NULL) const;
+
+	/**
+	 * Returns xpdf text page of this page.
+	 *
+	 * The text page is shared with text searching and it is kept until the
+	 * page contents or display parameters change. It must not be modified.
+	 */
+	boost::shared_ptr<TextPage> getTextPage () const;
  
 	/**
 	 * Move contentstream up one level. Which means it will be repainted by less objects.
@@ -416,6 +456,17 @@ private:
 	 */
 	inline void change (bool invalid = false);
 
+	/**
+	 * Get text of the page displayed by xpdf. 
+	 * Cached text is returned if it is still valid.
+	 */
+	TextPage& _text_page () const;
+
+	/**
+	 * Drop cached text of the page and stop observing content streams.
+	 */
+	void _invalidate_text () const;
+
 	//
 	// Helper methods because of cpage not included in headers
 	//
@@ -32,6 +32,9 @@
 #include "kernel/cpdf.h"
 #include "kernel/cpageattributes.h"
 
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
 // =====================================================================================
 namespace pdfobjects {
 // =====================================================================================
@@ -39,6 +42,224 @@ namespace pdfobjects {
 using namespace boost;
 using namespace utils;
 
+namespace {
+
+/** Rendering of one horizontal band of a page slice.
+ */
+struct BandJob
+{
+	const Page * page;
+	const Catalog * catalog;
+	const DisplayParams * params;
+	SplashOutputDev * out;
+	/** Page slice (the same for all bands). */
+	int x, y, w, h;
+	/** First row of the band in the slice. */
+	int top;
+	bool failed;
+
+	/** Renders the slice on the band device (clipped to the band rows). */
+	void display ()
+	{
+		page->displaySlice (out, params->hDpi, params->vDpi,
+				0, params->useMediaBox, params->crop,
+				x, y, w, h,
+				false, catalog);
+	}
+
+	/** Renders the band on a worker thread, errors are only logged. */
+	void run ()
+	{
+		try
+		{
+			display ();
+		}catch (std::exception& e)
+		{
+			kernelPrintDbg (debug::DBG_ERR, "Band at row "<<top<<" failed: "<<e.what());
+			failed = true;
+		}
+	}
+};
+
+/**
+ * Draws page slice on a splash device in horizontal bands.
+ *
+ * Each band is rendered by its own thread on a band device of the given output
+ * device (the first one by the calling thread), bitmaps of the bands are
+ * composed into the output device afterwards. Band devices render the whole
+ * slice with the same transformation clipped to their rows, so the composed
+ * bitmap is identical to the one rendered in a single pass. Threads share
+ * xref, catalog and page objects (xpdf objects are reference counted
+ * atomically and file access is serialized with MULTITHREADED) and the
+ * document image cache. Fonts embedded in the document are shared through
+ * SplashFontFileCache.
+ *
+ * @return false if the slice was not split (too few bands or rows, or
+ * fonts can't be rasterized concurrently because t1lib is enabled).
+ */
+bool
+displayBands (SplashOutputDev& out, const Page& page, XRef* xref,
+		RenderContext& ctx, const Catalog* catalog, const DisplayParams& params,
+		int x, int y, int w, int h)
+{
+#if MULTITHREADED
+	// whole page - use the size displaySlice would use
+	if (w < 0 || h < 0)
+	{
+		GfxState state (params.hDpi, params.vDpi,
+				params.useMediaBox ? page.getMediaBox () : page.getCropBox (),
+				page.getRotate (), out.upsideDown ());
+		x = y = 0;
+		w = (int)(state.getPageWidth () + 0.5);
+		h = (int)(state.getPageHeight () + 0.5);
+	}
+	int n = (int)std::min (params.bands, (size_t)std::max (h, 0));
+	if (n < 2 || w <= 0)
+		return false;
+	kernelPrintDbg (debug::DBG_DBG, "Displaying slice "<<x<<","<<y<<" "<<w<<"x"<<h<<" in "<<n<<" bands");
+
+	std::vector<boost::shared_ptr<SplashOutputDev> > devs;
+	std::vector<SplashOutputDev*> bands;
+	std::vector<BandJob> jobs (n);
+	for (int i = 0, top = 0; i < n; ++i)
+	{
+		int rows = h / n + ((i < h % n) ? 1 : 0);
+		boost::shared_ptr<SplashOutputDev> dev (out.makeBandDev (top, top + rows));
+		if (!dev)
+			return false;
+		dev->startDoc (xref);
+		dev->setImageCache (ctx.getImageCache ());
+		devs.push_back (dev);
+		bands.push_back (dev.get ());
+
+		BandJob& job = jobs[i];
+		job.page = &page;
+		job.catalog = catalog;
+		job.params = &params;
+		job.out = dev.get ();
+		job.x = x;
+		job.y = y;
+		job.w = w;
+		job.h = h;
+		job.top = top;
+		job.failed = false;
+		top += rows;
+	}
+
+	boost::thread_group group;
+	for (int i = 1; i < n; ++i)
+		group.create_thread (boost::bind (&BandJob::run, &jobs[i]));
+	try
+	{
+		jobs[0].display ();
+	}catch (...)
+	{
+		group.join_all ();
+		throw;
+	}
+	group.join_all ();
+	for (int i = 1; i < n; ++i)
+		if (jobs[i].failed)
+			throw PdfException ();
+
+	out.composeBands (&bands[0], n);
+	return true;
+#else
+	// xpdf structures are not thread safe
+	return false;
+#endif
+}
+
+} // namespace
+
+//
+//
+//
+const Catalog* 
+RenderContext::getCatalog ()
+{
+	if(catalog)
+		return catalog.get();
+
+	kernelPrintDbg(debug::DBG_DBG, "Creating catalog");
+	assert(xref);
+	catalog.reset(new Catalog(xref));
+
+	// remembers referencies which catalog content depends on
+	rootRef = IndiRef(xref->getRootNum(), xref->getRootGen());
+	acroFormRef = IndiRef();
+	::Object catDict, acroForm;
+	xref->getCatalog(&catDict);
+	if(catDict.isDict() && catDict.dictLookupNF("AcroForm", &acroForm)->isRef())
+		acroFormRef = IndiRef(acroForm.getRef());
+	acroForm.free();
+	catDict.free();
+
+	return catalog.get();
+}
+
+//
+//
+//
+boost::shared_ptr< ::Object> 
+RenderContext::getPageObject (const boost::shared_ptr<CDict>& pageDict)
+{
+	IndiRef ref = pageDict->getIndiRef();
+	PageObjectCache::iterator i = pageObjects.find(ref);
+	if(i != pageObjects.end())
+		return i->second;
+
+	kernelPrintDbg(debug::DBG_DBG, "Creating xpdf page object for "<<ref);
+	boost::shared_ptr< ::Object> obj(pageDict->_makeXpdfObject(), xpdf::object_deleter());
+	if(objDict != obj->getType())
+	{
+		kernelPrintDbg(debug::DBG_ERR, "Page "<<ref<<" is not a dictionary");
+		throw XpdfInvalidObject();
+	}
+	pageObjects.insert(PageObjectCache::value_type(ref, obj));
+	return obj;
+}
+
+//
+//
+//
+void 
+RenderContext::objectChanged (const IndiRef& ref)
+{
+	++changes;
+	if(pageObjects.erase(ref))
+		kernelPrintDbg(debug::DBG_DBG, "Cached page object for "<<ref<<" discarded");
+	::Ref xpdfRef = {(int)ref.num, (int)ref.gen};
+	imageCache->invalidate(xpdfRef);
+
+	if(catalog && (ref == rootRef || ref == acroFormRef))
+		invalidateCatalog();
+}
+
+//
+//
+//
+void 
+RenderContext::invalidateCatalog ()
+{
+	kernelPrintDbg(debug::DBG_DBG, "");
+	catalog.reset();
+	rootRef = acroFormRef = IndiRef();
+}
+
+//
+//
+//
+void 
+RenderContext::invalidate ()
+{
+	kernelPrintDbg(debug::DBG_DBG, "");
+	++changes;
+	invalidateCatalog();
+	pageObjects.clear();
+	imageCache->clear();
+}
+
 //
 //
 //
@@ -86,17 +307,26 @@ CPageDisplay::displayPage (::OutputDev& out,
 						   boost::shared_ptr<CDict> pagedict, 
 						   int x, int y, int w, int h)
 {
+	if (!(pagedict))
+		throw XpdfInvalidObject ();
+
 	// Get xref
 	boost::shared_ptr<CPdf> pdf = pagedict->getPdf().lock();
 	XRef* xref = (pdf)?pdf->getCXref ():NULL;
 	assert (NULL != xref);
-	if (!(pagedict))
-		throw XpdfInvalidObject ();
 
 	//
-	// Create xpdf object representing CPage
+	// Get xpdf object representing CPage
+	// Dictionary which is current value of its indirect object is taken from
+	// the document render context, others (e.g. fake dictionaries with changes)
+	// have to be converted each time
 	//
-	boost::shared_ptr<Object> xpdfPage (pagedict->_makeXpdfObject(), xpdf::object_deleter());
+	RenderContext& ctx = pdf->getRenderContext ();
+	boost::shared_ptr<Object> xpdfPage;
+	if (hasValidRef (pagedict) && pdf->getIndirectProperty (pagedict->getIndiRef()) == pagedict)
+		xpdfPage = ctx.getPageObject (pagedict);
+	else
+		xpdfPage = boost::shared_ptr<Object> (pagedict->_makeXpdfObject(), xpdf::object_deleter());
 		// Check page dictionary
 		assert (objDict == xpdfPage->getType());
 		if (objDict != xpdfPage->getType ())
@@ -112,7 +342,10 @@ CPageDisplay::displayPage (::OutputDev& out,
 	//
 	SplashOutputDev* sout = dynamic_cast<SplashOutputDev*> (&out);
 	if (sout)
+	{
 		sout->startDoc (xref);
+		sout->setImageCache (ctx.getImageCache ());
+	}
 
 	//
 	// Create default page attributes and make page
@@ -120,17 +353,20 @@ CPageDisplay::displayPage (::OutputDev& out,
 	// 
 	Page page (xref, 0, xpdfPageDict, new PageAttrs (NULL, xpdfPageDict));
 	
-	// Create catalog
-	boost::scoped_ptr<Catalog> xpdfCatalog (new Catalog (xref));
+	// Catalog is shared by all pages of the document
+	const Catalog* xpdfCatalog = ctx.getCatalog ();
 	
 	//
 	// Page object display (..., useMediaBox, crop, links, catalog)
 	//
 	// TODO ROTATION !! int rotation = _params.rotate - pagedict->getRotation ();
+	if (sout && _params.bands > 1
+			&& displayBands (*sout, page, xref, ctx, xpdfCatalog, _params, x, y, w, h))
+		return;
 	page.displaySlice (&out, _params.hDpi, _params.vDpi,
 			0, _params.useMediaBox, _params.crop,
 			x, y, w, h, 
-			false, xpdfCatalog.get());
+			false, xpdfCatalog);
 
 }
 
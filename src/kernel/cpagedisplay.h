@@ -30,6 +30,7 @@
 #include "kernel/static.h"
 #include "kernel/cpagemodule.h"
 #include "kernel/displayparams.h"	// DisplayParams
+#include "kernel/cpdf.h"			// IndComparator
 
 //=====================================================================================
 namespace pdfobjects {
@@ -40,6 +41,132 @@ class CPage;
 class CDict;
 
 
+//=====================================================================================
+// RenderContext
+//=====================================================================================
+
+/** Per document cache of xpdf objects used for page rendering.
+ *
+ * Displaying a page requires xpdf Catalog (for annotations and AcroForm) and
+ * xpdf representation of the page dictionary. Both are quite expensive to
+ * create - Catalog reads whole page tree and page dictionary has to be
+ * converted from its cobject representation - so this class keeps them
+ * between rendering calls.
+ * <br>
+ * It also holds the cache of decoded images which is handed to
+ * SplashOutputDev, so that repeated renders of the document (zooming,
+ * scrolling) don't decode the same image streams again.
+ * <br>
+ * Cached values are discarded by CPdf when something they depend on
+ * changes (see objectChanged). Page dictionaries are cached without resolving
+ * their referencies, so changes in other indirect objects (e.g. resources or
+ * content streams) are visible without any invalidation.
+ * <br>
+ * Instance is owned by CPdf and has to be destroyed (or invalidated) before
+ * xref it is created for.
+ */
+class RenderContext: public noncopyable
+{
+public:
+	/** Type for cached xpdf page dictionaries.
+	 */
+	typedef std::map<IndiRef, boost::shared_ptr< ::Object>, utils::IndComparator> PageObjectCache;
+
+private:
+	/** Xref used for all xpdf objects.
+	 */
+	XRef * xref;
+
+	/** Cached catalog (NULL if not created yet).
+	 */
+	boost::scoped_ptr<Catalog> catalog;
+
+	/** Reference of the document catalog used by cached catalog.
+	 */
+	IndiRef rootRef;
+
+	/** Reference of the AcroForm dictionary used by cached catalog.
+	 *
+	 * Has default (invalid) value if AcroForm is direct or missing.
+	 */
+	IndiRef acroFormRef;
+
+	/** Cached xpdf page dictionaries.
+	 */
+	PageObjectCache pageObjects;
+
+	/** Decoded images (keyed by image stream reference).
+	 */
+	SplashImageCache * imageCache;
+
+	/** Number of handled changes (see getChangeCount).
+	 */
+	size_t changes;
+
+public:
+	/** Initialization constructor.
+	 * @param x Xref used for all created xpdf objects.
+	 */
+	RenderContext(XRef * x): xref(x), imageCache(new SplashImageCache()), changes(0) {}
+
+	/** Destructor.
+	 * Releases the image cache (output devices may still hold it).
+	 */
+	~RenderContext() { imageCache->decRefCnt(); }
+
+	/** Returns catalog for the document.
+	 *
+	 * Creates one if there is no cached instance.
+	 *
+	 * @return Catalog instance owned by this context (valid until next
+	 * invalidation).
+	 */
+	const Catalog * getCatalog();
+
+	/** Returns xpdf object for given page dictionary.
+	 * @param pageDict Page dictionary (with valid indirect reference).
+	 *
+	 * Converts given dictionary to xpdf object and keeps it for next calls.
+	 *
+	 * @return Xpdf dictionary object.
+	 */
+	boost::shared_ptr< ::Object> getPageObject(const boost::shared_ptr<CDict> & pageDict);
+
+	/** Returns cache of decoded images for the document.
+	 * @return Image cache owned by this context (use incRefCnt to keep it
+	 * longer).
+	 */
+	SplashImageCache * getImageCache() { return imageCache; }
+
+	/** Returns number of document changes seen so far.
+	 *
+	 * The value grows with each objectChanged and invalidate call, so
+	 * anything derived from the document content (e.g. page text) can be
+	 * cached together with this value and dropped when it differs.
+	 *
+	 * @return Change counter value.
+	 */
+	size_t getChangeCount()const { return changes; }
+
+	/** Handles change of indirect object.
+	 * @param ref Reference of changed object.
+	 *
+	 * Discards cached page object and decoded image for given reference and
+	 * also catalog, if the document catalog or AcroForm dictionary has
+	 * changed.
+	 */
+	void objectChanged(const IndiRef & ref);
+
+	/** Discards cached catalog.
+	 */
+	void invalidateCatalog();
+
+	/** Discards all cached objects.
+	 */
+	void invalidate();
+};
+
+
 //=====================================================================================
 // CPageDisplay 
 //=====================================================================================
@@ -122,6 +249,12 @@ public:
 	 */
 	void setDisplayParams (const DisplayParams& dp);
 
+	/**
+	 * Returns actual display params.
+	 */
+	const DisplayParams& getDisplayParams () const
+		{ return _params; }
+
 	/**
 	 * Draws page on an output device.
 	 * Use old display params.
@@ -131,6 +264,10 @@ public:
 	/**
 	 * Draws page using specified page dictionary on an output device with last used display parameters.
 	 *
+	 * If the output device is a SplashOutputDev and display parameters ask for
+	 * more bands (see DisplayParams::bands), horizontal bands of the page are
+	 * rendered in parallel and composed into the output device bitmap.
+	 *
 	 * @param out Output device.
 	 * @param dict If not null, page is created from dict otherwise
 	 * this page dictionary is used. But still some information is gathered from this page dictionary.
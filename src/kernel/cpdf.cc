@@ -31,9 +31,12 @@
 #include "kernel/factories.h"
 #include "utils/debug.h"
 #include "kernel/cpageattributes.h"
+#include "kernel/cpagedisplay.h"
 #include "kernel/pdfedit-core-dev.h"
 #include "kernel/streamwriter.h"
 #include <poppler/Stream.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 
 using namespace boost;
 using namespace std;
@@ -1118,6 +1121,7 @@ using namespace utils;
 	// clears nodeCountCache
 	kernelPrintDbg(DBG_DBG, "Discarding nodeCountCache with "<<pdf->nodeCountCache.size()<<" entries");
 	utils::clearCache(pdf->nodeCountCache);
+	pdf->invalidatePageIndex();
 	
 	// registers new page tree root
 	// checks newValue property type and if it is not reference to dictionary it
@@ -1589,6 +1593,9 @@ void CPdf::initRevisionSpecific()
 		pageList.clear();
 	}
 
+	// all cached rendering objects may be out of date now
+	renderContext->invalidate();
+
 	// cleans up indirect mapping
 	if(indMap.size())
 	{
@@ -1613,6 +1620,7 @@ void CPdf::initRevisionSpecific()
 	
 	kernelPrintDbg(debug::DBG_DBG, "Cleaning up nodeCountCache with "<<nodeCountCache.size()<<" entries");
 	utils::clearCache(nodeCountCache);
+	invalidatePageIndex();
 	
 	kernelPrintDbg(debug::DBG_DBG, "Cleaning up pageTreeKidsParentCache with "<<pageTreeKidsParentCache.size()<<" entries");
 	utils::clearCache(pageTreeKidsParentCache);
@@ -1665,12 +1673,15 @@ CPdf::CPdf(BaseStream * stream, OpenMode openMode)
 	 pageTreeKidsObserver(new PageTreeKidsObserver(this)),
 	 id(NO_PDF_ID),
 	 change(false), 
+	 pageIndexState(PAGE_INDEX_INVALID),
+	 validPagePositions(0),
 	 modeController(NULL)
 {
 	// gets xref writer - if error occures, exception is thrown 
 	// Note that we can't do anything that could use cobjects here
 	// because of weak_ptr & shared_ptr are not initialized yet
 	xref=new XRefWriter(stream, this);
+	renderContext.reset(new RenderContext(xref));
 	mode=openMode;
 
 	// sets mode accoring openMode
@@ -1780,6 +1791,8 @@ void CPdf::invalidate()
 		i->second->invalidate();
 	}
 	pageList.clear();
+	invalidatePageIndex();
+	renderContext->invalidate();
 
 	// idealy we should unregister page tree observers but as the _this
 	// is no longer valid in this context (last reference to 
@@ -1816,6 +1829,9 @@ CPdf::~CPdf()
 {
 	kernelPrintDbg(DBG_DBG, "");
 
+	// rendering context holds xpdf objects which depend on xref
+	renderContext.reset();
+
 	// deallocates XRefWriter
 	delete xref;
 
@@ -2249,6 +2265,7 @@ void CPdf::changeIndirectProperty(const boost::shared_ptr<IProperty> &prop)
 	boost::shared_ptr<Object> propObject(prop->_makeXpdfObject(), xpdf::object_deleter());
 	kernelPrintDbg(DBG_DBG, "Registering change to the XRefWriter");
 	xref->changeObject(indiRef.num, indiRef.gen, propObject.get());
+	renderContext->objectChanged(indiRef);
 
 	// checks whether prop is same instance as one in mapping. If so, keeps
 	// indirect mapping, because it has just changed some of its direct fields. 
@@ -2326,12 +2343,10 @@ using namespace std;
 	}
 	kernelPrintDbg(debug::DBG_DBG,"File \"" << filename << "\" open successfully in mode=" << openMode);
 	
-	// creates FileStream writer to enable changes to the File stream
+	// creates buffered FileStream writer to enable changes to the File stream
 	Object obj;
 	obj.initNull();
-    	Goffset  startA,lengthA ;
-   	// (GooFile* fA, Goffset startA, GBool limitedA,  Goffset lengthA, Object *dictA)
-    	StreamWriter * stream=new FileStreamWriter(file, startA, gFalse, lengthA, &obj);
+	StreamWriter * stream=new BufferedFileStreamWriter(file, 0, gFalse, 0, &obj);
 	kernelPrintDbg(debug::DBG_DBG,"File stream created");
 
 	// stream is ready, creates CPdf instance
@@ -2396,13 +2411,33 @@ using namespace utils;
 		return i->second;
 	}
 
-	// page is not available in pageList, searching has to be done
+	// page is not available in pageList, uses page index if possible
+	boost::shared_ptr<CDict> pageDict_ptr;
+	if(buildPageIndex())
+	{
+		IndiRef pageRef=pageRefIndex[pos-1];
+		boost::shared_ptr<IProperty> pageProp=getIndirectProperty(pageRef);
+		if(isDict(pageProp))
+		{
+			kernelPrintDbg(DBG_DBG, "Page at pos="<<pos<<" found in page index "<<pageRef);
+			pageDict_ptr=IProperty::getSmartCObjectPtr<CDict>(pageProp);
+		}else
+		{
+			kernelPrintDbg(DBG_WARN, "Page index entry "<<pageRef<<" is not dictionary. Discarding index.");
+			invalidatePageIndex();
+		}
+	}
+
+	// searching has to be done
 	// find throws an exception if any problem found, otherwise pageDict_ptr
 	// contians Page dictionary at specified position.
-	boost::shared_ptr<CDict> rootPages_ptr=getPageTreeRoot(_this.lock());
-	if(!rootPages_ptr.get())
-		throw PageNotFoundException(pos);
-	boost::shared_ptr<CDict> pageDict_ptr=findPageDict(_this.lock(), rootPages_ptr, 1, pos, &nodeCountCache);
+	if(!pageDict_ptr.get())
+	{
+		boost::shared_ptr<CDict> rootPages_ptr=getPageTreeRoot(_this.lock());
+		if(!rootPages_ptr.get())
+			throw PageNotFoundException(pos);
+		pageDict_ptr=findPageDict(_this.lock(), rootPages_ptr, 1, pos, &nodeCountCache);
+	}
 
 	// creates CPage instance from page dictionary and stores it to the pageList
 	CPage * page=CPageFactory::getInstance(pageDict_ptr);
@@ -2483,12 +2518,137 @@ boost::shared_ptr<CPage> CPdf::getPrevPage(const boost::shared_ptr<CPage> &page)
 	return getPage(pos);
 }
 
+size_t CPdf::findText(const std::string & text, ITextSearchCallback & callback, const TextSearchParams & params)const
+{
+	kernelPrintDbg(DBG_DBG, "text="<<text);
+
+	size_t found=0;
+	size_t count=getPageCount();
+	std::vector<libs::Rectangle> recs;
+	for(size_t pos=1; pos<=count; ++pos)
+	{
+		recs.clear();
+		getPage(pos)->findText(text, recs, params);
+		for(size_t i=0; i<recs.size(); ++i)
+		{
+			++found;
+			if(!callback.found(pos, recs[i]))
+				return found;
+		}
+	}
+	return found;
+}
+
+namespace {
+
+/** Work shared by threads searching a text.
+ */
+struct TextSearchJob
+{
+	const std::string * text;
+	const TextSearchParams * params;
+	ITextSearchCallback * callback;
+	size_t pageCount;
+	/** Next page to search. */
+	size_t next;
+	/** Number of reported occurrences. */
+	size_t found;
+	/** Search has been stopped by callback or by an error. */
+	bool stop;
+	bool failed;
+	boost::mutex mutex;
+
+	/** Searches pages of given instance until there is no page left.
+	 * @param pdf Document instance used by this thread.
+	 */
+	void run(boost::shared_ptr<CPdf> pdf)
+	{
+		std::vector<libs::Rectangle> recs;
+		for(;;)
+		{
+			size_t pos;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				if(stop || next>pageCount)
+					return;
+				pos=next++;
+			}
+			recs.clear();
+			try
+			{
+				pdf->getPage(pos)->findText(*text, recs, *params);
+			}catch(std::exception &e)
+			{
+				kernelPrintDbg(DBG_ERR, "Text search failed at pos="<<pos<<" cause="<<e.what());
+				boost::mutex::scoped_lock lock(mutex);
+				stop=failed=true;
+				return;
+			}
+			boost::mutex::scoped_lock lock(mutex);
+			for(size_t i=0; !stop && i<recs.size(); ++i)
+			{
+				++found;
+				if(!callback->found(pos, recs[i]))
+					stop=true;
+			}
+		}
+	}
+};
+
+} // namespace
+
+size_t CPdf::findText(const std::vector<boost::shared_ptr<CPdf> > & instances, const std::string & text, ITextSearchCallback & callback, const TextSearchParams & params)
+{
+	kernelPrintDbg(DBG_DBG, "text="<<text<<" threads="<<instances.size());
+
+	if(instances.empty())
+		return 0;
+
+	TextSearchJob job;
+	job.text=&text;
+	job.params=&params;
+	job.callback=&callback;
+	job.pageCount=instances.front()->getPageCount();
+	job.next=1;
+	job.found=0;
+	job.stop=job.failed=false;
+
+	boost::thread_group group;
+	for(size_t i=1; i<instances.size(); ++i)
+		group.create_thread(boost::bind(&TextSearchJob::run, &job, instances[i]));
+	job.run(instances.front());
+	group.join_all();
+
+	if(job.failed)
+		throw PdfException();
+	return job.found;
+}
+
 size_t CPdf::getPagePosition(const boost::shared_ptr<CPage> &page)const
 {
 	kernelPrintDbg(DBG_DBG, "");
 		
 	check_need_credentials(xref);
 
+	// uses page index to get position of the page dictionary and checks
+	// whether the page is really the one returned for this position 
+	if(buildPageIndex())
+	{
+		refreshPagePositions();
+		boost::shared_ptr<CDict> pageDict=page->getDictionary();
+		PagePositionIndex::const_iterator posIter;
+		if(pageDict.get() && (posIter=pagePositionIndex.find(pageDict->getIndiRef()))!=pagePositionIndex.end())
+		{
+			size_t pos=posIter->second;
+			PageList::const_iterator i=pageList.find(pos);
+			if(i!=pageList.end() && i->second == page)
+			{
+				kernelPrintDbg(DBG_DBG, "Page found at pos="<<pos);
+				return pos;
+			}
+		}
+	}
+
 	// search in returned page list
 	PageList::iterator i;
 	for(i=pageList.begin(); i!=pageList.end(); ++i)
@@ -2540,7 +2700,23 @@ using namespace utils;
 				difference = -1;
 				boost::shared_ptr<CDict> oldDict_ptr=getCObjectFromRef<CDict>(oldValue);
 
-				for(PageList::iterator i=pageList.begin(); i!=pageList.end(); ++i)
+				// page index (if valid) still contains oldValue position, so
+				// just checks CPage at that position
+				PageList::iterator i=pageList.end();
+				if(pageIndexState==PAGE_INDEX_VALID)
+				{
+					size_t oldPos=getIndexedPagePosition(getValueFromSimple<CRef>(oldValue));
+					if(oldPos)
+					{
+						minPos=oldPos;
+						i=pageList.find(minPos);
+						if(i!=pageList.end() && i->second->getDictionary()!=oldDict_ptr)
+							i=pageList.end();
+					}
+				}else
+					i=pageList.begin();
+
+				for(; i!=pageList.end(); ++i)
 				{
 					// checks page's dictionary with old one
 					boost::shared_ptr<CPage> page=i->second;
@@ -2617,6 +2793,9 @@ using namespace utils;
 
 	// number of added pages by newValue tree
 	int pagesCount=0;
+
+	// position of newValue node (0 if not known)
+	size_t newPos=0;
 	
 	// handles new value - one after change
 	// if pNull - no new value is available (subtree has been removed)
@@ -2647,7 +2826,7 @@ using namespace utils;
 		// no information
 		try
 		{
-			minPos = getNodePosition(_this.lock(), newValue, &nodeCountCache);
+			minPos = newPos = getNodePosition(_this.lock(), newValue, &nodeCountCache);
 		}catch(std::exception &e)
 		{
 			// position can't be determined
@@ -2661,6 +2840,9 @@ using namespace utils;
 	// corrects difference with added pages
 	difference += pagesCount;
 
+	// page index has to be updated before pages positions are consolidated
+	updatePageIndex(oldValue, newValue, newPos);
+
 	// no difference means no speacial handling for other pages
 	// we have replaced old sub tree with new subtree with same number of pages
 	if(difference==0)
@@ -2729,6 +2911,217 @@ using namespace utils;
 }
 
 
+namespace {
+
+/** Collects leaf nodes references from page tree.
+ * @param nodeDict Intermediate node dictionary.
+ * @param index Index where to append found page references.
+ * @param visited Set of already visited intermediate nodes.
+ *
+ * Goes through Kids array of given node in the same way as findPageDict and
+ * appends each leaf node reference to given index. Intermediate nodes are
+ * processed recursively. All other Kids elements are ignored.
+ *
+ * @return false if the page tree contains cycle, true otherwise.
+ */
+bool collectPageRefs(
+		const boost::shared_ptr<CDict> & nodeDict, 
+		PageRefIndex & index, 
+		std::set<IndiRef, utils::IndComparator> & visited)
+{
+using namespace utils;
+
+	if(!visited.insert(nodeDict->getIndiRef()).second)
+	{
+		kernelPrintDbg(DBG_WARN, "Page tree node "<<nodeDict->getIndiRef()<<" is referenced more times.");
+		return false;
+	}
+
+	ChildrenStorage children;
+	getKidsFromInterNode(nodeDict, children);
+	for(ChildrenStorage::iterator i=children.begin(); i!=children.end(); ++i)
+	{
+		boost::shared_ptr<IProperty> child=*i;
+		if(!isRef(child))
+			continue;
+
+		PageTreeNodeType nodeType=getNodeType(child);
+		if(nodeType==LeafNode)
+		{
+			index.push_back(getValueFromSimple<CRef>(child));
+			continue;
+		}
+		if(nodeType==InterNode || nodeType==RootNode)
+		{
+			if(!collectPageRefs(getCObjectFromRef<CDict>(child), index, visited))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+} // end of anonymous namespace for page index
+
+bool CPdf::buildPageIndex()const
+{
+using namespace utils;
+
+	if(pageIndexState!=PAGE_INDEX_INVALID)
+	{
+		// index which is kept up to date by consolidatePageList has to
+		// cover all pages, otherwise something has been missed
+		if(pageIndexState==PAGE_INDEX_VALID && pageRefIndex.size()!=getPageCount())
+		{
+			kernelPrintDbg(DBG_WARN, "Page index size="<<pageRefIndex.size()
+					<<" doesn't match page count="<<getPageCount()<<". Rebuilding.");
+			invalidatePageIndex();
+		}else
+			return pageIndexState==PAGE_INDEX_VALID;
+	}
+
+	kernelPrintDbg(DBG_DBG, "Building page index");
+	pageIndexState=PAGE_INDEX_UNUSABLE;
+	boost::shared_ptr<CDict> rootDict=getPageTreeRoot(_this.lock());
+	if(!rootDict.get())
+		return false;
+
+	std::set<IndiRef, utils::IndComparator> visited;
+	try
+	{
+		if(!collectPageRefs(rootDict, pageRefIndex, visited))
+		{
+			invalidatePageIndex();
+			pageIndexState=PAGE_INDEX_UNUSABLE;
+			return false;
+		}
+	}catch(CObjectException & e)
+	{
+		kernelPrintDbg(DBG_WARN, "Page tree can't be indexed. cause="<<e.what());
+		invalidatePageIndex();
+		pageIndexState=PAGE_INDEX_UNUSABLE;
+		return false;
+	}
+
+	// page tree can be searched for each position only if it is not 
+	// ambiguous - each page dictionary has to be referenced just once
+	size_t pos=1;
+	for(PageRefIndex::const_iterator i=pageRefIndex.begin(); i!=pageRefIndex.end(); ++i, ++pos)
+	{
+		if(!pagePositionIndex.insert(PagePositionIndex::value_type(*i, pos)).second)
+		{
+			kernelPrintDbg(DBG_WARN, "Page tree is ambiguous. "<<*i<<" is referenced more times.");
+			invalidatePageIndex();
+			pageIndexState=PAGE_INDEX_UNUSABLE;
+			return false;
+		}
+	}
+
+	if(pageRefIndex.size()!=getPageCount())
+	{
+		kernelPrintDbg(DBG_WARN, "Page index size="<<pageRefIndex.size()
+				<<" doesn't match page count="<<getPageCount());
+		invalidatePageIndex();
+		pageIndexState=PAGE_INDEX_UNUSABLE;
+		return false;
+	}
+
+	kernelPrintDbg(DBG_DBG, "Page index with "<<pageRefIndex.size()<<" pages built");
+	validPagePositions=pageRefIndex.size();
+	pageIndexState=PAGE_INDEX_VALID;
+	return true;
+}
+
+void CPdf::invalidatePageIndex()const
+{
+	kernelPrintDbg(DBG_DBG, "Discarding page index with "<<pageRefIndex.size()<<" entries");
+	pageRefIndex.clear();
+	pagePositionIndex.clear();
+	validPagePositions=0;
+	pageIndexState=PAGE_INDEX_INVALID;
+}
+
+size_t CPdf::getIndexedPagePosition(const IndiRef & ref)const
+{
+	PagePositionIndex::const_iterator posIter=pagePositionIndex.find(ref);
+	if(posIter==pagePositionIndex.end())
+		return 0;
+	if(posIter->second<=validPagePositions)
+		return posIter->second;
+
+	// position is not renumbered yet, page has to be somewhere behind
+	// valid positions
+	for(size_t i=validPagePositions; i<pageRefIndex.size(); ++i)
+		if(pageRefIndex[i]==ref)
+			return i+1;
+	return 0;
+}
+
+void CPdf::refreshPagePositions()const
+{
+	if(validPagePositions>=pageRefIndex.size())
+		return;
+	kernelPrintDbg(DBG_DBG, "Renumbering page index from pos="<<validPagePositions+1);
+	for(size_t i=validPagePositions; i<pageRefIndex.size(); ++i)
+		pagePositionIndex[pageRefIndex[i]]=i+1;
+	validPagePositions=pageRefIndex.size();
+}
+
+void CPdf::updatePageIndex(const boost::shared_ptr<IProperty> & oldValue, const boost::shared_ptr<IProperty> & newValue, size_t newPos)
+{
+using namespace utils;
+
+	// unusable index is rebuilt after any change, invalid one is rebuilt
+	// lazily when needed
+	if(pageIndexState!=PAGE_INDEX_VALID)
+	{
+		invalidatePageIndex();
+		return;
+	}
+
+	// only single page insertion, removal or replacement is handled
+	// incrementally
+	if((!isNull(oldValue) && getNodeType(oldValue)!=LeafNode) 
+			|| (!isNull(newValue) && getNodeType(newValue)!=LeafNode))
+	{
+		kernelPrintDbg(DBG_DBG, "Intermediate node has changed. Discarding page index.");
+		invalidatePageIndex();
+		return;
+	}
+
+	if(!isNull(oldValue))
+	{
+		IndiRef oldRef=getValueFromSimple<CRef>(oldValue);
+		size_t oldPos=getIndexedPagePosition(oldRef);
+		if(!oldPos)
+		{
+			kernelPrintDbg(DBG_WARN, "Removed page "<<oldRef<<" is not in page index. Discarding index.");
+			invalidatePageIndex();
+			return;
+		}
+		pagePositionIndex.erase(oldRef);
+		pageRefIndex.erase(pageRefIndex.begin()+(oldPos-1));
+		validPagePositions=std::min(validPagePositions, oldPos-1);
+		kernelPrintDbg(DBG_DBG, "Page "<<oldRef<<" removed from page index at pos="<<oldPos);
+	}
+
+	if(!isNull(newValue))
+	{
+		IndiRef newRef=getValueFromSimple<CRef>(newValue);
+		if(!newPos || newPos>pageRefIndex.size()+1 
+				|| pagePositionIndex.find(newRef)!=pagePositionIndex.end())
+		{
+			kernelPrintDbg(DBG_WARN, "Page "<<newRef<<" can't be added to page index (pos="<<newPos<<"). Discarding index.");
+			invalidatePageIndex();
+			return;
+		}
+		pageRefIndex.insert(pageRefIndex.begin()+(newPos-1), newRef);
+		pagePositionIndex.insert(PagePositionIndex::value_type(newRef, newPos));
+		validPagePositions=std::min(validPagePositions, newPos-1);
+		kernelPrintDbg(DBG_DBG, "Page "<<newRef<<" added to page index at pos="<<newPos);
+	}
+}
+
 bool CPdf::consolidatePageTree(const boost::shared_ptr<CDict> & interNode, bool propagate)
 {
 using namespace utils;
@@ -3135,6 +3528,7 @@ void CPdf::save(bool newRevision)const
 	// mark, that no changes were stored
 	// check for credentials is done in XRefWriter
 	xref->saveChanges(newRevision);
+	renderContext->invalidate();
 	change=false;
 }
 
@@ -3171,6 +3565,7 @@ void CPdf::changeTrailer(std::string &name, const boost::shared_ptr<IProperty> &
 	Object *result;
 	boost::shared_ptr<Object> o(value->_makeXpdfObject());
 	result = xref->changeTrailer(name.c_str(), o.get());
+	renderContext->invalidateCatalog();
 	if (result) {
 		xpdf::object_deleter d;
 		d(result);
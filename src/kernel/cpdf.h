@@ -32,6 +32,7 @@
 #include "kernel/modecontroller.h"
 #include "kernel/iproperty.h"
 #include "kernel/cstream.h"
+#include "kernel/textsearchparams.h"
 #include <poppler/Stream.h>
 
 class StreamWriter;
@@ -43,6 +44,7 @@ class IProperty;
 class CDict;
 class CXref;
 class CPage;
+class RenderContext;
 template<typename IP> inline boost::shared_ptr<CDict> getCDictFromDict (IP& ip, const std::string& key);
 
 namespace utils {
@@ -93,6 +95,17 @@ typedef std::map<IndiRef, size_t, utils::IndComparator> PageTreeNodeCountCache;
  */
 typedef std::map<IndiRef, IndiRef, utils::IndComparator> PageTreeKidsParentCache;
 
+/** Type for flat page index.
+ * Element at index i holds reference of the page dictionary at position i+1.
+ * @see CPdf::pageRefIndex
+ */
+typedef std::vector<IndiRef> PageRefIndex;
+
+/** Type for page dictionary reference to position mapping.
+ * @see CPdf::pagePositionIndex
+ */
+typedef std::map<IndiRef, size_t, utils::IndComparator> PagePositionIndex;
+
 /** State of reference translation.
  * <ul>
  * <li><b>STATE_NEW</b> represents a new mapping. This means that a new
@@ -379,6 +392,7 @@ protected:
 		 * <li>invalidates pdf-::pageCount
 		 * <li>clears pdf::pageList and invalidates all pages.
 		 * <li>clears pdf::nodeCountCache
+		 * <li>invalidates pdf flat page index
 		 * <li>tries to get dictionary from newValue (if it is reference) and
 		 * registers observers to whole new page tree (uses
 		 * pdf::registerPageTreeObservers method).
@@ -709,6 +723,60 @@ protected:
 	 */
 	void consolidatePageList(const boost::shared_ptr<IProperty> & oldValue, const boost::shared_ptr<IProperty> & newValue);
 
+	/** Builds flat page index if it is not valid.
+	 *
+	 * Walks the page tree from its root (in the same way as findPageDict 
+	 * does) and collects references of all leaf nodes to pageRefIndex and
+	 * pagePositionIndex. If the page tree contains same page dictionary 
+	 * more times, contains cycle or the number of collected pages doesn't
+	 * match getPageCount, index is marked as unusable.
+	 *
+	 * @return true if index is valid and can be used, false otherwise.
+	 */
+	bool buildPageIndex()const;
+
+	/** Discards flat page index.
+	 *
+	 * Index will be rebuilt when it is needed next time.
+	 */
+	void invalidatePageIndex()const;
+
+	/** Returns position of the page dictionary from flat page index.
+	 * @param ref Reference of the page dictionary.
+	 *
+	 * Index has to be valid. Uses pagePositionIndex if the stored position
+	 * is not affected by pending renumbering (see validPagePositions), 
+	 * otherwise searches pageRefIndex behind valid positions. Doesn't 
+	 * renumber pagePositionIndex, so a sequence of page tree changes doesn't
+	 * pay for renumbering after each of them.
+	 *
+	 * @return Position of the page or 0 if it is not indexed.
+	 */
+	size_t getIndexedPagePosition(const IndiRef & ref)const;
+
+	/** Renumbers pending positions in pagePositionIndex.
+	 *
+	 * Sets positions of all pages behind validPagePositions from 
+	 * pageRefIndex, so all positions in pagePositionIndex are up to date
+	 * afterwards.
+	 */
+	void refreshPagePositions()const;
+
+	/** Updates flat page index after page tree change.
+	 * @param oldValue Old reference (CNull if no previous state).
+	 * @param newValue New reference (CNull if no future state).
+	 * @param newPos Position of newValue node or 0 if unknown.
+	 *
+	 * Called from consolidatePageList with the same parameters. If both
+	 * values are CNull or leaf nodes, removes oldValue page from index 
+	 * and inserts newValue page to the newPos position. Positions of all 
+	 * following pages are not renumbered immediately, validPagePositions 
+	 * is lowered instead and refreshPagePositions renumbers them when they
+	 * are needed. Otherwise (intermediate node has been added or removed) 
+	 * index is invalidated.
+	 */
+	void updatePageIndex(const boost::shared_ptr<IProperty> & oldValue, const boost::shared_ptr<IProperty> & newValue, size_t newPos);
+
 	/** Registers definitive value of property to the xref.
 	 * @param ip Property to be used.
 	 * @param ref Reference for property
@@ -923,6 +991,51 @@ private:
 	 */
 	mutable PageTreeNodeCountCache nodeCountCache;
 
+	/** State of the flat page index.
+	 * <ul>
+	 * <li><b>PAGE_INDEX_INVALID</b> index has to be rebuilt before use.
+	 * <li><b>PAGE_INDEX_VALID</b> pageRefIndex and pagePositionIndex
+	 * reflect current page tree.
+	 * <li><b>PAGE_INDEX_UNUSABLE</b> page tree can't be indexed (it is
+	 * ambiguous or malformed) and tree searching has to be used until next
+	 * page tree change.
+	 * </ul>
+	 */
+	enum PageIndexState {PAGE_INDEX_INVALID, PAGE_INDEX_VALID, PAGE_INDEX_UNUSABLE};
+
+	/** Current state of the flat page index.
+	 */
+	mutable PageIndexState pageIndexState;
+
+	/** Flat page index.
+	 *
+	 * Holds references of all page dictionaries in document order, so page
+	 * dictionary at given position can be found without page tree searching.
+	 * Index is built lazily by buildPageIndex when first needed and kept
+	 * up to date by consolidatePageList when single page is inserted or
+	 * removed. Any other page tree change invalidates it.
+	 * <br>
+	 * Content is meaningful only if pageIndexState is PAGE_INDEX_VALID.
+	 */
+	mutable PageRefIndex pageRefIndex;
+
+	/** Page dictionary reference to position mapping.
+	 *
+	 * Reverse mapping to pageRefIndex used by getPagePosition. Contains the
+	 * same references as pageRefIndex, but only positions up to 
+	 * validPagePositions are up to date (see refreshPagePositions).
+	 */
+	mutable PagePositionIndex pagePositionIndex;
+
+	/** Number of leading pages with up to date position in 
+	 * pagePositionIndex.
+	 *
+	 * Page insertion or removal lowers the value to the number of pages 
+	 * before the changed position instead of renumbering all following 
+	 * pages.
+	 */
+	mutable size_t validPagePositions;
+
 	/** Cache for indirect Kids arrays mapping to their parents.
 	 *
 	 * This cache enables to overcome problem with indirect Kids arrays in
@@ -992,6 +1105,16 @@ private:
 	 */
 	configuration::ModeController* modeController;
 
+	/** Rendering cache for this document.
+	 *
+	 * Keeps xpdf objects needed for page displaying between rendering calls.
+	 * It is informed about each indirect object change in
+	 * changeIndirectProperty and discarded completely when document content
+	 * is reinitialized (revision change, credentials setting, save).
+	 * Use getRenderContext to access it.
+	 */
+	boost::shared_ptr<RenderContext> renderContext;
+
 	/** Weak reference to this instance for proper reference counting
 	 * with combination to published shared_ptr.
 	 */
@@ -1074,6 +1197,18 @@ public:
 		return dynamic_cast<CXref *>(xref);
 	}
        
+	/** Returns rendering cache for this document.
+	 *
+	 * Returned context is valid for the whole CPdf instance life cycle and
+	 * it is intended to be used by page displaying code only.
+	 *
+	 * @return Rendering context instance.
+	 */
+	RenderContext & getRenderContext()const
+	{
+		return *renderContext;
+	}
+
 	/** Returns actually used mode controller.
 	 *
 	 * @return IModeController implementator or NULL, if no mode 
@@ -1207,7 +1342,7 @@ public:
 	/** Saves changes to pdf file.
 	 * @param newRevision Flag for new revision creation.
 	 *
-	 * If revision is 0 (the newest one), uses XRefWriter::saveChanges method to
+	 * If the current revision is the newest one, uses XRefWriter::saveChanges method to
 	 * store changes. Parameter newRevision has precisely the same meaning.
 	 * For more implementation information @see XRefWriter
 	 *
@@ -1370,6 +1505,9 @@ public:
 	 * by this CPdf instance or it is no longer available, exception is thrown.
 	 * <br>
 	 * NOTE: instances are same if they are stand for same instance.
+	 * <br>
+	 * Position is taken from flat page index according page dictionary
+	 * reference. pageList is searched only if index can't be used.
 	 *
 	 * @throw PageNotFoundException if given page is not recognized by CPdf
 	 * instance.
@@ -1395,8 +1533,9 @@ public:
 	 * @param pos Position (starting from 1).
 	 *
 	 * At first tries to find page with given position in pageList. If found,
-	 * returns instance from list. Otherwise, searches page tree by findPageDict
-	 * helper function and if page dictionary is found, creates new CPage
+	 * returns instance from list. Otherwise, gets page dictionary from flat
+	 * page index (or searches page tree by findPageDict helper function if
+	 * index can't be used) and if page dictionary is found, creates new CPage
 	 * instance and inserts new mapping (postion to CPage instance) to pageList.
 	 *
 	 * @throw PageNotFoundException if pos can't be found or out of range.
@@ -1474,6 +1613,47 @@ public:
 		return getPage(getPageCount());
 	}
 
+	// text search methods
+	// ===================
+
+	/** Finds all occurrences of a text in the document.
+	 * @param text Text to find.
+	 * @param callback Receiver of found occurrences.
+	 * @param params Search parameters.
+	 *
+	 * Searches pages one after another by CPage::findText and reports
+	 * occurrences of each page as soon as the page is searched. Pages keep
+	 * their text between searches, so repeated searches do not display
+	 * unchanged pages again.
+	 *
+	 * @return Number of reported occurrences.
+	 */
+	size_t findText(const std::string & text, ITextSearchCallback & callback, 
+			const TextSearchParams & params = TextSearchParams())const;
+
+	/** Finds all occurrences of a text in the document by more threads.
+	 * @param instances Instances of the same document, one per thread.
+	 * @param text Text to find.
+	 * @param callback Receiver of found occurrences.
+	 * @param params Search parameters.
+	 *
+	 * Pages are distributed among threads, each of them uses its own
+	 * instance, because CPdf instances are not thread safe. Instances
+	 * have to be opened (see getInstance) by the caller and must not be
+	 * used by anybody else during the search. Callback is not called
+	 * concurrently, but occurrences of different pages are reported in the
+	 * order in which pages are searched.
+	 * <br>
+	 * Pages keep their text, so the same instances should be used for
+	 * repeated searches.
+	 *
+	 * @throw PdfException if a page can't be searched.
+	 * @return Number of reported occurrences.
+	 */
+	static size_t findText(const std::vector<boost::shared_ptr<CPdf> > & instances, 
+			const std::string & text, ITextSearchCallback & callback, 
+			const TextSearchParams & params = TextSearchParams());
+
 	// Version handling and work around
 	// =================================
 
@@ -48,7 +48,8 @@ using namespace utils;
 //
 //
 //
-CStream::CStream (boost::weak_ptr<CPdf> p, const ::Object& o, const IndiRef& rf) : IProperty (p,rf), parser (NULL), tmpObj (NULL)
+CStream::CStream (boost::weak_ptr<CPdf> p, const ::Object& o, const IndiRef& rf) 
+	: IProperty (p,rf), bufferLoaded (true), rawStart (0), rawLength (0), parser (NULL), tmpObj (NULL)
 {
 	kernelPrintDbg (debug::DBG_DBG,"");
 	// Make sure it is a stream
@@ -62,20 +63,22 @@ CStream::CStream (boost::weak_ptr<CPdf> p, const ::Object& o, const IndiRef& rf)
 	assert (NULL != dict);
 	objDict->initDict ((Dict *)dict);
 	utils::complexValueFromXpdfObj<pDict,CDict::Value&> (dictionary, *objDict, dictionary.value);
+	dictionary._valueChanged ();
 
 	// Set pdf and ref
 	dictionary.setPdf (p);
 	dictionary.setIndiRef (rf);
 	
-	// Save the contents of the container
-	utils::parseStreamToContainer (buffer, o);
+	// Remember where the contents are, they are read when needed
+	initBuffer (o);
 }
 
 
 //
 //
 //
-CStream::CStream (const ::Object& o) : parser (NULL), tmpObj (NULL)
+CStream::CStream (const ::Object& o) 
+	: bufferLoaded (true), rawStart (0), rawLength (0), parser (NULL), tmpObj (NULL)
 {
 	kernelPrintDbg (debug::DBG_DBG,"");
 	// Make sure it is a stream
@@ -89,6 +92,7 @@ CStream::CStream (const ::Object& o) : parser (NULL), tmpObj (NULL)
 	assert (NULL != dict);
 	objDict->initDict ((Dict *)dict);
 	utils::complexValueFromXpdfObj<pDict,CDict::Value&> (dictionary, *objDict, dictionary.value);
+	dictionary._valueChanged ();
 
 	// Save the contents of the container
 	utils::parseStreamToContainer (buffer, o);
@@ -98,7 +102,8 @@ CStream::CStream (const ::Object& o) : parser (NULL), tmpObj (NULL)
 //
 //
 //
-CStream::CStream (const CDict& dict) : parser (NULL), tmpObj (NULL)
+CStream::CStream (const CDict& dict) 
+	: bufferLoaded (true), rawStart (0), rawLength (0), parser (NULL), tmpObj (NULL)
 {
 	kernelPrintDbg (debug::DBG_DBG,"");
 
@@ -108,7 +113,8 @@ CStream::CStream (const CDict& dict) : parser (NULL), tmpObj (NULL)
 //
 //
 //
-CStream::CStream (bool makeReqEntries) : parser (NULL)
+CStream::CStream (bool makeReqEntries) 
+	: bufferLoaded (true), rawStart (0), rawLength (0), parser (NULL), tmpObj (NULL)
 {
 	kernelPrintDbg (debug::DBG_DBG,"");
 
@@ -116,6 +122,75 @@ CStream::CStream (bool makeReqEntries) : parser (NULL)
 		createReqEntries ();
 }
 
+//
+//
+//
+void
+CStream::initBuffer (const ::Object& o)
+{
+	// Stream data can be read later only if they are stored in the document
+	// file - we need the pdf to get them
+	boost::shared_ptr<CPdf> pdf = getPdf ().lock ();
+	::Stream* xpdfStream = o.getStream ();
+	assert (xpdfStream);
+	::BaseStream* base = (pdf && pdf->getCXref ()) ? xpdfStream->getBaseStream () : NULL;
+	if (NULL == base || strFile != base->getKind ())
+	{
+		utils::parseStreamToContainer (buffer, o);
+		return;
+	}
+	
+	// Length has to be known directly
+	boost::shared_ptr< ::Object> xpdfDict(XPdfObjectFactory::getInstance(), xpdf::object_deleter()); 
+	xpdfDict->initDict ((Dict *)o.streamGetDict());
+	boost::shared_ptr< ::Object> xpdfLen(XPdfObjectFactory::getInstance(), xpdf::object_deleter()); 
+	xpdfDict->dictLookup ("Length", xpdfLen.get());
+	if (!xpdfLen->isInt () || 0 > xpdfLen->getInt ())
+	{
+		utils::parseStreamToContainer (buffer, o);
+		return;
+	}
+
+	rawStart = base->getStart ();
+	rawLength = static_cast<size_t> (xpdfLen->getInt ());
+	bufferLoaded = false;
+	kernelPrintDbg (debug::DBG_DBG, "Stream data deferred (start="<<rawStart<<" length="<<rawLength<<")");
+}
+
+//
+//
+//
+void
+CStream::loadBuffer () const
+{
+	if (bufferLoaded)
+		return;
+	
+	boost::shared_ptr<CPdf> pdf = getPdf ().lock ();
+	if (!pdf)
+	{
+		kernelPrintDbg (debug::DBG_ERR, "Stream data not loaded and pdf is not available anymore.");
+		throw CObjInvalidOperation ();
+	}
+	kernelPrintDbg (debug::DBG_DBG, "Loading stream data (start="<<rawStart<<" length="<<rawLength<<")");
+	
+	// Read raw data directly from the document 
+	::Object nullObj;
+	nullObj.initNull ();
+	::Stream* rawstr = pdf->getCXref ()->makeRawSubStream (rawStart, rawLength, &nullObj);
+	assert (rawstr);
+	buffer.resize (rawLength);
+	rawstr->reset ();
+	if (rawLength)
+		buffer.resize (rawstr->getBlock (&buffer[0], rawLength));
+	rawstr->close ();
+	delete rawstr;
+	
+	if (rawLength != buffer.size())
+		kernelPrintDbg (debug::DBG_ERR, "Stream buffer length ("<<buffer.size()<<") doesn't match Length value ("<<rawLength<<").");
+	bufferLoaded = true;
+}
+
 //
 //
 //
@@ -142,6 +217,9 @@ CStream::doClone () const
 	assert (NULL == parser  || !"Want to clone opened stream.. Should the stream state be also copied?");
 	//assert (getLength() == buffer.size());
 	
+	// Clone has to be independent on the pdf
+	loadBuffer ();
+	
 	// Make new stream object
 	// NOTE: We do not want to inherit any IProperty variable
 	CStream* clone_ = _newInstance ();
@@ -157,6 +235,7 @@ CStream::doClone () const
 		CDict::Value::value_type item =  make_pair ((*it).first, newIp);
 		clone_->dictionary.value.push_back (item);
 	}
+	clone_->dictionary._valueChanged ();
 
 	copy (buffer.begin(), buffer.end(), back_inserter (clone_->buffer));
 	
@@ -173,6 +252,10 @@ CStream::doClone () const
 void 
 CStream::setPdf (boost::weak_ptr<CPdf> pdf)
 {
+	// Data can be read only from the original pdf
+	if (!bufferLoaded && getPdf ().lock () != pdf.lock ())
+		loadBuffer ();
+
 	// Set pdf to this object and dictionary it contains
 	IProperty::setPdf (pdf);
 	dictionary.setPdf (pdf);
@@ -209,6 +292,7 @@ CStream::setRawBuffer (const Buffer& buf)
 	// Copy buf to buffer
 	buffer.clear ();
 	copy (buf.begin(), buf.end(), back_inserter (buffer));
+	bufferLoaded = true;
 	// Change length
 	setLength (buffer.size());
 	
@@ -263,6 +347,7 @@ CStream::_makeXpdfObject () const
 	// Set correct length. This can ONLY happen e.g. when length is an indirect
 	// object
 	// 
+	loadBuffer ();
 	if (getLength() != buffer.size())
 		kernelPrintDbg (debug::DBG_WARN, "Length attribute of a stream is not valid. Changing it to buffer size.");
 
@@ -290,7 +375,8 @@ CStream::getStringRepresentation (string& str) const
 	dictionary.getStringRepresentation (str);
 
 	// Put them together
-	return utils::streamToString (strDict, buffer.begin(), buffer.end(), back_inserter(str));
+	const Buffer& buf = getBuffer ();
+	return utils::streamToString (strDict, buf.begin(), buf.end(), back_inserter(str));
 }
 
 
@@ -358,6 +444,7 @@ CStream::_objectChanged (boost::shared_ptr<const ObserverContext> context)
 	assert (hasValidRef (this));
 
 	// Set correct length
+	loadBuffer ();
 	if (getLength() != buffer.size())
 	{
 		kernelPrintDbg (debug::DBG_WARN, "Length attribute of a stream is not valid. Changing it to buffer size.");
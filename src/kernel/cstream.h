@@ -84,8 +84,21 @@ public:
 protected:
 	/** Stream dictionary. */
 	CDict dictionary;
-	/** Stream buffer. */
-	Buffer buffer;
+	/** Stream buffer. 
+	 * Streams read from a pdf document are not loaded until somebody needs
+	 * the data (see loadBuffer). Use getBuffer to access data.
+	 */
+	mutable Buffer buffer;
+	/** Flag whether the buffer holds the stream data. */
+	mutable bool bufferLoaded;
+	/** Absolute document offset of the raw (encoded) stream data.
+	 * Used only if bufferLoaded is false.
+	 */
+	Guint rawStart;
+	/** Number of raw (encoded) bytes in the document.
+	 * Used only if bufferLoaded is false.
+	 */
+	size_t rawLength;
 
 	//
 	// Parsing
@@ -230,9 +243,20 @@ public:
 	/**
 	 * Get encoded buffer. Can contain non printable characters.
 	 *
+	 * Stream data are read from the document when the buffer is required
+	 * for the first time.
+	 *
 	 * @return Buffer.
 	 */
-	const Buffer& getBuffer () const {return buffer;}
+	const Buffer& getBuffer () const {loadBuffer (); return buffer;}
+
+	/**
+	 * Checks whether stream data have been already read.
+	 *
+	 * @return true if buffer holds stream data, false if they are still in the
+	 * document only.
+	 */
+	bool isBufferLoaded () const {return bufferLoaded;}
 	
 	/**
 	 * Get filters.
@@ -331,11 +355,11 @@ public:
 		// Create context
 		boost::shared_ptr<ObserverContext> context (this->_createContext());
 	
-		// Make buffer pdf valid, encode buf and save it to buffer
-		std::string strbuf;
-		utils::makeStreamPdfValid (buf.begin(), buf.end(), strbuf);
-		buffer.clear();
-		copy(strbuf.begin(), strbuf.end(), back_inserter(buffer));
+		// Save buf to buffer
+		// 	-- decoded data need not be made pdf valid (see makeStreamPdfValid),
+		// 	   so copy it at once
+		buffer.assign (buf.begin(), buf.end());
+		bufferLoaded = true;
 		// Change length
 		std::vector<std::string> filters;
 		getFilters(filters);
@@ -447,6 +471,28 @@ private:
 
 
 private:
+	/**
+	 * Reads stream data from the document if they are not loaded yet.
+	 *
+	 * Raw data are read from rawStart position through a substream provided
+	 * by the pdf cross reference table.
+	 *
+	 * \exception CObjInvalidOperation if stream is not loaded and it is not
+	 * associated with a pdf anymore.
+	 */
+	void loadBuffer () const;
+
+	/**
+	 * Initializes raw data position from xpdf stream object.
+	 *
+	 * Stream data are read later by loadBuffer when they are needed. Data
+	 * are read immediately if the object is not backed by the document
+	 * file.
+	 *
+	 * @param o Xpdf stream object.
+	 */
+	void initBuffer (const ::Object& o);
+
 	/**
 	 * Get length.
 	 *
@@ -88,8 +88,12 @@ public:
 		curobj = boost::shared_ptr< ::Object>(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
 	}
 
-	/** Open. */
-	void open ()
+	/** 
+	 * Open. 
+	 *
+	 * @param record Record the data read from all streams (see getReadData).
+	 */
+	void open (bool record = false)
 	{		
 		assert (!streams.empty());
 		curobj->free ();
@@ -111,6 +115,8 @@ public:
 		
 		// Create parser
 		lexer = new ::Lexer (xref, xarr.get());
+		if (record)
+			lexer->startRecord ();
 		parser = boost::shared_ptr<Parser> (new ::Parser (xref, lexer, 
 					gFalse  // TODO gfalse should be ok here
 				       		// because content stream must
@@ -197,6 +203,26 @@ public:
 	 */
 	bool eofOfActualStream ()
 		{ return (parser->eofOfActualStream()); }
+
+	/** 
+	 * Get position of the next object in the data read from all streams. 
+	 * Valid only if the data is recorded.
+	 */
+	size_t getObjPos ()
+		{ return parser->getObjPos(); }
+
+	/**
+	 * Get the data read from all streams so far. Streams are separated by a
+	 * newline if they do not end with a whitespace.
+	 *
+	 * @param str Output string, empty if the data is not recorded.
+	 */
+	void getReadData (std::string& str) const
+	{
+		str.clear ();
+		if (lexer && lexer->getRecord())
+			str.assign (lexer->getRecord()->getCString(), lexer->getRecord()->getLength());
+	}
 	
 };
 
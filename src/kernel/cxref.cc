@@ -98,13 +98,22 @@ void CXref::cleanUp()
 
 	kernelPrintDbg(DBG_DBG, "Cleaning newStorage");
 	// newStorage doesn't need special entries deallocation
-
+	// values of new objects are gone with changedStorage, so none of them
+	// is counted any more
+	newStorage.clear();
+	initializedNewRefs=0;
 	kernelPrintDbg(DBG_DBG, "newStorage cleaned up");
 
 	// remove changed trailer
 	currTrailer.reset();
 }
 
+CXref::CXref(BaseStream * stream)
+	:XRef(stream), needs_credentials(false), internal_fetch(true), initializedNewRefs(0)
+{
+	init();
+}
+
 CXref::~CXref()
 {
 using namespace debug;
@@ -144,6 +153,10 @@ using namespace debug;
 	{
 		changedEntry=new ObjectEntry();
 		kernelPrintDbg(DBG_DBG, "object is changed for the first time, creating changedEntry");
+
+		// newly created object gets its first value
+		if(newStorage.contains(ref))
+			++initializedNewRefs;
 	}
 	assert(ref.num!=0);
 
@@ -606,20 +619,22 @@ using namespace debug;
 	return obj;
 }
 
+::Stream * CXref::makeRawSubStream(Guint start, Guint length, const ::Object * dict)const
+{
+	assert(str);
+	assert(dict);
+
+	kernelPrintDbg(debug::DBG_DBG, "start="<<start<<" length="<<length);
+	return str->makeSubStream(start, gTrue, length, dict);
+}
+
 int CXref::getNumObjects()const
 { 
 	using namespace debug;
 
 	kernelPrintDbg(DBG_DBG, "");
 
-	size_t newSize=0;
-    	RefStorage::ConstIterator begin , i;
-
-	for(i=newStorage.begin(); i!=newStorage.end(); ++i)
-		if(i->second==INITIALIZED_REF)
-			++newSize;
-
-    	return  newSize;
+	return XRef::getNumObjects()+initializedNewRefs;
 }
 
 
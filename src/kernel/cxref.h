@@ -121,7 +121,7 @@ protected:
 	 * This constructor is protected to prevent uninitialized instances.
 	 * We need at least to specify stream with data.
 	 */
-	CXref(): XRef(NULL), needs_credentials(false), internal_fetch(false){}
+	CXref(): XRef(NULL), needs_credentials(false), internal_fetch(false), initializedNewRefs(0){}
 
 	/** Entry for ChangedStorage.
 	 *
@@ -133,25 +133,36 @@ protected:
 		::Object * object;
 	} ObjectEntry;
 	
-	typedef ObjectStorage<const ::Ref, ObjectEntry*, xpdf::RefComparator> ChangedStorage;
+	typedef DenseObjectStorage< ::Ref, ObjectEntry*, xpdf::RefComparator> ChangedStorage;
 
 	/** Object storage for changed objects.
 	 * Mapping from object referencies to the ObjectEntry structure.
 	 * This structure contains new Object value for reference and 
 	 * flag. 
+	 * <br>
+	 * Storage is indexed by object number, so lookups done by each fetch
+	 * are constant time.
 	 */
 	ChangedStorage changedStorage;   
 
-	typedef ObjectStorage<const ::Ref, RefState, xpdf::RefComparator> RefStorage;
+	typedef DenseObjectStorage< ::Ref, RefState, xpdf::RefComparator> RefStorage;
 
 	/** Object storage for newly created objects.
 	 * Value is the flag of newly created reference. When new entry is added, it
 	 * should have Reserved state and when changed for the first time
 	 * Initialized. Unused is default value for not found, so unknown
-	 * (ObjectStorage returns 0 if entry is not found). 
+	 * (DenseObjectStorage returns 0 if entry is not found). 
 	 */
 	RefStorage newStorage;
 
+	/** Number of newly created objects which have a value.
+	 * Incremented by changeObject when a reference from newStorage gets its
+	 * first value (it is in changedStorage since then) and reset by cleanUp
+	 * which drops both storages. getNumObjects doesn't have to go through
+	 * the storages.
+	 */
+	size_t initializedNewRefs;
+
 	/** Registers change in given object addressable through given 
 	 * reference.
 	 * @param ref Object reference identificator.
@@ -470,7 +481,8 @@ public:
 	/** Returns number of indirect objects.
 	 *
 	 * Delegates to XRef::getNumObjects and adds also number of all
-	 * newly inserted (and initialized) objects.
+	 * newly created objects which have a value (see initializedNewRefs),
+	 * so this is constant time operation.
 	 *
 	 * @return Total number of objects.
 	 */
@@ -503,6 +515,26 @@ public:
 	 * found obj is set to objNull.
 	 */
 	virtual ::Object * fetch(int num, int gen, ::Object *obj)const;
+
+	/** Creates raw substream of the document data.
+	 * @param start Absolute offset of the first byte in the document.
+	 * @param length Number of bytes available in the substream.
+	 * @param dict Dictionary for the substream (objNull object if no
+	 * dictionary is needed).
+	 *
+	 * Returned stream reads data directly from the stream used for this
+	 * instance creation and it doesn't apply any filters or decryption.
+	 * This is the way how to get raw stream data from the document without
+	 * keeping them in the memory.
+	 * <br>
+	 * Note that the returned stream shares the file handle with the
+	 * document stream, so it should be reset before reading and closed
+	 * afterwards to restore the original position. Caller is responsible
+	 * for deallocation.
+	 *
+	 * @return Limited substream of the document stream.
+	 */
+	::Stream * makeRawSubStream(Guint start, Guint length, const ::Object * dict)const;
 };
 
 // implemented as macro because we want to have better log information
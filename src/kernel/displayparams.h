@@ -56,12 +56,17 @@ typedef struct DisplayParams
 	GBool		useMediaBox;/**< Use page media box. */
 	GBool		crop;		/**< Crop the page. 	*/
 	GBool		upsideDown;	/**< Upside down. 	*/
+	size_t		bands;		/**< Number of horizontal bands rendered in parallel
+							  (SplashOutputDev only, 1 renders on the calling thread).
+							  Bands are rendered as page slices, so they may differ
+							  from the page rendered at once by rounding. */
 	
 	/** Constructor. Default values are set. */
 	DisplayParams () : 
 		hDpi (DEFAULT_HDPI), vDpi (DEFAULT_VDPI),
 		pageRect (libs::Rectangle (DEFAULT_PAGE_LX, DEFAULT_PAGE_LY, DEFAULT_PAGE_RX, DEFAULT_PAGE_RY)),
-		rotate (DEFAULT_ROTATE), useMediaBox (gTrue), crop (gFalse), upsideDown (gTrue) 
+		rotate (DEFAULT_ROTATE), useMediaBox (gTrue), crop (gFalse), upsideDown (gTrue),
+		bands (DEFAULT_BANDS)
 		{}
 
 
@@ -72,7 +77,7 @@ typedef struct DisplayParams
 		return (hDpi == dp.hDpi && vDpi == dp.vDpi &&
 				pageRect == dp.pageRect && rotate == dp.rotate &&
 				useMediaBox == dp.useMediaBox && crop == dp.crop &&
-				upsideDown == dp.upsideDown);
+				upsideDown == dp.upsideDown && bands == dp.bands);
 	}
 
 	/** Converting position from pixmap of viewed page to pdf position.
@@ -124,6 +129,7 @@ typedef struct DisplayParams
 	static const int DEFAULT_HDPI 	= 72;		/**< Default horizontal dpi. */
 	static const int DEFAULT_VDPI 	= 72;		/**< Default vertical dpi. */
 	static const int DEFAULT_ROTATE	= 0;		/**< No rotatation. */
+	static const int DEFAULT_BANDS	= 1;		/**< Page is rendered by one thread. */
 
 	static const int DEFAULT_PAGE_LX = 0;		/**< Default x position of left upper corner. */
 	static const int DEFAULT_PAGE_LY = 0;		/**< Default y position of right upper corner. */
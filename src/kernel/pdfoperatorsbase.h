@@ -115,7 +115,7 @@ private:
 	// Ctor & Dtor
 protected:
 	/** Constructor. */
-	PdfOperator () : _contentstream (NULL) {}
+	PdfOperator () : _contentstream (NULL), _sourceBegin (0), _sourceEnd (0) {}
 
 	// Destructor
 public:
@@ -323,6 +323,17 @@ public:
 	BBox getBBox () const
 		{ assert (BBox::isInitialized(_bbox)); return _bbox; }
 	
+	//
+	// Source
+	//
+private:
+	/** 
+	 * Range of this operator in the decoded data of its content stream. 
+	 * Empty if the operator has to be written again. Maintained by
+	 * CContentStream.
+	 */
+	size_t _sourceBegin;
+	size_t _sourceEnd;
 
 	//
 	// Observer interface
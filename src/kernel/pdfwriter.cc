@@ -28,6 +28,12 @@
 #include "kernel/cobject.h"
 #include "kernel/streamwriter.h"
 #include "kernel/factories.h"
+#include "kernel/pdfspecification.h"
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <deque>
 #include <poppler/Hints.h>
 #include <poppler/Stream.h>
 #include <zlib.h>
@@ -40,6 +46,15 @@
 // size of the additional space for a xref entry for unexpected entries
 #define XREFFILLING 15
 
+// size of the chunk used when raw stream data are copied from the file
+#define STREAMCOPYCHUNK (64*1024)
+
+// size of the chunk used when decoded stream data are read and compressed
+#define DEFLATECHUNK 32768
+
+// compressed data buffer bigger than this is not kept for following streams
+#define DEFLATEKEEPBUFFER (4*1024*1024)
+
 const char * PDFHEADER="%PDF-";
 
 const char * TRAILER_KEYWORD="trailer";
@@ -135,11 +150,17 @@ using namespace observer;
 	}
 }
 
+void NullFilterStreamWriter::createInstance()
+{
+	instance=boost::shared_ptr<NullFilterStreamWriter>(new NullFilterStreamWriter());
+}
+
 boost::shared_ptr<NullFilterStreamWriter> NullFilterStreamWriter::getInstance()
 {
-	if(!instance)
-		instance=boost::shared_ptr<NullFilterStreamWriter>(
-				new NullFilterStreamWriter());
+	// writers of the content writer pipeline may ask for the instance
+	// concurrently
+	static boost::once_flag once=BOOST_ONCE_INIT;
+	boost::call_once(once, &NullFilterStreamWriter::createInstance);
 
 	return instance;
 }
@@ -175,9 +196,94 @@ unsigned char * NullFilterStreamWriter::null_extractor(const Object&obj, size_t&
 	return buffer;
 }
 
+/** Helper function for stream object writing.
+ * @param obj Stream object.
+ * @param ref Indirect reference for object (NULL if direct).
+ * @param header String for everything up to the stream data.
+ * @param footer String for everything behind the stream data.
+ *
+ * Stream object written as header, stream data and footer has the same
+ * format as streamToCharBuffer produces.
+ */
+static void getStreamObjectFrame(const Object& obj, Ref* ref, std::string& header, std::string& footer)
+{
+	header.clear();
+	footer = Specification::CSTREAM_FOOTER;
+	if(ref)
+	{
+		std::ostringstream indirectHeader;
+		indirectHeader << *ref << " " << Specification::INDIRECT_HEADER << "\n";
+		header = indirectHeader.str();
+		footer += Specification::INDIRECT_FOOTER;
+	}
+	boost::shared_ptr< ::Object> streamDictObj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	streamDictObj->initDict((Dict *)obj.streamGetDict());
+	std::string dict;
+	xpdfObjToString(*streamDictObj, dict);
+	header += dict;
+	header += Specification::CSTREAM_HEADER;
+}
+
+bool NullFilterStreamWriter::copyFileStream(const Object& obj, Ref* ref, StreamWriter& outStream)
+{
+	assert(obj.isStream());
+	BaseStream * base = obj.getStream()->getBaseStream();
+	if(base->getKind()!=strFile)
+		return false;
+	boost::shared_ptr< ::Object> lenghtObj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	obj.streamGetDict()->lookup("Length", lenghtObj.get());
+	if(!lenghtObj->isInt() || 0>lenghtObj->getInt())
+		return false;
+	size_t streamLen = lenghtObj->getInt();
+
+	// writes everything up to the stream data
+	std::string header, footer;
+	getStreamObjectFrame(obj, ref, header, footer);
+
+	size_t objPos = outStream.getPos();
+	outStream.putBuffer(header.c_str(), header.length());
+
+	// copies data in large chunks. Output stream may share file handle with
+	// the document and it may move the file position when its buffer is
+	// written, so each chunk is read from the explicitly set position (file
+	// writers always write to their own position)
+	std::vector<char> chunk(STREAMCOPYCHUNK);
+	Guint start = base->getStart();
+	size_t copied = 0;
+	bool eof = false;
+	base->reset();
+	while(copied<streamLen && !eof)
+	{
+		base->setPos(start+copied);
+		size_t toRead = std::min((size_t)STREAMCOPYCHUNK, streamLen-copied);
+		size_t chunkLen = base->getBlock(&chunk[0], toRead);
+		if(chunkLen<toRead)
+			eof = true;
+		outStream.putBuffer(&chunk[0], chunkLen);
+		copied += chunkLen;
+	}
+	base->close();
+	if(copied!=streamLen)
+	{
+		// Length doesn't match data - let the generic way to fix it
+		utilsPrintDbg(debug::DBG_WARN, "Stream data length ("<<copied<<") doesn't match Length value ("<<streamLen<<"). Using buffered copy.");
+		outStream.trim(objPos - outStream.getStart());
+		outStream.setPos(objPos);
+		return false;
+	}
+	outStream.putLine(footer.c_str(), footer.length());
+	return true;
+}
+
 void NullFilterStreamWriter::compress(const Object& obj, Ref* ref, StreamWriter& outStream)const
 {
 	assert(obj.isStream());
+
+	// stream data stored in the file are copied directly without
+	// intermediate buffer
+	if(copyFileStream(obj, ref, outStream))
+		return;
+
 	CharBuffer charBuffer;
 	size_t size=streamToCharBuffer(obj, ref, charBuffer, null_extractor);
 	if(!size)
@@ -198,18 +304,55 @@ void ZlibFilterStreamWriter::update_dict(const Object& obj)
 	obj.getStream()->getBaseStream()->dictAdd(copyString("Filter"), &filterArray);
 }
 
+ZlibFilterStreamWriter::ZlibFilterStreamWriter()
+	:level(Z_DEFAULT_COMPRESSION), blockSize(DEFAULT_BLOCK_SIZE), blockThreads(1)
+{
+}
+
+void ZlibFilterStreamWriter::createInstance()
+{
+	instance=boost::shared_ptr<ZlibFilterStreamWriter>(new ZlibFilterStreamWriter());
+}
+
 boost::shared_ptr<ZlibFilterStreamWriter> ZlibFilterStreamWriter::getInstance()
 {
-	if(!instance)
-		instance=boost::shared_ptr<ZlibFilterStreamWriter>(
-				new ZlibFilterStreamWriter());
+	// writers of the content writer pipeline may ask for the instance
+	// concurrently
+	static boost::once_flag once=BOOST_ONCE_INIT;
+	boost::call_once(once, &ZlibFilterStreamWriter::createInstance);
 
 	return instance;
 }
 
+void ZlibFilterStreamWriter::setLevel(int l)
+{
+	if(l!=Z_DEFAULT_COMPRESSION && (l<Z_NO_COMPRESSION || l>Z_BEST_COMPRESSION))
+	{
+		utilsPrintDbg(debug::DBG_WARN, "Invalid compression level "<<l<<". Using default.");
+		l=Z_DEFAULT_COMPRESSION;
+	}
+	level=l;
+}
+
+void ZlibFilterStreamWriter::setBlockCompression(size_t threads, size_t size)
+{
+	if(!threads)
+		threads=boost::thread::hardware_concurrency();
+	blockThreads=(threads)?threads:1;
+	blockSize=(size)?size:DEFAULT_BLOCK_SIZE;
+}
+
 bool ZlibFilterStreamWriter::supportObject(const Object& obj)const
 {
 	assert(obj.isStream());
+	// data of the external file stream are not stored in the document so
+	// we leave such a stream untouched
+	Object fileObj;
+	obj.streamGetDict()->lookupNF("F", &fileObj);
+	bool external = !fileObj.isNull();
+	fileObj.free();
+	if(external)
+		return false;
 	std::vector<std::string> filters; 
 	int count = getFiltersFromStream(obj, filters);
 	// with 0 filters we will simply support such an object and turn it
@@ -226,118 +369,369 @@ bool ZlibFilterStreamWriter::supportObject(const Object& obj)const
 	return false;
 }
 
-unsigned char* ZlibFilterStreamWriter::deflate_buffer(unsigned char * in, size_t in_size, size_t& size)
+/** Growing output buffer for compressed data.
+ * Buffer keeps its memory for following streams (unless it is too big)
+ * so that it is not allocated for each stream again.
+ */
+struct DeflateBuffer
 {
-	z_stream z;
-	z.zalloc = NULL; 
-	z.zfree = NULL;
-	z.opaque = NULL;
-	z.next_in = in; 
-	z.avail_in = in_size; 
-
-	// we do expect some comprimation so in_size should be definitely enough
-	size_t out_size = in_size;
-	unsigned char * out_buff = (unsigned char*)malloc(sizeof(unsigned char)*out_size);
-	int ret;
-	size_t total=0;
+	std::vector<unsigned char> data;
+	size_t length;
 
-	if(!out_buff)
+	DeflateBuffer():length(0){}
+
+	/** Makes sure that at least given number of bytes is available behind
+	 * the data.
+	 * @param size Number of bytes.
+	 */
+	void reserve(size_t size)
 	{
-		utilsPrintDbg(debug::DBG_CRIT, "Unable to allocate buffer with size="<<out_size);
-		goto out_error;
+		if(data.size()-length<size)
+			data.resize(std::max(2*data.size(), length+size));
 	}
-	z.next_out = out_buff; 
-	z.avail_out = out_size;
-	if ((ret = deflateInit(&z, Z_DEFAULT_COMPRESSION)) != Z_OK)
+
+	/** Starts new data.
+	 */
+	void clear()
 	{
-		utilsPrintDbg(debug::DBG_ERR, "deflateInit failed with ret="<<ret);
-		goto out_free_error;
+		if(data.size()>DEFLATEKEEPBUFFER)
+			std::vector<unsigned char>().swap(data);
+		length=0;
 	}
+};
+
+/** Compresses data with given z_stream.
+ * @param z Initialized zlib stream.
+ * @param in Input data.
+ * @param inSize Input data size.
+ * @param flush zlib flush mode.
+ * @param out Buffer where to append compressed data.
+ * @return true on success, false otherwise.
+ */
+static bool deflateToBuffer(z_stream &z, const unsigned char *in, size_t inSize, int flush, DeflateBuffer &out)
+{
+	z.next_in=(Bytef *)in;
+	z.avail_in=inSize;
+	int ret;
 	do
 	{
-		size_t window_size = out_size;
-		// we need to reallocate if output buffer run out
-		// of space
-		if(z.avail_out == 0)
+		out.reserve(DEFLATECHUNK);
+		size_t avail=out.data.size()-out.length;
+		z.next_out=&out.data[out.length];
+		z.avail_out=avail;
+		ret=::deflate(&z, flush);
+		if(ret==Z_STREAM_ERROR)
 		{
-			out_size *= 2;
-			utilsPrintDbg(debug::DBG_DBG, 
-					"Output buffer size not sufficient, resizing to "
-					<< out_size);
-			unsigned char *tmp_buff = (unsigned char*)realloc(out_buff, out_size);
-			if(!tmp_buff)
-			{
-				utilsPrintDbg(debug::DBG_CRIT, "Unable to reallocate buffer with size="<<out_size);
-				goto out_free_error;
-			}
-			out_buff = tmp_buff;
-			window_size = z.avail_out = out_size - total;
-			z.next_out = out_buff + total;
+			utilsPrintDbg(debug::DBG_ERR, "compression failed with ret="<<ret);
+			return false;
 		}
-		ret = ::deflate(&z, Z_FINISH);
-		if(ret < 0)
+		out.length+=avail-z.avail_out;
+		// all data are consumed and flushed if there is some space left
+	}while(z.avail_out==0 || (flush==Z_FINISH && ret!=Z_STREAM_END));
+	assert(z.avail_in==0);
+	return true;
+}
+
+/** Deflate state reused for all streams written by one thread.
+ */
+struct DeflateContext
+{
+	/** zlib stream (valid only if initialized is set). */
+	z_stream z;
+	bool initialized;
+	/** Level z is initialized with. */
+	int level;
+	/** Chunk of decoded stream data. */
+	unsigned char chunk[DEFLATECHUNK];
+	/** Decoded stream data (only for streams compressed in blocks). */
+	DeflateBuffer in;
+	/** Compressed stream data. */
+	DeflateBuffer out;
+
+	DeflateContext():initialized(false), level(Z_DEFAULT_COMPRESSION) {}
+
+	~DeflateContext()
+	{
+		if(initialized)
+			deflateEnd(&z);
+	}
+
+	/** Prepares zlib stream for new data.
+	 * @param l Compression level.
+	 * @return true on success, false otherwise.
+	 */
+	bool begin(int l)
+	{
+		out.clear();
+		if(initialized && level==l)
+			return deflateReset(&z)==Z_OK;
+		if(initialized)
+			deflateEnd(&z);
+		memset(&z, 0, sizeof(z));
+		int ret=deflateInit(&z, l);
+		initialized=(ret==Z_OK);
+		if(!initialized)
 		{
-			utilsPrintDbg(debug::DBG_ERR, "compression failed with ret="<<ret);
-			goto out_free_error;
+			utilsPrintDbg(debug::DBG_ERR, "deflateInit failed with ret="<<ret);
+			return false;
 		}
-		total += window_size - z.avail_out;
-	}while(z.avail_out == 0);
-	assert(z.avail_in == 0);
-	assert(ret == Z_STREAM_END);
-	deflateEnd(&z);
-	size = total;
+		level=l;
+		return true;
+	}
+};
+
+/** Deflate context of the current thread. */
+static boost::thread_specific_ptr<DeflateContext> deflateContext;
+
+/** Returns deflate context of the current thread.
+ * @return Context which is created when used for the first time.
+ */
+static DeflateContext &getDeflateContext()
+{
+	if(!deflateContext.get())
+		deflateContext.reset(new DeflateContext());
+	return *deflateContext;
+}
+
+unsigned char* ZlibFilterStreamWriter::deflate_buffer(unsigned char * in, size_t in_size, size_t& size, int level)
+{
+	DeflateContext &context=getDeflateContext();
+	if(!context.begin(level) || !deflateToBuffer(context.z, in, in_size, Z_FINISH, context.out))
+		return NULL;
+	size = context.out.length;
+	unsigned char * out_buff = (unsigned char*)malloc(sizeof(unsigned char)*std::max(size, (size_t)1));
+	if(!out_buff)
+	{
+		utilsPrintDbg(debug::DBG_CRIT, "Unable to allocate buffer with size="<<size);
+		return NULL;
+	}
+	memcpy(out_buff, &context.out.data[0], size);
 	return out_buff;
+}
 
-out_free_error:
-	free(out_buff);
-out_error:
-	deflateEnd(&z);
-	return NULL;
+/** Block of stream data compressed independently.
+ */
+struct DeflateBlock
+{
+	/** Input data. */
+	const unsigned char *data;
+	size_t length;
+	/** Number of bytes in front of data used as dictionary. */
+	size_t dictLength;
+	/** Set for the last block of the stream. */
+	bool last;
+	/** Compressed data (raw deflate). */
+	DeflateBuffer out;
+	/** adler32 checksum of input data. */
+	uLong adler;
+	bool ok;
+};
+
+/** Work shared by threads compressing blocks.
+ */
+struct DeflateBlockJob
+{
+	std::vector<DeflateBlock> blocks;
+	int level;
+	/** Index of the next block to compress. */
+	size_t next;
+	boost::mutex mutex;
+
+	/** Compresses blocks until there are any left.
+	 * Each block is compressed by its own raw deflate stream which ends
+	 * with sync flush (on byte boundary) so that blocks can be simply 
+	 * concatenated.
+	 */
+	void run()
+	{
+		z_stream z;
+		memset(&z, 0, sizeof(z));
+		bool initialized=(deflateInit2(&z, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)==Z_OK);
+		for(;;)
+		{
+			size_t index;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				index=next++;
+			}
+			if(index>=blocks.size())
+				break;
+			DeflateBlock &block=blocks[index];
+			block.adler=adler32(adler32(0L, Z_NULL, 0), block.data, block.length);
+			block.ok=initialized && deflateReset(&z)==Z_OK;
+			if(block.ok && block.dictLength)
+				block.ok=deflateSetDictionary(&z, block.data-block.dictLength, block.dictLength)==Z_OK;
+			if(block.ok)
+				block.ok=deflateToBuffer(z, block.data, block.length, 
+						(block.last)?Z_FINISH:Z_SYNC_FLUSH, block.out);
+		}
+		if(initialized)
+			deflateEnd(&z);
+	}
+};
+
+/** Compresses data by more threads.
+ * @param in Data to compress.
+ * @param level zlib compression level.
+ * @param blockSize Size of one block.
+ * @param threads Number of threads.
+ * @param out Buffer for compressed data (zlib format).
+ * @return true on success, false otherwise.
+ */
+static bool deflateBlocks(const DeflateBuffer &in, int level, size_t blockSize, size_t threads, DeflateBuffer &out)
+{
+	DeflateBlockJob job;
+	job.level=level;
+	job.next=0;
+	size_t blocks=(in.length+blockSize-1)/blockSize;
+	job.blocks.resize(blocks);
+	for(size_t i=0; i<blocks; ++i)
+	{
+		DeflateBlock &block=job.blocks[i];
+		size_t start=i*blockSize;
+		block.data=&in.data[start];
+		block.length=std::min(blockSize, in.length-start);
+		block.dictLength=std::min(start, (size_t)(1<<MAX_WBITS));
+		block.last=(i==blocks-1);
+	}
+	boost::thread_group group;
+	for(size_t i=1; i<std::min(threads, blocks); ++i)
+		group.create_thread(boost::bind(&DeflateBlockJob::run, &job));
+	job.run();
+	group.join_all();
+
+	// zlib header with the same level flags as deflate would produce
+	int flags=(level==Z_DEFAULT_COMPRESSION)?2:(level<2)?0:(level<6)?1:(level==6)?2:3;
+	unsigned header=(0x78<<8)|(flags<<6);
+	header+=31-header%31;
+	out.clear();
+	out.reserve(2);
+	out.data[out.length++]=header>>8;
+	out.data[out.length++]=header&0xff;
+	uLong adler=adler32(0L, Z_NULL, 0);
+	for(size_t i=0; i<blocks; ++i)
+	{
+		DeflateBlock &block=job.blocks[i];
+		if(!block.ok)
+			return false;
+		out.reserve(block.out.length);
+		memcpy(&out.data[out.length], &block.out.data[0], block.out.length);
+		out.length+=block.out.length;
+		adler=adler32_combine(adler, block.adler, block.length);
+	}
+	out.reserve(4);
+	for(int i=3; i>=0; --i)
+		out.data[out.length++]=(adler>>(8*i))&0xff;
+	return true;
 }
 
-unsigned char* ZlibFilterStreamWriter::deflate(const Object& obj, size_t& size)
+/** Reads decoded stream data and compresses them.
+ * @param obj Stream object.
+ * @param context Deflate context (compressed data are stored to its out
+ * buffer).
+ * @param level zlib compression level.
+ * @param blockSize Size of block for parallel compression.
+ * @param threads Number of threads for parallel compression.
+ * @return Number of decoded bytes or -1 on error.
+ */
+static long deflateStreamData(const Object& obj, DeflateContext &context, int level, size_t blockSize, size_t threads)
 {
-	assert(obj.isStream());
-	unsigned char *rawBuffer, *deflateBuff = NULL;
-	size_t rawSize;
-	if((rawBuffer = convertStreamToDecodedData(obj, rawSize)) == NULL)
-		goto out;
-	// This should never happen - why would we want to have/change 
-	// emty streams? It is much simpler to remove it from the streams
-	// if we want to get rid of it. Nevertheless we have already seen
-	// streams with zero decoded content (e.g. PDFreference obj. 
-	// [4129 0] - content stream from the page 1236)
-	// If we let an empty string to the deflate_buffer, this will fail
-	// and we will get corrupted document!!!
-	if(!rawSize)
-	{
-		size = rawSize;
-		return rawBuffer;
-	}
-	utilsPrintDbg(debug::DBG_DBG, "Raw buffer size="<<rawSize);
-	if((deflateBuff = deflate_buffer(rawBuffer, rawSize, size))==NULL)
-		goto free_out;
-	utilsPrintDbg(debug::DBG_DBG, "Compressed buffer size="<<size);
-	update_dict(obj);
-
-free_out:
-	free(rawBuffer);
-out:
-	return deflateBuff;
+	Stream *str=obj.getStream();
+	str->reset();
+	long total=0;
+	int len;
+	if(threads>1)
+	{
+		// whole data are needed to split them into blocks
+		context.in.clear();
+		do
+		{
+			context.in.reserve(DEFLATECHUNK);
+			len=str->getBlock((char *)&context.in.data[context.in.length], DEFLATECHUNK);
+			context.in.length+=len;
+		}while(len==DEFLATECHUNK);
+		str->reset();
+		total=context.in.length;
+		if(context.in.length>=2*blockSize)
+			return deflateBlocks(context.in, level, blockSize, threads, context.out)?total:-1;
+		if(!context.begin(level) || !deflateToBuffer(context.z, &context.in.data[0], 
+					context.in.length, Z_FINISH, context.out))
+			return -1;
+		return total;
+	}
+
+	// data are compressed while they are read
+	if(!context.begin(level))
+		return -1;
+	while((len=str->getBlock((char *)context.chunk, DEFLATECHUNK))>0)
+	{
+		if(!deflateToBuffer(context.z, context.chunk, len, Z_NO_FLUSH, context.out))
+			return -1;
+		total+=len;
+	}
+	str->reset();
+	if(!deflateToBuffer(context.z, NULL, 0, Z_FINISH, context.out))
+		return -1;
+	return total;
 }
 
 void ZlibFilterStreamWriter::compress(const Object& obj, Ref* ref, StreamWriter& outStream)const
 {
-	CharBuffer charBuffer;
 	assert(obj.isStream());
-	size_t size=streamToCharBuffer(obj, ref, charBuffer, deflate);
-	if(!size)
+	DeflateContext &context=getDeflateContext();
+	long rawSize=deflateStreamData(obj, context, level, blockSize, blockThreads);
+	if(rawSize<0)
 	{
-		utilsPrintDbg(debug::DBG_WARN, "zero size stream returned. Probably error in the the object");
+		utilsPrintDbg(debug::DBG_WARN, "Unable to compress stream data. Storing them without changes.");
+		NullFilterStreamWriter::getInstance()->compress(obj, ref, outStream);
 		return;
 	}
-	outStream.putLine(charBuffer.get(), size);
-	return;
+
+	// original filters are not used for output stream anymore. Empty 
+	// streams are stored without any filter. External file streams are
+	// not supported so F, FFilter and FDecodeParms are not present and
+	// DL (decoded length) stays valid
+	BaseStream *base=obj.getStream()->getBaseStream();
+	const char * fieldsToRemove[] = {"Filter", "DecodeParms", NULL};
+	for(int i=0; fieldsToRemove[i]; ++i)
+	{
+		Object *old=base->dictDel(fieldsToRemove[i]);
+		if(old)
+			xpdf::freeXpdfObject(old);
+	}
+	size_t size=0;
+	if(rawSize)
+	{
+		utilsPrintDbg(debug::DBG_DBG, "Raw size="<<rawSize);
+		update_dict(obj);
+		size=context.out.length;
+		utilsPrintDbg(debug::DBG_DBG, "Compressed size="<<size);
+	}
+	// Length is updated only if it doesn't match (it may be indirect)
+	Object lengthObj;
+	obj.streamGetDict()->lookup("Length", &lengthObj);
+	if(!lengthObj.isInt() || (size_t)lengthObj.getInt()!=size)
+	{
+		lengthObj.free();
+		lengthObj.initInt(size);
+		char *key=copyString("Length");
+		Object *old=base->dictUpdate(key, &lengthObj);
+		if(old)
+		{
+			gfree(key);
+			xpdf::freeXpdfObject(old);
+		}
+	}
+	lengthObj.free();
+
+	std::string header, footer;
+	getStreamObjectFrame(obj, ref, header, footer);
+	outStream.putBuffer(header.c_str(), header.length());
+	if(size)
+		outStream.putBuffer((const char *)&context.out.data[0], size);
+	outStream.putLine(footer.c_str(), footer.length());
+	context.in.clear();
+	context.out.clear();
 }
 
 // initialization of static data for FilterStreamWriter classes
@@ -485,10 +879,33 @@ void IPdfWriter::writeHeader(const char* version, StreamWriter &stream)
     	stream.getLine(const_cast<char*>(buffer), strlen(buffer));
 }
 
+void IPdfWriter::prepareObject(const ::Ref & ref, const Object & obj, std::string & data)const
+{
+	// serializes object with the same writer function as writeContent
+	// but to the memory
+	Object dict;
+	dict.initNull();
+	MemStreamWriter memStream(&dict);
+	::Ref objRef=ref;
+	writeObject(obj, memStream, &objRef, true);
+	data.assign(memStream.getData(), memStream.getDataLength());
+}
+
 const std::string OldStylePdfWriter::CONTENT = "Content phase"; 
 const std::string OldStylePdfWriter::TRAILER = "XREF/TRAILER phase";
 
-void OldStylePdfWriter::writeContent(ObjectList &objectList,BaseStream & stream, size_t off)
+void OldStylePdfWriter::writeContent(ObjectList &objectList,StreamWriter & stream, size_t off)
+{
+	writeObjects(objectList, NULL, stream, off);
+}
+
+void OldStylePdfWriter::writePreparedContent(ObjectList &objectList, const PreparedList & prepared, StreamWriter & stream, size_t off)
+{
+	assert(prepared.size()==objectList.size());
+	writeObjects(objectList, &prepared, stream, off);
+}
+
+void OldStylePdfWriter::writeObjects(ObjectList &objectList, const PreparedList * prepared, StreamWriter & stream, size_t off)
 {
 using namespace debug;
 using namespace boost;
@@ -539,7 +956,12 @@ using namespace boost;
 		size_t objPos=stream.getPos();
 		offTable.insert(OffsetTab::value_type(ref, objPos));		
 		
-		writeObject(*obj, stream, &ref, true);	
+		if(prepared)
+		{
+			const std::string & data=(*prepared)[index];
+			stream.putBuffer(data.data(), data.size());
+		}else
+			writeObject(*obj, stream, &ref, true);	
 		utilsPrintDbg(DBG_DBG, "Object with "<<ref<<" stored at offset="<<objPos);
 		
 		// calls observers
@@ -571,6 +993,121 @@ void stripXRefStreamFields(const Object &trailer)
 	}
 }
 
+/** Helper function for dictionary entry setting.
+ * @param dict Dictionary object.
+ * @param key Name of the entry.
+ * @param value Value to be set (dictionary becomes owner of its content).
+ *
+ * Adds new entry or replaces the old value (which is deallocated).
+ */
+void setDictEntry(const Object &dict, const char *key, Object &value)
+{
+	char * keyCopy=copyString(key);
+	Object * original=dict.dictUpdate(keyCopy, &value);
+	if(original)
+	{
+		// value has been set to something different, we have to deallocate it
+		// and to free key, because it is not stored in update
+		gfree(keyCopy);
+		xpdf::freeXpdfObject(original);
+	}
+}
+
+/** Helper function for trailer linking to the previous revision.
+ * @param trailer Trailer dictionary.
+ * @param prevXRefPos Position of the previous xref section (0 if none).
+ * @param size Value for the Size entry.
+ *
+ * Sets (or removes if there is no previous section) Prev entry, removes
+ * XRefStm and all fields which could come from xref stream dictionary and
+ * sets Size entry.
+ */
+void updateTrailer(const Object &trailer, size_t prevXRefPos, size_t size)
+{
+using namespace debug;
+
+	// updates Prev field - to say where previous xref table starts
+	// if 0, removes Prev entry if present
+	if(!prevXRefPos)
+	{
+		Object * prev=trailer.dictDel("Prev");
+		if(prev)
+			xpdf::freeXpdfObject(prev);
+		utilsPrintDbg(DBG_DBG, "No previous xref section. Removing Trailer::Prev.");
+	}else
+	{
+		Object newPrev;
+		newPrev.initInt(prevXRefPos);
+		setDictEntry(trailer, "Prev", newPrev);
+		utilsPrintDbg(DBG_DBG, "Linking to previous xref section. Trailer::Prev="<<prevXRefPos);
+	}
+
+	// hybrid xref files can contain both xref table and xref stream
+	// in such a case startxref points to xreftable and trailer::XrefStm
+	// to the additional objects in xref stream. PDF>=1.5 capable readers
+	// reads both of them and so we have to remove XRefStm for later 
+	// revisions to prevent from confusions.
+	Object * xrefStm = trailer.dictDel("XRefStm");
+	if(xrefStm)
+	{
+		utilsPrintDbg(DBG_DBG, "Removing old Trailer::XRefStm.");
+		xpdf::freeXpdfObject(xrefStm);
+	}
+
+	// some documents (e.g. those generated by Word with Acrobad 9 pdf printer)
+	// generate strange xref layout (xref table with trailer containig additional
+	// fields valid for trailer stream dictionary which references the xref stream
+	// by means of Prev field). We have to strip all those fields to provide a 
+	// proper document
+	stripXRefStreamFields(trailer);
+
+	Object newSize;
+	newSize.initInt(size);
+	setDictEntry(trailer, "Size", newSize);
+	utilsPrintDbg(DBG_DBG, "Setting Trailer::Size="<<size);
+}
+
+/** Helper function for the end of revision writing.
+ * @param xrefPos Position of the xref section.
+ * @param stream Stream writer where to write.
+ *
+ * Writes startxref keyword with the given position followed by %%EOF 
+ * marker, removes all data behind and flushes the stream.
+ * @return stream position of %%EOF marker.
+ */
+size_t writeRevisionEnd(size_t xrefPos, StreamWriter &stream)
+{
+using namespace debug;
+
+	// stores offset of last (created one) xref table
+	stream.putLine(STARTXREF_KEYWORD, strlen(STARTXREF_KEYWORD));
+	char xrefPosStr[128];
+	sprintf(xrefPosStr, "%u", (unsigned int)xrefPos);
+	stream.putLine(xrefPosStr, strlen(xrefPosStr));
+	
+	// Finaly puts %%EOF behind but keeps position of marker start
+	size_t pos=stream.getPos();
+	stream.putLine(EOFMARKER, strlen(EOFMARKER));
+	kernelPrintDbg(DBG_DBG, "PDF end of file marker saved");
+
+	// stream may contain some non sense information behind, so they has to be
+	// cleaned.
+	size_t currPos=stream.getPos();
+	stream.setPos(0, -1);
+	size_t eofPos=stream.getPos();
+	if(eofPos>currPos)
+	{
+		size_t size=eofPos-currPos;
+		kernelPrintDbg(DBG_DBG, "Cleaning pending ("<<size<<"B) data behind stored revision.");
+		stream.trim(currPos);
+	}
+
+	// revision is complete - make sure it is in the file
+	stream.flush();
+
+	return pos;
+}
+
 size_t OldStylePdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo &prevSection, StreamWriter & stream, size_t off)
 {
 	using namespace std;
@@ -583,7 +1120,8 @@ size_t OldStylePdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo
 	if(!offTable.size())
 	{
 		utilsPrintDbg(DBG_WARN, "No data stored. Skipping cross ref and trailer.");
-		return stream.getPos();
+		lastXRefPos=stream.getPos();
+		return lastXRefPos;
 	}
 		
 	// stores start position of the cross reference table
@@ -711,98 +1249,430 @@ size_t OldStylePdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo
 		notifyObservers(newValue, context);
 	}
 
-	// updates Prev field - to say where previous xref table starts
-	// if 0, removes Prev entry if present
-	if(!prevSection.xrefPos)
-	{
-		// FIXME prepare for stream trailers - we don't have this
-		// problem at the moment, becayse we don't create such 
-		// trailers and the first one never contains Prev. However
-		// this can be problem if we had incremental update from 
-		// other party which uses stream trailers for all.
-		Object * prev=trailer.dictDel("Prev");
-		if(prev)
-			xpdf::freeXpdfObject(prev);
-		utilsPrintDbg(DBG_DBG, "No previous xref section. Removing Trailer::Prev.");
-	}else
-	{
-		Object newPrev;
-		newPrev.initInt(prevSection.xrefPos);
-		char * key=copyString("Prev");
-		Object * originalPrev=trailer.dictUpdate(key, &newPrev);
-		if(originalPrev)
-		{
-			// value has been set to something different, we have to deallocate it
-			// and to free key, because it is not stored in update
-			utilsPrintDbg(DBG_DBG, "Removing old Trailer::Prev="<<originalPrev->getInt());
-			free(key);
-			xpdf::freeXpdfObject(originalPrev);
-		}
-		utilsPrintDbg(DBG_DBG, "Linking to previous xref section. Trailer::Prev="<<newPrev.getInt());
-	}
-
-	// hybrid xref files can contain both xref table and xref stream
-	// in such a case startxref points to xreftable and trailer::XrefStm
-	// to the additional objects in xref stream. PDF>=1.5 capable readers
-	// reads both of them and so we have to remove XRefStm for later 
-	// revisions to prevent from confusions.
-	Object * xrefStm = trailer.dictDel("XRefStm");
-	if(xrefStm)
-	{
-		utilsPrintDbg(DBG_DBG, "Removing old Trailer::XRefStm.");
-		xpdf::freeXpdfObject(xrefStm);
-	}
-
-	// some documents (e.g. those generated by Word with Acrobad 9 pdf printer)
-	// generate strange xref layout (xref table with trailer containig additional
-	// fields valid for trailer stream dictionary which references the xref stream
-	// by means of Prev field). We have to strip all those fields to provide a 
-	// proper document
-	stripXRefStreamFields(trailer);
-
-	// sets Size entry with the maximum from the original entries count and 
-	// the highest changed object reference number
-	Object newSize;
-	newSize.initInt(std::max(prevSection.entriesNum, (size_t)(maxObjNum + 1)));
-	char * key=copyString("Size");
-	Object * originalSize=trailer.dictUpdate(key, &newSize);
-	if(originalSize)
-	{
-		// value has been set to something different, we have to deallocate it
-		// and to free key, because it is not stored in update
-		utilsPrintDbg(DBG_DBG, "Removing old Trailer::Size="<<originalSize->getInt());
-		gfree(key);
-		xpdf::freeXpdfObject(originalSize);
-	}
-	utilsPrintDbg(DBG_DBG, "Setting Trailer::Size="<<newSize.getInt());
+	// links trailer with the previous section and sets Size entry with the
+	// maximum from the original entries count and the highest changed object
+	// reference number
+	updateTrailer(trailer, prevSection.xrefPos, 
+			std::max(prevSection.entriesNum, (size_t)(maxObjNum + 1)));
 
 	// stores changed trailer to the file
 	stream.putLine(TRAILER_KEYWORD, strlen(TRAILER_KEYWORD));
 	writeObject(trailer, stream, NULL, false);
 	kernelPrintDbg(DBG_DBG, "Trailer saved");
 
-	// stores offset of last (created one) xref table
-	stream.putLine(STARTXREF_KEYWORD, strlen(STARTXREF_KEYWORD));
-	char xrefPosStr[128];
-	sprintf(xrefPosStr, "%u", (unsigned int)xrefPos);
-	stream.putLine(xrefPosStr, strlen(xrefPosStr));
+	size_t pos=writeRevisionEnd(xrefPos, stream);
+	lastXRefPos=xrefPos;
+
+	// resets internal data
+	reset();
+
+	return pos;
+}
+
+void OldStylePdfWriter::reset()
+{
+	offTable.clear();
+	maxObjNum=0;
+}
+
+/** Minimal PDF version with cross reference and object streams support. */
+const char * XREFSTREAM_MIN_VERSION="1.5";
+
+const size_t XRefStreamPdfWriter::DEFAULT_OBJSTM_CAPACITY;
+const std::string XRefStreamPdfWriter::CONTENT = "Content phase"; 
+const std::string XRefStreamPdfWriter::TRAILER = "XREF stream phase";
+
+/** Helper function for stream data compression.
+ * @param in Data to compress.
+ * @param out Compressed data.
+ * @return true if data were compressed, false otherwise (out contains 
+ * copy of in).
+ */
+bool deflateString(const std::string &in, std::string &out)
+{
+	size_t size;
+	unsigned char * buff=ZlibFilterStreamWriter::deflate_buffer(
+			(unsigned char *)const_cast<char *>(in.data()), in.size(), size,
+			ZlibFilterStreamWriter::getInstance()->getLevel());
+	if(!buff)
+	{
+		utilsPrintDbg(debug::DBG_WARN, "Unable to compress data. Storing them without filter.");
+		out=in;
+		return false;
+	}
+	out.assign((const char *)buff, size);
+	free(buff);
+	return true;
+}
+
+/** Helper function for indirect stream object writing.
+ * @param ref Reference of the stream object.
+ * @param dict Stream dictionary.
+ * @param data Raw (not yet encoded) stream data.
+ * @param stream Stream writer where to write.
+ *
+ * Compresses given data, sets Filter and Length entries in the given 
+ * dictionary and writes whole indirect object to the stream.
+ */
+void writeIndirectStream(const ::Ref &ref, Object &dict, const std::string &data, StreamWriter &stream)
+{
+	std::string encoded;
+	Object value;
+	if(deflateString(data, encoded))
+	{
+		value.initName("FlateDecode");
+		setDictEntry(dict, "Filter", value);
+	}
+	value.initInt(encoded.size());
+	setDictEntry(dict, "Length", value);
+
+	std::string dictStr;
+	xpdfObjToString(dict, dictStr);
+
+	std::ostringstream header;
+	header << ref << " " << Specification::INDIRECT_HEADER << "\n";
+
+	// data may contain 0 bytes so we have to keep std::string and write it
+	// with explicit length
+	std::string objStr=header.str();
+	objStr+=dictStr;
+	objStr+=Specification::CSTREAM_HEADER;
+	objStr+=encoded;
+	objStr+=Specification::CSTREAM_FOOTER;
+	objStr+=Specification::INDIRECT_FOOTER;
+	stream.putLine(objStr.data(), objStr.size());
+}
+
+/** Returns number of bytes needed for given cross reference stream field.
+ * @param value Maximum field value.
+ * @return number of bytes (at least 1).
+ */
+int xrefFieldWidth(size_t value)
+{
+	int width=1;
+	while(width<(int)sizeof(size_t) && (value>>(8*width)))
+		width++;
+	return width;
+}
+
+/** Appends cross reference stream field to the given data.
+ * @param data Cross reference stream data.
+ * @param value Field value.
+ * @param width Field width in bytes.
+ *
+ * Fields are stored in big-endian order.
+ */
+void appendXRefField(std::string &data, size_t value, int width)
+{
+	for(int i=width-1; i>=0; i--)
+		data+=(char)((value>>(8*i)) & 0xff);
+}
+
+void XRefStreamPdfWriter::writeHeader(const char* version, StreamWriter &stream)
+{
+	// simple string comparison is enough for 1.x versions
+	if(!version || strcmp(version, XREFSTREAM_MIN_VERSION)<0)
+	{
+		utilsPrintDbg(debug::DBG_INFO, "Cross reference streams require PDF-"
+				<<XREFSTREAM_MIN_VERSION<<". Changing header version.");
+		version=XREFSTREAM_MIN_VERSION;
+	}
+	IPdfWriter::writeHeader(version, stream);
+}
+
+const char * XRefStreamPdfWriter::getRequiredVersion()const
+{
+	return XREFSTREAM_MIN_VERSION;
+}
+
+void XRefStreamPdfWriter::flushBatch()
+{
+	if(batch.empty())
+		return;
+
+	// object stream data starts with object number and offset pairs (offset
+	// is relative to the First value) followed by objects themselves
+	std::ostringstream offsets;
+	std::string objects;
+	for(size_t i=0; i<batch.size(); i++)
+	{
+		offsets << batch[i].first << " " << objects.size() << " ";
+		objects+=batch[i].second;
+		objects+="\n";
+	}
+	std::string content=offsets.str();
+	content[content.size()-1]='\n';
+
+	PendingObjStm objStm;
+	objStm.n=batch.size();
+	objStm.first=content.size();
+	objStm.data=content+objects;
+	objStms.push_back(objStm);
+	utilsPrintDbg(debug::DBG_DBG, "Object stream with "<<objStm.n
+			<<" objects prepared (index="<<objStms.size()-1<<")");
+	batch.clear();
+}
+
+void XRefStreamPdfWriter::writeObjStm(const PendingObjStm & objStm, int num, StreamWriter & stream)const
+{
+	Object dict;
+	dict.initDict((XRef *)NULL);
+	Object value;
+	value.initName("ObjStm");
+	setDictEntry(dict, "Type", value);
+	value.initInt(objStm.n);
+	setDictEntry(dict, "N", value);
+	value.initInt(objStm.first);
+	setDictEntry(dict, "First", value);
+
+	::Ref ref={num, 0};
+	writeIndirectStream(ref, dict, objStm.data, stream);
+	dict.free();
+}
+
+void XRefStreamPdfWriter::prepareObject(const ::Ref & ref, const Object & obj, std::string & data)const
+{
+	if(isDirectObject(ref, obj))
+	{
+		IPdfWriter::prepareObject(ref, obj, data);
+		return;
+	}
+	boost::scoped_ptr<IProperty> cobj_ptr(createObjFromXpdfObj(obj));
+	cobj_ptr->getStringRepresentation(data);
+}
+
+void XRefStreamPdfWriter::writeContent(ObjectList &objectList, StreamWriter & stream, size_t off)
+{
+	writeObjects(objectList, NULL, stream, off);
+}
+
+void XRefStreamPdfWriter::writePreparedContent(ObjectList &objectList, const PreparedList & prepared, StreamWriter & stream, size_t off)
+{
+	assert(prepared.size()==objectList.size());
+	writeObjects(objectList, &prepared, stream, off);
+}
+
+void XRefStreamPdfWriter::writeObjects(ObjectList &objectList, const PreparedList * prepared, StreamWriter & stream, size_t off)
+{
+using namespace debug;
+using namespace boost;
+
+	utilsPrintDbg(DBG_DBG, "pos="<<off);
 	
-	// Finaly puts %%EOF behind but keeps position of marker start
-	size_t pos=stream.getPos();
-	stream.putLine(EOFMARKER, strlen(EOFMARKER));
-	kernelPrintDbg(DBG_DBG, "PDF end of file marker saved");
+	// if off is not 0, uses it to set position in the stream, otherwise uses
+	// current position
+	if(off)
+		stream.setPos(off);
 
-	// stream may contain some non sense information behind, so they has to be
-	// cleaned.
-	size_t currPos=stream.getPos();
-	stream.setPos(0, -1);
-	size_t eofPos=stream.getPos();
-	if(eofPos>currPos)
+	ObjectList::const_iterator i;
+	size_t index=0;
+	
+	// creates context for observers
+	shared_ptr<OperationScope> scope(new OperationScope());
+	scope->total=objectList.size();
+	scope->task=CONTENT;
+	shared_ptr<ChangeContext> context(new ChangeContext(scope));
+	shared_ptr<OperationStep> newValue(new OperationStep());
+
+	for(i=objectList.begin(); i!=objectList.end(); ++i, index++)
 	{
-		size_t size=eofPos-currPos;
-		kernelPrintDbg(DBG_DBG, "Cleaning pending ("<<size<<"B) data behind stored revision.");
-		stream.trim(currPos);
+		::Ref ref=i->first;
+		Object * obj=i->second;
+
+		// object must be valid
+		if(!obj)
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<ref<<" is not valid. Skipping.");
+			continue;
+		}
+		
+		// no duplicities are allowed, because previous object wouldn't be
+		// available
+		if(entries.find(ref)!=entries.end())
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<ref<<" is already stored. Skipping.");
+			continue;
+		}
+
+		// updates maximum Object number if ref is the one
+		if(ref.num>maxObjNum)
+			maxObjNum=ref.num;
+
+		Entry entry;
+		if(isDirectObject(ref, *obj))
+		{
+			entry.type=1;
+			entry.field2=stream.getPos();
+			entry.field3=ref.gen;
+			if(prepared)
+			{
+				const std::string & data=(*prepared)[index];
+				stream.putBuffer(data.data(), data.size());
+			}else
+				writeObject(*obj, stream, &ref, true);	
+			utilsPrintDbg(DBG_DBG, "Object with "<<ref<<" stored at offset="<<entry.field2);
+		}else
+		{
+			std::string objPdfFormat;
+			if(prepared)
+				objPdfFormat=(*prepared)[index];
+			else
+				prepareObject(ref, *obj, objPdfFormat);
+
+			// currently filled object stream will be placed at objStms.size()
+			// position - real object number is assigned in writeTrailer
+			entry.type=2;
+			entry.field2=objStms.size();
+			entry.field3=batch.size();
+			batch.push_back(std::make_pair(ref.num, objPdfFormat));
+			utilsPrintDbg(DBG_DBG, "Object with "<<ref<<" stored to object stream at index="<<entry.field3);
+			if(batch.size()>=objStmCapacity)
+				flushBatch();
+		}
+		entries.insert(EntriesTab::value_type(ref, entry));
+		
+		// calls observers
+		newValue->currStep=index;
+		notifyObservers(newValue, context);
 	}
+	
+	utilsPrintDbg(DBG_DBG, "All objects (number="<<objectList.size()<<") stored.");
+}
+
+size_t XRefStreamPdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo &prevSection, StreamWriter & stream, size_t off)
+{
+	using namespace std;
+	using namespace debug;
+	using namespace boost;
+
+	utilsPrintDbg(DBG_DBG, "");
+
+	// partially filled object stream has to be closed too
+	flushBatch();
+	
+	// nothing has been stored, so no need for cross ref and trailer
+	if(!entries.size())
+	{
+		utilsPrintDbg(DBG_WARN, "No data stored. Skipping cross ref and trailer.");
+		lastXRefPos=stream.getPos();
+		return lastXRefPos;
+	}
+
+	if(off)
+		stream.setPos(off);
+
+	// object streams and the cross reference stream get object numbers 
+	// behind all objects known so far
+	size_t base=max(prevSection.entriesNum, (size_t)(maxObjNum + 1));
+
+	// compressed entries refer to object streams by index in objStms
+	for(EntriesTab::iterator i=entries.begin(); i!=entries.end(); ++i)
+		if(i->second.type==2)
+			i->second.field2+=base;
+
+	// creates context for observers
+	shared_ptr<OperationScope> scope(new OperationScope());
+	scope->total=objStms.size()+1;
+	scope->task=TRAILER;
+	shared_ptr<ChangeContext> context(new ChangeContext(scope));
+	shared_ptr<OperationStep> newValue(new OperationStep());
+
+	// writes all object streams
+	for(size_t i=0; i<objStms.size(); i++)
+	{
+		::Ref ref={(int)(base+i), 0};
+		Entry entry={1, stream.getPos(), 0};
+		entries.insert(EntriesTab::value_type(ref, entry));
+		writeObjStm(objStms[i], ref.num, stream);
+		utilsPrintDbg(DBG_DBG, "Object stream "<<ref<<" stored at offset="<<entry.field2);
+
+		newValue->currStep=i+1;
+		notifyObservers(newValue, context);
+	}
+
+	// cross reference stream has to contain also its own entry
+	size_t xrefPos=stream.getPos();
+	::Ref xrefRef={(int)(base+objStms.size()), 0};
+	Entry xrefEntry={1, xrefPos, 0};
+	entries.insert(EntriesTab::value_type(xrefRef, xrefEntry));
+
+	// the very first section has to start the free objects list
+	if(!prevSection.xrefPos)
+	{
+		::Ref freeRef={0, 65535};
+		Entry freeEntry={0, 0, 65535};
+		entries.insert(EntriesTab::value_type(freeRef, freeEntry));
+	}
+
+	// calculates fields widths
+	size_t max2=0, max3=0;
+	for(EntriesTab::const_iterator i=entries.begin(); i!=entries.end(); ++i)
+	{
+		max2=max(max2, i->second.field2);
+		max3=max(max3, i->second.field3);
+	}
+	int w2=xrefFieldWidth(max2), w3=xrefFieldWidth(max3);
+
+	// creates stream data and Index array with continuous subsections
+	std::string data;
+	Object index;
+	index.initArray((XRef *)NULL);
+	int subStart=-1, subCount=0, lastNum=-1;
+	for(EntriesTab::const_iterator i=entries.begin(); i!=entries.end(); ++i)
+	{
+		int num=i->first.num;
+		if(subCount && num==lastNum)
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<i->first<<" has the same number as previous one. Skipping.");
+			continue;
+		}
+		if(!subCount || num!=lastNum+1)
+		{
+			if(subCount)
+			{
+				Object value;
+				index.arrayAdd(value.initInt(subStart));
+				index.arrayAdd(value.initInt(subCount));
+				utilsPrintDbg(DBG_DBG, "Subsection with start="<<subStart<<" and size="<<subCount);
+			}
+			subStart=num;
+			subCount=0;
+		}
+		subCount++;
+		lastNum=num;
+		appendXRefField(data, i->second.type, 1);
+		appendXRefField(data, i->second.field2, w2);
+		appendXRefField(data, i->second.field3, w3);
+	}
+	Object value;
+	index.arrayAdd(value.initInt(subStart));
+	index.arrayAdd(value.initInt(subCount));
+	utilsPrintDbg(DBG_DBG, "Subsection with start="<<subStart<<" and size="<<subCount);
+
+	// links trailer with the previous section and sets Size to cover also
+	// the cross reference stream
+	updateTrailer(trailer, prevSection.xrefPos, xrefRef.num+1);
+
+	// cross reference stream dictionary contains all trailer fields
+	Object * xrefDict=trailer.clone();
+	value.initName("XRef");
+	setDictEntry(*xrefDict, "Type", value);
+	setDictEntry(*xrefDict, "Index", index);
+	Object w;
+	w.initArray((XRef *)NULL);
+	w.arrayAdd(value.initInt(1));
+	w.arrayAdd(value.initInt(w2));
+	w.arrayAdd(value.initInt(w3));
+	setDictEntry(*xrefDict, "W", w);
+	writeIndirectStream(xrefRef, *xrefDict, data, stream);
+	xpdf::freeXpdfObject(xrefDict);
+	kernelPrintDbg(DBG_DBG, "Cross reference stream "<<xrefRef<<" saved");
+
+	newValue->currStep=objStms.size()+1;
+	notifyObservers(newValue, context);
+
+	size_t pos=writeRevisionEnd(xrefPos, stream);
+	lastXRefPos=xrefPos;
 
 	// resets internal data
 	reset();
@@ -810,12 +1680,352 @@ size_t OldStylePdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo
 	return pos;
 }
 
-void OldStylePdfWriter::reset()
+void XRefStreamPdfWriter::reset()
 {
-	offTable.clear();
+	entries.clear();
+	objStms.clear();
+	batch.clear();
 	maxObjNum=0;
 }
 
+/** Replaces document file related data of given object by a private copy.
+ * @param document Document which provides the object.
+ * @param ref Reference of the object.
+ * @param obj Object to detach.
+ *
+ * Objects returned by PdfDocumentWriter::fillObjectList are not completely
+ * independent on the document. Stream objects read their data lazily from
+ * the document file and objects from object streams share their values 
+ * with the cached object stream. None of them can be processed by another 
+ * thread while the document is used to fetch other objects.
+ * <br>
+ * Raw (still encoded) stream data are read to the memory and the stream 
+ * is recreated on top of MemStream with the same dictionary and filters.
+ * Objects stored in object streams are replaced by their deep copy. Other
+ * objects are parsed from the file by each fetch (or deep copied from the
+ * changed storage), so they already own all their values.
+ * <br>
+ * Worker threads then serialize detached objects (createObjFromXpdfObj
+ * without pdf and string conversion) which touches only data owned by the
+ * object and debug output which is serialized by debug::writeDbg.
+ *
+ * @return number of stream data bytes copied to the memory.
+ */
+size_t detachObject(const PdfDocumentWriter & document, const ::Ref & ref, ::Object *& obj)
+{
+	if(!obj)
+		return 0;
+
+	if(obj->isStream())
+	{
+		BaseStream *base=obj->getStream()->getBaseStream();
+		if(base->getKind()!=strFile)
+			return 0;
+
+		boost::shared_ptr< ::Object> lengthObj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+		obj->streamGetDict()->lookup("Length", lengthObj.get());
+		size_t lengthHint=(lengthObj->isInt() && lengthObj->getInt()>0)?lengthObj->getInt():1;
+		size_t size;
+		unsigned char *data=bufferFromStream(*base, lengthHint, size);
+		if(!data)
+			throw std::bad_alloc();
+
+		// MemStream takes over the buffer and one dictionary reference
+		Object dict;
+		dict.initDict((Dict *)obj->streamGetDict());
+		Stream *str=new MemStream((char *)data, 0, size, &dict, gTrue);
+		str=str->addFilters(&dict);
+		obj->free();
+		obj->initStream(str);
+		return size;
+	}
+
+	if(ref.num>=0 && ref.num<document.XRef::getSize() 
+			&& document.XRef::getEntry(ref.num)->type==xrefEntryCompressed)
+	{
+		::Object *copy=obj->clone();
+		if(!copy)
+			throw std::bad_alloc();
+		xpdf::freeXpdfObject(obj);
+		obj=copy;
+	}
+	return 0;
+}
+
+/** Pipeline for parallel objects writing.
+ *
+ * Objects provided by PdfDocumentWriter::fillObjectList are fetched by the
+ * producer thread which also detaches them from the document (see 
+ * detachObject) so that no other thread touches the input document. 
+ * Objects are grouped to jobs which are serialized and compressed by 
+ * worker threads (IPdfWriter::prepareObject) to independent buffers. The
+ * thread which calls write method takes finished jobs in the original 
+ * order and puts their data to the output stream by 
+ * IPdfWriter::writePreparedContent, so that cross reference data are 
+ * collected exactly as when objects are written by one thread.
+ * <br>
+ * Number of jobs in flight is limited, so memory consumption doesn't depend
+ * on the document size.
+ */
+class ContentWriterPipeline
+{
+	/** Maximum number of objects in one job. */
+	static const size_t JOB_MAX_OBJECTS = 64;
+
+	/** Maximum size of detached stream data in one job. */
+	static const size_t JOB_MAX_DATA = 1024*1024;
+
+	/** Maximum number of jobs in flight per worker thread. */
+	static const size_t JOBS_PER_WORKER = 4;
+
+	/** Group of objects processed by one worker thread. */
+	struct Job
+	{
+		/** Objects to write (owned by the job). */
+		IPdfWriter::ObjectList objects;
+		/** Serialized objects. */
+		IPdfWriter::PreparedList prepared;
+		/** Flag set when all objects are prepared. */
+		bool done;
+		/** Exception raised while objects were prepared. */
+		boost::exception_ptr error;
+
+		Job():done(false){}
+	};
+	typedef std::deque<Job *> JobQueue;
+
+	PdfDocumentWriter & document;
+	IPdfWriter & pdfWriter;
+	size_t workers;
+	size_t maxJobs;
+
+	/** Guards all following fields. */
+	boost::mutex mutex;
+	/** Signaled when a new job is waiting for a worker. */
+	boost::condition_variable jobReady;
+	/** Signaled when a job is prepared. */
+	boost::condition_variable jobDone;
+	/** Signaled when a job is removed from inFlight queue. */
+	boost::condition_variable jobSlot;
+
+	/** All jobs which are not written yet in the original order. */
+	JobQueue inFlight;
+	/** Jobs waiting for a worker thread (subset of inFlight). */
+	JobQueue todo;
+	/** Set when producer has no more objects. */
+	bool producerFinished;
+	/** Exception raised by the producer. */
+	boost::exception_ptr producerError;
+	/** Set when the pipeline is destroyed. */
+	bool stopped;
+
+	boost::thread_group threads;
+
+	/** Deallocates job with all its objects.
+	 * @param job Job to deallocate.
+	 */
+	static void freeJob(Job * job)
+	{
+		IPdfWriter::ObjectList::iterator i;
+		for(i=job->objects.begin(); i!=job->objects.end(); ++i)
+			xpdf::freeXpdfObject(i->second);
+		delete job;
+	}
+
+	/** Adds job to the queues.
+	 * @param job Job to add.
+	 * Waits until there is a free slot for the job.
+	 * @return false if the pipeline has been stopped (job is not queued).
+	 */
+	bool enqueue(Job * job)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		while(inFlight.size()>=maxJobs && !stopped)
+			jobSlot.wait(lock);
+		if(stopped)
+			return false;
+		inFlight.push_back(job);
+		todo.push_back(job);
+		jobReady.notify_one();
+		return true;
+	}
+
+	/** Producer thread main loop.
+	 */
+	void produce()
+	{
+	using namespace debug;
+
+		IPdfWriter::ObjectList objectList;
+		Job * job=NULL;
+		try
+		{
+			bool running=true;
+			while(running && document.fillObjectList(objectList, PdfDocumentWriter::writeBatchCount)>0)
+			{
+				size_t jobData=0;
+				IPdfWriter::ObjectList::iterator i;
+				for(i=objectList.begin(); running && i!=objectList.end(); ++i)
+				{
+					if(!job)
+						job=new Job();
+					jobData+=detachObject(document, i->first, i->second);
+					job->objects.push_back(*i);
+					i->second=NULL;
+					if(job->objects.size()>=JOB_MAX_OBJECTS || jobData>=JOB_MAX_DATA)
+					{
+						running=enqueue(job);
+						if(running)
+							job=NULL;
+						jobData=0;
+					}
+				}
+				// objects which haven't been moved to a job are freed below
+				if(!running)
+					break;
+				objectList.clear();
+			}
+			if(job && running && enqueue(job))
+				job=NULL;
+		}catch(...)
+		{
+			utilsPrintDbg(DBG_ERR, "Unable to provide objects for writing.");
+			boost::mutex::scoped_lock lock(mutex);
+			producerError=boost::current_exception();
+		}
+
+		// frees everything which hasn't been queued
+		if(job)
+			freeJob(job);
+		// (objects moved to jobs are NULL in the list)
+		IPdfWriter::ObjectList::iterator i;
+		for(i=objectList.begin(); i!=objectList.end(); ++i)
+			if(i->second)
+				xpdf::freeXpdfObject(i->second);
+
+		boost::mutex::scoped_lock lock(mutex);
+		producerFinished=true;
+		jobReady.notify_all();
+		jobDone.notify_all();
+	}
+
+	/** Worker thread main loop.
+	 */
+	void work()
+	{
+		for(;;)
+		{
+			Job * job;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				while(todo.empty() && !producerFinished && !stopped)
+					jobReady.wait(lock);
+				if(stopped || todo.empty())
+					return;
+				job=todo.front();
+				todo.pop_front();
+			}
+
+			try
+			{
+				job->prepared.resize(job->objects.size());
+				for(size_t i=0; i<job->objects.size(); ++i)
+				{
+					IPdfWriter::ObjectElement & elem=job->objects[i];
+					if(elem.second)
+						pdfWriter.prepareObject(elem.first, *elem.second, job->prepared[i]);
+				}
+			}catch(...)
+			{
+				job->error=boost::current_exception();
+			}
+
+			boost::mutex::scoped_lock lock(mutex);
+			job->done=true;
+			jobDone.notify_all();
+		}
+	}
+public:
+	/** Initialization constructor.
+	 * @param documentA Document which provides objects.
+	 * @param pdfWriterA Pdf content writer.
+	 * @param workersA Number of worker threads.
+	 */
+	ContentWriterPipeline(PdfDocumentWriter & documentA, IPdfWriter & pdfWriterA, size_t workersA)
+		:document(documentA), pdfWriter(pdfWriterA), workers(workersA), 
+		 maxJobs(workersA*JOBS_PER_WORKER), producerFinished(false), stopped(false)
+	{
+	}
+
+	/** Destructor.
+	 * Stops and joins all threads and deallocates all objects which have not
+	 * been written.
+	 */
+	~ContentWriterPipeline()
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			stopped=true;
+			jobReady.notify_all();
+			jobSlot.notify_all();
+		}
+		threads.join_all();
+
+		JobQueue::iterator i;
+		for(i=inFlight.begin(); i!=inFlight.end(); ++i)
+			freeJob(*i);
+	}
+
+	/** Writes all objects to the given stream.
+	 * @param stream Stream writer where to write.
+	 *
+	 * Starts producer and worker threads and writes prepared jobs as they 
+	 * are finished. Exceptions raised in other threads are rethrown here.
+	 */
+	void write(StreamWriter & stream)
+	{
+	using namespace debug;
+
+		threads.create_thread(boost::bind(&ContentWriterPipeline::produce, this));
+		for(size_t i=0; i<workers; ++i)
+			threads.create_thread(boost::bind(&ContentWriterPipeline::work, this));
+
+		for(;;)
+		{
+			Job * job;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				while(!(inFlight.empty() && producerFinished) 
+						&& (inFlight.empty() || !inFlight.front()->done))
+					jobDone.wait(lock);
+				if(inFlight.empty())
+				{
+					if(producerError)
+						boost::rethrow_exception(producerError);
+					return;
+				}
+				job=inFlight.front();
+				inFlight.pop_front();
+				jobSlot.notify_one();
+			}
+
+			try
+			{
+				if(job->error)
+					boost::rethrow_exception(job->error);
+				utilsPrintDbg(DBG_INFO, "Writing "<<job->objects.size()
+						<<" objects to the output outputStream.");
+				pdfWriter.writePreparedContent(job->objects, job->prepared, stream);
+			}catch(...)
+			{
+				freeJob(job);
+				throw;
+			}
+			freeJob(job);
+		}
+	}
+};
+
 FileStreamData* PdfDocumentWriter::getStreamData(const char *fileName)
 {
 using namespace debug;
@@ -831,15 +2041,15 @@ using namespace debug;
 		return NULL;
 	}
 	Object dict;
-    	Goffset  startA,lengthA ;
+	dict.initNull();
 	FileStreamData *streamData = new FileStreamData;
-    	streamData->stream = new FileStreamWriter(file, startA, false, lengthA, &dict);
+	streamData->stream = new FileStreamWriter(file, 0, gFalse, 0, &dict);
 	streamData->file = file;
 	return streamData;
 }
 
 PdfDocumentWriter::PdfDocumentWriter(FileStreamData &data, IPdfWriter *_pdfWriter):
-	CXref(data.stream), pdfWriter(_pdfWriter) 
+	CXref(data.stream), workerThreads(0), pdfWriter(_pdfWriter) 
 {
 	assert(data.stream);
 	assert(data.file);
@@ -906,21 +2116,43 @@ using namespace debug;
 		throw NotImplementedException("Encrypted document");
 	}
 	
-	// creates outputStream writer from given file
+	// creates buffered outputStream writer from given file
 	Object dict;
-    	boost::shared_ptr<BaseStream> outputStream(
-            new FileStream((GooFile*)file, 0, gFalse, 0, &dict));
+	dict.initNull();
+	boost::shared_ptr<StreamWriter> outputStream(
+			new BufferedFileStreamWriter(file, 0, gFalse, 0, &dict));
 
 	// Writes header with the same PDF version
 	pdfWriter->writeHeader(getPDFVersion(), *outputStream);
 	
+	size_t threads=workerThreads;
+	if(!threads)
+		threads=boost::thread::hardware_concurrency();
+	if(threads>1)
+		writeObjectsParallel(*outputStream, threads);
+	else
+		writeObjectsSerial(*outputStream);
+
+	utilsPrintDbg(DBG_INFO, "Writing xref and trailer section");
+	// no previous section information and all objects are going to be written
+	IPdfWriter::PrevSecInfo prevInfo={0, 0};
+	pdfWriter->writeTrailer(*getTrailerDict(), prevInfo, *outputStream);
+	outputStream->flush();
+
+	return 0;
+}
+
+void PdfDocumentWriter::writeObjectsSerial(StreamWriter & stream)
+{
+using namespace debug;
+
 	IPdfWriter::ObjectList objectList;
 	while (fillObjectList(objectList, writeBatchCount)>0)
 	{
-		// writes collected objects and xref & trailer section
+		// writes collected objects
 		utilsPrintDbg(DBG_INFO, "Writing "<<objectList.size()
 				<<" objects to the output outputStream.");
-        	pdfWriter->writeContent(objectList, *outputStream);
+        	pdfWriter->writeContent(objectList, stream);
 		// clean up
 		utilsPrintDbg(DBG_DBG, "Cleaning up all writen objects("
 				<<objectList.size()<<").");
@@ -931,14 +2163,13 @@ using namespace debug;
 			i->second=NULL;
 		}
 	}
-	utilsPrintDbg(DBG_INFO, "Writing xref and trailer section");
-	// no previous section information and all objects are going to be written
-	IPdfWriter::PrevSecInfo prevInfo={0, 0};
-	pdfWriter->writeTrailer(*getTrailerDict(), prevInfo, *outputStream);
-////	outputStream->flush();
-//    fflush(f);
+}
 
-	return 0;
+void PdfDocumentWriter::writeObjectsParallel(StreamWriter & stream, size_t threads)
+{
+	utilsPrintDbg(debug::DBG_INFO, "Writing objects with "<<threads<<" worker threads");
+	ContentWriterPipeline pipeline(*this, *pdfWriter, threads);
+	pipeline.write(stream);
 }
 
 } // utils namespace
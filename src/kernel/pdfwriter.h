@@ -294,6 +294,10 @@ public:
 class NullFilterStreamWriter: public FilterStreamWriter
 {
 	static boost::shared_ptr<NullFilterStreamWriter> instance;
+
+	/** Creates the shared instance (called once, see getInstance).
+	 */
+	static void createInstance();
 public:
 	static boost::shared_ptr<NullFilterStreamWriter> getInstance();
 
@@ -306,36 +310,113 @@ public:
 	 */
 	static unsigned char * null_extractor(const Object&obj, size_t& size);
 
+	/** Copies file stream object to the output stream.
+	 * @param obj Stream object.
+	 * @param ref Indirect reference for object (NULL if direct).
+	 * @param outStream Stream where to write data.
+	 *
+	 * Raw data of streams backed by the document file are copied in chunks
+	 * directly to the output stream without buffering the whole stream. 
+	 * Output has the same format as streamToCharBuffer would produce.
+	 *
+	 * @return true if object has been written, false if it is not a file
+	 * stream with direct Length or if data don't match its Length (nothing
+	 * is written in such a case).
+	 */
+	static bool copyFileStream(const Object& obj, Ref* ref, StreamWriter& outStream);
+
 	/** Writes given stream object to the stream.
 	 * @param obj Stream object.
 	 * @param ref Indirect reference for object (NULL if direct).
 	 * @param outStream Stream where to write data.
 	 *
-	 * Uses streamToCharBuffer with null_extractor extractor.
+	 * Uses copyFileStream for streams backed by the document file and
+	 * streamToCharBuffer with null_extractor extractor otherwise.
 	 */
 	virtual void compress(const Object& obj, Ref* ref, StreamWriter& outStream)const;
 };
 
 /** Implementation of FlateDecode filter stream writer.
  * It is based on zlib implementation of default deflate method.
+ * <br>
+ * Decoded stream data are compressed while they are read from the stream
+ * (with zlib state reused by all streams written by the same thread) and
+ * written to the output stream without additional copies. Compression 
+ * level can be changed before each save (see setLevel) and large streams
+ * can be split into blocks compressed by more threads (see 
+ * setBlockCompression).
  */
 class ZlibFilterStreamWriter: public FilterStreamWriter
 {
 	/** Shared writer instance */
 	static boost::shared_ptr<ZlibFilterStreamWriter> instance;
 
+	/** zlib compression level. */
+	int level;
+
+	/** Size of independently compressed blocks. */
+	size_t blockSize;
+
+	/** Number of threads compressing blocks of one stream. */
+	size_t blockThreads;
+
 	/** Updates given stream object with the applied fiter data.
 	 * @param obj Stream object.
 	 *
 	 * Only for internal use of ZlibFilterStreamWriter class.
 	 */
 	static void update_dict(const Object& obj);
+
+	/** Initializes writer with zlib default compression level and no
+	 * block compression.
+	 */
+	ZlibFilterStreamWriter();
+
+	/** Creates the shared instance (called once, see getInstance).
+	 */
+	static void createInstance();
 public:
+	/** Default size of independently compressed blocks. */
+	static const size_t DEFAULT_BLOCK_SIZE = 128*1024;
+
 	static boost::shared_ptr<ZlibFilterStreamWriter> getInstance();
 
+	/** Sets compression level for all following writes.
+	 * @param level zlib compression level (0 - no compression, 1 - the 
+	 * fastest, 9 - the best, -1 - zlib default).
+	 *
+	 * Level can be changed before each save - e.g. the fastest one for
+	 * autosave and the best one for a document archival. Invalid values
+	 * are replaced by the zlib default level.
+	 */
+	void setLevel(int level);
+
+	/** Returns compression level.
+	 * @return zlib compression level.
+	 */
+	int getLevel()const
+	{
+		return level;
+	}
+
+	/** Sets parallel compression of large streams.
+	 * @param threads Number of threads compressing one stream (0 stands
+	 * for number of available processors, 1 disables parallel 
+	 * compression).
+	 * @param size Size of block compressed by one thread.
+	 *
+	 * Streams with at least 2 blocks of decoded data are split into blocks
+	 * which are compressed independently (each of them uses the end of the
+	 * previous block as the dictionary) and concatenated into a single
+	 * zlib stream - the same way as pigz does. Output is slightly bigger
+	 * and not identical with the serial compression. Disabled by default.
+	 */
+	void setBlockCompression(size_t threads, size_t size=DEFAULT_BLOCK_SIZE);
+
 	/** Checks whether given stream object is supported by this writer.
 	 * @param obj Stream object.
-	 * @return true if no filter FlateDecode are used.
+	 * @return true if no filter FlateDecode are used and the stream data
+	 * are not stored in an external file (F entry), false otherwise.
 	 */
 	virtual bool supportObject(const Object& obj)const;
 
@@ -343,24 +424,22 @@ public:
 	 * @param in Input buffer.
 	 * @param in_size Input buffer size.
 	 * @param size Size of the output buffer data.
+	 * @param level zlib compression level.
 	 * @return allocated buffer with the size data bytes or NULL on failure.
 	 *
 	 * Uses zlib interface to deflate given data.
 	 */
-	static unsigned char* deflate_buffer(unsigned char * in, size_t in_size, size_t& size);
+	static unsigned char* deflate_buffer(unsigned char * in, size_t in_size, size_t& size, int level=-1);
 
-	/** Stream data extractor implementation for streamToCharBuffer function.
+	/** Writes given stream object compressed by FlateDecode filter.
 	 * @param obj Stream object.
-	 * @param size Size of the returned buffer data.
-	 * @return allocated buffer with data or NULL on failure.
-	 * 
-	 * Uses bufferFromStreamData to get raw data without any filters,
-	 * compresses returned buffer with the deflate_buffer function and 
-	 * updates given stream object's dictionary to contain proper filter 
-	 * data.
+	 * @param ref Indirect reference for object (NULL if direct).
+	 * @param outStream Stream where to write data.
+	 *
+	 * Stream dictionary is updated to contain FlateDecode filter and
+	 * correct Length. Stream is written without changes by 
+	 * NullFilterStreamWriter if its data cannot be compressed.
 	 */
-	static unsigned char* deflate(const Object& obj, size_t& size);
-
 	virtual void compress(const Object& obj, Ref* ref, StreamWriter& outStream)const;
 };
 
@@ -407,6 +486,12 @@ public:
 	 */
 	typedef std::vector<ObjectElement> ObjectList;
 
+	/** Type for prepared objects list.
+	 * Element at the given index holds serialized form of the ObjectList 
+	 * element with the same index (as produced by prepareObject method).
+	 */
+	typedef std::vector<std::string> PreparedList;
+
 	/** Type for pdf writer observer contenxt.
 	 *
 	 * This context holds OperationScope structure for change scope information. 
@@ -466,7 +551,37 @@ public:
 	 * <br>
 	 * Doesn't write xref and trailer.
 	 */
-    	void writeContent(ObjectList & objectList, BaseStream & stream, size_t off=0);
+	virtual void writeContent(ObjectList & objectList, StreamWriter & stream, size_t off=0)=0;
+
+	/** Serializes given object to the form used by writePreparedContent.
+	 * @param ref Reference of the object.
+	 * @param obj Object to serialize.
+	 * @param data String where to store serialized object.
+	 *
+	 * This is the expensive part of the object writing (stream data 
+	 * encoding and conversion to the string) split from writeContent so 
+	 * that objects can be prepared in parallel. Implementation mustn't 
+	 * touch any writer state, because it is called concurrently from more
+	 * threads (each object is prepared only by one of them).
+	 * <br>
+	 * Default implementation stores complete indirect object exactly as 
+	 * it would be written to the stream by writeContent.
+	 */
+	virtual void prepareObject(const ::Ref & ref, const Object & obj, std::string & data)const;
+
+	/** Puts all already prepared objects to given stream.
+	 * @param objectList List of objects to store.
+	 * @param prepared Objects serialized by prepareObject method (in the same
+	 * order as in objectList).
+	 * @param stream Stream writer where to write.
+	 * @param off Stream offset where to start writing (if 0, uses current
+	 * position).
+	 *
+	 * Has the same effect as writeContent with the same objectList (both
+	 * written data and observers notifications), but objects are not 
+	 * serialized again.
+	 */
+	virtual void writePreparedContent(ObjectList & objectList, const PreparedList & prepared, StreamWriter & stream, size_t off=0)=0;
 
 	/** Writes xref and trailer section.
 	 * @param trailer Trailer object.xrefPos.
@@ -483,6 +598,35 @@ public:
 	 */
 	virtual size_t writeTrailer(const Object & trailer, const PrevSecInfo &prevSection, StreamWriter & stream, size_t off=0)=0;
 
+	/** Returns position of the last written cross reference section.
+	 *
+	 * The value is set by writeTrailer method and it is not cleared by 
+	 * reset, so it can be used to link the next revision (or to reopen 
+	 * the document) after writeTrailer has finished. Note that the
+	 * cross reference section doesn't have to start at the stream position
+	 * where writeTrailer started (e.g. when some objects are written 
+	 * together with the cross reference data).
+	 *
+	 * @return stream offset of the cross reference section (xref keyword
+	 * or cross reference stream object) or 0 if nothing has been written 
+	 * yet.
+	 */
+	virtual size_t getLastXRefPos()const =0;
+
+	/** Returns minimal PDF version required by the written content.
+	 *
+	 * writeHeader takes care of the version when the complete document is
+	 * written. Incremental updates keep the original header and so the 
+	 * caller has to raise the version in the document catalog (Version 
+	 * entry) if it is lower than the returned one.
+	 *
+	 * @return Minimal PDF version or NULL if any version is fine (default).
+	 */
+	virtual const char * getRequiredVersion()const
+	{
+		return NULL;
+	}
+
 	/** Resets internal data collected in writeContent method.
 	 *
 	 * Everything collected in writeContent method, which is needed by
@@ -533,6 +677,22 @@ class OldStylePdfWriter: public IPdfWriter
 	 * chapter for more information).
 	 */
 	int maxObjNum;
+
+	/** Position of the last written xref section.
+	 * Set by writeTrailer and not cleared by reset.
+	 */
+	size_t lastXRefPos;
+
+	/** Writes given objects.
+	 * @param objectList List of objects to write.
+	 * @param prepared Prepared objects (NULL if they should be serialized
+	 * directly to the stream).
+	 * @param stream Stream writer where to write.
+	 * @param off Stream offset where to start writing.
+	 *
+	 * Common implementation of writeContent and writePreparedContent.
+	 */
+	void writeObjects(ObjectList & objectList, const PreparedList * prepared, StreamWriter & stream, size_t off);
 public:
 	/** String for context task in writeContent.
 	 * This value is used in ScopedChangeContext's task field in writeContent
@@ -550,7 +710,7 @@ public:
 	 *
 	 * Initializes CONTENT and TRAILER fields to default values.
 	 */
-	OldStylePdfWriter():maxObjNum(0){}
+	OldStylePdfWriter():maxObjNum(0), lastXRefPos(0){}
 
 	/** Writes given objects.
 	 * @param objectList List of objects to write.
@@ -569,7 +729,13 @@ public:
 	 * contains total number of objects which should be written by this call.
 	 * Context task field contains CONTENT string.
 	 */
-     	void writeContent(ObjectList & objectList, BaseStream & stream, size_t off=0);
+	virtual void writeContent(ObjectList & objectList, StreamWriter & stream, size_t off=0);
+
+	/** Writes given prepared objects.
+	 * @see IPdfWriter::writePreparedContent
+	 * @see writeContent
+	 */
+	virtual void writePreparedContent(ObjectList & objectList, const PreparedList & prepared, StreamWriter & stream, size_t off=0);
 
 	/** Writes cross reference table and trailer.
 	 * @param trailer Trailer object.
@@ -624,6 +790,14 @@ public:
 	 */
 	virtual size_t writeTrailer(const Object & trailer, const PrevSecInfo &prevSection, StreamWriter & stream, size_t off=0);
 
+	/** Returns position of the last written xref keyword.
+	 * @return file offset of the last xref table.
+	 */
+	virtual size_t getLastXRefPos()const
+	{
+		return lastXRefPos;
+	}
+
 	/** Resets all collected data.
 	 *
 	 * Clears offTable field and so this instance can be used for another 
@@ -632,6 +806,230 @@ public:
 	virtual void reset();
 };
 
+/** Implementator of cross reference stream pdf writer.
+ *
+ * Writes content in the compressed format introduced by PDF 1.5. Indirect 
+ * objects which are not streams and have 0 generation number are packed 
+ * into deflated object streams (/Type /ObjStm) and all other objects are 
+ * written as usual. Cross reference section is written as a deflated cross 
+ * reference stream (/Type /XRef) which also serves as the trailer.
+ * <br>
+ * Object streams and the cross reference stream need new object numbers.
+ * They are allocated in writeTrailer above the maximum of the previous 
+ * section Size and the highest written object number, so they never 
+ * clash with objects already present in the document.
+ * <p>
+ * Note that the produced document (or revision) is readable only by PDF 1.5
+ * capable readers. writeHeader bumps the version to 1.5 if it is lower, 
+ * incremental updates keep the original header and XRefWriter::saveChanges
+ * sets the catalog Version entry instead (see getRequiredVersion).
+ */
+class XRefStreamPdfWriter: public IPdfWriter
+{
+public:
+	/** Default maximum number of objects in one object stream. */
+	static const size_t DEFAULT_OBJSTM_CAPACITY = 100;
+
+	/** String for context task in writeContent.
+	 * @see OldStylePdfWriter::CONTENT
+	 */
+	static const std::string CONTENT;
+
+	/** String for context task in writeTrailer.
+	 * @see OldStylePdfWriter::TRAILER
+	 */
+	static const std::string TRAILER;
+private:
+	/** Cross reference stream entry.
+	 * Fields have meaning according to the type field (see PDF specification 
+	 * 3.4.7 Cross-Reference Streams):
+	 * <ul>
+	 * <li>type 0 - free object (field2 is the next free object number,
+	 * field3 its generation number)
+	 * <li>type 1 - object in use (field2 is file offset, field3 generation
+	 * number)
+	 * <li>type 2 - compressed object (field2 is the object stream number, 
+	 * field3 index of the object inside the object stream)
+	 * </ul>
+	 */
+	struct Entry
+	{
+		int type;
+		size_t field2;
+		size_t field3;
+	};
+
+	/** Type for entries table.
+	 * Mapping from reference to the cross reference stream entry. Only 
+	 * object numbers are relevant for cross reference stream, but full 
+	 * reference is kept to detect duplicities consistently with 
+	 * OldStylePdfWriter.
+	 */
+	typedef std::map<const ::Ref, Entry, xpdf::RefComparator> EntriesTab;
+
+	/** Object stream which is waiting for its object number.
+	 * Data are kept uncompressed, they are compressed when the stream is
+	 * written by writeTrailer which also assigns object stream number.
+	 */
+	struct PendingObjStm
+	{
+		/** Number of objects in the stream. */
+		size_t n;
+		/** Offset of the first object in the decoded data. */
+		size_t first;
+		/** Uncompressed object stream body (offsets followed by objects). */
+		std::string data;
+	};
+	typedef std::vector<PendingObjStm> ObjStmList;
+
+	/** Entries collected since last reset.
+	 * Type 2 entries have field2 set to the index of the object stream
+	 * in objStms until writeTrailer assigns real object numbers.
+	 */
+	EntriesTab entries;
+
+	/** Object streams collected since last reset. */
+	ObjStmList objStms;
+
+	/** Objects for the currently filled object stream.
+	 * Each element holds the object number and its string representation.
+	 */
+	std::vector<std::pair<int, std::string> > batch;
+
+	/** Maximum number of objects in one object stream. */
+	size_t objStmCapacity;
+
+	/** Maximum object number written.
+	 * @see OldStylePdfWriter::maxObjNum
+	 */
+	int maxObjNum;
+
+	/** Position of the last written cross reference stream.
+	 * Set by writeTrailer and not cleared by reset.
+	 */
+	size_t lastXRefPos;
+
+	/** Moves current batch to the new pending object stream.
+	 * Does nothing if the batch is empty.
+	 */
+	void flushBatch();
+
+	/** Compresses pending object stream and writes it as indirect object.
+	 * @param objStm Object stream to write.
+	 * @param num Object number of the object stream.
+	 * @param stream Stream writer where to write.
+	 */
+	void writeObjStm(const PendingObjStm & objStm, int num, StreamWriter & stream)const;
+
+	/** Returns true if given object has to be written directly.
+	 * @param ref Reference of the object.
+	 * @param obj Object.
+	 *
+	 * Streams can't be stored in object streams and compressed objects 
+	 * have implicitly 0 generation number.
+	 * @return true for streams and objects with non 0 generation number.
+	 */
+	static bool isDirectObject(const ::Ref & ref, const Object & obj)
+	{
+		return obj.isStream() || ref.gen;
+	}
+
+	/** Writes given objects.
+	 * @see OldStylePdfWriter::writeObjects
+	 */
+	void writeObjects(ObjectList & objectList, const PreparedList * prepared, StreamWriter & stream, size_t off);
+public:
+	/** Initialize constructor.
+	 * @param capacity Maximum number of objects packed into one object
+	 * stream (0 stands for DEFAULT_OBJSTM_CAPACITY).
+	 */
+	XRefStreamPdfWriter(size_t capacity=DEFAULT_OBJSTM_CAPACITY)
+		:objStmCapacity((capacity)?capacity:DEFAULT_OBJSTM_CAPACITY), 
+		 maxObjNum(0), lastXRefPos(0) {}
+
+	/** Writes PDF header to the given stream.
+	 * @param version Version of the PDF standard used for this document.
+	 * @param stream Stream writer where to write.
+	 *
+	 * Delegates to IPdfWriter::writeHeader with the given version or 1.5
+	 * if the given one is lower (cross reference streams require it).
+	 */
+	virtual void writeHeader(const char* version, StreamWriter &stream);
+
+	/** Writes given objects.
+	 * @param objectList List of objects to write.
+	 * @param stream Stream writer where to write.
+	 * @param off Stream offset where to start writing (if 0, uses current
+	 * position).
+	 *
+	 * Streams and objects with non 0 generation number are written directly
+	 * to the stream (the same way as OldStylePdfWriter does). All other 
+	 * objects are collected and each time objStmCapacity objects are 
+	 * collected they are compressed into the object stream which is written
+	 * by writeTrailer.
+	 * <br>
+	 * Notifies observers the same way as OldStylePdfWriter::writeContent.
+	 */
+	virtual void writeContent(ObjectList & objectList, StreamWriter & stream, size_t off=0);
+
+	/** Serializes given object.
+	 * @param ref Reference of the object.
+	 * @param obj Object to serialize.
+	 * @param data String where to store serialized object.
+	 *
+	 * Objects which are written directly are serialized by 
+	 * IPdfWriter::prepareObject, others are converted to their string 
+	 * representation which is stored to the object stream.
+	 */
+	virtual void prepareObject(const ::Ref & ref, const Object & obj, std::string & data)const;
+
+	/** Writes given prepared objects.
+	 * @see IPdfWriter::writePreparedContent
+	 * @see writeContent
+	 */
+	virtual void writePreparedContent(ObjectList & objectList, const PreparedList & prepared, StreamWriter & stream, size_t off=0);
+
+	/** Writes object streams and cross reference stream.
+	 * @param trailer Trailer object.
+	 * @param prevSection Context for previous section.
+	 * @param stream Stream writer where to write.
+	 * @param off Stream offset where to start writing (if 0, uses current
+	 * position).
+	 *
+	 * Writes all pending object streams, then the cross reference stream
+	 * with all entries collected since last reset. Cross reference stream
+	 * dictionary contains all trailer entries (Prev and Size are updated the
+	 * same way as in OldStylePdfWriter::writeTrailer) and so it replaces 
+	 * trailer. startxref and %%EOF marker follow.
+	 * <br>
+	 * Notifies observers after each object stream is written. Context task
+	 * field contains TRAILER string.
+	 *
+	 * @return stream position of pdf end of file %%EOF marker.
+	 */
+	virtual size_t writeTrailer(const Object & trailer, const PrevSecInfo &prevSection, StreamWriter & stream, size_t off=0);
+
+	/** Returns position of the last written cross reference stream.
+	 * @return file offset of the last cross reference stream object.
+	 */
+	virtual size_t getLastXRefPos()const
+	{
+		return lastXRefPos;
+	}
+
+	/** Returns PDF version required by cross reference streams.
+	 * @return "1.5".
+	 */
+	virtual const char * getRequiredVersion()const;
+
+	/** Resets all collected data.
+	 *
+	 * Clears entries and pending object streams and so this instance can be 
+	 * used for another revision.
+	 */
+	virtual void reset();
+};
+
 /** Helper data structure which keeps all file stream related data.
  */
 struct FileStreamData 
@@ -702,12 +1100,36 @@ public:
  */
 class PdfDocumentWriter: public pdfobjects::CXref
 {
+	friend class ContentWriterPipeline;
+
 	/** Number of objects that should be written in one batch.
 	 * This constant is used as the maxObjectCount parameter to 
 	 * fillObjectList method.
 	 */
 	static const int writeBatchCount = 1000;
 
+	/** Number of threads used for objects serialization.
+	 * @see setWorkerThreads
+	 */
+	size_t workerThreads;
+
+	/** Writes all objects provided by fillObjectList in this thread.
+	 * @param stream Stream writer where to write.
+	 */
+	void writeObjectsSerial(StreamWriter & stream);
+
+	/** Writes all objects provided by fillObjectList using more threads.
+	 * @param stream Stream writer where to write.
+	 * @param threads Number of serialization threads.
+	 *
+	 * Objects are fetched by the producer thread, serialized and compressed
+	 * by threads worker threads (IPdfWriter::prepareObject) and written
+	 * in the original order by the calling thread (so that observers are
+	 * notified from the same thread as in writeObjectsSerial). Produced 
+	 * data are same as by writeObjectsSerial.
+	 */
+	void writeObjectsParallel(StreamWriter & stream, size_t threads);
+
 protected:
 	/** Pdf content writer implementator.
 	 *
@@ -746,6 +1168,8 @@ protected:
 	 * Sets position to the file beginning and writes the same pdf header as in
 	 * the original stream. Then writes all objects provided by fillObjectList 
 	 * (calls this method repeatedly unless 0 objects are returned).
+	 * Objects are serialized by more threads unless setWorkerThreads 
+	 * limits it to 1 (see writeObjectsParallel).
 	 * Finally stores xref and trailer section.
 	 * <br>
 	 * Caller is responsible for file handle closing.
@@ -816,7 +1240,29 @@ public:
 
 		return current;
 	}
-	
+
+	/** Sets number of threads used for objects serialization.
+	 * @param threads Number of threads (0 stands for number of available
+	 * processors).
+	 *
+	 * Objects are fetched, serialized and written by the calling thread 
+	 * if the resulting number is 1. Otherwise objects are fetched and 
+	 * serialized (including stream data compression) in separate threads 
+	 * and only written by the calling thread. Written data are same in both
+	 * cases. Default value is 0.
+	 */
+	void setWorkerThreads(size_t threads)
+	{
+		workerThreads=threads;
+	}
+
+	/** Returns number of threads used for objects serialization.
+	 * @return Number of threads as set by setWorkerThreads.
+	 */
+	size_t getWorkerThreads()const
+	{
+		return workerThreads;
+	}
 };
 
 } // namespace utils
@@ -308,6 +308,18 @@ namespace {
 		// return changed state
 		return state;
 	}
+	// "B", "B*", "F", "S", "b", "b*", "f", "f*", "n", "s"
+	GfxState *
+    	opPaintUpdate (GfxState* state, boost::shared_ptr<GfxResources> res, const boost::shared_ptr<PdfOperator> op, const PdfOperator::Operands& args, BBox* rc)
+	{
+		state = StateUpdater::unknownUpdate (state, res, op, args, rc);
+
+		// Painting operator ends the path
+		state->clearPath ();
+		
+		// return changed state
+		return state;
+	}
 	// "Tc"
 	GfxState *
     	opTcUpdate (GfxState* state, boost::shared_ptr<GfxResources>, const boost::shared_ptr<PdfOperator>, const PdfOperator::Operands& args, BBox* rc)
@@ -973,9 +985,9 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
     	{"'",   1, {setNthBitsShort (pString)},
             		opApoUpdate, "" },
     	{"B",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"B*",  0, {setNoneBitsShort ()},
-           		unknownUpdate, "" },
+           		opPaintUpdate, "" },
     	{"BDC", 2, {setNthBitsShort (pName), setNthBitsShort (pDict, pName)},
             		unknownUpdate, "" },
     	{"BI",  -1, {setNoneBitsShort ()},
@@ -1001,7 +1013,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
     	{"EX",  0, {setNoneBitsShort ()},
             		unknownUpdate, "" },
     	{"F",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"G",   1, {setNthBitsShort (pInt, pReal)},
             		unknownUpdate, "" },
     	{"ID",  0, {setNoneBitsShort ()},
@@ -1020,7 +1032,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
     	{"RG",  3, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)},
             		unknownUpdate, "" },
     	{"S",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"SC",  -4, {setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),
                 	setNthBitsShort (pInt, pReal),	setNthBitsShort (pInt, pReal)},
             		unknownUpdate, "" },
@@ -1060,9 +1072,9 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
     	{"W*",  0, {setNoneBitsShort ()},
             		unknownUpdate, "" },
     	{"b",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"b*",  0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"c",   6, {setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),
                  	setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)},
             		opcUpdate, "" },
@@ -1079,9 +1091,9 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
                  	setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)},
             		unknownUpdate, "" },
     	{"f",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"f*",  0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"g",   1, {setNthBitsShort (pInt, pReal)},
             		unknownUpdate, "" },
     	{"gs",  1, {setNthBitsShort (pName)},
@@ -1100,7 +1112,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
     	{"m",   2, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)},
             opmUpdate, "" },
     	{"n",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"q",   0, {setNoneBitsShort ()},
             		opqUpdate, "Q" },
     	{"re",  4, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),
@@ -1111,7 +1123,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
     	{"ri",  1, {setNthBitsShort (pName)},
             		unknownUpdate, "" },
     	{"s",   0, {setNoneBitsShort ()},
-            		unknownUpdate, "" },
+            		opPaintUpdate, "" },
     	{"sc",  -4, {setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),
                 setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)},
             		unknownUpdate, "" },
@@ -1153,11 +1165,60 @@ StateUpdater::unknownUpdate (GfxState* state,
 }
 
 
+//
+//
+//
+GfxState*
+StateUpdater::updatePdfOperator (GfxState* state,
+								 boost::shared_ptr<GfxResources> res,
+								 boost::shared_ptr<PdfOperator> op,
+								 BBox& rc)
+{
+	// Get operator name
+	std::string frst;
+	op->getOperatorName(frst);
+	// Get operator specification
+	const CheckTypes* chcktp = findOp (frst);
+	// Get operands
+	PdfOperator::Operands ops;
+	op->getParameters (ops);
+	// If operator found use the function else use default
+	if (NULL != chcktp)
+	{
+		// Check arguments
+		if ( ((chcktp->argNum >= 0) && (ops.size () != (size_t)chcktp->argNum)) ||
+		      ((chcktp->argNum < 0) && (ops.size () > (size_t)-chcktp->argNum)) )
+		{
+			kernelPrintDbg (debug::DBG_CRIT, "Bad content stream. Incorrect parameters.");
+			throw CObjInvalidObject ();
+		}
+
+		// Update the state
+		return (chcktp->update) (state, res, op, ops, &rc);
+	}
+
+	// Update the state
+	return unknownUpdate (state, res, op, ops, &rc);
+}
+
 //
 //
 //
 const StateUpdater::CheckTypes*
 StateUpdater::findOp (const string& opName)
+{
+	int opcode = findOpCode (opName.c_str());
+	if (0 <= opcode)
+		return &(KNOWN_OPERATORS[opcode]);
+	else
+		return NULL;
+}
+
+//
+//
+//
+int
+StateUpdater::findOpCode (const char* opName)
 {
 	int lo, hi, med, cmp;
 	
@@ -1171,7 +1232,7 @@ StateUpdater::findOp (const string& opName)
 	while (hi - lo > 1) 
 	{
 		med = (lo + hi) / 2;
-		cmp = opName.compare (KNOWN_OPERATORS[med].name);
+		cmp = strcmp (opName, KNOWN_OPERATORS[med].name);
 		if (cmp > 0)
 			lo = med;
 		else if (cmp < 0)
@@ -1181,9 +1242,19 @@ StateUpdater::findOp (const string& opName)
 	}
 
 	if (0 == cmp)
-		return &(KNOWN_OPERATORS[lo]);
+		return lo;
 	else
-		return NULL;
+		return -1;
+}
+
+//
+//
+//
+const StateUpdater::CheckTypes&
+StateUpdater::getOp (int opcode)
+{
+	assert (0 <= opcode && (size_t)opcode < sizeof (KNOWN_OPERATORS) / sizeof (CheckTypes));
+	return KNOWN_OPERATORS[opcode];
 }
 
 //
@@ -119,6 +119,25 @@ public:
 	 */
 	static const CheckTypes* findOp (const std::string& name);
 
+	/**
+	 * Find operator code.
+	 *
+	 * Operator code is the index of the operator specification in known
+	 * operators. It is used by compact representation of content streams.
+	 *
+	 * @param name Name of the operator.
+	 *
+	 * @return Operator code, -1 if the operator is not known.
+	 */
+	static int findOpCode (const char* name);
+
+	/**
+	 * Get operator specification by operator code.
+	 *
+	 * @param opcode Operator code returned by findOpCode.
+	 */
+	static const CheckTypes& getOp (int opcode);
+
 	/**
 	 *  Get end tag of an operator.
 	 *
@@ -129,6 +148,27 @@ public:
 	static std::string getEndTag (const std::string& name);
 	
 public:
+	/**
+	 * Update graphical state according to one pdf operator.
+	 *
+	 * Operators are not traversed, children of a composite have to be updated
+	 * separately.
+	 *
+	 * @param state Graphical state. It can be deleted and another state
+	 * returned (e.g. by Q operator).
+	 * @param res Graphical resources.
+	 * @param op Pdf operator.
+	 * @param rc Bounding box of the operator.
+	 *
+	 * @return Updated graphical state.
+	 * @throw CObjInvalidObject if the operator has incorrect operands. State is
+	 * not deleted in this case.
+	 */
+	static GfxState* updatePdfOperator (GfxState* state,
+										boost::shared_ptr<GfxResources> res,
+										boost::shared_ptr<PdfOperator> op,
+										BBox& rc);
+
 	/**
 	 *  Update pdf operators.
 	 *
@@ -161,35 +201,15 @@ public:
 		while (!it.isEnd ())
 		{
 			op = it.getCurrent();
-			// Get operator name
-			std::string frst;
-			op->getOperatorName(frst);
-			// Get operator specification
-			const CheckTypes* chcktp = findOp (frst);
-			// Get operands
-			PdfOperator::Operands ops;
-			op->getParameters (ops);
-			// If operator found use the function else use default
-			if (NULL != chcktp)
-			{
-				// Check arguments
-				if ( ((chcktp->argNum >= 0) && (ops.size () != (size_t)chcktp->argNum)) ||
-				      ((chcktp->argNum < 0) && (ops.size () > (size_t)-chcktp->argNum)) )
-				{
-					kernelPrintDbg (debug::DBG_CRIT, "Bad content stream. Incorrect parameters.");
-					
-					// Delete gfx state
-					delete tmpstate;
-					throw CObjInvalidObject ();
-				}
-
+			try {
 				// Update the state
-				tmpstate = (chcktp->update) (tmpstate, res, op, ops, &rc);
-				
-			}else
+				tmpstate = updatePdfOperator (tmpstate, res, op, rc);
+			
+			}catch (CObjInvalidObject&)
 			{
-				// Update the state
-				tmpstate = unknownUpdate (tmpstate, res, op, ops, &rc);
+				// Delete gfx state
+				delete tmpstate;
+				throw;
 			}
 
 			assert (tmpstate);
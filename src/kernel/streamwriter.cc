@@ -40,10 +40,19 @@ void FileStreamWriter::putChar(int ch)
 }
 
 void FileStreamWriter::putLine(const char * line, size_t length)
+{
+	if(!line)
+		return;
+
+	putBuffer(line, length);
+	putChar(0xA);
+}
+
+void FileStreamWriter::putBuffer(const char * buffer, size_t length)
 {
 using namespace debug;
 
-	if(!line)
+	if(!buffer)
 		return;
 
 	size_t pos=getPos();
@@ -52,7 +61,7 @@ using namespace debug;
 	// writes all data
 	while(totalWriten<length)
 	{
-		size_t writen=fwrite(line+totalWriten, sizeof(char), length-totalWriten, f);
+		size_t writen=fwrite(buffer+totalWriten, sizeof(char), length-totalWriten, f);
 		if(!writen)
 		{
 			int err = errno;
@@ -61,8 +70,6 @@ using namespace debug;
 		}
 		totalWriten+=writen;
 	}
-	fputc(0xA, f);
-	totalWriten++;
 	fflush(f);
 	setPos(pos+totalWriten);
 }
@@ -140,3 +147,219 @@ using namespace debug;
 
 	return totalWriten;
 }
+
+BufferedFileStreamWriter::BufferedFileStreamWriter(FILE *fA, Guint startA, GBool limitedA, 
+		Guint lengthA, Object * dictA, size_t bufferSizeA)
+	: BaseStream(dictA),
+	  FileStreamWriter(fA, startA, limitedA, lengthA, dictA),
+	  buffer(NULL), bufferSize(bufferSizeA), bufferUsed(0), bufferPos(0)
+{
+	if(!bufferSize)
+		bufferSize=1;
+	buffer=new char[bufferSize];
+}
+
+BufferedFileStreamWriter::~BufferedFileStreamWriter()
+{
+	writeBuffer();
+	delete [] buffer;
+}
+
+void BufferedFileStreamWriter::writeBuffer()
+{
+using namespace debug;
+
+	if(!bufferUsed)
+		return;
+
+	FileStream::setPos(bufferPos);
+	size_t totalWriten=0;
+	while(totalWriten<bufferUsed)
+	{
+		size_t writen=fwrite(buffer+totalWriten, sizeof(char), bufferUsed-totalWriten, f);
+		if(!writen)
+		{
+			int err = errno;
+			kernelPrintDbg(DBG_ERR, "Write error \"" << strerror(err) << "\"");
+			break;
+		}
+		totalWriten+=writen;
+	}
+	fflush(f);
+	bufferUsed=0;
+	FileStream::setPos(bufferPos+totalWriten);
+}
+
+void BufferedFileStreamWriter::putChar(int ch)
+{
+	char c=(char)ch;
+	putBuffer(&c, 1);
+}
+
+void BufferedFileStreamWriter::putBuffer(const char * data, size_t length)
+{
+	if(!data || !length)
+		return;
+
+	if(bufferUsed+length>bufferSize)
+		writeBuffer();
+
+	// too big to be buffered - file position has to be synchronized with
+	// the stream position because it might have been moved by reading
+	if(length>=bufferSize)
+	{
+		FileStream::setPos(FileStream::getPos());
+		FileStreamWriter::putBuffer(data, length);
+		return;
+	}
+	
+	if(!bufferUsed)
+		bufferPos=FileStream::getPos();
+	memcpy(buffer+bufferUsed, data, length);
+	bufferUsed+=length;
+}
+
+bool BufferedFileStreamWriter::trim(size_t pos)
+{
+	writeBuffer();
+	return FileStreamWriter::trim(pos);
+}
+
+void BufferedFileStreamWriter::flush()const
+{
+	// flush doesn't change the logical content of the stream
+	const_cast<BufferedFileStreamWriter *>(this)->writeBuffer();
+	FileStreamWriter::flush();
+}
+
+size_t BufferedFileStreamWriter::cloneToFile(FILE * file, size_t start, size_t length)
+{
+	writeBuffer();
+	return FileStreamWriter::cloneToFile(file, start, length);
+}
+
+void BufferedFileStreamWriter::reset()
+{
+	writeBuffer();
+	FileStream::reset();
+}
+
+void BufferedFileStreamWriter::close()
+{
+	writeBuffer();
+	FileStream::close();
+}
+
+void BufferedFileStreamWriter::setPos(Guint pos, int dir)
+{
+	writeBuffer();
+	FileStream::setPos(pos, dir);
+}
+
+void BufferedFileStreamWriter::moveStart(int delta)
+{
+	writeBuffer();
+	FileStream::moveStart(delta);
+}
+
+Stream * BufferedFileStreamWriter::clone()
+{
+	writeBuffer();
+	return FileStream::clone();
+}
+
+Stream * BufferedFileStreamWriter::makeSubStream(Guint startA, GBool limitedA,
+		Guint lengthA, const Object *dictA)
+{
+	writeBuffer();
+	return FileStream::makeSubStream(startA, limitedA, lengthA, dictA);
+}
+
+MemStreamWriter::MemStreamWriter(Object * dictA, size_t capacityA)
+	: BaseStream(dictA),
+	  StreamWriter(dictA),
+	  MemStream((char *)gmalloc((capacityA)?capacityA:1), 0, 0, dictA, gTrue),
+	  capacity((capacityA)?capacityA:1)
+{
+}
+
+void MemStreamWriter::ensureCapacity(size_t size)
+{
+	if(size<=capacity)
+		return;
+
+	size_t newCapacity=capacity;
+	while(newCapacity<size)
+		newCapacity*=2;
+
+	// buffer may be moved so pointers have to be recalculated
+	size_t pos=bufPtr-buf;
+	buf=(char *)grealloc(buf, newCapacity);
+	capacity=newCapacity;
+	bufPtr=buf+pos;
+	bufEnd=buf+start+length;
+}
+
+void MemStreamWriter::putChar(int ch)
+{
+	char c=(char)ch;
+	putBuffer(&c, 1);
+}
+
+void MemStreamWriter::putLine(const char * line, size_t length)
+{
+	if(!line)
+		return;
+
+	putBuffer(line, length);
+	putChar(0xA);
+}
+
+void MemStreamWriter::putBuffer(const char * buffer, size_t len)
+{
+	if(!buffer || !len)
+		return;
+
+	size_t pos=bufPtr-buf;
+	ensureCapacity(pos+len);
+	memcpy(buf+pos, buffer, len);
+	bufPtr=buf+pos+len;
+
+	// appends stream if we have written behind its end
+	if(pos+len>start+length)
+	{
+		length=pos+len-start;
+		bufEnd=buf+start+length;
+	}
+}
+
+bool MemStreamWriter::trim(size_t pos)
+{
+	if(pos>length)
+		return false;
+
+	length=pos;
+	bufEnd=buf+start+length;
+	if(bufPtr>bufEnd)
+		bufPtr=bufEnd;
+	return true;
+}
+
+size_t MemStreamWriter::cloneToFile(FILE * file, size_t start, size_t len)
+{
+using namespace debug;
+
+	if(!file || start>=length)
+		return 0;
+
+	// 0 length stands for everything until the end of the stream
+	if(!len || start+len>length)
+		len=length-start;
+	size_t totalWriten=0, writen;
+	while(totalWriten<len && 
+		(writen=fwrite(buf+this->start+start+totalWriten, sizeof(char), len-totalWriten, file))>0)
+		totalWriten+=writen;
+
+	kernelPrintDbg(DBG_INFO, totalWriten<<" bytes written to output file");
+	return totalWriten;
+}
@@ -43,7 +43,7 @@
  * Declares base interface for all writers to Base stream. All real writers
  * should implement this abstract class and stream type which is written.
  */
-class StreamWriter: public BaseStream
+class StreamWriter: virtual public BaseStream
 {
 public:
 	/** Constructor with dictionary object.
@@ -71,6 +71,16 @@ public:
 	 * Otherwise result is unpredictable.
 	 */
 	virtual void putLine(const char * line, size_t length)=0;
+
+	/** Puts exactly length number of bytes.
+	 * @param buffer Buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 *
+	 * Same as putLine but no line delimiter is added after buffer content.
+	 * Caller should guarantee that buffer is allocated at least for length 
+	 * size.
+	 */
+	virtual void putBuffer(const char * buffer, size_t length)=0;
 	
 	/** Removes all data behind given position.
 	 * @param pos Stream offset from where to trim.
@@ -162,6 +172,16 @@ public:
 	 *
 	 */
 	virtual void putLine(const char * line, size_t length);
+
+	/** Puts exactly length number of bytes to the file.
+	 * @param buffer Buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 *
+	 * Additionally flushes all changes to the file and position is moved after
+	 * inserted buffer.
+	 * @see StreamWriter::putBuffer
+	 */
+	virtual void putBuffer(const char * buffer, size_t length);
 	
 	/** Removes all data behind given file offset position.
 	 * @param pos Stream offset where to start removing.
@@ -208,4 +228,213 @@ public:
 	virtual size_t cloneToFile(FILE * file, size_t start, size_t length);
 };
 
+/** Buffered FileStream writer.
+ *
+ * FileStreamWriter which collects written data in the user space buffer and
+ * writes them to the file in large blocks instead of writing and flushing
+ * each putChar/putLine separately.
+ * <br>
+ * Pending data are written when the buffer is full, when flush is called
+ * explicitly (flush points) and before any operation which reads or seeks in
+ * the underlying file (so reading always sees all written data). Position
+ * (getPos) reflects also pending data.
+ */
+class BufferedFileStreamWriter: public FileStreamWriter
+{
+	/** Write buffer. */
+	char * buffer;
+	/** Allocated size of the buffer. */
+	size_t bufferSize;
+	/** Number of pending bytes in the buffer. */
+	size_t bufferUsed;
+	/** Absolute file position of the first pending byte. */
+	Guint bufferPos;
+
+	/** Writes pending data to the file.
+	 *
+	 * Data are written at bufferPos position and file stream position is
+	 * moved behind them. Buffer is empty afterwards.
+	 */
+	void writeBuffer();
+public:
+	/** Default size of the write buffer. */
+	static const size_t DEFAULT_BUFFER_SIZE = 256*1024;
+
+	/** Costructor.
+	 * @param fA File handle for stream.
+	 * @param startA Start offset in the file.
+	 * @param limitedA Limited flag for stream (true if stream has limited
+	 * size).
+	 * @param lengthA Length of the stream (ignored if limitedA is false).
+	 * @param dictA Dictionary for the stream (should be initialized as NULL
+	 * object).
+	 * @param bufferSizeA Size of the write buffer.
+	 */
+	BufferedFileStreamWriter(FILE *fA, Guint startA, GBool limitedA, Guint lengthA, 
+			Object * dictA, size_t bufferSizeA=DEFAULT_BUFFER_SIZE);
+
+	/** Destructor.
+	 *
+	 * Writes all pending data. File handle is not closed (see
+	 * ~FileStreamWriter).
+	 */
+	virtual ~BufferedFileStreamWriter();
+
+	/** Puts character to the buffer.
+	 * @param ch Character to write.
+	 * @see StreamWriter::putChar
+	 */
+	virtual void putChar(int ch);
+
+	/** Puts exactly length number of bytes to the buffer.
+	 * @param buffer Buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 *
+	 * Data which don't fit into the buffer are written directly.
+	 * @see StreamWriter::putBuffer
+	 */
+	virtual void putBuffer(const char * buffer, size_t length);
+
+	/** Writes pending data and removes all data behind given position.
+	 * @see FileStreamWriter::trim
+	 */
+	virtual bool trim(size_t pos);
+
+	/** Writes all pending data and flushes the file.
+	 */
+	virtual void flush()const;
+
+	/** Writes pending data and duplicates content to given file.
+	 * @see FileStreamWriter::cloneToFile
+	 */
+	virtual size_t cloneToFile(FILE * file, size_t start, size_t length);
+
+	//
+	// Reading and positioning - pending data are written first
+	//
+	virtual void reset();
+	virtual void close();
+	virtual int getChar()
+	{
+		if(bufferUsed)
+			writeBuffer();
+		return FileStream::getChar();
+	}
+	virtual int lookChar()
+	{
+		if(bufferUsed)
+			writeBuffer();
+		return FileStream::lookChar();
+	}
+	virtual int getBlock(char *blk, int size)
+	{
+		if(bufferUsed)
+			writeBuffer();
+		return FileStream::getBlock(blk, size);
+	}
+	virtual int getPos()const
+	{
+		return (bufferUsed) ? bufferPos+bufferUsed : FileStream::getPos();
+	}
+	virtual void setPos(Guint pos, int dir = 0);
+	virtual void moveStart(int delta);
+	virtual Stream * clone();
+	virtual Stream * makeSubStream(Guint startA, GBool limitedA,
+			Guint lengthA, const Object *dictA);
+};
+
+/** Memory stream writer.
+ *
+ * Implements StreamWriter on top of MemStream so that data can be 
+ * produced to the memory with the same interface as to the file (e.g. to
+ * serialize an object without touching the target file). Buffer grows as
+ * data are written and it is deallocated in destructor.
+ * <br>
+ * Stream always starts at 0 offset of the buffer.
+ */
+class MemStreamWriter: public StreamWriter, public MemStream
+{
+	/** Allocated size of the buffer. */
+	size_t capacity;
+
+	/** Makes sure that buffer can hold at least size bytes.
+	 * @param size Required size.
+	 */
+	void ensureCapacity(size_t size);
+public:
+	/** Default initial size of the buffer. */
+	static const size_t DEFAULT_BUFFER_SIZE = 4*1024;
+
+	/** Constructor.
+	 * @param dictA Dictionary for the stream (should be initialized as NULL
+	 * object).
+	 * @param capacityA Initial size of the buffer.
+	 */
+	MemStreamWriter(Object * dictA, size_t capacityA=DEFAULT_BUFFER_SIZE);
+
+	/** Destructor.
+	 * Buffer is deallocated by MemStream destructor.
+	 */
+	virtual ~MemStreamWriter(){}
+
+	/** Puts character at current position.
+	 * @param ch Character to put to the stream.
+	 * @see StreamWriter::putChar
+	 */
+	virtual void putChar(int ch);
+
+	/** Puts exactly length number of byte to one line.
+	 * @param line Line buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 *
+	 * Appends LF after given data.
+	 * @see StreamWriter::putLine
+	 */
+	virtual void putLine(const char * line, size_t length);
+
+	/** Puts exactly length number of bytes.
+	 * @param buffer Buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 * @see StreamWriter::putBuffer
+	 */
+	virtual void putBuffer(const char * buffer, size_t length);
+
+	/** Removes all data behind given position.
+	 * @param pos Stream offset from where to trim.
+	 *
+	 * If current position is in removed area, it is moved to the stream
+	 * end. Buffer is not shrunk.
+	 *
+	 * @return true if stream was trimed, false if pos is behind the stream 
+	 * end.
+	 */
+	virtual bool trim(size_t pos);
+
+	/** Does nothing, all data are already in the buffer.
+	 */
+	virtual void flush()const {}
+
+	/** Duplicates content to given file.
+	 * @see StreamWriter::cloneToFile
+	 */
+	virtual size_t cloneToFile(FILE * file, size_t start, size_t length);
+
+	/** Returns written data.
+	 * Pointer is valid until the next write operation.
+	 * @return Pointer to the stream data.
+	 */
+	const char * getData()const
+	{
+		return buf+start;
+	}
+
+	/** Returns number of bytes in the stream.
+	 * @return Stream data length.
+	 */
+	size_t getDataLength()const
+	{
+		return length;
+	}
+};
+
 #endif
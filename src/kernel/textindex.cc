@@ -0,0 +1,563 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+// static includes
+#include "kernel/static.h"
+
+#include "kernel/textindex.h"
+#include "kernel/cpdf.h"
+#include "kernel/cpage.h"
+#include "kernel/cstream.h"
+#include "kernel/carray.h"
+#include "kernel/cdict.h"
+#include "kernel/cpageattributes.h"
+#include <zlib.h>
+#include <xpdf/UnicodeTypeTable.h>
+
+//==========================================================
+namespace pdfobjects {
+//==========================================================
+
+using namespace std;
+using namespace boost;
+using namespace utils;
+
+//=====================================================================================
+namespace {
+//=====================================================================================
+
+	/** Header of index files. */
+	const string INDEX_HEADER ("%PDFedit-text-index 2");
+
+	/**
+	 * Is the character a word separator.
+	 * Ascii non alphanumeric characters and unicode spaces and general
+	 * punctuation separate words.
+	 */
+	bool is_separator (Unicode u)
+	{
+		if (u < 0x80)
+			return !isalnum (static_cast<int> (u));
+		return (0xa0 == u) || (0x2000 <= u && u <= 0x206f) || (0x3000 == u);
+	}
+
+	/** Append unicode character to utf-8 string. */
+	void append_utf8 (string& str, Unicode u)
+	{
+		if (u < 0x80)
+			str += static_cast<char> (u);
+		else if (u < 0x800)
+		{
+			str += static_cast<char> (0xc0 | (u >> 6));
+			str += static_cast<char> (0x80 | (u & 0x3f));
+		}else if (u < 0x10000)
+		{
+			str += static_cast<char> (0xe0 | (u >> 12));
+			str += static_cast<char> (0x80 | ((u >> 6) & 0x3f));
+			str += static_cast<char> (0x80 | (u & 0x3f));
+		}else
+		{
+			str += static_cast<char> (0xf0 | ((u >> 18) & 0x07));
+			str += static_cast<char> (0x80 | ((u >> 12) & 0x3f));
+			str += static_cast<char> (0x80 | ((u >> 6) & 0x3f));
+			str += static_cast<char> (0x80 | (u & 0x3f));
+		}
+	}
+
+	/** 
+	 * Convert utf-8 string to unicode characters. Bytes which do not form a
+	 * valid utf-8 sequence are taken as latin1 characters.
+	 */
+	void decode_utf8 (const string& str, vector<Unicode>& out)
+	{
+		for (size_t i = 0; i < str.length(); )
+		{
+			unsigned char c = static_cast<unsigned char> (str[i]);
+			size_t len = (c >= 0xf0) ? 4 : (c >= 0xe0) ? 3 : (c >= 0xc0) ? 2 : 1;
+			Unicode u = (1 == len) ? c : (c & (0x3f >> (len - 1)));
+			bool ok = (i + len <= str.length());
+			for (size_t j = 1; ok && j < len; ++j)
+			{
+				unsigned char cc = static_cast<unsigned char> (str[i+j]);
+				ok = (0x80 == (cc & 0xc0));
+				u = (u << 6) | (cc & 0x3f);
+			}
+			if (!ok)
+				{ u = c; len = 1; }
+			out.push_back (u);
+			i += len;
+		}
+	}
+
+	/** Split unicode text to case folded words. */
+	void split_words (const vector<Unicode>& text, vector<string>& words)
+	{
+		string word;
+		for (size_t i = 0; i <= text.size(); ++i)
+		{
+			if (i == text.size() || is_separator (text[i]))
+			{
+				if (!word.empty() && words.end() == std::find (words.begin(), words.end(), word))
+					words.push_back (word);
+				word.clear ();
+			}else
+				append_utf8 (word, unicodeToUpper (text[i]));
+		}
+	}
+
+	/** Get document identifier (first part of the trailer ID) hex encoded. */
+	string document_id (const CPdf& pdf)
+	{
+		try {
+			shared_ptr<const CDict> trailer = pdf.getTrailer ();
+			if (!trailer || !trailer->containsProperty ("ID"))
+				return string ();
+			shared_ptr<IProperty> ids = getReferencedObject (trailer->getProperty ("ID"));
+			string id = getStringFromArray (ids, 0);
+
+			ostringstream oss;
+			oss << hex << setfill ('0');
+			for (size_t i = 0; i < id.length(); ++i)
+				oss << setw (2) << static_cast<unsigned> (static_cast<unsigned char> (id[i]));
+			return oss.str ();
+
+		}catch (CObjectException&)
+		{
+			kernelPrintDbg (debug::DBG_WARN, "Invalid document ID.");
+		}
+		return string ();
+	}
+
+	typedef TextIndex::Fingerprint Fingerprint;
+
+	/** Add data to fingerprint. */
+	void add_data (Fingerprint& fp, const char* data, size_t len)
+	{
+		fp.crc = crc32 (fp.crc, reinterpret_cast<const Bytef*> (data), static_cast<uInt> (len));
+		fp.length += len;
+	}
+
+	/** Add string representation of a property to fingerprint. */
+	void add_property (Fingerprint& fp, const IProperty& prop)
+	{
+		string str;
+		prop.getStringRepresentation (str);
+		add_data (fp, str.c_str(), str.length());
+	}
+
+	typedef set<pair<IndiRef::ObjNum, IndiRef::GenNum> > Visited;
+
+	/**
+	 * Add XObject streams of resources to fingerprint. Resources of form
+	 * XObjects are added too, every referenced stream only once.
+	 */
+	void add_xobjects (Fingerprint& fp, shared_ptr<IProperty> resources, Visited& visited)
+	{
+		resources = getReferencedObject (resources);
+		if (!isDict (resources))
+			return;
+		shared_ptr<CDict> res = IProperty::getSmartCObjectPtr<CDict> (resources);
+		if (!res->containsProperty ("XObject"))
+			return;
+		shared_ptr<IProperty> xobjects = getReferencedObject (res->getProperty ("XObject"));
+		if (!isDict (xobjects))
+			return;
+		shared_ptr<CDict> dict = IProperty::getSmartCObjectPtr<CDict> (xobjects);
+		add_property (fp, *dict);
+
+		vector<string> names;
+		dict->getAllPropertyNames (names);
+		for (vector<string>::const_iterator it = names.begin(); it != names.end(); ++it)
+		{
+			shared_ptr<IProperty> prop = dict->getProperty (*it);
+			if (!isRef (prop))
+				continue;
+			IndiRef ref = getValueFromSimple<CRef> (prop);
+			if (!visited.insert (make_pair (ref.num, ref.gen)).second)
+				continue;
+			shared_ptr<IProperty> xobject = getReferencedObject (prop);
+			if (!isStream (xobject))
+				continue;
+			shared_ptr<CStream> stream = IProperty::getSmartCObjectPtr<CStream> (xobject);
+			add_property (fp, *stream);
+			if (stream->containsProperty (Specification::Page::RESOURCES))
+				add_xobjects (fp, stream->getProperty (Specification::Page::RESOURCES), visited);
+		}
+	}
+
+	/**
+	 * Get fingerprint of page dictionary reference, content streams, resources
+	 * and XObject streams.
+	 */
+	Fingerprint page_fingerprint (const CPage& page)
+	{
+		shared_ptr<CDict> dict = page.getDictionary ();
+		Fingerprint fp;
+		
+		ostringstream oss;
+		oss << dict->getIndiRef ();
+		add_data (fp, oss.str().c_str(), oss.str().length());
+
+		// Resources can be inherited
+		CPageAttributes::InheritedAttributes attrs;
+		CPageAttributes::fillInherited (dict, attrs);
+		if (attrs._resources)
+		{
+			add_property (fp, *attrs._resources);
+			Visited visited;
+			add_xobjects (fp, attrs._resources, visited);
+		}
+
+		if (!dict->containsProperty (Specification::Page::CONTENTS))
+			return fp;
+		shared_ptr<IProperty> contents = getReferencedObject (dict->getProperty (Specification::Page::CONTENTS));
+		
+		// Contents can be either stream or an array of streams
+		vector<shared_ptr<CStream> > streams;
+		if (isStream (contents))
+			streams.push_back (IProperty::getSmartCObjectPtr<CStream> (contents));
+		else if (isArray (contents))
+		{
+			shared_ptr<CArray> array = IProperty::getSmartCObjectPtr<CArray> (contents);
+			for (size_t i = 0; i < array->getPropertyCount(); ++i)
+				streams.push_back (getCStreamFromArray (array, i));
+		}
+		for (size_t i = 0; i < streams.size(); ++i)
+		{
+			const CStream::Buffer& buffer = streams[i]->getBuffer ();
+			if (!buffer.empty())
+				add_data (fp, &buffer[0], buffer.size());
+		}
+		return fp;
+	}
+
+//=====================================================================================
+} // namespace
+//=====================================================================================
+
+//
+//
+//
+size_t
+TextIndex::update (const CPdf& pdf)
+{
+	_key (pdf);
+
+	// Remove pages which are not in the document anymore
+	size_t count = pdf.getPageCount ();
+	while (!_pages.empty() && _pages.rbegin()->first > count)
+		_remove (_pages.rbegin()->first);
+
+	size_t updated = 0;
+	for (size_t pos = 1; pos <= count; ++pos)
+	{
+		shared_ptr<CPage> page = pdf.getPage (pos);
+		Fingerprint fingerprint = page_fingerprint (*page);
+		Pages::const_iterator it = _pages.find (pos);
+		if (it != _pages.end() && it->second.fingerprint == fingerprint)
+			continue;
+		
+		_index (pos, *page, fingerprint);
+		++updated;
+	}
+
+	kernelPrintDbg (debug::DBG_INFO, "Indexed " << updated << " of " << count << " pages.");
+	return updated;
+}
+
+//
+//
+//
+void
+TextIndex::updatePage (const CPdf& pdf, size_t pos)
+{
+	_key (pdf);
+	shared_ptr<CPage> page = pdf.getPage (pos);
+	_index (pos, *page, page_fingerprint (*page));
+}
+
+//
+//
+//
+void
+TextIndex::_index (size_t pos, const CPage& page, const Fingerprint& fingerprint)
+{
+#if TEXTOUT_WORD_LIST
+	_remove (pos);
+	Page& indexed = _pages[pos];
+	indexed.fingerprint = fingerprint;
+
+	shared_ptr<TextPage> text = page.getTextPage ();
+	scoped_ptr<TextWordList> list (text->makeWordList (gFalse));
+	for (int i = 0; i < list->getLength(); ++i)
+	{
+		const TextWord* word = list->get (i);
+		const int len = word->getLength ();
+		
+		// Split the word on separators, bounding box of each part is the
+		// union of its character bounding boxes
+		string key;
+		double xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+		for (int j = 0; j <= len; ++j)
+		{
+			if (j == len || is_separator (word->getChar (j)))
+			{
+				if (key.empty())
+					continue;
+				Rectangles& rcs = _words[key][pos];
+				if (rcs.empty())
+					indexed.words.push_back (key);
+				rcs.push_back (libs::Rectangle (xMin, yMin, xMax, yMax));
+				key.clear ();
+				continue;
+			}
+
+			double x0, y0, x1, y1;
+			word->getCharBBox (j, &x0, &y0, &x1, &y1);
+			if (key.empty())
+				{ xMin = min (x0, x1); yMin = min (y0, y1); xMax = max (x0, x1); yMax = max (y0, y1); }
+			else
+				{ xMin = min (xMin, min (x0, x1)); yMin = min (yMin, min (y0, y1)); 
+				  xMax = max (xMax, max (x0, x1)); yMax = max (yMax, max (y0, y1)); }
+			append_utf8 (key, unicodeToUpper (word->getChar (j)));
+		}
+	}
+#else
+	kernelPrintDbg (debug::DBG_ERR, "Xpdf built without word lists.");
+	throw NotImplementedException ("text word lists");
+#endif
+}
+
+//
+//
+//
+void
+TextIndex::_remove (size_t pos)
+{
+	Pages::iterator it = _pages.find (pos);
+	if (it == _pages.end())
+		return;
+
+	const vector<string>& words = it->second.words;
+	for (vector<string>::const_iterator w = words.begin(); w != words.end(); ++w)
+	{
+		Words::iterator itw = _words.find (*w);
+			assert (itw != _words.end());
+		itw->second.erase (pos);
+		if (itw->second.empty())
+			_words.erase (itw);
+	}
+	_pages.erase (it);
+}
+
+//
+//
+//
+void
+TextIndex::_key (const CPdf& pdf)
+{
+	string id = document_id (pdf);
+	if (id != _id)
+	{
+		_words.clear ();
+		_pages.clear ();
+		_id = id;
+	}
+	_revision = pdf.getActualRevision ();
+}
+
+//
+//
+//
+size_t
+TextIndex::find (const std::string& text, Hits& hits) const
+{
+	vector<Unicode> utext;
+	decode_utf8 (text, utext);
+	vector<string> keys;
+	split_words (utext, keys);
+
+	// Occurences of all words
+	vector<const Postings*> postings;
+	for (vector<string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+	{
+		Words::const_iterator itw = _words.find (*it);
+		if (itw == _words.end())
+			return 0;
+		postings.push_back (&itw->second);
+	}
+	if (postings.empty())
+		return 0;
+
+	// Pages containing all words
+	size_t found = 0;
+	for (Postings::const_iterator it = postings.front()->begin(); it != postings.front()->end(); ++it)
+	{
+		size_t pos = it->first;
+		bool all = true;
+		for (size_t i = 1; all && i < postings.size(); ++i)
+			all = (postings[i]->end() != postings[i]->find (pos));
+		if (!all)
+			continue;
+
+		for (size_t i = 0; i < postings.size(); ++i)
+		{
+			const Rectangles& rcs = postings[i]->find (pos)->second;
+			for (Rectangles::const_iterator rc = rcs.begin(); rc != rcs.end(); ++rc)
+				hits.push_back (Hit (pos, *rc));
+			found += rcs.size();
+		}
+	}
+	return found;
+}
+
+//
+//
+//
+bool
+TextIndex::load (const std::string& file, const CPdf& pdf)
+{
+	_words.clear ();
+	_pages.clear ();
+	_id.clear ();
+	_revision = 0;
+
+	ifstream in (file.c_str());
+	if (!in)
+		return false;
+
+	// Header, document identifier and revision
+	string line, tag, id;
+	if (!getline (in, line) || INDEX_HEADER != line)
+		return false;
+	if (!getline (in, line))
+		return false;
+	istringstream idline (line);
+	idline >> tag >> id;
+	if ("id" != tag)
+		return false;
+	// Document without identifier can't be told from other documents
+	if (id.empty() || document_id (pdf) != id)
+	{
+		kernelPrintDbg (debug::DBG_INFO, "Index " << file << " belongs to other document.");
+		return false;
+	}
+	size_t revision = 0;
+	if (!(in >> tag >> revision) || "revision" != tag)
+		return false;
+	// Index of a newer revision doesn't describe the actual one (older
+	// revision is selected or the file was replaced by an older version)
+	if (revision > pdf.getActualRevision ())
+	{
+		kernelPrintDbg (debug::DBG_INFO, "Index " << file << " belongs to newer revision " << revision);
+		return false;
+	}
+
+	// Pages and their words
+	bool ok = true;
+	while (ok && (in >> tag))
+	{
+		size_t pos, count;
+		Fingerprint fingerprint;
+		ok = ("page" == tag) && !(in >> pos >> fingerprint.crc >> fingerprint.length >> count).fail() 
+				&& 0 < pos && !_pages.count (pos);
+		if (!ok)
+			break;
+		Page& indexed = _pages[pos];
+		indexed.fingerprint = fingerprint;
+
+		for (size_t i = 0; ok && i < count; ++i)
+		{
+			string word;
+			size_t rccount;
+			ok = !(in >> word >> rccount).fail();
+			if (!ok)
+				break;
+			Rectangles& rcs = _words[word][pos];
+			indexed.words.push_back (word);
+			for (size_t j = 0; ok && j < rccount; ++j)
+			{
+				libs::Rectangle rc;
+				ok = !(in >> rc.xleft >> rc.yleft >> rc.xright >> rc.yright).fail();
+				rcs.push_back (rc);
+			}
+		}
+	}
+	if (!ok || !in.eof())
+	{
+		kernelPrintDbg (debug::DBG_WARN, "Index " << file << " is corrupted.");
+		_words.clear ();
+		_pages.clear ();
+		return false;
+	}
+
+	_id = id;
+	_revision = revision;
+	return true;
+}
+
+//
+//
+//
+void
+TextIndex::save (const std::string& file) const
+{
+	ofstream out (file.c_str());
+	if (!out)
+	{
+		kernelPrintDbg (debug::DBG_ERR, "Unable to write index " << file);
+		throw PdfException ();
+	}
+
+	out << INDEX_HEADER << "\n";
+	out << "id " << _id << "\n";
+	out << "revision " << _revision << "\n";
+	out << setprecision (10);
+	for (Pages::const_iterator it = _pages.begin(); it != _pages.end(); ++it)
+	{
+		const vector<string>& words = it->second.words;
+		const Fingerprint& fp = it->second.fingerprint;
+		out << "page " << it->first << " " << fp.crc << " " << fp.length << " " << words.size() << "\n";
+		for (vector<string>::const_iterator w = words.begin(); w != words.end(); ++w)
+		{
+			const Rectangles& rcs = _words.find (*w)->second.find (it->first)->second;
+			out << *w << " " << rcs.size();
+			for (Rectangles::const_iterator rc = rcs.begin(); rc != rcs.end(); ++rc)
+				out << " " << rc->xleft << " " << rc->yleft << " " << rc->xright << " " << rc->yright;
+			out << "\n";
+		}
+	}
+
+	out.flush ();
+	if (!out)
+	{
+		kernelPrintDbg (debug::DBG_ERR, "Unable to write index " << file);
+		throw PdfException ();
+	}
+}
+
+//==========================================================
+} // namespace pdfobjects
+//==========================================================
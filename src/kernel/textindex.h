@@ -0,0 +1,214 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _TEXTINDEX_H_
+#define _TEXTINDEX_H_
+
+// static includes
+#include "kernel/static.h"
+
+
+//==========================================================
+namespace pdfobjects {
+//==========================================================
+
+// Forward declaration
+class CPdf;
+class CPage;
+
+
+//==========================================================
+// TextIndex
+//==========================================================
+
+/**
+ * Full-text index of a document.
+ *
+ * Maps words of all pages to their occurences (page position and bounding
+ * box in the same coordinates as CPage::findText returns). Words are taken
+ * from xpdf text page word lists, they are split on non alphanumeric
+ * characters and compared case insensitively.
+ *
+ * Every indexed page keeps a fingerprint (CRC32 and length) of its page
+ * dictionary reference, content stream data, resources and XObject streams
+ * (including those used by forms). update() indexes only pages which were
+ * not indexed or whose fingerprint differs, so an index loaded from a
+ * sidecar file of an older revision is refreshed incrementally. 
+ * <br>
+ * Only find() is fast. update() still has to decode all content and XObject
+ * streams of the document to compute fingerprints, so it costs about as
+ * much as reading the whole document (but much less than extracting its
+ * text). When a page is known to be changed (e.g. from page observers)
+ * updatePage() can be used directly.
+ *
+ * <pre>
+ * TextIndex index;
+ * string file = TextIndex::getFileName (pdffile);
+ * if (!index.load (file, *pdf) || index.update (*pdf))
+ *   index.save (file);
+ * index.find ("word", hits);
+ * </pre>
+ */
+class TextIndex
+{
+	// typedefs
+public:
+	/** Occurence of a word. */
+	struct Hit
+	{
+		size_t page;			/**< Page position. */
+		libs::Rectangle rc;		/**< Bounding box of the word. */
+		Hit (size_t p, const libs::Rectangle& r) : page (p), rc (r) {}
+	};
+	typedef std::vector<Hit> Hits;
+	/** Fingerprint of page data. */
+	struct Fingerprint
+	{
+		unsigned long crc;		/**< CRC32 of the data. */
+		size_t length;			/**< Length of the data. */
+		Fingerprint () : crc (0), length (0) {}
+		bool operator== (const Fingerprint& fp) const
+			{ return crc == fp.crc && length == fp.length; }
+	};
+
+private:
+	typedef std::vector<libs::Rectangle> Rectangles;
+	/** Occurences of a word on pages. */
+	typedef std::map<size_t, Rectangles> Postings;
+	typedef std::map<std::string, Postings> Words;
+	/** Indexed page. */
+	struct Page
+	{
+		Fingerprint fingerprint;			/**< Page fingerprint. */
+		std::vector<std::string> words;		/**< Distinct words of the page. */
+	};
+	typedef std::map<size_t, Page> Pages;
+
+	// variables
+private:
+	std::string _id;		/**< Document identifier. */
+	size_t _revision;		/**< Revision of the document. */
+	Words _words;			/**< Inverted index. */
+	Pages _pages;			/**< Indexed pages. */
+
+	// ctor & dtor
+public:
+	/** Ctor. Creates empty index. */
+	TextIndex () : _revision (0) {}
+
+	//
+	// Methods
+	//
+public:
+	/**
+	 * Indexes all pages of a document which are not indexed or which changed.
+	 * Pages beyond the page count of the document are removed.
+	 *
+	 * @param pdf Document.
+	 * @return Number of (re)indexed pages.
+	 */
+	size_t update (const CPdf& pdf);
+
+	/**
+	 * Reindexes one page.
+	 *
+	 * @param pdf Document.
+	 * @param pos Page position.
+	 */
+	void updatePage (const CPdf& pdf, size_t pos);
+
+	/**
+	 * Finds all occurences of words.
+	 *
+	 * If more words are given, occurences of all of them are returned but
+	 * only on pages containing each of them. Hits are ordered by pages.
+	 *
+	 * @param text Word or words (utf-8).
+	 * @param hits Output container of occurences.
+	 *
+	 * @return Number of occurences found.
+	 */
+	size_t find (const std::string& text, Hits& hits) const;
+
+	/**
+	 * Get count of indexed pages.
+	 */
+	size_t getPageCount () const
+		{ return _pages.size(); }
+
+	/**
+	 * Loads index from a file.
+	 *
+	 * Index is accepted only if it belongs to the same document (document
+	 * identifiers are equal, documents without identifier are never
+	 * accepted) and it was not created for a newer revision than the
+	 * actual one. Pages changed in newer revisions are reindexed by
+	 * update().
+	 *
+	 * @param file Index file name.
+	 * @param pdf Document.
+	 *
+	 * @return true if index was loaded, false if the file does not exist, is
+	 * not valid or belongs to other document or revision (index is empty
+	 * then).
+	 */
+	bool load (const std::string& file, const CPdf& pdf);
+
+	/**
+	 * Saves index to a file.
+	 *
+	 * @param file Index file name.
+	 * @throw PdfException if the file cannot be written.
+	 */
+	void save (const std::string& file) const;
+
+	/**
+	 * Get name of sidecar index file of a document.
+	 *
+	 * @param pdffile Document file name.
+	 */
+	static std::string getFileName (const std::string& pdffile)
+		{ return pdffile + ".idx"; }
+
+	//
+	// Helper methods
+	//
+private:
+	/** Indexes words of a page. */
+	void _index (size_t pos, const CPage& page, const Fingerprint& fingerprint);
+	/** Removes all occurences of words of a page. */
+	void _remove (size_t pos);
+	/** Sets key of the index to the document. */
+	void _key (const CPdf& pdf);
+
+}; // class TextIndex
+
+
+//==========================================================
+} // namespace pdfobjects
+//==========================================================
+
+
+#endif // _TEXTINDEX_H_
@@ -328,7 +328,25 @@ XmlOutputBuilder::build (PageColumnIterator it_s, PageColumnIterator it_e)
 string
 XmlOutputBuilder::xml (const XmlOutputBuilder& out)
 {
-	return XML_GENERAL::header + out.str() + XML_GENERAL::footer;
+	return xml_header () + out.str() + xml_footer ();
+}
+
+//
+//
+//
+string
+XmlOutputBuilder::xml_header ()
+{
+	return XML_GENERAL::header;
+}
+
+//
+//
+//
+string
+XmlOutputBuilder::xml_footer ()
+{
+	return XML_GENERAL::footer;
 }
 
 //=====================================================================================
@@ -138,6 +138,13 @@ public:
 public:	
 	/** Get xml output. */
 	static std::string xml (const XmlOutputBuilder& out);
+
+	/** 
+	 * Get xml header and footer. Output of several builders put between
+	 * them is a valid xml output (e.g. when pages are converted separately).
+	 */
+	static std::string xml_header ();
+	static std::string xml_footer ();
 };
 
 
@@ -285,7 +285,6 @@ namespace {
 void
 SimpleWordEngine::operator() (const PdfOperatorPtr op, const GfxState& gfx_state)
 {
-	static PageSimpleFragmentPtr sfrag (PageSimpleFragmentPtr(new PageSimpleFragment));
 	assert (op);
 
 	//
@@ -68,6 +68,13 @@ protected:
 	PageSimpleFragments sfrags;	/**< List of all simple fragments on a page. */
 	PageFragments frags;		/**< List of all fragments on a page. */
 	GfxResourcePtr res;			/**< Resources containing fonts, etc. */
+	PageSimpleFragmentPtr sfrag;	/**< Simple fragment being collected. */
+
+	//
+	// Ctor
+	//
+public:
+	SimpleWordEngine () : sfrag (new PageSimpleFragment) {}
 
 	//
 	// Page source functor
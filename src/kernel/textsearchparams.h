@@ -77,6 +77,29 @@ typedef struct TextSearchParams
 } TextSearchParams;
 
 
+/**
+ * Receiver of occurrences found by a document text search.
+ *
+ * @see CPdf::findText
+ */
+class ITextSearchCallback
+{
+public:
+	/** 
+	 * Text found on a page. 
+	 *
+	 * @param pos Page position.
+	 * @param rc Bounding box of the occurrence.
+	 *
+	 * @return False to stop the search.
+	 */
+	virtual bool found (size_t pos, const libs::Rectangle& rc) = 0;
+
+	/** Destructor. */
+	virtual ~ITextSearchCallback () {}
+};
+
+
 //=====================================================================================
 } // namespace pdfobjects
 //=====================================================================================
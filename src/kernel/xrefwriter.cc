@@ -512,6 +512,9 @@ void XRefWriter::saveChanges(bool newRevision)
 		// object itself to writer which is allowed to alter object
 		changed.push_back(IPdfWriter::ObjectElement(ref, obj->clone()));
 	}
+	const char * requiredVersion=pdfWriter->getRequiredVersion();
+	if(requiredVersion)
+		requireCatalogVersion(changed, requiredVersion);
 
 	// delegates writing to pdfWriter using streamWriter stream from storePos
 	// position and frees all clones from changed storage.
@@ -521,10 +524,12 @@ void XRefWriter::saveChanges(bool newRevision)
 		xpdf::freeXpdfObject(o);
 	}
 
-	// Stores position of the cross reference section to xrefPos
-	size_t xrefPos=streamWriter->getPos();
+	// Stores position of the cross reference section to xrefPos. We can't
+	// rely on the current stream position, because pdfWriter may write also
+	// some objects (e.g. object streams) before cross reference section
 	IPdfWriter::PrevSecInfo secInfo={lastXRefPos, XRef::maxObj+1};
 	size_t newEofPos=pdfWriter->writeTrailer(*getTrailerDict(), secInfo, *streamWriter);
+	size_t xrefPos=pdfWriter->getLastXRefPos();
 
 	// if new revision should be created, moves storePos behind stored content
 	// (more preciselly before pdf end of file marker %%EOF) and forces CXref 
@@ -550,6 +555,74 @@ void XRefWriter::saveChanges(bool newRevision)
 	kernelPrintDbg(DBG_DBG, "finished");
 }
 
+void XRefWriter::requireCatalogVersion(utils::IPdfWriter::ObjectList & changed, const char * version)const
+{
+	using namespace utils;
+
+	// simple string comparison is enough for 1.x versions
+	const char * headerVersion=getPDFVersion();
+	if(headerVersion && strcmp(headerVersion, version)>=0)
+		return;
+
+	boost::shared_ptr< ::Object> rootRef(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	getTrailerDict()->dictLookupNF("Root", rootRef.get());
+	if(!rootRef->isRef())
+	{
+		kernelPrintDbg(DBG_ERR, "Trailer::Root is not a reference. Unable to set catalog Version.");
+		return;
+	}
+	::Ref ref=rootRef->getRef();
+
+	// uses catalog from the changed list if it is there, otherwise
+	// the current one is added
+	::Object * catalog=NULL;
+	for(IPdfWriter::ObjectList::iterator i=changed.begin(); i!=changed.end(); ++i)
+		if(i->first.num==ref.num && i->first.gen==ref.gen)
+		{
+			catalog=i->second;
+			break;
+		}
+	bool add=false;
+	if(!catalog)
+	{
+		boost::shared_ptr< ::Object> current(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+		fetch(ref.num, ref.gen, current.get());
+		catalog=current->clone();
+		add=true;
+	}
+	if(!catalog || !catalog->isDict())
+	{
+		kernelPrintDbg(DBG_ERR, "Catalog "<<ref<<" is not a dictionary. Unable to set catalog Version.");
+		if(add && catalog)
+			xpdf::freeXpdfObject(catalog);
+		return;
+	}
+
+	boost::shared_ptr< ::Object> catalogVersion(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	catalog->dictLookupNF("Version", catalogVersion.get());
+	if(catalogVersion->isName() && strcmp(catalogVersion->getName(), version)>=0)
+	{
+		if(add)
+			xpdf::freeXpdfObject(catalog);
+		return;
+	}
+
+	kernelPrintDbg(DBG_INFO, "Setting catalog Version to "<<version<<" (header version is "
+			<<(headerVersion?headerVersion:"unknown")<<")");
+	::Object value;
+	value.initName(version);
+	char * key=copyString("Version");
+	::Object * original=catalog->dictUpdate(key, &value);
+	if(original)
+	{
+		// key is not stored when the value is replaced
+		gfree(key);
+		xpdf::freeXpdfObject(original);
+	}
+	if(add)
+		changed.push_back(IPdfWriter::ObjectElement(ref, catalog));
+}
+
 #define ERR_OFFSET (size_t)(-1UL)
 #define isERR_OFFSET(value) (value == ERR_OFFSET)
 
@@ -756,8 +829,12 @@ void XRefWriter::collectRevisions()
 			break;
 		
 		hybrid_xref = false;
+		// XRefStm makes sense only in the xref table trailer (trailer
+		// is a stream for xref stream sections)
 		Object stm;
-		trailer->dictLookupNF("XRefStm", &stm);
+		stm.initNull();
+		if(trailer->isDict())
+			trailer->dictLookupNF("XRefStm", &stm);
 		if (stm.isInt())
 		{
 			kernelPrintDbg(DBG_INFO, "Document contains hybrid-file XREF.");
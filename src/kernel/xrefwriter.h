@@ -123,10 +123,10 @@ private:
 	
 	/** Actual revision.
 	 *
-	 * Latest revision is represented by 0 and each older one has bigger
-	 * number.
+	 * The oldest revision is represented by 0 and each newer one has bigger
+	 * number (see utils::isLatestRevision).
 	 * <br>
-	 * Instance is created in 0 revision number and this can be changed by
+	 * Instance is created in the latest revision and this can be changed by
 	 * changeRevision method.
 	 */
 	unsigned revision;
@@ -134,8 +134,8 @@ private:
 	/** Type for revision storage.
 	 *
 	 * Each element stands for revision with number same as index in array.
-	 * The newest revision is first element (with index 0). Value stored in
-	 * array is stream offset where xref section for such revision starts.
+	 * The newest revision is the last element. Value stored in array is
+	 * stream offset where xref section for such revision starts.
 	 */
 	typedef std::vector<size_t> RevisionStorage;
 
@@ -248,6 +248,19 @@ protected:
 	 */
 	size_t getRevisionEnd(size_t xrefStart)const;
 
+	/** Makes sure that the catalog declares at least given PDF version.
+	 * @param changed List of objects which will be written.
+	 * @param version Required PDF version.
+	 *
+	 * Incremental update can't change the file header, so the catalog
+	 * Version entry is used instead (see PDF specification 3.6.1). Does
+	 * nothing if the header or the catalog Version entry is already high
+	 * enough. Otherwise sets the Version entry of the catalog from the 
+	 * changed list or adds a changed clone of the current catalog to the
+	 * list.
+	 */
+	void requireCatalogVersion(utils::IPdfWriter::ObjectList & changed, const char * version)const;
+
 public:
 	/** Initialize constructor with file stream writer.
 	 * @param stream File stream with pdf content.
@@ -334,7 +347,7 @@ public:
 	 * @param gen Generation number of object.
 	 * @param obj Instance of object.
 	 *
-	 * If revision is 0 (most recent), delegates to the to the 
+	 * If the current revision is the most recent one, delegates to the 
 	 * CXref::changeObject method. Otherwise deny to make chage, because
 	 * it is not possible to do changes to a older release.
 	 * <br>
@@ -354,7 +367,7 @@ public:
 	 * @param name Name of the entry.
 	 * @param value New value.
 	 *
-	 * If revision is 0 (most recent), delegates to the 
+	 * If the current revision is the most recent one, delegates to the 
 	 * CXref::changeTrailer method. Otherwise deny to make chage, because
 	 * it is not possible to do changes to an older release.	 
 	 * <br>
@@ -382,6 +395,10 @@ public:
 	 * Also append new xref table for changed objects and finally new trailer is
 	 * added. Trailer's Prev field is set to contain file offset to previous
 	 * xref position.
+	 * <br>
+	 * If pdfWriter requires newer PDF version than the document header 
+	 * declares (e.g. XRefStreamPdfWriter), the catalog is written with
+	 * updated Version entry (see requireCatalogVersion).
 	 * <p>
 	 * <b>Revision handling</b>:
 	 * <br>
@@ -592,7 +609,7 @@ public:
 	
 	/** Returns number of indirect objects.
 	 *
-	 * If revision is 0 (the newest revision) delegates to the 
+	 * If the current revision is the newest one delegates to the 
 	 * CXref::getNumObjects (because new object may have been created),
 	 * otherwise delegates to XRef::getNumObjects.
 	 * 
@@ -600,7 +617,7 @@ public:
 	 */
 	virtual int getNumObjects()const 
 	{ 
-		if(!revision)
+		if(utils::isLatestRevision(*this))
 			return CXref::getNumObjects();
 
 		return XRef::getNumObjects();
@@ -55,7 +55,7 @@ void bench_getIndirectProperty(shared_ptr<CPdf> pdf,
 		if(state == UNUSED_REF)
 		{
 			if(result_unknown)
-				update_result(time_diff(start, end), *result_unknown);
+				update_result(start, end, *result_unknown);
 			++not_present;
 		}
 		else
@@ -65,7 +65,7 @@ void bench_getIndirectProperty(shared_ptr<CPdf> pdf,
 			// be present
 			assert(state == INITIALIZED_REF);
 			if(result_known)
-				update_result(time_diff(start, end), *result_known);
+				update_result(start, end, *result_known);
 			--total;
 		}
 	}
@@ -80,7 +80,7 @@ void bench_getIndirectProperty(shared_ptr<CPdf> pdf,
 		get_time_stamp(&end);
 		assert(state == UNUSED_REF);
 		if(result_unknown)
-			update_result(time_diff(start, end), *result_unknown);
+			update_result(start, end, *result_unknown);
 	}
 }
 
@@ -124,7 +124,7 @@ void bench_changeIndirectObject(shared_ptr<CPdf> pdf, struct result *result, int
 		pdf->changeIndirectProperty(changed_obj);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 	}
 }
 struct PagePosition
@@ -168,7 +168,7 @@ void bench_insertPage(shared_ptr<CPdf> pdf, shared_ptr<CPdf> original_pdf,
 		pdf->insertPage(page, pos);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 	}
 }
 
@@ -197,7 +197,7 @@ void bench_removePage(shared_ptr<CPdf> pdf, shared_ptr<CPdf> copy_pdf,
 		pdf->removePage(pos);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 	}
 }
 
@@ -211,7 +211,7 @@ void bench_fwd_iter(shared_ptr<CPdf> pdf, struct result * result)
 	page = pdf->getFirstPage();
 	get_time_stamp(&end);
 	if(result)
-		update_result(time_diff(start, end), *result);
+		update_result(start, end, *result);
 
 	get_time_stamp(&start);
 	while(pdf->hasNextPage(page))
@@ -219,7 +219,7 @@ void bench_fwd_iter(shared_ptr<CPdf> pdf, struct result * result)
 		page = pdf->getNextPage(page);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 		get_time_stamp(&start);
 	}
 	// we don't use last unsuccessfull hasNextPage
@@ -235,7 +235,7 @@ void bench_bwd_iter(shared_ptr<CPdf> pdf, struct result * result)
 	page = pdf->getLastPage();
 	get_time_stamp(&end);
 	if(result)
-		update_result(time_diff(start, end), *result);
+		update_result(start, end, *result);
 
 	get_time_stamp(&start);
 	while(pdf->hasPrevPage(page))
@@ -243,7 +243,7 @@ void bench_bwd_iter(shared_ptr<CPdf> pdf, struct result * result)
 		page = pdf->getPrevPage(page);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 		get_time_stamp(&start);
 	}
 
@@ -281,7 +281,7 @@ void bench_addIndirectProperty(shared_ptr<CPdf> pdf, shared_ptr<CPdf> helper_pdf
 		pdf->addIndirectProperty(d, follow_refs);
 		get_time_stamp(&end);
 		if (result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 	}
 }
 
@@ -294,7 +294,7 @@ void bench_changeRevision(shared_ptr<CPdf> pdf, struct result * result)
 		pdf->changeRevision(i);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 	}
 }
 
@@ -311,108 +311,112 @@ int main(int argc, char **argv)
 	shared_ptr<CPdf> pdf;
 
 	DEFINE_RESULTS(getInstance, "getInstance");
-	get_time_stamp(&start);
-	pdf = open_file(file_name);
-	get_time_stamp(&end);
-	update_result(time_diff(start, end), getInstance);
-
-	// get all indirect properties and check also those which 
-	// are not present
 	DEFINE_RESULTS(getIndirectProperty_known_no_changes1,"getIndirectProperty_known_no_changed_first");
 	DEFINE_RESULTS(getIndirectProperty_unknown_no_changes1,"getIndirectProperty_unknown_no_changed_first");
-	bench_getIndirectProperty(pdf,
-			&getIndirectProperty_known_no_changes1, 
-			&getIndirectProperty_unknown_no_changes1);
-
-	// repeat again on the same instance - this test can
-	// show big internal caching performance grow, because all
-	// indirect properties are cached so that repeated getIndirectProperty
-	// with the same indirect number has to return the same object
-	// (if a reference to it still exists)
 	DEFINE_RESULTS(getIndirectProperty_known_no_changes2,"getIndirectProperty_known_no_changed_again");
 	DEFINE_RESULTS(getIndirectProperty_unknown_no_changes2,"getIndirectProperty_unknown_no_changed_again");
-	bench_getIndirectProperty(pdf,
-			&getIndirectProperty_known_no_changes2, 
-			&getIndirectProperty_unknown_no_changes2);
-
-	// changeIndirectProperty to all properties - we simply create
-	// deep copy and call changeIndirectProperty
-	pdf = open_file(file_name);
 	DEFINE_RESULTS(changeIndirectProperty_all1,"changeIndirectProperty_all_first");
-	bench_changeIndirectObject(pdf, &changeIndirectProperty_all1, 100);
-	
-	// get all indirect objects after they have been changed
 	DEFINE_RESULTS(getIndirectProperty_known_all_changes,"getIndirectProperty_known_all_changed");
 	DEFINE_RESULTS(getIndirectProperty_unknown_all_changes,"getIndirectProperty_unknown_all_changed");
-	bench_getIndirectProperty(pdf,
-			&getIndirectProperty_known_all_changes, 
-			&getIndirectProperty_unknown_all_changes);
-
-	// we already maintain all changed object without xpdf code so
-	// we should measure only our performance here
 	DEFINE_RESULTS(changeIndirectProperty_all2,"changeIndirectProperty_all_again");
-	bench_changeIndirectObject(pdf, &changeIndirectProperty_all2, 100);
-	
-	// addIndirectProperty to all page dictionaries from different pdf
-	// instance - follows also referencies
-	shared_ptr<CPdf> helper_pdf = open_file(file_name);
-	pdf = open_file(file_name);
 	DEFINE_RESULTS(addIndirectProperty_different_pdf_follow, "addIndirectProperty_different_pdf_followref");
-	bench_addIndirectProperty(pdf, helper_pdf, &addIndirectProperty_different_pdf_follow, true);
-	// no follow refs case
-	pdf = open_file(file_name);
 	DEFINE_RESULTS(addIndirectProperty_different_pdf_nofollow, "addIndirectProperty_different_pdf_nofollowref");
-	bench_addIndirectProperty(pdf, helper_pdf, &addIndirectProperty_different_pdf_nofollow, false);
-	helper_pdf.reset();
-	
-	// getPageCount
 	DEFINE_RESULTS(getPageCount, "getPageCount");
-	pdf = open_file(file_name);
-	get_time_stamp(&start);
-	pdf->getPageCount();
-	get_time_stamp(&end);
-	update_result(time_diff(start, end), getPageCount);
-
-	// page iteration - forward + hasNextPage
-	// 		  - backward + hasPrevPage
-	// 		  - first/last
 	DEFINE_RESULTS(page_fwd_iteration, "page_forward_iteration");
 	DEFINE_RESULTS(page_bwd_iteration, "page_backward_iteration");
-	pdf = open_file(file_name);
-	bench_fwd_iter(pdf, &page_fwd_iteration);
-	pdf = open_file(file_name);
-	bench_bwd_iter(pdf, &page_bwd_iteration);
-
-	// TODO getPagePosition
-	
-	// insertPage - same document opened in different CPdf all pages
-	// are inserted to the back and front
-	pdf = open_file(file_name);
-	shared_ptr<CPdf> copy_pdf = open_file(file_name);
 	DEFINE_RESULTS(insertPage_all_end, "insertPage_all_end");
-	bench_insertPage(pdf, copy_pdf, &insertPage_all_end, PagePosition(PagePosition::END), 100);
-
-	pdf = open_file(file_name);
-	copy_pdf = open_file(file_name);
 	DEFINE_RESULTS(insertPage_all_front, "insertPage_all_front");
-	bench_insertPage(pdf, copy_pdf, &insertPage_all_front, PagePosition(PagePosition::FRONT), 100);
-
-	// removePage from back, front
-	pdf = open_file(file_name);
 	DEFINE_RESULTS(removePage_all_end, "removePage_all_end");
-	bench_removePage(pdf, copy_pdf, 
-			&removePage_all_end, PagePosition(PagePosition::END), 100);
-
-	pdf = open_file(file_name);
 	DEFINE_RESULTS(removePage_all_front, "removePage_all_front");
-	bench_removePage(pdf, copy_pdf, 
-			&removePage_all_front, PagePosition(PagePosition::FRONT), 100);
-	copy_pdf.reset();
-
-	pdf = open_file(file_name);
 	DEFINE_RESULTS(change_revision, "change_revision");
-	bench_changeRevision(pdf, &change_revision);
-	pdf.reset();
+	for(int round = 0; round < bench_rounds(); ++round)
+	{
+		start_round(round);
+		get_time_stamp(&start);
+		pdf = open_file(file_name);
+		get_time_stamp(&end);
+		update_result(start, end, getInstance);
+
+		// get all indirect properties and check also those which 
+		// are not present
+		bench_getIndirectProperty(pdf,
+				&getIndirectProperty_known_no_changes1, 
+				&getIndirectProperty_unknown_no_changes1);
+
+		// repeat again on the same instance - this test can
+		// show big internal caching performance grow, because all
+		// indirect properties are cached so that repeated getIndirectProperty
+		// with the same indirect number has to return the same object
+		// (if a reference to it still exists)
+		bench_getIndirectProperty(pdf,
+				&getIndirectProperty_known_no_changes2, 
+				&getIndirectProperty_unknown_no_changes2);
+
+		// changeIndirectProperty to all properties - we simply create
+		// deep copy and call changeIndirectProperty
+		pdf = open_file(file_name);
+		bench_changeIndirectObject(pdf, &changeIndirectProperty_all1, 100);
+
+		// get all indirect objects after they have been changed
+		bench_getIndirectProperty(pdf,
+				&getIndirectProperty_known_all_changes, 
+				&getIndirectProperty_unknown_all_changes);
+
+		// we already maintain all changed object without xpdf code so
+		// we should measure only our performance here
+		bench_changeIndirectObject(pdf, &changeIndirectProperty_all2, 100);
+
+		// addIndirectProperty to all page dictionaries from different pdf
+		// instance - follows also referencies
+		shared_ptr<CPdf> helper_pdf = open_file(file_name);
+		pdf = open_file(file_name);
+		bench_addIndirectProperty(pdf, helper_pdf, &addIndirectProperty_different_pdf_follow, true);
+		// no follow refs case
+		pdf = open_file(file_name);
+		bench_addIndirectProperty(pdf, helper_pdf, &addIndirectProperty_different_pdf_nofollow, false);
+		helper_pdf.reset();
+
+		// getPageCount
+		pdf = open_file(file_name);
+		get_time_stamp(&start);
+		pdf->getPageCount();
+		get_time_stamp(&end);
+		update_result(start, end, getPageCount);
+
+		// page iteration - forward + hasNextPage
+		// 		  - backward + hasPrevPage
+		// 		  - first/last
+		pdf = open_file(file_name);
+		bench_fwd_iter(pdf, &page_fwd_iteration);
+		pdf = open_file(file_name);
+		bench_bwd_iter(pdf, &page_bwd_iteration);
+
+		// TODO getPagePosition
+
+		// insertPage - same document opened in different CPdf all pages
+		// are inserted to the back and front
+		pdf = open_file(file_name);
+		shared_ptr<CPdf> copy_pdf = open_file(file_name);
+		bench_insertPage(pdf, copy_pdf, &insertPage_all_end, PagePosition(PagePosition::END), 100);
+
+		pdf = open_file(file_name);
+		copy_pdf = open_file(file_name);
+		bench_insertPage(pdf, copy_pdf, &insertPage_all_front, PagePosition(PagePosition::FRONT), 100);
+
+		// removePage from back, front
+		pdf = open_file(file_name);
+		bench_removePage(pdf, copy_pdf, 
+				&removePage_all_end, PagePosition(PagePosition::END), 100);
+
+		pdf = open_file(file_name);
+		bench_removePage(pdf, copy_pdf, 
+				&removePage_all_front, PagePosition(PagePosition::FRONT), 100);
+		copy_pdf.reset();
+
+		pdf = open_file(file_name);
+		bench_changeRevision(pdf, &change_revision);
+		pdf.reset();
+	}
 
 	struct result *all_results [] = {
 		&getInstance,
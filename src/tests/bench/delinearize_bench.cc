@@ -37,17 +37,20 @@ int main(int argc, char **argv)
 	if((ret = init_bench(argc, argv)))
 		return ret;
 
-	boost::shared_ptr<Delinearizator> delin = Delinearizator::getInstance(file_name, new OldStylePdfWriter());
-
-	// check for existing file and remove it
+	// output file is truncated by each round
 	std::string output_file = file_name+std::string("-delinearized.pdf");
 	time_stamp_t start, end;
 	DEFINE_RESULTS(delinearize, "delinearize");
 
-	get_time_stamp(&start);
-	delin->delinearize(output_file.c_str());
-	get_time_stamp(&end);
-	update_result(time_diff(start, end), delinearize);
+	for(int round = 0; round < bench_rounds(); ++round)
+	{
+		start_round(round);
+		boost::shared_ptr<Delinearizator> delin = Delinearizator::getInstance(file_name, new OldStylePdfWriter());
+		get_time_stamp(&start);
+		delin->delinearize(output_file.c_str());
+		get_time_stamp(&end);
+		update_result(start, end, delinearize);
+	}
 	struct result *all_results [] = {
 		&delinearize,
 		NULL
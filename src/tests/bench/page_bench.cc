@@ -0,0 +1,119 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <kernel/static.h>
+#include <kernel/cpdf.h>
+#include <kernel/cpage.h>
+#include <kernel/pdfedit-core-dev.h>
+#include <xpdf/SplashOutputDev.h>
+#include "utils.h"
+
+using namespace boost;
+using namespace pdfobjects;
+using namespace std;
+
+// renders all pages of the document with the splash output device
+void bench_displayPage(shared_ptr<CPdf> pdf, struct result *result)
+{
+	SplashColor paperColor;
+	paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+	SplashOutputDev splash(splashModeRGB8, 4, gFalse, paperColor);
+	splash.startDoc(pdf->getCXref());
+	DisplayParams params;
+	time_stamp_t start, end;
+	size_t count = pdf->getPageCount();
+	for(size_t pos = 1; pos <= count; ++pos)
+	{
+		shared_ptr<CPage> page = pdf->getPage(pos);
+		get_time_stamp(&start);
+		page->displayPage(splash, params);
+		get_time_stamp(&end);
+		if(result)
+			update_result(start, end, *result);
+	}
+}
+
+// extracts text from all pages of the document
+void bench_getText(shared_ptr<CPdf> pdf, struct result *result)
+{
+	time_stamp_t start, end;
+	size_t count = pdf->getPageCount();
+	for(size_t pos = 1; pos <= count; ++pos)
+	{
+		shared_ptr<CPage> page = pdf->getPage(pos);
+		string text;
+		get_time_stamp(&start);
+		page->getText(text);
+		get_time_stamp(&end);
+		if(result)
+			update_result(start, end, *result);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	if((ret = init_bench(argc, argv)))
+		return ret;
+	time_stamp_t start, end;
+	shared_ptr<CPdf> pdf;
+
+	DEFINE_RESULTS(getInstance, "getInstance");
+	DEFINE_RESULTS(displayPage_first, "displayPage_first");
+	DEFINE_RESULTS(displayPage_again, "displayPage_again");
+	DEFINE_RESULTS(getText_first, "getText_first");
+	DEFINE_RESULTS(getText_again, "getText_again");
+	for(int round = 0; round < bench_rounds(); ++round)
+	{
+		start_round(round);
+		get_time_stamp(&start);
+		pdf = open_file(file_name, CPdf::ReadOnly);
+		get_time_stamp(&end);
+		update_result(start, end, getInstance);
+
+		// the first pass has to parse content streams and fonts, the 
+		// second one shows how much is reused by the same instance
+		bench_displayPage(pdf, &displayPage_first);
+		bench_displayPage(pdf, &displayPage_again);
+
+		pdf = open_file(file_name, CPdf::ReadOnly);
+		bench_getText(pdf, &getText_first);
+		bench_getText(pdf, &getText_again);
+		pdf.reset();
+	}
+
+	struct result *all_results [] = {
+		&getInstance,
+		&displayPage_first,
+		&displayPage_again,
+		&getText_first,
+		&getText_again,
+		NULL
+	};
+	print_results(stdout, all_results);
+
+	fprintf(stdout, "\n---\n");
+	gMemReport(stdout);
+	return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <kernel/static.h>
+#include <kernel/cpdf.h>
+#include <kernel/cpage.h>
+#include <kernel/cxref.h>
+#include <kernel/pdfedit-core-dev.h>
+#include "utils.h"
+
+using namespace boost;
+using namespace pdfobjects;
+using namespace std;
+
+// copies src file to dst file
+int copy_file(const char *src, const char *dst)
+{
+	FILE *in = fopen(src, "rb");
+	if(!in)
+		return -1;
+	FILE *out = fopen(dst, "wb");
+	if(!out)
+	{
+		fclose(in);
+		return -1;
+	}
+	char buffer[BUFSIZ];
+	size_t len;
+	while((len = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		fwrite(buffer, 1, len, out);
+	fclose(in);
+	return fclose(out);
+}
+
+// stores document content to the temporary file
+void bench_clone(shared_ptr<CPdf> pdf, struct result *result)
+{
+	FILE *out = tmpfile();
+	if(!out)
+		return;
+	time_stamp_t start, end;
+	get_time_stamp(&start);
+	pdf->clone(out);
+	get_time_stamp(&end);
+	fclose(out);
+	if(result)
+		update_result(start, end, *result);
+}
+
+// changes all page dictionaries and saves them
+void bench_save(shared_ptr<CPdf> pdf, struct result *result_change, 
+		struct result *result_save)
+{
+	time_stamp_t start, end;
+
+	// skip for read only documents
+	if(pdf->getMode() == CPdf::ReadOnly)
+		return;
+
+	size_t count = pdf->getPageCount();
+	get_time_stamp(&start);
+	for(size_t pos = 1; pos <= count; ++pos)
+	{
+		shared_ptr<CDict> pageDict = pdf->getPage(pos)->getDictionary();
+		shared_ptr<IProperty> changed = pageDict->clone();
+		changed->setPdf(pageDict->getPdf());
+		changed->setIndiRef(pageDict->getIndiRef());
+		pdf->changeIndirectProperty(changed);
+	}
+	get_time_stamp(&end);
+	if(result_change)
+		update_result(start, end, *result_change);
+
+	get_time_stamp(&start);
+	pdf->save(false);
+	get_time_stamp(&end);
+	if(result_save)
+		update_result(start, end, *result_save);
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	if((ret = init_bench(argc, argv)))
+		return ret;
+
+	char tmp_name[] = "/tmp/save_benchXXXXXX";
+	int fd = mkstemp(tmp_name);
+	if(fd < 0)
+	{
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+
+	DEFINE_RESULTS(clone, "clone");
+	DEFINE_RESULTS(change_pages, "changeIndirectProperty_all_pages");
+	DEFINE_RESULTS(save, "save");
+	for(int round = 0; round < bench_rounds(); ++round)
+	{
+		start_round(round);
+		shared_ptr<CPdf> pdf = open_file(file_name, CPdf::ReadOnly);
+		bench_clone(pdf, &clone);
+
+		// saving modifies the file so use a fresh copy for each round
+		if(copy_file(file_name, tmp_name))
+		{
+			perror(tmp_name);
+			break;
+		}
+		pdf = open_file(tmp_name, CPdf::ReadWrite);
+		try
+		{
+			bench_save(pdf, &change_pages, &save);
+		}catch(ReadOnlyDocumentException &e)
+		{
+			// linearized documents cannot be changed
+		}
+	}
+	unlink(tmp_name);
+
+	struct result *all_results [] = {
+		&clone,
+		&change_pages,
+		&save,
+		NULL
+	};
+	print_results(stdout, all_results);
+
+	fprintf(stdout, "\n---\n");
+	gMemReport(stdout);
+	return 0;
+}
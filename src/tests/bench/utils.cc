@@ -22,19 +22,92 @@
  * Project is hosted on http://sourceforge.net/projects/pdfedit
  */
 #include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <new>
+#include <algorithm>
+#include <sys/resource.h>
 #include <kernel/pdfedit-core-dev.h>
 #include "utils.h"
 const char *file_name;
+int bench_warmup = 0;
+int bench_repetitions = 1;
+static const char *bench_name;
+static const char *json_file;
+
+// true while warmup round is running
+static bool warmup_round = false;
+
+// number of C++ heap allocations
+static unsigned long alloc_count = 0;
+
+void * operator new(size_t size) throw(std::bad_alloc)
+{
+	++alloc_count;
+	void * ptr = malloc(size ? size : 1);
+	if(!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void * operator new[](size_t size) throw(std::bad_alloc)
+{
+	return operator new(size);
+}
+
+void operator delete(void * ptr) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void * ptr) throw()
+{
+	free(ptr);
+}
+
+static void usage(const char * name)
+{
+	std::cerr << "Usage: " << name << " [-w warmup] [-r repetitions] [-j json_file] file" << std::endl;
+	std::cerr << "\t-w number of warmup rounds (default 0)" << std::endl;
+	std::cerr << "\t-r number of measured rounds (default 1)" << std::endl;
+	std::cerr << "\t-j file to store results in JSON format" << std::endl;
+	std::cerr << "Rounds are used only by benchmarks which support them." << std::endl;
+}
+
 int parse_cmd_line(int argc, char **argv)
 {
-	if(argc<2)
+	const char * name = strrchr(argv[0], '/');
+	bench_name = (name) ? name+1 : argv[0];
+
+	int opt;
+	while((opt = getopt(argc, argv, "w:r:j:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'w':
+				bench_warmup = atoi(optarg);
+				break;
+			case 'r':
+				bench_repetitions = atoi(optarg);
+				break;
+			case 'j':
+				json_file = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(optind >= argc || bench_warmup < 0 || bench_repetitions < 1)
 	{
 		std::cerr << "Bad usage. Filename parameter expected" << std::endl;
+		usage(argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	// TODO use getopt instead and support several files
-	file_name = argv[1];
+	// TODO support several files
+	file_name = argv[optind];
 	return 0;
 }
 
@@ -48,32 +121,83 @@ int init_bench(int argc, char **argv)
 	return parse_cmd_line(argc, argv);
 }
 
+void take_time_stamp(time_stamp_t *stamp)
+{
+	clock_gettime(CLOCK_MONOTONIC, &stamp->time);
+	stamp->allocs = alloc_count;
+}
+
 // result is in miliseconds
 double time_diff(time_stamp_t &start, time_stamp_t &end)
 {
-	time_stamp_t diff;
-	diff.tv_sec = end.tv_sec - start.tv_sec;
-	diff.tv_usec = end.tv_usec - start.tv_usec;
-	if(start.tv_usec > end.tv_usec)
-	{
-		--diff.tv_sec;
-		diff.tv_usec += 1000000;
-	}
-
-	return diff.tv_sec*1000 + (double)diff.tv_usec/(double)1000;
+	return (end.time.tv_sec - start.time.tv_sec)*1000.0 
+		+ (end.time.tv_nsec - start.time.tv_nsec)/1000000.0;
 }
 
 void update_result(double time, struct result & result)
 {
+	if(warmup_round)
+		return;
 	if(time >= result.max_time)
 		result.max_time = time;
 	if (time <= result.min_time)
 		result.min_time = time;
 	result.sum_time += time;
 	++(result.count);
+	result.samples.push_back(time);
 	result.valid = true;
 }
 
+void update_result(time_stamp_t &start, time_stamp_t &end, struct result & result)
+{
+	if(warmup_round)
+		return;
+	update_result(time_diff(start, end), result);
+	result.allocs += end.allocs - start.allocs;
+}
+
+int bench_rounds()
+{
+	return bench_warmup + bench_repetitions;
+}
+
+void start_round(int round)
+{
+	warmup_round = round < bench_warmup;
+}
+
+long peak_rss()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage))
+		return -1;
+	return usage.ru_maxrss;
+}
+
+// nearest rank percentile of sorted samples
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+	if(rank < 1)
+		rank = 1;
+	return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static void json_string(FILE * out, const char * str)
+{
+	fputc('"', out);
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\')
+			fputc('\\', out);
+		if((unsigned char)*str < 0x20)
+			fprintf(out, "\\u%04x", *str);
+		else
+			fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
 void print_results(FILE * out, struct result ** results)
 {
 using namespace std;
@@ -87,9 +211,65 @@ using namespace std;
 			continue;
 		}
 		double avg = (double)curr->sum_time/(double)curr->count;
-		fprintf(out, ":max=%g:min=%g:avg=%g:count=%u\n", 
-				curr->max_time, curr->min_time, avg, curr->count);
+		vector<double> sorted(curr->samples);
+		sort(sorted.begin(), sorted.end());
+		fprintf(out, ":max=%g:min=%g:avg=%g:count=%u:p50=%g:p95=%g:p99=%g:allocs=%lu\n", 
+				curr->max_time, curr->min_time, avg, curr->count,
+				percentile(sorted, 50), percentile(sorted, 95),
+				percentile(sorted, 99), curr->allocs);
+	}
+
+	if(json_file)
+	{
+		FILE * json = fopen(json_file, "w");
+		if(!json)
+		{
+			perror(json_file);
+			return;
+		}
+		print_results_json(json, results);
+		fclose(json);
+	}
+}
+
+void print_results_json(FILE * out, struct result ** results)
+{
+using namespace std;
+	fprintf(out, "{\n\t\"bench\": ");
+	json_string(out, bench_name ? bench_name : "");
+	fprintf(out, ",\n\t\"file\": ");
+	json_string(out, file_name ? file_name : "");
+	fprintf(out, ",\n\t\"warmup\": %d,\n\t\"repetitions\": %d,\n\t\"peak_rss_kb\": %ld,\n",
+			bench_warmup, bench_repetitions, peak_rss());
+	fprintf(out, "\t\"results\": [");
+	for(struct result **iter=results; *iter; ++iter)
+	{
+		struct result * curr = *iter;
+		fprintf(out, "%s\n\t\t{\"name\": ", (iter==results) ? "" : ",");
+		json_string(out, curr->name);
+		if(!curr->valid)
+		{
+			fprintf(out, ", \"count\": 0}");
+			continue;
+		}
+		vector<double> sorted(curr->samples);
+		sort(sorted.begin(), sorted.end());
+		double mean = curr->sum_time/curr->count;
+		double var = 0;
+		for(size_t i=0; i<sorted.size(); ++i)
+			var += (sorted[i]-mean)*(sorted[i]-mean);
+		if(sorted.size() > 1)
+			var /= sorted.size() - 1;
+		fprintf(out, ", \"count\": %u, \"min\": %.6f, \"max\": %.6f, "
+				"\"mean\": %.6f, \"stddev\": %.6f, "
+				"\"p50\": %.6f, \"p95\": %.6f, \"p99\": %.6f, "
+				"\"allocs\": %lu, \"allocs_per_op\": %.2f}",
+				curr->count, curr->min_time, curr->max_time, mean, sqrt(var),
+				percentile(sorted, 50), percentile(sorted, 95), 
+				percentile(sorted, 99), curr->allocs, 
+				(double)curr->allocs/curr->count);
 	}
+	fprintf(out, "\n\t]\n}\n");
 }
 
 int getFontId(boost::shared_ptr<pdfobjects::CPage> page, const std::string &fontName, std::string &fontId)
@@ -29,19 +29,30 @@
 #include <kernel/cpage.h>
 #include <sys/time.h>
 #include <time.h>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <limits.h>
 
 extern const char * file_name;
 
+// number of warmup rounds (results are discarded) and measured rounds
+// for benchmarks which use bench_rounds/start_round
+extern int bench_warmup;
+extern int bench_repetitions;
+
 int init_bench(int argc, char **argv);
 
-// redefine if something different than gettimeofday should
-// be used for time measuring
-typedef struct timeval time_stamp_t;
+// time stamp with the monotonic clock and number of C++ heap allocations
+// done so far
+typedef struct time_stamp
+{
+	struct timespec time;
+	unsigned long allocs;
+} time_stamp_t;
+void take_time_stamp(time_stamp_t *stamp);
 double time_diff(time_stamp_t &start, time_stamp_t &end);
-// gets current time stamp - pointer to timeval struct
-#define get_time_stamp(val)	gettimeofday(val, NULL)
+// gets current time stamp - pointer to time_stamp_t struct
+#define get_time_stamp(val)	take_time_stamp(val)
 
 struct result
 {
@@ -51,13 +62,28 @@ struct result
 	unsigned count;
 	const char * name;
 	bool valid;
+	unsigned long allocs;
+	std::vector<double> samples;
 };
 
-#define DEFINE_RESULTS(var, name) struct result var = {0,LONG_MAX,0,0,name,false}
+#define DEFINE_RESULTS(var, name) struct result var = {0,LONG_MAX,0,0,name,false,0}
 
 void update_result(double time, struct result & result);
+void update_result(time_stamp_t &start, time_stamp_t &end, struct result & result);
+
+// prints results in the text form (one line per result) and also in JSON
+// form to the file specified by -j parameter
 void print_results(FILE * out, struct result ** results);
+void print_results_json(FILE * out, struct result ** results);
+
+// total number of rounds (warmup + measured)
+int bench_rounds();
+// marks start of the given round - update_result ignores times measured 
+// in warmup rounds
+void start_round(int round);
 
+// peak resident set size of the process in kB
+long peak_rss();
 
 static inline boost::shared_ptr<pdfobjects::CPdf> open_file(
 		const char * name, 
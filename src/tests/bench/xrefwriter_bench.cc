@@ -24,6 +24,8 @@
 #include <kernel/xrefwriter.h>
 #include <kernel/pdfedit-core-dev.h>
 #include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
 #include "utils.h"
 
 using namespace boost;
@@ -46,7 +48,7 @@ void bench_changeRevision(XRefWriter * xref, struct result * result)
 		xref->changeRevision(i);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 	}
 }
 
@@ -71,7 +73,7 @@ void bench_knowsRef(XRefWriter * xref, struct result * result_known, struct resu
 		if(state == UNUSED_REF)
 		{
 			if(result_unknown)
-				update_result(time_diff(start, end), *result_unknown);
+				update_result(start, end, *result_unknown);
 			++not_present;
 		}
 		else
@@ -81,7 +83,7 @@ void bench_knowsRef(XRefWriter * xref, struct result * result_known, struct resu
 			// be present
 			assert(state == INITIALIZED_REF);
 			if(result_known)
-				update_result(time_diff(start, end), *result_known);
+				update_result(start, end, *result_known);
 			--total;
 		}
 	}
@@ -95,7 +97,7 @@ void bench_knowsRef(XRefWriter * xref, struct result * result_known, struct resu
 		get_time_stamp(&end);
 		assert(state == UNUSED_REF);
 		if(result_unknown)
-			update_result(time_diff(start, end), *result_unknown);
+			update_result(start, end, *result_unknown);
 	}
 }
 
@@ -134,7 +136,7 @@ void bench_changeObject(XRefWriter * xref, struct result *result, int per)
 		xref->changeObject(ref.num, ref.gen, changed_obj);
 		get_time_stamp(&end);
 		if(result)
-			update_result(time_diff(start, end), *result);
+			update_result(start, end, *result);
 		xpdf::freeXpdfObject(changed_obj);
 	}
 }
@@ -164,7 +166,7 @@ void bench_fetch(XRefWriter *xref, struct result * result_known, struct result *
 		if(state == UNUSED_REF)
 		{
 			if(result_unknown)
-				update_result(time_diff(start, end), *result_unknown);
+				update_result(start, end, *result_unknown);
 			++not_present;
 		}
 		else
@@ -174,7 +176,7 @@ void bench_fetch(XRefWriter *xref, struct result * result_known, struct result *
 			// be present
 			assert(state == INITIALIZED_REF);
 			if(result_known)
-				update_result(time_diff(start, end), *result_known);
+				update_result(start, end, *result_known);
 			--total;
 		}
 	}
@@ -191,11 +193,61 @@ void bench_fetch(XRefWriter *xref, struct result * result_known, struct result *
 		obj.free();
 		assert(state == UNUSED_REF);
 		if(result_unknown)
-			update_result(time_diff(start, end), *result_unknown);
+			update_result(start, end, *result_unknown);
 	}
 
 }
 
+// copies given file to the temporary file (name is stored to tmpName)
+static int copy_to_tmp(const char * fileName, char * tmpName)
+{
+	int fd = mkstemp(tmpName);
+	if(fd < 0)
+		return -1;
+	FILE * out = fdopen(fd, "wb");
+	FILE * in = fopen(fileName, "rb");
+	if(!in || !out)
+	{
+		if(in)
+			fclose(in);
+		if(out)
+			fclose(out);
+		unlink(tmpName);
+		return -1;
+	}
+	char buffer[BUFSIZ];
+	size_t read;
+	while((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		fwrite(buffer, 1, read, out);
+	fclose(in);
+	fclose(out);
+	return 0;
+}
+
+// saves per% changed objects as a new revision of the document copy
+void bench_saveChanges(const char * fileName, struct result * result, int per)
+{
+	char tmpName[] = "/tmp/xrefwriter_benchXXXXXX";
+	if(copy_to_tmp(fileName, tmpName))
+		return;
+
+	shared_ptr<CPdf> pdf;
+	XRefWriter * xref;
+	open_and_get_xrefwriter(pdf, xref, tmpName);
+	if(pdf->getMode() != CPdf::ReadOnly)
+	{
+		time_stamp_t start, end;
+		bench_changeObject(xref, NULL, per);
+		get_time_stamp(&start);
+		xref->saveChanges(true);
+		get_time_stamp(&end);
+		if(result)
+			update_result(start, end, *result);
+	}
+	pdf.reset();
+	unlink(tmpName);
+}
+
 int main(int argc, char ** argv)
 {
 	int ret;
@@ -207,43 +259,51 @@ int main(int argc, char ** argv)
 	shared_ptr<CPdf> pdf;
 	XRefWriter * xref;
 
-	// changeRevision test
-	open_and_get_xrefwriter(pdf, xref, file_name);
 	DEFINE_RESULTS(changeRevisionResults1, "changeRevision_no_changed");
-	bench_changeRevision(xref, &changeRevisionResults1);
-
-	// knowsRef test without any changed objects
-	open_and_get_xrefwriter(pdf, xref, file_name);
 	DEFINE_RESULTS(knowsRef_known1, "knowsRef_known_no_changed");
 	DEFINE_RESULTS(knowsRef_unknown1, "knowsRef_unknown_no_changed");
-	bench_knowsRef(xref, &knowsRef_known1, &knowsRef_unknown1);
-
-	// knowsRef test with all indirect object changed
-	open_and_get_xrefwriter(pdf, xref, file_name);
 	DEFINE_RESULTS(knowsRef_known2, "knowsRef_known_all_changed");
 	DEFINE_RESULTS(knowsRef_unknown2, "knowsRef_unknown_all_changed");
 	DEFINE_RESULTS(changeObject_all, "changeObject_all");
-	// change all objects bench
-	if(pdf->getMode() != CPdf::ReadOnly)
-	{
-		bench_changeObject(xref, &changeObject_all, 100);
-		bench_knowsRef(xref, &knowsRef_known2, &knowsRef_unknown2);
-	}
-	
-	// fetch without changed objects
-	open_and_get_xrefwriter(pdf, xref, file_name);
 	DEFINE_RESULTS(fetch_known1, "fetch_known_no_changed");
 	DEFINE_RESULTS(fetch_unknown1, "fetch_unknown_no_changed");
-	bench_fetch(xref, &fetch_known1, &fetch_unknown1);
-	
-	// fetch with all objects changed
-	open_and_get_xrefwriter(pdf, xref, file_name);
 	DEFINE_RESULTS(fetch_known2, "fetch_known_all_changed");
 	DEFINE_RESULTS(fetch_unknown2, "fetch_unknown_all_changed");
-	if(pdf->getMode() != CPdf::ReadOnly)
+	DEFINE_RESULTS(saveChanges_all, "saveChanges_all_changed");
+	for(int round = 0; round < bench_rounds(); ++round)
 	{
-		bench_changeObject(xref, NULL, 100);
-		bench_fetch(xref, &fetch_known2, &fetch_unknown2);
+		start_round(round);
+		// changeRevision test
+		open_and_get_xrefwriter(pdf, xref, file_name);
+		bench_changeRevision(xref, &changeRevisionResults1);
+
+		// knowsRef test without any changed objects
+		open_and_get_xrefwriter(pdf, xref, file_name);
+		bench_knowsRef(xref, &knowsRef_known1, &knowsRef_unknown1);
+
+		// knowsRef test with all indirect object changed
+		open_and_get_xrefwriter(pdf, xref, file_name);
+		// change all objects bench
+		if(pdf->getMode() != CPdf::ReadOnly)
+		{
+			bench_changeObject(xref, &changeObject_all, 100);
+			bench_knowsRef(xref, &knowsRef_known2, &knowsRef_unknown2);
+		}
+
+		// fetch without changed objects
+		open_and_get_xrefwriter(pdf, xref, file_name);
+		bench_fetch(xref, &fetch_known1, &fetch_unknown1);
+
+		// fetch with all objects changed
+		open_and_get_xrefwriter(pdf, xref, file_name);
+		if(pdf->getMode() != CPdf::ReadOnly)
+		{
+			bench_changeObject(xref, NULL, 100);
+			bench_fetch(xref, &fetch_known2, &fetch_unknown2);
+		}
+
+		// saveChanges with all objects changed (on the copy of the document)
+		bench_saveChanges(file_name, &saveChanges_all, 100);
 	}
 
 	// clone (???)
@@ -255,6 +315,7 @@ int main(int argc, char ** argv)
 		&changeObject_all,
 		&fetch_known1, &fetch_unknown1,
 		&fetch_known2, &fetch_unknown2,
+		&saveChanges_all,
 		NULL
 	};
 
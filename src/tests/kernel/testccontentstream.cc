@@ -140,6 +140,60 @@ frontinsert (ostream& oss, const char* fileName)
 
 //=====================================================================================
 
+bool
+insertcomposite (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> ppdf = getTestCPdf (fileName);
+	size_t pagecnt = ppdf->getPageCount ();
+	ppdf.reset();
+	
+	for (size_t i = 0; i < pagecnt && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		assert (!ccs.empty());
+		shared_ptr<CContentStream> cs = ccs.front();
+
+		CContentStream::Operators ops;
+		cs->getPdfOperators (ops);
+		if (ops.empty())
+			continue;
+		size_t count = 0;
+		for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+			++count;
+
+		// Insert a composite after the first operator
+		PdfOperator::Iterator it = PdfOperator::getIterator (ops.front());
+		PdfOperator::Iterator next = PdfOperator::getIterator (getLastOperator (ops.front()));
+		next.next ();
+		shared_ptr<PdfOperator> op (new UnknownCompositePdfOperator ("halo","kto tam"));
+		shared_ptr<PdfOperator> opp (new UnknownCompositePdfOperator ("tu","fun, tam?"));
+		op->push_back (opp,op);
+		cs->insertOperator (it, op, false);
+
+		// Children of the composite stay in the iterator list
+		size_t newcount = 0;
+		for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+			++newcount;
+		CPPUNIT_ASSERT_EQUAL (count + 2, newcount);
+		if (!next.isEnd())
+		{
+			PdfOperator::Iterator prev = next;
+			prev.prev ();
+			CPPUNIT_ASSERT (opp == prev.getCurrent());
+		}
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
 bool
 position (ostream& oss, const char* fileName, const libs::Rectangle rc)
 {
@@ -172,6 +226,266 @@ position (ostream& oss, const char* fileName, const libs::Rectangle rc)
 
 //=====================================================================================
 
+bool
+compact (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> ppdf = getTestCPdf (fileName);
+	size_t pagecnt = ppdf->getPageCount ();
+	ppdf.reset();
+	
+	for (size_t i = 0; i < pagecnt && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		for (vector<boost::shared_ptr<CContentStream> >::iterator it = ccs.begin(); it != ccs.end(); ++it)
+		{
+			// Representation of compact operators
+			string tmp1;
+			(*it)->getStringRepresentation (tmp1);
+
+			// Representation of pdf operators
+			CContentStream::Operators ops;
+			(*it)->getPdfOperators (ops);
+			string tmp2;
+			(*it)->getStringRepresentation (tmp2);
+
+			CPPUNIT_ASSERT (tmp1 == tmp2);
+		}
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+/** Get string representations of bounding boxes of all operators. */
+void
+getBBoxes (shared_ptr<CContentStream> cs, vector<string>& bboxes)
+{
+	bboxes.clear ();
+	CContentStream::Operators ops;
+	cs->getPdfOperators (ops);
+	if (ops.empty())
+		return;
+	for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+	{
+		ostringstream str;
+		str << it.getCurrent()->getBBox ();
+		bboxes.push_back (str.str());
+	}
+}
+
+/** Are bounding boxes after a change equal to completely updated ones. */
+bool
+sameAsFullUpdate (shared_ptr<CContentStream> cs)
+{
+	vector<string> local, full;
+	getBBoxes (cs, local);
+	cs->reparse (true);
+	getBBoxes (cs, full);
+	return local == full;
+}
+
+bool
+bboxupdate (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> ppdf = getTestCPdf (fileName);
+	size_t pagecnt = ppdf->getPageCount ();
+	ppdf.reset();
+	
+	for (size_t i = 0; i < pagecnt && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		if (ccs.empty())
+			continue;
+		shared_ptr<CContentStream> cs = ccs.front();
+
+		// Find a simple operator in the middle
+		CContentStream::Operators ops;
+		cs->getPdfOperators (ops);
+		if (ops.empty())
+			continue;
+		vector<shared_ptr<PdfOperator> > all;
+		for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+			if (!isCompositeOp (it.getCurrent()) && 0 < it.getCurrent()->getParametersCount())
+				all.push_back (it.getCurrent());
+		if (all.empty())
+			continue;
+		shared_ptr<PdfOperator> op = all[all.size() / 2];
+
+		// Insert
+		shared_ptr<PdfOperator> cloned = op->clone ();
+		cs->insertOperator (op, cloned);
+		CPPUNIT_ASSERT (sameAsFullUpdate (cs));
+
+		// Change operand
+		PdfOperator::Operands operands;
+		cloned->getParameters (operands);
+		if (isReal (operands.front()))
+		{
+			IProperty::getSmartCObjectPtr<CReal>(operands.front())->setValue (42.5);
+			CPPUNIT_ASSERT (sameAsFullUpdate (cs));
+		}else if (isInt (operands.front()))
+		{
+			IProperty::getSmartCObjectPtr<CInt>(operands.front())->setValue (42);
+			CPPUNIT_ASSERT (sameAsFullUpdate (cs));
+		}
+
+		// Delete
+		cs->deleteOperator (cloned);
+		CPPUNIT_ASSERT (sameAsFullUpdate (cs));
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+/** Operator data of a content stream with a single stream. */
+bool
+getSavedData (shared_ptr<CContentStream> cs, string& str)
+{
+	vector<shared_ptr<CStream> > streams;
+	cs->getCStreams (streams);
+	if (1 != streams.size())
+		return false;
+	streams.front()->getDecodedStringRepresentation (str);
+	return true;
+}
+
+bool
+savesource (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> ppdf = getTestCPdf (fileName);
+	size_t pagecnt = ppdf->getPageCount ();
+	ppdf.reset();
+	
+	for (size_t i = 0; i < pagecnt && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		if (ccs.empty())
+			continue;
+		shared_ptr<CContentStream> cs = ccs.front();
+		string before;
+		if (!getSavedData (cs, before))
+			continue;
+
+		// Find a real operand in the middle
+		CContentStream::Operators ops;
+		cs->getPdfOperators (ops);
+		if (ops.empty())
+			continue;
+		vector<shared_ptr<PdfOperator> > all;
+		for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+		{
+			PdfOperator::Operands operands;
+			it.getCurrent()->getParameters (operands);
+			if (!isCompositeOp (it.getCurrent()) && !operands.empty() && isReal (operands.front()))
+				all.push_back (it.getCurrent());
+		}
+		if (all.empty())
+			continue;
+		shared_ptr<PdfOperator> op = all[all.size() / 2];
+
+		// Change it, only the operator is written again
+		PdfOperator::Operands operands;
+		op->getParameters (operands);
+		IProperty::getSmartCObjectPtr<CReal>(operands.front())->setValue (42.5);
+		string after;
+		CPPUNIT_ASSERT (getSavedData (cs, after));
+		size_t prefix = 0;
+		while (prefix < before.size() && prefix < after.size() && before[prefix] == after[prefix])
+			++prefix;
+		size_t suffix = 0;
+		while (suffix < before.size() - prefix && suffix < after.size() - prefix 
+				&& before[before.size() - suffix - 1] == after[after.size() - suffix - 1])
+			++suffix;
+		string opstr;
+		op->getStringRepresentation (opstr);
+		CPPUNIT_ASSERT (after.size() - prefix - suffix <= opstr.size() + 1);
+
+		// Saved data contains the same operators
+		string repr, reparsed;
+		cs->getStringRepresentation (repr);
+		cs->reparse ();
+		cs->getStringRepresentation (reparsed);
+		CPPUNIT_ASSERT (repr == reparsed);
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+bool
+compactparse (ostream& oss, const char* fileName)
+{
+	// Content and number of its first level operators
+	static const struct { const char* content; size_t count; } contents[] = {
+		{ "q 1 0 0 1 0 0 cm /P <</MCID 0 /A [1 (x) <00ff> [true null] 2 0 R]>> BDC "
+		  "BT /F1 12 Tf [(a) -10.5 (b)] TJ ET EMC Q 1 /N unknown", 2 },
+		{ "q Q BT 1 Tw", 1 },		// missing end tag
+		{ "q Q 1 BT ET", 1 },		// bad operand count
+		{ "q Q /F1 (a) Tf", 1 },	// bad operand type
+		{ "q Q 1 2", 1 },			// operands without operator
+		{ "BT ET q BT ET Q (a) Tj", 3 },
+	};
+
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	if (1 > pdf->getPageCount())
+		return true;
+	boost::shared_ptr<CPage> page = pdf->getPage (1);
+	boost::shared_ptr<CDict> dict = page->getDictionary();
+	if (!dict->containsProperty ("Contents"))
+		return true;
+	shared_ptr<IProperty> tmp = utils::getReferencedObject (dict->getProperty ("Contents"));
+	if (!isStream (tmp))
+		return true;
+
+	for (size_t i = 0; i < sizeof (contents) / sizeof (contents[0]); ++i)
+	{
+		string content = contents[i].content;
+		CStream::Buffer buf (content.begin(), content.end());
+		dict->getProperty<CStream>("Contents")->setBuffer (buf);
+
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		CPPUNIT_ASSERT (!ccs.empty());
+		
+		string tmp1;
+		ccs.front()->getStringRepresentation (tmp1);
+		CContentStream::Operators ops;
+		ccs.front()->getPdfOperators (ops);
+		string tmp2;
+		ccs.front()->getStringRepresentation (tmp2);
+
+		CPPUNIT_ASSERT_EQUAL (contents[i].count, ops.size());
+		CPPUNIT_ASSERT (tmp1 == tmp2);
+		_working (oss);
+	}
+
+	return true;
+}
+
+//=====================================================================================
+
 namespace  {
 	
 	bool img (Parser* parser, Object& o, XRef* xref)
@@ -713,6 +1027,9 @@ class TestCContentStream : public CppUnit::TestFixture
 		CPPUNIT_TEST(TestSetCS);
 		CPPUNIT_TEST(TestFront);
 		CPPUNIT_TEST(TestCStreams);
+		CPPUNIT_TEST(TestCompact);
+		CPPUNIT_TEST(TestBBoxUpdate);
+		CPPUNIT_TEST(TestSaveSource);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -800,6 +1117,10 @@ public:
 				CPPUNIT_ASSERT (frontinsert (OUTPUT, (*it).c_str()));
 				OK_TEST;
 
+				TEST(" insert composite");
+				CPPUNIT_ASSERT (insertcomposite (OUTPUT, (*it).c_str()));
+				OK_TEST;
+
 				TEST(" add content stream");
 				CPPUNIT_ASSERT (addcc (OUTPUT, (*it).c_str()));
 				OK_TEST;
@@ -860,6 +1181,73 @@ public:
 		}
 	}
 
+	//
+	//
+	//
+	void TestCompact ()
+	{
+		OUTPUT << "CContentStream..." << endl;
+		
+		for(TestParams::FileList::const_iterator it = TestParams::instance().files.begin(); 
+				it != TestParams::instance().files.end(); 
+					++it)
+		{
+			OUTPUT << "Testing filename: " << *it << endl;
+
+			TEST(" compact operators");
+			CPPUNIT_ASSERT (compact (OUTPUT, (*it).c_str()));
+			OK_TEST;
+
+			BEGIN_CHECK_READONLY;
+				TEST(" compact parsing");
+				CPPUNIT_ASSERT (compactparse (OUTPUT, (*it).c_str()));
+				OK_TEST;
+			END_CHECK_READONLY;
+		}
+	}
+
+	//
+	//
+	//
+	void TestBBoxUpdate ()
+	{
+		OUTPUT << "CContentStream..." << endl;
+		
+		for(TestParams::FileList::const_iterator it = TestParams::instance().files.begin(); 
+				it != TestParams::instance().files.end(); 
+					++it)
+		{
+			OUTPUT << "Testing filename: " << *it << endl;
+
+			BEGIN_CHECK_READONLY;
+				TEST(" bounding box update");
+				CPPUNIT_ASSERT (bboxupdate (OUTPUT, (*it).c_str()));
+				OK_TEST;
+			END_CHECK_READONLY;
+		}
+	}
+
+	//
+	//
+	//
+	void TestSaveSource ()
+	{
+		OUTPUT << "CContentStream..." << endl;
+		
+		for(TestParams::FileList::const_iterator it = TestParams::instance().files.begin(); 
+				it != TestParams::instance().files.end(); 
+					++it)
+		{
+			OUTPUT << "Testing filename: " << *it << endl;
+
+			BEGIN_CHECK_READONLY;
+				TEST(" saving changed operators");
+				CPPUNIT_ASSERT (savesource (OUTPUT, (*it).c_str()));
+				OK_TEST;
+			END_CHECK_READONLY;
+		}
+	}
+
 	//
 	//
 	//
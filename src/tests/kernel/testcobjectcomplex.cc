@@ -490,6 +490,85 @@ c_set ()
 
 //=====================================================================================
 
+bool
+c_bigdict ()
+{
+	CDict d;
+	const int count = 50;
+
+	// Enough items to use key index
+	for (int i = 0; i < count; ++i)
+	{
+		ostringstream name;
+		name << "key" << i;
+		CInt val (i);
+		d.addProperty (name.str(), val);
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		ostringstream name;
+		name << "key" << i;
+		CPPUNIT_ASSERT (d.containsProperty (name.str()));
+		CPPUNIT_ASSERT (i == getIntFromIProperty (d.getProperty (name.str())));
+	}
+	CPPUNIT_ASSERT (!d.containsProperty ("key"));
+	CPPUNIT_ASSERT (!d.containsProperty ("key50"));
+
+	// Delete every other item and replace the rest
+	for (int i = 0; i < count; i += 2)
+	{
+		ostringstream name;
+		name << "key" << i;
+		d.delProperty (name.str());
+	}
+	for (int i = 1; i < count; i += 2)
+	{
+		ostringstream name;
+		name << "key" << i;
+		CInt val (-i);
+		d.setProperty (name.str(), val);
+	}
+	CPPUNIT_ASSERT (count / 2 == (int)d.getPropertyCount ());
+	for (int i = 0; i < count; ++i)
+	{
+		ostringstream name;
+		name << "key" << i;
+		CPPUNIT_ASSERT ((0 != i % 2) == d.containsProperty (name.str()));
+		if (i % 2)
+			CPPUNIT_ASSERT (-i == getIntFromIProperty (d.getProperty (name.str())));
+	}
+
+	// Insertion order is kept
+	list<string> names;
+	d.getAllPropertyNames (names);
+	int i = 1;
+	for (list<string>::iterator it = names.begin (); it != names.end (); ++it, i += 2)
+	{
+		ostringstream name;
+		name << "key" << i;
+		CPPUNIT_ASSERT (name.str() == *it);
+	}
+
+	// Same number of items with a different key
+	size_t size = d.getPropertyCount ();
+	d.delProperty ("key1");
+	CInt other (1);
+	d.addProperty ("other", other);
+	CPPUNIT_ASSERT (size == d.getPropertyCount ());
+	CPPUNIT_ASSERT (!d.containsProperty ("key1"));
+	CPPUNIT_ASSERT (1 == getIntFromIProperty (d.getProperty ("other")));
+
+	// Clone has its own index
+	boost::shared_ptr<CDict> clone = IProperty::getSmartCObjectPtr<CDict> (d.clone ());
+	CPPUNIT_ASSERT (1 == getIntFromIProperty (clone->getProperty ("other")));
+	CPPUNIT_ASSERT (-3 == getIntFromIProperty (clone->getProperty ("key3")));
+	CPPUNIT_ASSERT (!clone->containsProperty ("key1"));
+
+	return true;
+}
+
+//=====================================================================================
+
 bool
 c_xpdfctor (const char* filename)
 {
@@ -737,6 +816,10 @@ public:
 			CPPUNIT_ASSERT (c_set ());
 			OK_TEST;
 
+			TEST(" big dictionary")
+			CPPUNIT_ASSERT (c_bigdict ());
+			OK_TEST;
+
 			TEST(" xpdf addProperty + getPosition")
 			CPPUNIT_ASSERT (c_addprop2 ());
 			OK_TEST;
@@ -25,6 +25,12 @@
 
 #include "kernel/static.h"
 #include "xpdf/PDFDoc.h"
+#include "splash/Splash.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashPattern.h"
+#include "splash/SplashGlyphBitmap.h"
+#include "splash/SplashFontFileCache.h"
 #include "tests/kernel/testmain.h"
 #include "tests/kernel/testcobject.h"
 #include "tests/kernel/testcpage.h"
@@ -32,7 +38,9 @@
 
 #include "kernel/factories.h"
 #include "kernel/cpage.h"
+#include "kernel/cpagedisplay.h"
 #include "kernel/cannotation.h"
+#include "kernel/textindex.h"
 
 
 //=====================================================================================
@@ -146,6 +154,382 @@ display (UNUSED_PARAM ostream& oss, const char* fileName)
 
 //=====================================================================================
 
+namespace {
+	/** Finds an image XObject of page resources which is in the image cache. */
+	boost::shared_ptr<CStream> cachedImage (boost::shared_ptr<CPage> page, SplashImageCache* images, ::Ref& imageRef)
+	{
+		boost::shared_ptr<CDict> dict = page->getDictionary ();
+		if (!dict->containsProperty ("Resources"))
+			return boost::shared_ptr<CStream> ();
+		boost::shared_ptr<IProperty> res = utils::getReferencedObject (dict->getProperty ("Resources"));
+		if (!isDict (res) || !IProperty::getSmartCObjectPtr<CDict> (res)->containsProperty ("XObject"))
+			return boost::shared_ptr<CStream> ();
+		boost::shared_ptr<IProperty> xobjects = utils::getReferencedObject (
+				IProperty::getSmartCObjectPtr<CDict> (res)->getProperty ("XObject"));
+		if (!isDict (xobjects))
+			return boost::shared_ptr<CStream> ();
+		boost::shared_ptr<CDict> xdict = IProperty::getSmartCObjectPtr<CDict> (xobjects);
+
+		std::vector<std::string> names;
+		xdict->getAllPropertyNames (names);
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			boost::shared_ptr<IProperty> prop = xdict->getProperty (names[i]);
+			if (!isRef (prop))
+				continue;
+			IndiRef ref = utils::getValueFromSimple<CRef> (prop);
+			imageRef.num = ref.num;
+			imageRef.gen = ref.gen;
+			SplashImageCacheEntry* entry = images->getImage (imageRef);
+			if (!entry)
+				continue;
+			images->releaseImage (entry);
+			boost::shared_ptr<IProperty> image = utils::getReferencedObject (prop);
+			if (isStream (image))
+				return IProperty::getSmartCObjectPtr<CStream> (image);
+		}
+		return boost::shared_ptr<CStream> ();
+	}
+}
+
+bool
+rendercontext (UNUSED_PARAM ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	if (!pdf->getPageCount())
+		return true;
+
+	boost::shared_ptr<CPage> page = pdf->getPage (1);
+	TextOutputDev textOut (NULL, gTrue, gFalse, gTrue);
+	if (!textOut.isOk ())
+		throw;
+
+	// page object and catalog are shared by display calls
+	RenderContext& ctx = pdf->getRenderContext ();
+	page->displayPage (textOut);
+	boost::shared_ptr<Object> pageObj = ctx.getPageObject (page->getDictionary());
+	const Catalog* catalog = ctx.getCatalog ();
+	page->displayPage (textOut);
+	CPPUNIT_ASSERT (pageObj == ctx.getPageObject (page->getDictionary()));
+	CPPUNIT_ASSERT (catalog == ctx.getCatalog ());
+	_working (oss);
+
+	// decoded images are shared by renders of the document
+	SplashColor paperColor;
+	paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+	SplashOutputDev out (splashModeRGB8, 4, gFalse, paperColor);
+	SplashImageCache* images = ctx.getImageCache ();
+	int hits0, misses0, count0, size0;
+	images->getStats (&hits0, &misses0, &count0, &size0);
+	page->displayPage (out);
+	int hits1, misses1, count1, size1;
+	images->getStats (&hits1, &misses1, &count1, &size1);
+	if (misses1 > misses0)
+	{
+		page->displayPage (out);
+		int hits2, misses2, count2, size2;
+		images->getStats (&hits2, &misses2, &count2, &size2);
+		CPPUNIT_ASSERT_EQUAL (misses1, misses2);
+		CPPUNIT_ASSERT (hits2 > hits1);
+		CPPUNIT_ASSERT_EQUAL (count1, count2);
+	}
+
+	// change to page dictionary has to discard cached page object but
+	// catalog is still valid
+	try {
+		pdf->canChange ();
+	}catch (ReadOnlyDocumentException&)
+	{
+		return true;
+	}
+	page->setRotation (90);
+	boost::shared_ptr<Object> changedObj = ctx.getPageObject (page->getDictionary());
+	CPPUNIT_ASSERT (pageObj != changedObj);
+	Object rotate;
+	CPPUNIT_ASSERT (changedObj->getDict()->lookup ("Rotate", &rotate)->isInt());
+	CPPUNIT_ASSERT_EQUAL (90, rotate.getInt());
+	rotate.free ();
+	CPPUNIT_ASSERT (catalog == ctx.getCatalog ());
+	page->displayPage (textOut);
+	delete textOut.getText(0, 0, 1000, 1000);
+	_working (oss);
+
+	// change of an image stream has to discard its decoded data, so that
+	// the next render decodes it again
+	::Ref imageRef;
+	boost::shared_ptr<CStream> image = cachedImage (page, images, imageRef);
+	if (image && !utils::isEncrypted (pdf))
+	{
+		image->setBuffer (CStream::Buffer (image->getBuffer ()));
+		CPPUNIT_ASSERT (NULL == images->getImage (imageRef));
+		int hits, misses, count, size;
+		images->getStats (&hits, &misses, &count, &size);
+		page->displayPage (out);
+		int hits3, misses3, count3, size3;
+		images->getStats (&hits3, &misses3, &count3, &size3);
+		CPPUNIT_ASSERT (misses3 > misses);
+		SplashImageCacheEntry* entry = images->getImage (imageRef);
+		CPPUNIT_ASSERT (NULL != entry);
+		images->releaseImage (entry);
+		_working (oss);
+	}
+
+	return true;
+}
+
+//=====================================================================================
+
+namespace {
+	/** Number of pixels in rows [top, top + rows) which differ in RGB8 bitmaps. */
+	int differentPixels (SplashBitmap* a, SplashBitmap* b, int top, int rows)
+	{
+		int count = 0;
+		for (int y = top; y < top + rows; ++y)
+		{
+			SplashColorPtr pa = a->getDataPtr () + y * a->getRowSize ();
+			SplashColorPtr pb = b->getDataPtr () + y * b->getRowSize ();
+			for (int x = 0; x < a->getWidth (); ++x, pa += 3, pb += 3)
+				if (memcmp (pa, pb, 3))
+					++count;
+		}
+		return count;
+	}
+
+	/** Bands must be stitched into exactly the bitmap rendered at once. */
+	bool sameBands (SplashBitmap* banded, SplashBitmap* bitmap)
+	{
+		if (banded->getWidth () != bitmap->getWidth () || banded->getHeight () != bitmap->getHeight ())
+			return false;
+		return 0 == differentPixels (banded, bitmap, 0, bitmap->getHeight ());
+	}
+}
+
+bool
+displaybands (UNUSED_PARAM ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+
+	SplashColor paperColor;
+	paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+	SplashOutputDev out (splashModeRGB8, 4, gFalse, paperColor);
+	SplashOutputDev bandOut (splashModeRGB8, 4, gFalse, paperColor);
+	// pages are not split into bands when t1lib is used
+	GBool t1lib = globalParams->getEnableT1lib ();
+	globalParams->setEnableT1lib ("no");
+	for (size_t i = 0; i < pdf->getPageCount() && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPage> page = pdf->getPage (i+1);
+		DisplayParams dp;
+		dp.hDpi = dp.vDpi = 100;
+
+		// the bands are stitched where the page rendered at once has them
+		page->displayPage (out, dp);
+		dp.bands = 3;
+		page->displayPage (bandOut, dp);
+		CPPUNIT_ASSERT (sameBands (bandOut.getBitmap (), out.getBitmap ()));
+
+		// the same for a page slice
+		dp.bands = 1;
+		page->displayPage (out, dp, 10, 20, 200, 150);
+		dp.bands = 4;
+		page->displayPage (bandOut, dp, 10, 20, 200, 150);
+		CPPUNIT_ASSERT_EQUAL (200, bandOut.getBitmap ()->getWidth ());
+		CPPUNIT_ASSERT_EQUAL (150, bandOut.getBitmap ()->getHeight ());
+		CPPUNIT_ASSERT (sameBands (bandOut.getBitmap (), out.getBitmap ()));
+
+		_working (oss);
+	}
+	globalParams->setEnableT1lib (t1lib ? "yes" : "no");
+
+	return true;
+}
+
+//=====================================================================================
+
+namespace {
+	/**
+	 * Solid color which is not static, so Splash draws it through the
+	 * generic pipe (pipeRun) instead of the span kernels.
+	 */
+	class PipeColor : public SplashPattern
+	{
+		SplashColor color;
+	public:
+		PipeColor (SplashColorPtr c) { memcpy (color, c, sizeof (color)); }
+		virtual SplashPattern* copy () { return new PipeColor (color); }
+		virtual void getColor (UNUSED_PARAM int x, UNUSED_PARAM int y, SplashColorPtr c)
+			{ memcpy (c, color, sizeof (color)); }
+		virtual GBool isStatic () { return gFalse; }
+	};
+
+	/** Fills a polygon given by the point coordinates. */
+	void fillPolygon (Splash& splash, const SplashCoord* xy, size_t points, bool eo)
+	{
+		SplashPath path;
+		path.moveTo (xy[0], xy[1]);
+		for (size_t i = 1; i < points; ++i)
+			path.lineTo (xy[2*i], xy[2*i+1]);
+		path.close ();
+		splash.fill (&path, eo);
+	}
+
+	/** Draws shapes and a glyph with fill colors of the given kind. */
+	void drawScene (Splash& splash, bool generic, SplashCoord alpha)
+	{
+		static const SplashCoord rect[] = {3, 5, 197, 5, 197, 40, 3, 40};
+		static const SplashCoord triangle[] = {10.3, 30.7, 180.2, 55.1, 40.6, 95.9};
+		static const SplashCoord star[] = {100, 20, 130, 110, 55, 55, 145, 55, 70, 110};
+		static const SplashCoord clip[] = {20.5, 10.25, 170.75, 30.5, 150.25, 100.5, 35.5, 90.75};
+		SplashColor colors[3] = {{0xff, 0x20, 0x40}, {0x30, 0x30, 0x30}, {0x10, 0x80, 0xe0}};
+
+		Guchar glyphData[37 * 20];
+		for (size_t i = 0; i < sizeof (glyphData); ++i)
+			glyphData[i] = (Guchar)((i * 53) % 256);
+		SplashGlyphBitmap glyph;
+		glyph.x = glyph.y = 0;
+		glyph.w = 37;
+		glyph.h = 20;
+		glyph.aa = gTrue;
+		glyph.data = glyphData;
+		glyph.freeData = gFalse;
+
+		// the same once without clipping and once clipped by a path
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			if (pass)
+			{
+				splash.saveState ();
+				SplashPath path;
+				path.moveTo (clip[0], clip[1]);
+				for (size_t i = 1; i < 4; ++i)
+					path.lineTo (clip[2*i], clip[2*i+1]);
+				path.close ();
+				splash.clipToPath (&path, gFalse);
+			}
+			for (size_t i = 0; i < 3; ++i)
+			{
+				if (generic)
+					splash.setFillPattern (new PipeColor (colors[i]));
+				else
+					splash.setFillPattern (new SplashSolidColor (colors[i]));
+				// the first shape is opaque so that the backdrop alpha varies
+				splash.setFillAlpha (i ? alpha : 1);
+				switch (i)
+				{
+					case 0: fillPolygon (splash, rect, 4, false); break;
+					case 1: fillPolygon (splash, triangle, 3, false); break;
+					default: fillPolygon (splash, star, 5, true); break;
+				}
+				splash.fillGlyph (60 * i + 7.5, 70 + 5 * pass, &glyph);
+			}
+			if (pass)
+				splash.restoreState ();
+		}
+	}
+}
+
+/**
+ * Draws the same scene with the span kernels and with the generic pipe
+ * and checks that the bitmaps are identical.
+ */
+bool
+spankernels (UNUSED_PARAM ostream& oss)
+{
+	static const SplashColorMode modes[] = {splashModeRGB8, splashModeBGR8};
+	static const SplashCoord alphas[] = {1, 0.6, 0.25};
+	SplashColor paperColor;
+	paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+	const int w = 201, h = 121;
+
+	for (size_t mode = 0; mode < sizeof (modes) / sizeof (modes[0]); ++mode)
+	for (int withAlpha = 0; withAlpha < 2; ++withAlpha)
+	for (int aa = 0; aa < 2; ++aa)
+	for (size_t alpha = 0; alpha < sizeof (alphas) / sizeof (alphas[0]); ++alpha)
+	{
+		SplashBitmap spans (w, h, 4, modes[mode], withAlpha);
+		SplashBitmap pipe (w, h, 4, modes[mode], withAlpha);
+		{
+			Splash spansSplash (&spans, aa);
+			spansSplash.clear (paperColor, 0);
+			drawScene (spansSplash, false, alphas[alpha]);
+			Splash pipeSplash (&pipe, aa);
+			pipeSplash.clear (paperColor, 0);
+			drawScene (pipeSplash, true, alphas[alpha]);
+		}
+		CPPUNIT_ASSERT (0 == memcmp (spans.getDataPtr (), pipe.getDataPtr (), spans.getRowSize () * h));
+		if (withAlpha)
+			CPPUNIT_ASSERT (0 == memcmp (spans.getAlphaPtr (), pipe.getAlphaPtr (), w * h));
+		_working (oss);
+	}
+
+	return true;
+}
+
+//=====================================================================================
+
+bool
+fontcache (UNUSED_PARAM ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	if (!pdf->getPageCount())
+		return true;
+	boost::shared_ptr<CPage> page = pdf->getPage (1);
+	SplashFontFileCache* cache = SplashFontFileCache::getCache ();
+	int maxSize = cache->getMaxSize ();
+	cache->flush ();
+
+	SplashColor paperColor;
+	paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+	int hits0, misses0, files0, size0;
+	cache->getStats (&hits0, &misses0, &files0, &size0);
+	int hits1, misses1, files1, size1;
+	int hits2, misses2, files2, size2;
+	{
+		// embedded fonts are loaded by the first output device
+		SplashOutputDev out (splashModeRGB8, 4, gFalse, paperColor);
+		page->displayPage (out);
+		cache->getStats (&hits1, &misses1, &files1, &size1);
+		if (misses1 == misses0)
+		{
+			oss << "no embedded fonts on the first page" << flush;
+			return true;
+		}
+		CPPUNIT_ASSERT (files1 > files0);
+		CPPUNIT_ASSERT (size1 > size0);
+
+		// and the second one gets the same font files
+		SplashOutputDev other (splashModeRGB8, 4, gFalse, paperColor);
+		page->displayPage (other);
+		cache->getStats (&hits2, &misses2, &files2, &size2);
+		CPPUNIT_ASSERT_EQUAL (misses1, misses2);
+		CPPUNIT_ASSERT (hits2 > hits1);
+		CPPUNIT_ASSERT_EQUAL (files1, files2);
+
+		// font files used by output devices are not evicted
+		cache->setMaxSize (1);
+		int hits, misses, files, size;
+		cache->getStats (&hits, &misses, &files, &size);
+		CPPUNIT_ASSERT (files > files0);
+		cache->setMaxSize (maxSize);
+	}
+	_working (oss);
+
+	// unused font files stay in the cache until the limit is exceeded
+	// (only files used by other output devices are kept then)
+	int hits, misses, files, size;
+	cache->getStats (&hits, &misses, &files, &size);
+	CPPUNIT_ASSERT_EQUAL (files2, files);
+	cache->setMaxSize (1);
+	cache->getStats (&hits, &misses, &files, &size);
+	CPPUNIT_ASSERT (files <= files0);
+	CPPUNIT_ASSERT (size < size2);
+	cache->setMaxSize (maxSize);
+
+	return true;
+}
+
+//=====================================================================================
+
 bool
 _export (UNUSED_PARAM ostream& oss, const char* fileName)
 {
@@ -167,6 +551,15 @@ _export (UNUSED_PARAM ostream& oss, const char* fileName)
 
 //=====================================================================================
 
+namespace {
+	struct CountingCallback : public ITextSearchCallback
+	{
+		size_t count;
+		CountingCallback () : count (0) {}
+		virtual bool found (size_t, const libs::Rectangle&) { ++count; return true; }
+	};
+}
+
 bool
 findtext (UNUSED_PARAM ostream& oss, const char* fileName)
 {
@@ -196,6 +589,58 @@ findtext (UNUSED_PARAM ostream& oss, const char* fileName)
 					//getchar ();
 			}else
 				oss << "Text: " << word << " at position: " << recs.front() << flush;
+
+			// second search uses cached text and must give the same result
+			Recs cached;
+			page->findText (word, cached);
+			CPPUNIT_ASSERT (cached.size() == recs.size());
+			for (size_t j = 0; j < recs.size(); ++j)
+				CPPUNIT_ASSERT (recs[j] == cached[j]);
+		}
+	}
+
+	// document search has to find everything page searches find
+	if (0 < pdf->getPageCount())
+	{
+		string tmp;
+		pdf->getPage (1)->getText (tmp);
+		if (tmp.length() > 10)
+		{
+			string word = tmp.substr (2,3);
+			size_t pages = 0;
+			for (size_t i = 0; i < pdf->getPageCount(); ++i)
+			{
+				std::vector<libs::Rectangle> recs;
+				pages += pdf->getPage (i+1)->findText (word, recs);
+			}
+			CountingCallback all;
+			CPPUNIT_ASSERT (pages == pdf->findText (word, all));
+			CPPUNIT_ASSERT (pages == all.count);
+		}
+	}
+
+	// raw change of content stream buffers is not a content stream change
+	// but it has to drop the cached text as well
+	if (0 < pdf->getPageCount() && !utils::isEncrypted (pdf) && !pdf->isLinearized ())
+	{
+		boost::shared_ptr<CPage> page = pdf->getPage (1);
+		string tmp;
+		page->getText (tmp);
+		std::vector<libs::Rectangle> recs;
+		if (tmp.length() > 10 && 0 < page->findText (tmp.substr (2,3), recs))
+		{
+			std::vector<boost::shared_ptr<CContentStream> > ccs;
+			page->getContentStreams (ccs);
+			CStream::Buffer empty;
+			for (size_t i = 0; i < ccs.size(); ++i)
+			{
+				CContentStream::CStreams streams;
+				ccs[i]->getCStreams (streams);
+				for (CContentStream::CStreams::iterator it = streams.begin(); it != streams.end(); ++it)
+					(*it)->setBuffer (empty);
+			}
+			recs.clear ();
+			CPPUNIT_ASSERT (0 == page->findText (tmp.substr (2,3), recs));
 		}
 	}
 	
@@ -203,6 +648,105 @@ findtext (UNUSED_PARAM ostream& oss, const char* fileName)
 }
 
 
+//=====================================================================================
+
+namespace {
+	/** Word which the index keeps whole (alphanumeric only). */
+	bool indexedWord (const string& word)
+	{
+		if (word.length() < 3)
+			return false;
+		for (size_t i = 0; i < word.length(); ++i)
+			if (!isalnum (static_cast<unsigned char> (word[i])))
+				return false;
+		return true;
+	}
+}
+
+bool
+textindex (UNUSED_PARAM ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		if (0 == pdf->getPageCount())
+			return true;
+
+	// Index all pages
+	TextIndex index;
+	CPPUNIT_ASSERT (pdf->getPageCount() == index.update (*pdf));
+	CPPUNIT_ASSERT (pdf->getPageCount() == index.getPageCount ());
+	CPPUNIT_ASSERT (0 == index.update (*pdf));
+
+	// Word occurences are found by page search as well
+	boost::shared_ptr<CPage> page = pdf->getPage (1);
+	string tmp;
+	page->getText (tmp);
+	istringstream words (tmp);
+	string word;
+	while (words >> word && !indexedWord (word))
+		;
+	if (indexedWord (word))
+	{
+		TextIndex::Hits hits;
+		index.find (word, hits);
+		std::vector<libs::Rectangle> recs;
+		page->findText (word, recs);
+		size_t onpage = 0;
+		for (TextIndex::Hits::const_iterator it = hits.begin(); it != hits.end(); ++it)
+			if (1 == it->page)
+				++onpage;
+		// the word is indexed on the page it was taken from
+		CPPUNIT_ASSERT (0 < onpage);
+		CPPUNIT_ASSERT (onpage <= recs.size());
+		oss << "Word: " << word << " indexed: " << hits.size() << " on page: " << recs.size() << flush;
+
+		// Saved index is the same
+		string file = TextIndex::getFileName (string (fileName) + "-textindex");
+		index.save (file);
+		TextIndex loaded;
+		// index of a document without ID is never accepted
+		if (!pdf->getTrailer()->containsProperty ("ID"))
+			CPPUNIT_ASSERT (!loaded.load (file, *pdf));
+		else
+		{
+			CPPUNIT_ASSERT (loaded.load (file, *pdf));
+			CPPUNIT_ASSERT (0 == loaded.update (*pdf));
+			TextIndex::Hits loadedhits;
+			loaded.find (word, loadedhits);
+			CPPUNIT_ASSERT (hits.size() == loadedhits.size());
+		}
+		remove (file.c_str());
+	}
+
+	// Only changed page is indexed again
+	std::vector<boost::shared_ptr<CContentStream> > ccs;
+	page->getContentStreams (ccs);
+	if (!ccs.empty())
+	{
+		CContentStream::Operators ops;
+		ccs.front()->getPdfOperators (ops);
+		if (!ops.empty())
+		{
+			ccs.front()->deleteOperator (ops.front());
+			CPPUNIT_ASSERT (1 == index.update (*pdf));
+		}
+	}
+
+	// Changed resources are indexed again too
+	boost::shared_ptr<CDict> dict = page->getDictionary ();
+	if (dict->containsProperty ("Resources"))
+	{
+		boost::shared_ptr<IProperty> res = utils::getReferencedObject (dict->getProperty ("Resources"));
+		if (isDict (res))
+		{
+			// resources may be shared by more pages
+			IProperty::getSmartCObjectPtr<CDict> (res)->addProperty ("PDFeditTextIndex", CName ("Changed"));
+			CPPUNIT_ASSERT (0 < index.update (*pdf));
+		}
+	}
+
+	return true;
+}
+
 //=====================================================================================
 
 bool
@@ -583,6 +1127,10 @@ public:
 	void TestDisplay ()
 	{
 		OUTPUT << "CPage display methods..." << endl;
+
+		TEST(" span kernels");
+		CPPUNIT_ASSERT (spankernels (OUTPUT));
+		OK_TEST;
 		
 		for(TestParams::FileList::const_iterator it = TestParams::instance().files.begin(); 
 				it != TestParams::instance().files.end(); 
@@ -593,6 +1141,18 @@ public:
 			TEST(" display");
 			CPPUNIT_ASSERT (display (OUTPUT, (*it).c_str()));
 			OK_TEST;
+
+			TEST(" render context");
+			CPPUNIT_ASSERT (rendercontext (OUTPUT, (*it).c_str()));
+			OK_TEST;
+
+			TEST(" display in bands");
+			CPPUNIT_ASSERT (displaybands (OUTPUT, (*it).c_str()));
+			OK_TEST;
+
+			TEST(" shared font files");
+			CPPUNIT_ASSERT (fontcache (OUTPUT, (*it).c_str()));
+			OK_TEST;
 		}
 	}
 	//
@@ -640,6 +1200,12 @@ public:
 			TEST(" find text");
 			CPPUNIT_ASSERT (findtext (OUTPUT, (*it).c_str()));
 			OK_TEST;
+
+			BEGIN_CHECK_READONLY;
+				TEST(" text index");
+				CPPUNIT_ASSERT (textindex (OUTPUT, (*it).c_str()));
+				OK_TEST;
+			END_CHECK_READONLY;
 		}
 	}
 	//
@@ -31,6 +31,7 @@
 #include "kernel/cpdf.h"
 #include "kernel/pdfwriter.h"
 #include "kernel/delinearizator.h"
+#include "kernel/flattener.h"
 
 using namespace pdfobjects;
 using namespace utils;
@@ -867,13 +868,21 @@ public:
 
 		printf("TC09:\tLatest revision allows changes\n");
 		pdf->changeRevision(pdf->getRevisionsCount()-1);
+		XRefWriter* latestXref = dynamic_cast<XRefWriter *>(pdf->getCXref());
+		CPPUNIT_ASSERT(latestXref);
+		int latestNumObjects = latestXref->getNumObjects();
 		shared_ptr<IProperty> newProp(CIntFactory::getInstance(1));
 		IndiRef ref = pdf->addIndirectProperty(newProp);
 		shared_ptr<IProperty> prop = pdf->getIndirectProperty(ref);
 		CPPUNIT_ASSERT(prop->getType()==pInt);
 		CPPUNIT_ASSERT(utils::getValueFromSimple<CInt>(prop)==1);
 
-		printf("TC10:\tchange done to the latest revision is preserved\n");
+		printf("TC10:\tgetNumObjects of the latest revision counts also new objects\n");
+		CPPUNIT_ASSERT(latestNumObjects>0);
+		CPPUNIT_ASSERT(latestNumObjects==latestXref->XRef::getNumObjects());
+		CPPUNIT_ASSERT(latestXref->getNumObjects()==latestNumObjects+1);
+
+		printf("TC11:\tchange done to the latest revision is preserved\n");
 		pdf->changeRevision(0);
 		pdf->changeRevision(pdf->getRevisionsCount()-1);
 		prop = pdf->getIndirectProperty(ref);
@@ -1117,6 +1126,79 @@ public:
 		CPPUNIT_ASSERT(changedIntProp->getIndiRef()==originalIntProp->getIndiRef());
 	}
 
+	/** Checks all pages positions against page tree searching.
+	 */
+	void checkPagePositions(boost::shared_ptr<CPdf> pdf)
+	{
+	using namespace pdfobjects::utils;
+
+		boost::shared_ptr<CDict> rootDict=getPageTreeRoot(pdf);
+		for(size_t pos=1; pos<=pdf->getPageCount(); ++pos)
+		{
+			boost::shared_ptr<CPage> page=pdf->getPage(pos);
+			CPPUNIT_ASSERT(page->getDictionary()==findPageDict(pdf, rootDict, 1, pos, NULL));
+			CPPUNIT_ASSERT(pdf->getPagePosition(page)==pos);
+		}
+	}
+
+	void pageIndexTC(string fileName)
+	{
+	using namespace boost;
+
+		printf("%s\n", __FUNCTION__);
+
+		boost::shared_ptr<CPdf> pdf=getTestCPdf(fileName.c_str(), CPdf::ReadWrite);
+		if(pdf->isLinearized() || pdf->getPageCount()<2)
+		{
+			printf("\t%s is not suitable for this test\n", fileName.c_str());
+			return;
+		}
+
+		printf("TC01:\tgetPage and getPagePosition match page tree.\n");
+		checkPagePositions(pdf);
+
+		printf("TC02:\tPositions are consistent after removePage.\n");
+		size_t pageCount=pdf->getPageCount();
+		size_t middle=(pageCount+1)/2;
+		shared_ptr<CPage> page=pdf->getPage(middle);
+		shared_ptr<CPage> last=pdf->getLastPage();
+		pdf->removePage(middle);
+		CPPUNIT_ASSERT(!page->isValid());
+		CPPUNIT_ASSERT(pdf->getPagePosition(last)==pageCount-1);
+		checkPagePositions(pdf);
+
+		printf("TC03:\tPositions are consistent after insertPage.\n");
+		shared_ptr<CPage> newPage=pdf->insertPage(page, 1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(newPage)==1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(last)==pageCount);
+		pdf->removePage(pageCount);
+		CPPUNIT_ASSERT(!last->isValid());
+		newPage=pdf->insertPage(last, pdf->getPageCount()+1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(newPage)==pageCount);
+		checkPagePositions(pdf);
+
+		printf("TC04:\tPositions are consistent after several insertPage in a row.\n");
+		pageCount=pdf->getPageCount();
+		middle=(pageCount+1)/2;
+		shared_ptr<CPage> first=pdf->getFirstPage();
+		last=pdf->getLastPage();
+		std::vector<shared_ptr<CPage> > inserted;
+		for(size_t i=0; i<3; ++i)
+			inserted.push_back(pdf->insertPage(first, 1));
+		for(size_t i=0; i<3; ++i)
+			inserted.push_back(pdf->insertPage(last, middle+3));
+		CPPUNIT_ASSERT(pdf->getPageCount()==pageCount+6);
+		CPPUNIT_ASSERT(pdf->getPagePosition(inserted[0])==3);
+		CPPUNIT_ASSERT(pdf->getPagePosition(inserted[2])==1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(inserted[3])==middle+5);
+		CPPUNIT_ASSERT(pdf->getPagePosition(inserted[5])==middle+3);
+		CPPUNIT_ASSERT(pdf->getPagePosition(last)==pageCount+6);
+		for(size_t i=0; i<3; ++i)
+			pdf->removePage(1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(inserted[5])==middle);
+		checkPagePositions(pdf);
+	}
+
 	void delinearizatorTC(string fileName)
 	{
 	using namespace pdfobjects::utils;
@@ -1139,6 +1221,125 @@ public:
 		delinearizator->delinearize(outputFile.c_str());
 	}
 
+	void xrefStreamTC(string fileName)
+	{
+	using namespace pdfobjects::utils;
+
+		printf("%s\n", __FUNCTION__);
+
+		boost::shared_ptr<CPdf> pdf=getTestCPdf(fileName.c_str(), CPdf::ReadOnly);
+		if(pdf->isLinearized())
+		{
+			printf("\t%s is not suitable for this test, because file is linearized\n", fileName.c_str());
+			return;
+		}
+
+		printf("TC01:\tFlattening with cross reference stream writer.\n");
+		boost::shared_ptr<Flattener> flattener=Flattener::getInstance(fileName.c_str(), new XRefStreamPdfWriter());
+		string outputFile=fileName+"-xrefstream.pdf";
+		CPPUNIT_ASSERT(flattener->flatten(outputFile.c_str())==0);
+		flattener.reset();
+
+		printf("TC02:\tFlattened document has the same pages.\n");
+		boost::shared_ptr<CPdf> outPdf=getTestCPdf(outputFile.c_str(), CPdf::ReadWrite);
+		CPPUNIT_ASSERT(outPdf->getPageCount()==pdf->getPageCount());
+		CPPUNIT_ASSERT(outPdf->getRevisionsCount()==1);
+
+		printf("TC03:\tIncremental update with cross reference stream writer.\n");
+		XRefWriter * xref=dynamic_cast<XRefWriter *>(outPdf->getCXref());
+		delete xref->setPdfWriter(new XRefStreamPdfWriter());
+		const int value=1234;
+		outPdf->getDictionary()->setProperty("XRefStreamTC", *CIntFactory::getInstance(value));
+		outPdf->save(true);
+		CPPUNIT_ASSERT(outPdf->getRevisionsCount()==2);
+		outPdf.reset();
+
+		printf("TC04:\tUpdated document keeps both revisions.\n");
+		outPdf=getTestCPdf(outputFile.c_str(), CPdf::ReadOnly);
+		CPPUNIT_ASSERT(outPdf->getRevisionsCount()==2);
+		CPPUNIT_ASSERT(outPdf->getPageCount()==pdf->getPageCount());
+		CPPUNIT_ASSERT(getIntFromDict("XRefStreamTC", outPdf->getDictionary())==value);
+		outPdf.reset();
+
+		printf("TC05:\tIncremental update with cross reference stream raises catalog Version.\n");
+		string oldStyleFile=fileName+"-xrefstream-oldstyle.pdf";
+		flattener=Flattener::getInstance(fileName.c_str(), new OldStylePdfWriter());
+		CPPUNIT_ASSERT(flattener->flatten(oldStyleFile.c_str())==0);
+		flattener.reset();
+		outPdf=getTestCPdf(oldStyleFile.c_str(), CPdf::ReadWrite);
+		xref=dynamic_cast<XRefWriter *>(outPdf->getCXref());
+		string headerVersion=xref->getPDFVersion();
+		delete xref->setPdfWriter(new XRefStreamPdfWriter());
+		outPdf->getDictionary()->setProperty("XRefStreamTC", *CIntFactory::getInstance(value));
+		outPdf->save(true);
+		outPdf.reset();
+		outPdf=getTestCPdf(oldStyleFile.c_str(), CPdf::ReadOnly);
+		xref=dynamic_cast<XRefWriter *>(outPdf->getCXref());
+		// header is kept, catalog declares the version
+		CPPUNIT_ASSERT(headerVersion==xref->getPDFVersion());
+		if(headerVersion<"1.5")
+			CPPUNIT_ASSERT(getNameFromDict("Version", outPdf->getDictionary())>="1.5");
+		CPPUNIT_ASSERT(getIntFromDict("XRefStreamTC", outPdf->getDictionary())==value);
+		outPdf.reset();
+
+		#if TEMP_FILES_CREATE
+		#else
+			remove (outputFile.c_str());
+			remove (oldStyleFile.c_str());
+		#endif
+	}
+
+	/** Flattens given file with given writer and number of threads.
+	 * @return content of the flattened document.
+	 */
+	string flattenToString(string fileName, pdfobjects::utils::IPdfWriter * writer, size_t threads)
+	{
+	using namespace pdfobjects::utils;
+
+		boost::shared_ptr<Flattener> flattener=Flattener::getInstance(fileName.c_str(), writer);
+		CPPUNIT_ASSERT(flattener);
+		flattener->setWorkerThreads(threads);
+		string outputFile=fileName+"-parallel.pdf";
+		CPPUNIT_ASSERT(flattener->flatten(outputFile.c_str())==0);
+		flattener.reset();
+
+		string content;
+		FILE * file=fopen(outputFile.c_str(), "rb");
+		CPPUNIT_ASSERT(file);
+		char buffer[BUFSIZ];
+		size_t read;
+		while((read=fread(buffer, sizeof(char), BUFSIZ, file))>0)
+			content.append(buffer, read);
+		fclose(file);
+		remove(outputFile.c_str());
+		return content;
+	}
+
+	void parallelWriterTC(string fileName)
+	{
+	using namespace pdfobjects::utils;
+
+		printf("%s\n", __FUNCTION__);
+
+		boost::shared_ptr<CPdf> pdf=getTestCPdf(fileName.c_str(), CPdf::ReadOnly);
+		if(pdf->isLinearized())
+		{
+			printf("\t%s is not suitable for this test, because file is linearized\n", fileName.c_str());
+			return;
+		}
+		pdf.reset();
+
+		printf("TC01:\tParallel flattening produces same data as serial.\n");
+		string serial=flattenToString(fileName, new OldStylePdfWriter(), 1);
+		CPPUNIT_ASSERT(!serial.empty());
+		CPPUNIT_ASSERT(serial==flattenToString(fileName, new OldStylePdfWriter(), 4));
+
+		printf("TC02:\tParallel flattening with cross reference stream writer.\n");
+		serial=flattenToString(fileName, new XRefStreamPdfWriter(), 1);
+		CPPUNIT_ASSERT(!serial.empty());
+		CPPUNIT_ASSERT(serial==flattenToString(fileName, new XRefStreamPdfWriter(), 4));
+	}
+
 #define staticArraySize(array) sizeof(array)/sizeof(*array)
 	void changeTrailerTC(string& fname)
 	{
@@ -1350,8 +1551,11 @@ public:
 			indirectPropertyTC(pdf);
 			pageManipulationTC(pdf);
 			linearizedTC(pdf);
+			pageIndexTC(fileName);
 
 			delinearizatorTC(fileName);
+			xrefStreamTC(fileName);
+			parallelWriterTC(fileName);
 			changeTrailerTC(fileName);
 		}
 		revisionsTC();
@@ -262,6 +262,36 @@ bool testdict (UNUSED_PARAM std::ostream& oss, const char* fileName)
 	return true;
 }
 
+//=========================================================================
+bool lazybuffer (UNUSED_PARAM std::ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	// Pages may share their content stream
+	std::set<const CStream*> seen;
+
+	for (size_t i = 0; i < pdf->getPageCount(); ++i)
+	{
+		boost::shared_ptr<CPage> page = pdf->getPage (i+1);
+		boost::shared_ptr<CStream> stream = getTestStreamContent (page);
+
+		// Buffer has to be read on demand and match Length
+		int len = 0;
+		stream->getProperty<CInt>("Length")->getValue (len);
+		if (seen.insert (stream.get()).second)
+			CPPUNIT_ASSERT (!stream->isBufferLoaded ());
+		const CStream::Buffer& buf = stream->getBuffer ();
+		CPPUNIT_ASSERT (stream->isBufferLoaded ());
+		CPPUNIT_ASSERT (buf.size() == static_cast<size_t> (len));
+
+		// Clone has its own copy of data
+		boost::shared_ptr<CStream> clone = IProperty::getSmartCObjectPtr<CStream> (stream->clone ());
+		CPPUNIT_ASSERT (clone->isBufferLoaded ());
+		CPPUNIT_ASSERT (clone->getBuffer () == buf);
+	}
+
+	return true;
+}
+
 //=========================================================================
 bool testmakexpdf (UNUSED_PARAM std::ostream& oss, const char* fileName)
 {
@@ -328,6 +358,10 @@ public:
 				CPPUNIT_ASSERT (setbuffer (OUTPUT, (*it).c_str()));
 				OK_TEST;
 			END_CHECK_READONLY;
+
+			TEST(" lazy buffer");
+			CPPUNIT_ASSERT (lazybuffer (OUTPUT, (*it).c_str()));
+			OK_TEST;
 		}
 	}
 	//
@@ -25,6 +25,7 @@
 
 #include "kernel/static.h"
 #include <errno.h>
+#include <zlib.h>
 #include "tests/kernel/testmain.h"
 #include "tests/kernel/testcpdf.h"
 
@@ -215,6 +216,213 @@ public:
 		}
 	}
 	
+	/** Reads whole stream content in blocks with given size.
+	 * @param str Stream to read.
+	 * @param blockSize Size of one block.
+	 * @param data Output buffer.
+	 */
+	void readBlocks(Stream * str, int blockSize, std::string & data)
+	{
+		std::vector<char> block(blockSize);
+		int len;
+		str->reset();
+		while((len=str->getBlock(&block[0], blockSize))>0)
+		{
+			data.append(&block[0], len);
+			if(len<blockSize)
+				break;
+		}
+		// nothing more after a short read
+		CPPUNIT_ASSERT(str->getChar()==EOF);
+	}
+
+	/** Reads whole stream content with getChar.
+	 * @param str Stream to read.
+	 * @param data Output buffer.
+	 */
+	void readChars(Stream * str, std::string & data)
+	{
+		int ch;
+		str->reset();
+		while((ch=str->getChar())!=EOF)
+			data.append(1, (char)ch);
+	}
+
+	void getBlockTC(boost::shared_ptr<CPdf> pdf)
+	{
+		printf("%s\n", __FUNCTION__);
+
+		printf("TC07:\tgetBlock returns same data as getChar for all streams\n");
+		const int blockSizes[] = {1, 7, 256, 4096};
+		XRef * xref = pdf->getCXref();
+		for(int num=1; num<xref->getSize(); ++num)
+		{
+			XRefEntry * entry = xref->getEntry(num);
+			if(entry->type==xrefEntryFree)
+				continue;
+			Object obj;
+			int gen = (entry->type==xrefEntryCompressed) ? 0 : entry->gen;
+			xref->fetch(num, gen, &obj);
+			if(!obj.isStream())
+			{
+				obj.free();
+				continue;
+			}
+			std::string chars;
+			readChars(obj.getStream(), chars);
+			for(size_t i=0; i<sizeof(blockSizes)/sizeof(*blockSizes); ++i)
+			{
+				std::string blocks;
+				readBlocks(obj.getStream(), blockSizes[i], blocks);
+				CPPUNIT_ASSERT(chars==blocks);
+			}
+			obj.free();
+		}
+	}
+
+	void filtersTC()
+	{
+		printf("%s\n", __FUNCTION__);
+
+		printf("TC08:\tgetBlock of ASCIIHex, ASCII85 and RunLength filters\n");
+		const char * filters[] = {"ASCIIHexDecode", "ASCII85Decode", "RunLengthDecode", NULL};
+		const char * data[] = {
+			"48 65 6c6c6F2c 20776f726c64>", 
+			"87cURD_*#TDfTZ)~>", 
+			"\004Hello\375!\001xy\200", 
+			NULL};
+		const char * expected[] = {"Hello, world", "Hello, world", "Hello!!!!xy", NULL};
+		for(int i=0; filters[i]; ++i)
+		{
+			Object dict, filter;
+			dict.initDict((XRef *)NULL);
+			dict.dictAdd(copyString("Filter"), filter.initName(filters[i]));
+			Stream * str = new MemStream((char *)data[i], 0, strlen(data[i]), &dict);
+			str = str->addFilters(&dict);
+			std::string chars, blocks;
+			readChars(str, chars);
+			CPPUNIT_ASSERT(chars==expected[i]);
+			readBlocks(str, 5, blocks);
+			CPPUNIT_ASSERT(chars==blocks);
+			// stream owns dictionary
+			delete str;
+		}
+	}
+
+	void flateEnginesTC(boost::shared_ptr<CPdf> pdf)
+	{
+		printf("%s\n", __FUNCTION__);
+
+		printf("TC09:\tzlib and built-in flate decoders produce same data\n");
+		GBool zlibInflate = FlateStream::getZlibInflate();
+		XRef * xref = pdf->getCXref();
+		for(int num=1; num<xref->getSize(); ++num)
+		{
+			XRefEntry * entry = xref->getEntry(num);
+			if(entry->type==xrefEntryFree)
+				continue;
+			Object obj;
+			int gen = (entry->type==xrefEntryCompressed) ? 0 : entry->gen;
+			xref->fetch(num, gen, &obj);
+			if(!obj.isStream())
+			{
+				obj.free();
+				continue;
+			}
+			std::string builtin, zlib;
+			FlateStream::setZlibInflate(gFalse);
+			readBlocks(obj.getStream(), 4096, builtin);
+			FlateStream::setZlibInflate(gTrue);
+			readBlocks(obj.getStream(), 4096, zlib);
+			CPPUNIT_ASSERT(builtin==zlib);
+			obj.free();
+		}
+		FlateStream::setZlibInflate(zlibInflate);
+	}
+
+	/** PNG predictor function for given filter type.
+	 * @param type PNG filter type (0-4).
+	 * @param a Left byte.
+	 * @param b Up byte.
+	 * @param c Up left byte.
+	 */
+	static int pngPredict(int type, int a, int b, int c)
+	{
+		int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+		switch(type)
+		{
+			case 1: return a;
+			case 2: return b;
+			case 3: return (a + b) / 2;
+			case 4: return (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+		}
+		return 0;
+	}
+
+	void predictorsTC()
+	{
+		printf("%s\n", __FUNCTION__);
+
+		printf("TC10:\tPNG and TIFF predictors decode encoded lines\n");
+		const int width = 37, height = 20;
+		const int colors[] = {1, 2, 3, 4, 6};
+		GBool zlibInflate = FlateStream::getZlibInflate();
+		for(size_t ci=0; ci<sizeof(colors)/sizeof(*colors); ++ci)
+		{
+			int bpp = colors[ci], rowBytes = width * bpp;
+			std::string image, png, tiff;
+			for(int i=0; i<rowBytes*height; ++i)
+				image.append(1, (char)((i * 7 + (i / rowBytes) * 13 + (i * i) % 11) & 0xff));
+			for(int y=0; y<height; ++y)
+			{
+				// each line uses different PNG filter
+				int type = y % 5;
+				png.append(1, (char)type);
+				for(int x=0; x<rowBytes; ++x)
+				{
+					const unsigned char * cur = (const unsigned char *)image.data() + y * rowBytes;
+					const unsigned char * up = (y > 0) ? cur - rowBytes : cur;
+					int a = (x >= bpp) ? cur[x - bpp] : 0;
+					int b = (y > 0) ? up[x] : 0;
+					int c = (y > 0 && x >= bpp) ? up[x - bpp] : 0;
+					png.append(1, (char)(cur[x] - pngPredict(type, a, b, c)));
+					tiff.append(1, (char)(cur[x] - a));
+				}
+			}
+			const std::string * encoded[] = {&png, &tiff};
+			const int predictors[] = {15, 2};
+			for(int pi=0; pi<2; ++pi)
+			{
+				uLongf zlen = compressBound(encoded[pi]->size());
+				std::vector<char> zdata(zlen);
+				CPPUNIT_ASSERT(compress((Bytef *)&zdata[0], &zlen, 
+						(const Bytef *)encoded[pi]->data(), encoded[pi]->size())==Z_OK);
+				for(int engine=0; engine<2; ++engine)
+				{
+					FlateStream::setZlibInflate(engine ? gTrue : gFalse);
+					Object dict, obj, parms;
+					dict.initDict((XRef *)NULL);
+					dict.dictAdd(copyString("Filter"), obj.initName("FlateDecode"));
+					parms.initDict((XRef *)NULL);
+					parms.dictAdd(copyString("Predictor"), obj.initInt(predictors[pi]));
+					parms.dictAdd(copyString("Colors"), obj.initInt(bpp));
+					parms.dictAdd(copyString("Columns"), obj.initInt(width));
+					dict.dictAdd(copyString("DecodeParms"), &parms);
+					Stream * str = new MemStream(&zdata[0], 0, zlen, &dict);
+					str = str->addFilters(&dict);
+					std::string chars, blocks;
+					readChars(str, chars);
+					CPPUNIT_ASSERT(chars==image);
+					readBlocks(str, 100, blocks);
+					CPPUNIT_ASSERT(blocks==image);
+					// stream owns dictionary
+					delete str;
+				}
+			}
+		}
+		FlateStream::setZlibInflate(zlibInflate);
+	}
+
 	virtual ~TestStream()
 	{
 	}
@@ -237,7 +445,11 @@ public:
 			fileStreamTC(*i);
 			boost::shared_ptr<CPdf> pdf=CPdf::getInstance((*i).c_str(), CPdf::ReadOnly);
 			contentStreamTC(pdf);
+			getBlockTC(pdf);
+			flateEnginesTC(pdf);
 		}
+		filtersTC();
+		predictorsTC();
 	}
 };
 CPPUNIT_TEST_SUITE_REGISTRATION(TestStream);
@@ -27,6 +27,8 @@
 #include <errno.h>
 #include "tests/kernel/testmain.h"
 #include "kernel/streamwriter.h"
+#include "kernel/pdfwriter.h"
+#include <zlib.h>
 
 	
 class TestStreamWriter: public CppUnit::TestFixture
@@ -116,6 +118,129 @@ public:
 		remove(cloneName.c_str());
 	}
 		
+	void memStreamWriterTC()
+	{
+		printf("%s\n", __FUNCTION__);
+
+		Object dict;
+		dict.initNull();
+		// small initial size to force buffer reallocations
+		MemStreamWriter * streamWriter=new MemStreamWriter(&dict, 2);
+
+		printf("TC01:\tWritten data are readable from the stream\n");
+		string data="first line";
+		streamWriter->putLine(data.c_str(), data.length());
+		streamWriter->putBuffer(data.c_str(), data.length());
+		string expected=data+"\n"+data;
+		CPPUNIT_ASSERT(streamWriter->getDataLength()==expected.length());
+		CPPUNIT_ASSERT(string(streamWriter->getData(), streamWriter->getDataLength())==expected);
+		streamWriter->reset();
+		for(size_t i=0; i<expected.length(); i++)
+			CPPUNIT_ASSERT(streamWriter->getChar()==expected[i]);
+		CPPUNIT_ASSERT(streamWriter->getChar()==EOF);
+
+		printf("TC02:\tData are overwritten at current position\n");
+		streamWriter->setPos(0);
+		streamWriter->putChar('F');
+		expected[0]='F';
+		CPPUNIT_ASSERT(string(streamWriter->getData(), streamWriter->getDataLength())==expected);
+		CPPUNIT_ASSERT(streamWriter->getPos()==1);
+
+		printf("TC03:\ttrim removes data\n");
+		CPPUNIT_ASSERT(!streamWriter->trim(expected.length()+1));
+		CPPUNIT_ASSERT(streamWriter->trim(data.length()));
+		CPPUNIT_ASSERT(streamWriter->getDataLength()==data.length());
+		streamWriter->setPos(0, -1);
+		streamWriter->putChar('\n');
+		CPPUNIT_ASSERT(string(streamWriter->getData(), streamWriter->getDataLength())==expected.substr(0, data.length()+1));
+
+		delete streamWriter;
+	}
+		
+	/** Writes stream with given data by ZlibFilterStreamWriter.
+	 * @param data Stream data.
+	 * @param compressed Output for compressed stream data.
+	 */
+	void zlibCompress(const string & data, string & compressed)
+	{
+		using namespace pdfobjects::utils;
+
+		Object dict, obj;
+		dict.initDict((XRef *)NULL);
+		dict.dictAdd(copyString("Length"), obj.initInt(data.length()));
+		Object streamObj;
+		streamObj.initStream(new MemStream((char *)data.c_str(), 0, data.length(), &dict));
+		Object outDict;
+		outDict.initNull();
+		MemStreamWriter streamWriter(&outDict);
+		ZlibFilterStreamWriter::getInstance()->compress(streamObj, NULL, streamWriter);
+
+		Object length;
+		streamObj.streamGetDict()->lookup("Length", &length);
+		CPPUNIT_ASSERT(length.isInt());
+		string written(streamWriter.getData(), streamWriter.getDataLength());
+		size_t pos=written.find(Specification::CSTREAM_HEADER);
+		CPPUNIT_ASSERT(pos!=string::npos);
+		compressed=written.substr(pos+Specification::CSTREAM_HEADER.length(), length.getInt());
+		streamObj.free();
+	}
+
+	void zlibFilterStreamWriterTC()
+	{
+		using namespace pdfobjects::utils;
+
+		printf("%s\n", __FUNCTION__);
+
+		boost::shared_ptr<ZlibFilterStreamWriter> writer=ZlibFilterStreamWriter::getInstance();
+		int level=writer->getLevel();
+		string data;
+		for(int i=0; data.length()<300*1024; ++i)
+		{
+			char line[64];
+			snprintf(line, sizeof(line), "%d %d Td (line %d) Tj\n", i%100, i%37, i*i%1013);
+			data+=line;
+		}
+
+		printf("TC01:\tcompressed data are same for all levels after inflate\n");
+		const int levels[] = {Z_BEST_SPEED, Z_DEFAULT_COMPRESSION, Z_BEST_COMPRESSION};
+		size_t sizes[3];
+		for(int i=0; i<3; ++i)
+		{
+			writer->setLevel(levels[i]);
+			string compressed;
+			zlibCompress(data, compressed);
+			sizes[i]=compressed.length();
+			vector<Bytef> out(data.length());
+			uLongf outLen=out.size();
+			CPPUNIT_ASSERT(uncompress(&out[0], &outLen, (const Bytef *)compressed.data(), compressed.length())==Z_OK);
+			CPPUNIT_ASSERT(string((const char *)&out[0], outLen)==data);
+		}
+		CPPUNIT_ASSERT(sizes[2]<=sizes[0]);
+
+		printf("TC02:\tstream compressed in blocks by more threads is correct zlib stream\n");
+		writer->setBlockCompression(3, 16*1024);
+		string compressed;
+		zlibCompress(data, compressed);
+		vector<Bytef> out(data.length());
+		uLongf outLen=out.size();
+		CPPUNIT_ASSERT(uncompress(&out[0], &outLen, (const Bytef *)compressed.data(), compressed.length())==Z_OK);
+		CPPUNIT_ASSERT(string((const char *)&out[0], outLen)==data);
+
+		writer->setBlockCompression(1);
+		writer->setLevel(level);
+
+		printf("TC03:\tstreams with external data are not supported\n");
+		Object dict, obj;
+		dict.initDict((XRef *)NULL);
+		dict.dictAdd(copyString("Length"), obj.initInt(0));
+		dict.dictAdd(copyString("F"), obj.initString(new GString("data.bin")));
+		dict.dictAdd(copyString("FFilter"), obj.initName("FlateDecode"));
+		Object streamObj;
+		streamObj.initStream(new MemStream((char *)data.c_str(), 0, 0, &dict));
+		CPPUNIT_ASSERT(!writer->supportObject(streamObj));
+		streamObj.free();
+	}
+
 	virtual ~TestStreamWriter()
 	{
 	}
@@ -131,6 +256,9 @@ public:
 
 	void Test()
 	{
+		memStreamWriterTC();
+		zlibFilterStreamWriterTC();
+
 		// creates pdf instances for all files
 		for(TestParams::FileList::const_iterator i = TestParams::instance().files.begin(); 
 				i != TestParams::instance().files.end(); 
@@ -334,12 +334,77 @@ public:
 		return true;
 	}
 
+	bool denseObjectStorageTC()
+	{
+		OUTPUT << __FUNCTION__<<endl;
+
+		typedef DenseObjectStorage< ::Ref, int, xpdf::RefComparator> Storage;
+		Storage storage;
+		::Ref r10={10, 0}, r10g1={10, 1}, r3={3, 0}, r0={0, 0};
+
+		OUTPUT << "TC01:\tEmpty storage doesn't contain anything\n";
+		CPPUNIT_ASSERT(storage.size()==0);
+		CPPUNIT_ASSERT(!storage.contains(r10));
+		CPPUNIT_ASSERT(storage.get(r10)==0);
+		CPPUNIT_ASSERT(storage.begin()==storage.end());
+
+		OUTPUT << "TC02:\tput inserts new and replaces existing values\n";
+		CPPUNIT_ASSERT(storage.put(r10, 1)==0);
+		CPPUNIT_ASSERT(storage.put(r3, 2)==0);
+		CPPUNIT_ASSERT(storage.put(r10, 3)==1);
+		CPPUNIT_ASSERT(storage.size()==2);
+		CPPUNIT_ASSERT(storage.get(r10)==3);
+		CPPUNIT_ASSERT(storage.get(r3)==2);
+		CPPUNIT_ASSERT(!storage.contains(r0));
+
+		OUTPUT << "TC03:\tgeneration number is checked\n";
+		CPPUNIT_ASSERT(!storage.contains(r10g1));
+		CPPUNIT_ASSERT(storage.put(r10g1, 4)==0);
+		CPPUNIT_ASSERT(storage.size()==3);
+		CPPUNIT_ASSERT(storage.get(r10g1)==4);
+		CPPUNIT_ASSERT(storage.get(r10)==3);
+
+		OUTPUT << "TC04:\titeration visits all associations\n";
+		int sum=0, count=0;
+		for(Storage::Iterator i=storage.begin(); i!=storage.end(); ++i, ++count)
+			sum+=i->second;
+		CPPUNIT_ASSERT(count==3 && sum==9);
+		CPPUNIT_ASSERT(storage.begin()->first.num==3);
+
+		OUTPUT << "TC05:\tremove discards just given reference\n";
+		CPPUNIT_ASSERT(storage.remove(r10)==3);
+		CPPUNIT_ASSERT(storage.remove(r10)==0);
+		CPPUNIT_ASSERT(storage.get(r10g1)==4);
+		CPPUNIT_ASSERT(storage.remove(r10g1)==4);
+		CPPUNIT_ASSERT(storage.size()==1);
+
+		OUTPUT << "TC06:\tkey in overflow is not stored again to freed slot\n";
+		CPPUNIT_ASSERT(storage.put(r10, 5)==0);
+		CPPUNIT_ASSERT(storage.put(r10g1, 6)==0);
+		CPPUNIT_ASSERT(storage.remove(r10)==5);
+		CPPUNIT_ASSERT(storage.put(r10g1, 7)==6);
+		CPPUNIT_ASSERT(storage.size()==2);
+		CPPUNIT_ASSERT(storage.remove(r10g1)==7);
+		CPPUNIT_ASSERT(!storage.contains(r10g1));
+		CPPUNIT_ASSERT(storage.get(r10g1)==0);
+		CPPUNIT_ASSERT(storage.size()==1);
+
+		OUTPUT << "TC07:\tclear removes everything\n";
+		storage.clear();
+		CPPUNIT_ASSERT(storage.size()==0);
+		CPPUNIT_ASSERT(!storage.contains(r3));
+		const Storage & constStorage=storage;
+		CPPUNIT_ASSERT(constStorage.begin()==constStorage.end());
+		return true;
+	}
+
 	void Test()
 	{
 		CPPUNIT_ASSERT(tokenizerTC());
 		CPPUNIT_ASSERT(modeControllerTC());
 		CPPUNIT_ASSERT(operatorHinterTC());
 		CPPUNIT_ASSERT(observerHandlerTC());
+		CPPUNIT_ASSERT(denseObjectStorageTC());
 	}
 };
 CPPUNIT_TEST_SUITE_REGISTRATION(TestUtils);
@@ -28,15 +28,21 @@
 
 using namespace pdfobjects;
 #define suffix ".flatten"
-int flatten_file(const char *fname)
+int flatten_file(const char *fname, bool xrefStream, size_t threads)
 {
 using namespace utils;
+	IPdfWriter *writer;
+	if(xrefStream)
+		writer = new XRefStreamPdfWriter();
+	else
+		writer = new OldStylePdfWriter();
 	boost::shared_ptr<utils::Flattener> flattener = 
-		Flattener::getInstance(fname, new OldStylePdfWriter()); 
+		Flattener::getInstance(fname, writer); 
 	if(!flattener) {
 		std::cerr << "Unable to open "<<fname<<" file"<<std::endl;
 		return 1;
 	}
+	flattener->setWorkerThreads(threads);
 	std::string outputFile(fname);
 	outputFile+=suffix;
 	std::cout << "Writing output to "<<outputFile<<std::endl;
@@ -52,12 +58,28 @@ int main(int argc, char** argv)
 	}
 	//debug::changeDebugLevel(debug::utilsDebugTarget, debug::DBG_DBG);
 	int ret = 0;
+	// -x option makes output with compressed cross reference and object
+	// streams (PDF 1.5)
+	bool xrefStream = false;
+	// -j N option sets number of threads used for objects serialization
+	// (0 - default - uses all available processors, 1 writes in this thread)
+	size_t threads = 0;
 	for(int i=1; i<argc; ++i)
 	{
 		const char *fname= argv[i];
+		if(!strcmp(fname, "-x"))
+		{
+			xrefStream = true;
+			continue;
+		}
+		if(!strcmp(fname, "-j") && i+1<argc)
+		{
+			threads = atoi(argv[++i]);
+			continue;
+		}
 		try
 		{
-			ret = flatten_file(fname);
+			ret = flatten_file(fname, xrefStream, threads);
 		}catch(...)
 		{
 			std::cerr << fname << " is not a valid pdf document - ignoring"<<std::endl;
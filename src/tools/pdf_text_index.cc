@@ -0,0 +1,151 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+/*
+ * Full-text index of a document.
+ *
+ * Builds or refreshes the sidecar index of a document (only pages changed
+ * since the index was saved are indexed again) and looks up words in it.
+ */
+#include <kernel/pdfedit-core-dev.h>
+#include <kernel/cpdf.h>
+#include <kernel/textindex.h>
+#include <boost/program_options.hpp>
+#include <sys/time.h>
+#include <vector>
+
+using namespace pdfobjects;
+using namespace std;
+using namespace boost;
+namespace po = program_options;
+
+namespace {
+
+	// default values
+	const string DEFAULT_FONT_DIR( "." );
+
+	struct _time {
+		struct timeval _start;
+		_time () {gettimeofday(&_start, NULL);}
+		std::string passed () const
+		{
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			std::ostringstream oss;
+			oss << (now.tv_sec - _start.tv_sec)*1000 + (now.tv_usec - _start.tv_usec)/1000;
+			return oss.str();
+		}
+	};
+
+	// library wrapper
+	struct _pdf_lib {
+		bool _ok;
+		_pdf_lib (int argc, char ** argv, const string& font_dir) {
+			struct pdfedit_core_dev_init init = {0};
+			init.fontDir = font_dir.c_str();
+			_ok = (0 == pdfedit_core_dev_init(&argc, &argv, &init));
+		}
+		~_pdf_lib () {pdfedit_core_dev_destroy();}
+	};
+}
+
+int 
+main(int argc, char ** argv)
+{
+	// 
+	// parameter parsing
+	//
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("file", po::value<string>(), "input file")
+		("index", po::value<string>(), "index file (default input file with .idx suffix)")
+		("rebuild", po::value<bool>()->default_value(false), "ignore saved index and index all pages")
+		("find", po::value<vector<string> >(), "words to find")
+		("font-dir", po::value<string>()->default_value(DEFAULT_FONT_DIR), "(xpdf) font directory with font definitions(e.g. N019003L.PFB)")
+	;
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);    
+	}catch(std::exception& e)
+	{
+		std::cout << "exception - " << e.what() << ". Please, check your parameters." << endl;
+		return 1;
+	}
+
+		if (vm.count("help") || !vm.count("file")) 
+		{
+			cout << desc << endl;
+			return 1;
+		}
+	string file = vm["file"].as<string>(); 
+	string index_file = vm.count("index") ? vm["index"].as<string>() : TextIndex::getFileName (file);
+	bool rebuild = vm["rebuild"].as<bool>();
+	vector<string> finds;
+	if (vm.count("find"))
+		finds = vm["find"].as<vector<string> >();
+	string font_dir = vm["font-dir"].as<string>();
+
+	// 
+	// pdf lib init & work
+	//
+	try
+	{
+		_pdf_lib _lib(argc, argv, font_dir);
+			if (!_lib._ok)
+				return 1;
+
+		// open pdf
+		shared_ptr<CPdf> pdf = CPdf::getInstance (file.c_str(), CPdf::ReadOnly);
+
+		// load the index and index changed pages
+		_time update_time;
+		TextIndex index;
+		bool loaded = !rebuild && index.load (index_file, *pdf);
+		size_t updated = index.update (*pdf);
+		if (!loaded || updated)
+			index.save (index_file);
+		cerr << "indexed " << updated << " of " << index.getPageCount() << " pages" 
+			 << (loaded ? " (index loaded)" : "") << " [" << update_time.passed() << "]" << endl;
+
+		// find words
+		for (vector<string>::const_iterator it = finds.begin(); it != finds.end(); ++it)
+		{
+			_time find_time;
+			TextIndex::Hits hits;
+			index.find (*it, hits);
+			cout << *it << ": " << hits.size() << " [" << find_time.passed() << "]" << endl;
+			for (TextIndex::Hits::const_iterator hit = hits.begin(); hit != hits.end(); ++hit)
+				cout << "\tpage " << hit->page << " " << hit->rc << endl;
+		}
+	
+	}catch (std::exception& e)
+	{
+		std::cout << "exception - " << e.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
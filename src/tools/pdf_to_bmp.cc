@@ -46,6 +46,7 @@ namespace po = program_options;
 int main()
 {
 	std::cerr << "This tool is not implemented for non Windows environment :(" << std::endl;
+	std::cerr << "Use pdf_to_image instead." << std::endl;
 	return 1;
 }
 
@@ -0,0 +1,384 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+
+/*
+ * Headless page rasterizer.
+ *
+ * Renders selected pages (all by default) with SplashOutputDev and stores
+ * them as PPM or PNG images. Pages are rendered by several worker threads,
+ * each of them has its own CPdf instance and output device, so no kernel
+ * or xpdf document structures are shared between workers. Large pages can
+ * be also split into bands (--bands) which are rendered in parallel.
+ */
+#include <kernel/pdfedit-core-dev.h>
+#include <kernel/cpdf.h>
+#include <kernel/cpage.h>
+#include <splash/SplashBitmap.h>
+#include <xpdf/GlobalParams.h>
+#include <xpdf/SplashOutputDev.h>
+
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <sys/time.h>
+#include <png.h>
+
+using namespace pdfobjects;
+using namespace std;
+using namespace boost;
+namespace po = program_options;
+
+namespace {
+
+	// default values
+	const string DEFAULT_FORMAT( "ppm" );
+	const string DEFAULT_FONT_DIR( "." );
+	const size_t DEFAULT_DPI = 72;
+
+	struct _time {
+		struct timeval _start;
+		_time () {gettimeofday(&_start, NULL);}
+		std::string passed () const
+		{
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			std::ostringstream oss;
+			oss << (now.tv_sec - _start.tv_sec)*1000 + (now.tv_usec - _start.tv_usec)/1000;
+			return oss.str();
+		}
+	};
+
+	// pages
+	typedef vector<size_t> Pages;
+	// library wrapper
+	struct _pdf_lib {
+		bool _ok;
+		_pdf_lib (int argc, char ** argv, const string& font_dir) {
+			struct pdfedit_core_dev_init init = {0};
+			init.fontDir = font_dir.c_str();
+			_ok = (0 == pdfedit_core_dev_init(&argc, &argv, &init));
+		}
+		~_pdf_lib () {pdfedit_core_dev_destroy();}
+	};
+
+	// to ppm (rows are written at once instead of per byte)
+	static bool save_ppm(const std::string& file, SplashBitmap * bitmap)
+	{
+		FILE * fp = fopen(file.c_str(), "wb");
+		if (!fp)
+			return false;
+
+		fprintf(fp, "P6\n%d %d\n255\n", bitmap->getWidth(), bitmap->getHeight());
+		size_t width = 3 * bitmap->getWidth();
+		SplashColorPtr row = bitmap->getDataPtr();
+		bool ok = true;
+		for (int y = 0; ok && y < bitmap->getHeight(); ++y, row += bitmap->getRowSize())
+			ok = (width == fwrite(row, 1, width, fp));
+
+		return (0 == fclose(fp)) && ok;
+	}
+
+	// to png
+	static bool save_png(const std::string& file, SplashBitmap * bitmap)
+	{
+		FILE * fp = fopen(file.c_str(), "wb");
+		if (!fp)
+			return false;
+
+		png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+		png_infop info_ptr = (png_ptr) ? png_create_info_struct(png_ptr) : NULL;
+		if (!info_ptr || setjmp(png_jmpbuf(png_ptr)))
+		{
+			png_destroy_write_struct(&png_ptr, (info_ptr) ? &info_ptr : NULL);
+			fclose(fp);
+			return false;
+		}
+
+		png_init_io(png_ptr, fp);
+		png_set_IHDR(png_ptr, info_ptr, bitmap->getWidth(), bitmap->getHeight(),
+				8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+				PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_write_info(png_ptr, info_ptr);
+		SplashColorPtr row = bitmap->getDataPtr();
+		for (int y = 0; y < bitmap->getHeight(); ++y, row += bitmap->getRowSize())
+			png_write_row(png_ptr, row);
+		png_write_end(png_ptr, info_ptr);
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+
+		fclose(fp);
+		return true;
+	}
+
+	// rendering settings shared by all workers
+	struct _settings {
+		size_t hdpi, vdpi;
+		size_t bands;
+		bool antialias;
+		bool png;
+		string prefix;
+	};
+
+	// what to do with a page
+	struct _imagify {
+		string operator () (shared_ptr<CPage> page,
+							SplashOutputDev& splash,
+							const std::string& file,
+							const _settings& settings)
+		{
+			_time time;
+
+			// alter display params
+			pdfobjects::DisplayParams displayparams;
+			displayparams.hDpi = settings.hdpi;
+			displayparams.vDpi = settings.vdpi;
+			displayparams.bands = settings.bands;
+
+			// display it = create internal splash bitmap
+			page->displayPage (splash, displayparams);
+			splash.clearModRegion();
+			std::string result = std::string (" [paint:") + time.passed() + std::string ("]");
+
+			_time save_time;
+			SplashBitmap * bitmap = splash.getBitmap();
+			bool ok = (settings.png) ? save_png(file, bitmap) : save_ppm(file, bitmap);
+			if (!ok)
+				throw std::runtime_error("unable to write " + file);
+			result += std::string (" [save:") + save_time.passed() + std::string ("]");
+
+			return result;
+		}
+	};
+
+	// pages which are waiting for a worker
+	struct _queue {
+		const Pages& _pages;
+		size_t _next;
+		size_t _failed;
+		boost::mutex _mutex;
+
+		_queue (const Pages& pages) : _pages (pages), _next (0), _failed (0) {}
+
+		bool get (size_t& page)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			if (_next >= _pages.size())
+				return false;
+			page = _pages[_next++];
+			return true;
+		}
+
+		// reports page result atomically
+		void report (const std::string& msg, bool failed)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			if (failed)
+				++_failed;
+			std::cout << msg << std::endl;
+		}
+	};
+
+	// one rendering thread with its own document and output device
+	struct _worker {
+		shared_ptr<CPdf> _pdf;
+		_queue& _pending;
+		const _settings& _conf;
+
+		_worker (shared_ptr<CPdf> pdf, _queue& pending, const _settings& conf)
+			: _pdf (pdf), _pending (pending), _conf (conf) {}
+
+		void operator () ()
+		{
+			SplashColor paperColor;
+			paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+			SplashOutputDev splash (splashModeRGB8, 4, gFalse, paperColor, gTrue, _conf.antialias);
+			splash.startDoc(_pdf->getCXref());
+
+			size_t pos;
+			while (_pending.get(pos))
+			{
+				ostringstream oss;
+				oss << _conf.prefix << pos << ((_conf.png) ? ".png" : ".ppm");
+				ostringstream msg;
+				msg << "Page " << pos;
+				_time time;
+				try
+				{
+					shared_ptr<CPage> page = _pdf->getPage(pos);
+					msg << _imagify()(page, splash, oss.str(), _conf);
+					msg << " [all:" << time.passed() << "]";
+					_pending.report(msg.str(), false);
+				}catch (std::exception& e)
+				{
+					msg << " exception - " << e.what();
+					_pending.report(msg.str(), true);
+				}
+			}
+		}
+	};
+}
+
+int
+main(int argc, char ** argv)
+{
+	//
+	// parameter parsing
+	//
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("file", po::value<string>(), "input file")
+		("what", po::value<Pages>(), "pages to convert")
+		("from", po::value<size_t>(), "first page of the range to convert")
+		("to", po::value<size_t>(), "last page of the range to convert")
+		("hdpi", po::value<size_t>()->default_value(DEFAULT_DPI), "horizontal dpi")
+		("vdpi", po::value<size_t>()->default_value(DEFAULT_DPI), "vertical dpi")
+		("antialias", po::value<bool>()->default_value(true), "anti-aliasing of fonts and vector graphics")
+		("format", po::value<string>()->default_value(DEFAULT_FORMAT), "output format (ppm or png)")
+		("output", po::value<string>()->default_value(""), "output file name prefix")
+		("jobs", po::value<size_t>()->default_value(0), "number of rendering threads (0 for one per core)")
+		("bands", po::value<size_t>()->default_value(1), "number of bands of each page rendered in parallel (0 for one per core)")
+		("font-dir", po::value<string>()->default_value(DEFAULT_FONT_DIR), "(xpdf) font directory with font definitions(e.g. N019003L.PFB)")
+	;
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	}catch(std::exception& e)
+	{
+		std::cout << "exception - " << e.what() << ". Please, check your parameters." << endl;
+		return 1;
+	}
+
+		if (!vm.count("file"))
+		{
+			cout << desc << endl;
+			return 1;
+		}
+	string file = vm["file"].as<string>();
+	string font_dir = vm["font-dir"].as<string>();
+	string format = vm["format"].as<string>();
+		if (format != "ppm" && format != "png")
+		{
+			cout << "Invalid format! " << endl << desc << endl;
+			return 1;
+		}
+
+	_settings settings;
+	settings.hdpi = vm["hdpi"].as<size_t>();
+	settings.vdpi = vm["vdpi"].as<size_t>();
+	settings.bands = vm["bands"].as<size_t>();
+	if (!settings.bands)
+		settings.bands = boost::thread::hardware_concurrency();
+	settings.antialias = vm["antialias"].as<bool>();
+	settings.png = (format == "png");
+	settings.prefix = vm["output"].as<string>();
+
+	size_t jobs = vm["jobs"].as<size_t>();
+	if (!jobs)
+		jobs = boost::thread::hardware_concurrency();
+#if !MULTITHREADED
+	// xpdf global caches are not protected without MULTITHREADED
+	jobs = 1;
+#endif
+	if (!jobs)
+		jobs = 1;
+
+	try
+	{
+		// pdf lib init & work
+		_pdf_lib _lib(argc, argv, font_dir);
+			if (!_lib._ok)
+				return 1;
+
+		// global parameters are set before any worker starts and are not
+		// changed later. t1lib is process global and not reentrant, so
+		// workers (each with its own font engine) have to use FreeType only
+		globalParams->setEnableT1lib("no");
+		globalParams->setEnableFreeType("yes");
+		globalParams->setErrQuiet(gTrue);
+		globalParams->setAntialias((settings.antialias) ? "yes" : "no");
+		globalParams->setVectorAntialias((settings.antialias) ? "yes" : "no");
+
+		// open pdf
+		shared_ptr<CPdf> pdf = CPdf::getInstance (file.c_str(), CPdf::ReadOnly);
+		size_t page_count = pdf->getPageCount();
+
+		Pages pages;
+		if (vm.count("what"))
+			pages = vm["what"].as<Pages>();
+		if (vm.count("from") || vm.count("to"))
+		{
+			size_t from = (vm.count("from")) ? vm["from"].as<size_t>() : 1;
+			size_t to = (vm.count("to")) ? vm["to"].as<size_t>() : page_count;
+			for (size_t i = from; i <= to; ++i)
+				pages.push_back(i);
+		}
+		if (!vm.count("what") && !vm.count("from") && !vm.count("to"))
+			for (size_t i = 1; i <= page_count; ++i)
+				pages.push_back(i);
+
+		for (Pages::iterator it = pages.begin(); it != pages.end();)
+		{
+				if (0 == *it || *it > page_count)
+				{
+					cout << "Invalid page number " << *it << "!" << endl;
+					it = pages.erase(it);
+					continue;
+				}
+			++it;
+		}
+		if (jobs > pages.size())
+			jobs = pages.size();
+
+		// each worker gets its own document instance. Instances are opened
+		// and closed here because CPdf instances registry is not thread safe
+		_time time;
+		_queue pending(pages);
+		vector<shared_ptr<CPdf> > pdfs;
+		pdfs.push_back(pdf);
+		while (pdfs.size() < jobs)
+			pdfs.push_back(CPdf::getInstance (file.c_str(), CPdf::ReadOnly));
+
+		thread_group workers;
+		for (size_t i = 0; i < jobs; ++i)
+			workers.create_thread(_worker(pdfs[i], pending, settings));
+		workers.join_all();
+		pdfs.clear();
+		pdf.reset();
+
+		std::cout << "Pages " << pages.size() << " [jobs:" << jobs << "] [all:" << time.passed() << "]" << std::endl;
+		if (pending._failed)
+			return 1;
+
+	}catch (std::exception& e)
+	{
+		std::cout << "exception - " << e.what() << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
@@ -21,14 +21,26 @@
  *
  * Project is hosted on http://sourceforge.net/projects/pdfedit
  */
+/*
+ * Text extractor.
+ *
+ * Pages are extracted by several worker threads (--jobs), each of them has
+ * its own CPdf instance, so no kernel or xpdf document structures are shared
+ * between workers. The output is written in page order as soon as the page
+ * and all pages before it are extracted.
+ */
 #include <kernel/pdfedit-core-dev.h>
 #include <kernel/cpdf.h>
 #include <kernel/cpage.h>
 #include <kernel/delinearizator.h>
+#include <kernel/textoutputbuilder.h>
+#include <xpdf/GlobalParams.h>
 #include <boost/program_options.hpp>
+#include <boost/thread.hpp>
 #include <vector>
 
 using namespace pdfobjects;
+using namespace textoutput;
 using namespace std;
 using namespace boost;
 namespace po = program_options;
@@ -38,6 +50,8 @@ namespace {
 	// default values
 	const string DEFAULT_ENCODING( "UTF-8" );
 	const bool DEFAULT_OUTPUT_PAGES = false;
+	const bool DEFAULT_XML = false;
+	const size_t DEFAULT_JOBS = 1;
 	const string DEFAULT_FONT_DIR( "." );
 
 	// pages
@@ -54,8 +68,16 @@ namespace {
 	};
 	// what to do with a page
 	struct _textify {
-		string operator () (shared_ptr<CPage> page, const string& encoding)
+		string operator () (shared_ptr<CPage> page, bool xml)
 		{
+			// xml of the page without the document header and footer
+			if (xml)
+			{
+				XmlOutputBuilder out;
+				page->convert<SimpleWordEngine, SimpleLineEngine, SimpleColumnEngine> (out);
+				return out.str();
+			}
+
 			// Update display params to use media box not default page rect (DEFAULT_PAGE_RX, DEFAULT_PAGE_RY)
 			// TODO upsidedown? get/set
 			DisplayParams dp;
@@ -64,11 +86,98 @@ namespace {
 			dp.rotate = page->getRotation ();
 			page->setDisplayParams (dp);
 
+			// encoding is set globally before extraction starts
 			string text;
-			page->getText( text, &encoding );
+			page->getText( text );
 			return text;
 		}
 	};
+
+	// pages which are waiting for a worker and their results waiting for
+	// the output
+	struct _queue {
+		const Pages& _pages;
+		size_t _window;
+		size_t _next;
+		size_t _written;
+		bool _stopped;
+		vector<string> _results;
+		vector<char> _done;
+		vector<char> _failed;
+		boost::mutex _mutex;
+		boost::condition_variable _cond;
+
+		// at most window results wait for the output
+		_queue (const Pages& pages, size_t window) 
+			: _pages (pages), _window (window), _next (0), _written (0), _stopped (false),
+			  _results (pages.size()), _done (pages.size(), 0), _failed (pages.size(), 0) {}
+
+		bool get (size_t& pos)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			while (!_stopped && _next < _pages.size() && _next >= _written + _window)
+				_cond.wait(lock);
+			if (_stopped || _next >= _pages.size())
+				return false;
+			pos = _next++;
+			return true;
+		}
+
+		void put (size_t pos, const string& result, bool failed)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			_results[pos] = result;
+			_failed[pos] = failed;
+			_done[pos] = true;
+			_cond.notify_all();
+		}
+
+		// waits for the result, false if extraction failed
+		bool take (size_t pos, string& result)
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			while (!_done[pos])
+				_cond.wait(lock);
+			_results[pos].swap(result);
+			++_written;
+			_cond.notify_all();
+			return !_failed[pos];
+		}
+
+		// no more pages are given to workers
+		void stop ()
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			_stopped = true;
+			_cond.notify_all();
+		}
+	};
+
+	// one extracting thread with its own document
+	struct _worker {
+		shared_ptr<CPdf> _pdf;
+		_queue& _pending;
+		bool _xml;
+
+		_worker (shared_ptr<CPdf> pdf, _queue& pending, bool xml)
+			: _pdf (pdf), _pending (pending), _xml (xml) {}
+
+		void operator () ()
+		{
+			size_t pos;
+			while (_pending.get(pos))
+			{
+				try
+				{
+					shared_ptr<CPage> page = _pdf->getPage(_pending._pages[pos]);
+					_pending.put(pos, _textify()(page, _xml), false);
+				}catch (std::exception& e)
+				{
+					_pending.put(pos, e.what(), true);
+				}
+			}
+		}
+	};
 }
 
 int 
@@ -84,6 +193,8 @@ main(int argc, char ** argv)
 		("what", po::value<Pages>(), "pages to convert")
 		("output-pages", po::value<bool>()->default_value(DEFAULT_OUTPUT_PAGES), "output page number before each page")
 		("encoding", po::value<string>()->default_value(DEFAULT_ENCODING), "encoding to use")
+		("xml", po::value<bool>()->default_value(DEFAULT_XML), "output xml with text positions instead of plain text")
+		("jobs", po::value<size_t>()->default_value(DEFAULT_JOBS), "number of extracting threads (0 for one per core)")
 		("font-dir", po::value<string>()->default_value(DEFAULT_FONT_DIR), "(xpdf) font directory with font definitions(e.g. N019003L.PFB)")
 	;
 
@@ -105,12 +216,23 @@ main(int argc, char ** argv)
 	string file = vm["file"].as<string>(); 
 	bool output_pages = vm["output-pages"].as<bool>(); 
 	string encoding = vm["encoding"].as<string>(); 
+	bool xml = vm["xml"].as<bool>(); 
 	string font_dir = vm["font-dir"].as<string>(); 
 	
 	Pages pages;
 	if (vm.count("what"))
 		pages = vm["what"].as<Pages>();
 
+	size_t jobs = vm["jobs"].as<size_t>();
+	if (!jobs)
+		jobs = boost::thread::hardware_concurrency();
+#if !MULTITHREADED
+	// xpdf global caches are not protected without MULTITHREADED
+	jobs = 1;
+#endif
+	if (!jobs)
+		jobs = 1;
+
 	try
 	{
 		// pdf lib init & work
@@ -118,34 +240,69 @@ main(int argc, char ** argv)
 			if (!_lib._ok)
 				return 1;
 
+		// global parameters are set before any worker starts and are not
+		// changed later
+		globalParams->setTextEncoding(const_cast<char*>(encoding.c_str()));
+
 		// open pdf
-		shared_ptr<CPdf> pdf = CPdf::getInstance (file.c_str(), CPdf::ReadWrite);
+		shared_ptr<CPdf> pdf = CPdf::getInstance (file.c_str(), CPdf::ReadOnly);
+		size_t page_count = pdf->getPageCount();
 
 		if (pages.empty())
-		{
-			for (size_t i = 1; i <= pdf->getPageCount(); ++i)
-			{
-				shared_ptr<CPage> page = pdf->getPage(i);
-				if (output_pages)
-					std::cout << "\nPage " << i << ":\n";
-				std::cout << _textify()(page, encoding);
-			}
-		}
-		
-		// do it for selected pages
+			for (size_t i = 1; i <= page_count; ++i)
+				pages.push_back(i);
+		Pages valid;
 		for (Pages::const_iterator it = pages.begin(); it != pages.end(); ++it)
+			if (*it <= page_count)
+				valid.push_back(*it);
+		if (jobs > valid.size())
+			jobs = std::max<size_t> (valid.size(), 1);
+
+		// each worker gets its own document instance. Instances are opened
+		// and closed here because CPdf instances registry is not thread safe
+		_queue pending(valid, 4 * jobs);
+		vector<shared_ptr<CPdf> > pdfs;
+		pdfs.push_back(pdf);
+		while (pdfs.size() < jobs)
+			pdfs.push_back(CPdf::getInstance (file.c_str(), CPdf::ReadOnly));
+
+		thread_group workers;
+		for (size_t i = 0; i < jobs; ++i)
+			workers.create_thread(_worker(pdfs[i], pending, xml));
+
+		// write results in page order
+		bool failed = false;
+		size_t pos = 0;
+		if (xml)
+			std::cout << XmlOutputBuilder::xml_header();
+		for (Pages::const_iterator it = pages.begin(); it != pages.end() && !failed; ++it)
 		{
-				if (*it > pdf->getPageCount())
+				if (*it > page_count)
 				{
 					cout << "Invalid page number! " << endl << desc << endl;
 					continue;
 				}
 
-			shared_ptr<CPage> page = pdf->getPage(*it);
-			if (output_pages)
+			string text;
+			if (!pending.take(pos++, text))
+			{
+				std::cout << "exception - " << text;
+				failed = true;
+				pending.stop();
+				break;
+			}
+			if (output_pages && !xml)
 				std::cout << "\nPage " << *it << ":\n";
-			std::cout << _textify()(page, encoding);
+			std::cout << text;
 		}
+		if (xml && !failed)
+			std::cout << XmlOutputBuilder::xml_footer();
+
+		workers.join_all();
+		pdfs.clear();
+		pdf.reset();
+		if (failed)
+			return -1;
 
 	}catch (std::exception& e)
 	{
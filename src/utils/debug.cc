@@ -24,6 +24,7 @@
 // vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
 #include "kernel/static.h" // WIN32 port - precompiled headers - REMOVE IN FUTURE!
 #include "debug.h"
+#include <boost/thread/mutex.hpp>
 
 /** Prefix for debug messages. */
 #define DEBUG_PREFIX "DEBUG"
@@ -57,4 +58,21 @@ void changeDebugLevel(unsigned int level)
 	changeDebugLevel(utilsDebugTarget, level);
 }
 
+/** Returns lock for debug messages writing.
+ * All targets share it, because they usually share the stream. Messages
+ * can be written also by static initializers, so the lock is created on
+ * the first use.
+ */
+static boost::mutex & getDebugLock()
+{
+	static boost::mutex debugLock;
+	return debugLock;
+}
+
+void writeDbg(DebugTarget & debugTarget, const std::string & message)
+{
+	boost::mutex::scoped_lock lock(getDebugLock());
+	debugTarget.stream << message << std::flush;
+}
+
 }
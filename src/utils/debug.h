@@ -26,6 +26,7 @@
 #define DEBUG_H
 
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <iomanip>
 
@@ -156,6 +157,16 @@ unsigned int changeDebugLevel(DebugTarget & debugTarget, unsigned int level);
  */
 void changeDebugLevel(unsigned int level);
 
+/** Writes formatted message to the target stream.
+ * @param debugTarget Target for the message.
+ * @param message Complete message (including the line end).
+ *
+ * Messages may come from more threads (e.g. pdf writer or page rendering
+ * threads), so writing is serialized by one lock for all targets and each
+ * message is written at once.
+ */
+void writeDbg(DebugTarget & debugTarget, const std::string & message);
+
 /** Prints message with given priority.
  * @param prefix Prefix for message.
  * @param dbgLevel Priority of message.
@@ -225,15 +236,19 @@ void changeDebugLevel(unsigned int level);
  * @code
  * priority:prefix:fileName:functionName:line: message
  * @endcode
+ * The whole message is formatted first and then written by writeDbg, so
+ * messages from different threads are not mixed.
  */
 #define _printDbg(prefix, level, target, msg)					\
 	do {									\
 	if (target.debugLevel >= level) { 					\
-		target.stream << level <<":"<<prefix<<":"			\
+		std::ostringstream _dbgMessage;					\
+		_dbgMessage << level <<":"<<prefix<<":"				\
 		    << __FILE__ << ":" << __FUNCTION__ <<":"<< __LINE__ 	\
 			<< ": "							\
 			<<  msg 						\
 			<< std::endl;						\
+		debug::writeDbg(target, _dbgMessage.str());			\
 	}									\
 	}while(0)
 
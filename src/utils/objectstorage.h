@@ -25,6 +25,7 @@
 #define _OBJECTCOMPARATOR_H_
 
 #include <map>
+#include <vector>
 
 
 /**
@@ -33,6 +34,9 @@
  * File which implements template object storage class. This is basicaly
  * mapping keys to objects and provide simple interface to manipulate
  * with it. It wrapps STL map class functionality.
+ * <br>
+ * DenseObjectStorage provides the same interface for keys which are indirect
+ * object referencies and stores values in a table indexed by object number.
  */
 
 /**
@@ -199,4 +203,297 @@ public:
 		return mapping.end();
 	}
 };
+
+/** Object storage indexed by object number.
+ *
+ * Provides same interface as ObjectStorage for keys which are indirect
+ * object referencies (K has to be assignable and provide num and gen
+ * fields). Values are stored in a vector indexed by the object number, so
+ * put, get, contains and remove don't need any tree searching and size is
+ * kept in a counter. Each slot holds one generation of the object number
+ * and checks it on each access - other generations of already used numbers
+ * (which are rare) are stored in an overflow mapping ordered by Comp.
+ * <br>
+ * Iteration goes through the table in object number order and then through
+ * the overflow mapping. Note that, unlike ObjectStorage, put may invalidate
+ * all iterators because table can be reallocated.
+ */
+template<typename K, typename V, typename Comp> class DenseObjectStorage
+{
+public:
+	/** Association type - key with its value. */
+	typedef std::pair<K, V> Association;
+
+private:
+	/** Table slot. */
+	struct Slot
+	{
+		/** Flag whether slot contains association. */
+		bool used;
+		/** Stored association (meaningful only if used). */
+		Association assoc;
+
+		Slot(): used(false), assoc() {}
+	};
+	typedef std::vector<Slot> Slots;
+	typedef std::map<K, Association, Comp> Overflow;
+
+	/** Table indexed by object number. */
+	Slots slots;
+
+	/** Associations which don't fit to their slots. */
+	Overflow overflow;
+
+	/** Number of all associations. */
+	size_t count;
+
+	/** Iterator implementation.
+	 *
+	 * Goes through used slots and then through overflow mapping.
+	 */
+	template<typename SlotIter, typename OverIter, typename A> class IteratorImpl
+	{
+		SlotIter slot;
+		SlotIter slotEnd;
+		OverIter over;
+
+		void skipUnused()
+		{
+			while(slot!=slotEnd && !slot->used)
+				++slot;
+		}
+	public:
+		IteratorImpl() {}
+		IteratorImpl(SlotIter s, SlotIter e, OverIter o)
+			: slot(s), slotEnd(e), over(o)
+		{
+			skipUnused();
+		}
+
+		A & operator*()const
+		{
+			return (slot!=slotEnd)?slot->assoc:over->second;
+		}
+
+		A * operator->()const
+		{
+			return &(operator*());
+		}
+
+		IteratorImpl & operator++()
+		{
+			if(slot!=slotEnd)
+			{
+				++slot;
+				skipUnused();
+			}else
+				++over;
+			return *this;
+		}
+
+		bool operator==(const IteratorImpl & other)const
+		{
+			return slot==other.slot && over==other.over;
+		}
+
+		bool operator!=(const IteratorImpl & other)const
+		{
+			return !(*this==other);
+		}
+	};
+
+	/** Returns slot for given key.
+	 * @param key Key of the value.
+	 *
+	 * @return Slot for the key's object number or NULL if number is out of
+	 * table.
+	 */
+	Slot * getSlot(const K & key)
+	{
+		if(key.num<0 || (size_t)key.num>=slots.size())
+			return 0;
+		return &slots[key.num];
+	}
+
+	/** Returns slot for given key.
+	 * @param key Key of the value.
+	 *
+	 * @return Slot for the key's object number or NULL if number is out of
+	 * table.
+	 */
+	const Slot * getSlot(const K & key)const
+	{
+		if(key.num<0 || (size_t)key.num>=slots.size())
+			return 0;
+		return &slots[key.num];
+	}
+
+public:
+	/** Iterator type. */
+	typedef IteratorImpl<typename Slots::iterator, typename Overflow::iterator, Association> Iterator;
+
+	/** Constant iterator type. */
+	typedef IteratorImpl<typename Slots::const_iterator, typename Overflow::const_iterator, const Association> ConstIterator;
+
+	/** Empty constructor.
+	 */
+	DenseObjectStorage(): count(0) {}
+
+	/** Clears storage.
+	 *
+	 * Doesn't deallocate values!
+	 */
+	void clear()
+	{
+		slots.clear();
+		overflow.clear();
+		count=0;
+	}
+
+	/** Add/change mapping.
+	 * @param key Key of the mapping.
+	 * @param value Value of the mapping (must be non null).
+	 *
+	 * @see ObjectStorage::put
+	 * @returns Value of the previous mapping or 0 if the key was inserted
+	 * to the storage.
+	 */
+	V put(const K & key, V value)
+	{
+		if(key.num>=0 && (size_t)key.num>=slots.size())
+			slots.resize(key.num+1);
+		Slot * slot=getSlot(key);
+		// key may still be in the overflow mapping if its slot has been
+		// freed by remove of a different generation
+		typename Overflow::iterator iter=overflow.empty()?overflow.end():overflow.find(key);
+		if(iter!=overflow.end())
+		{
+			V old=iter->second.second;
+			iter->second.second=value;
+			return old;
+		}
+		if(slot && !slot->used)
+		{
+			slot->used=true;
+			slot->assoc=Association(key, value);
+			++count;
+			return 0;
+		}
+		if(slot && slot->assoc.first.gen==key.gen)
+		{
+			V old=slot->assoc.second;
+			slot->assoc.second=value;
+			return old;
+		}
+
+		// slot is occupied by different generation
+		overflow.insert(typename Overflow::value_type(key, Association(key, value)));
+		++count;
+		return 0;
+	}
+
+	/** Finds value with the key.
+	 * @param key Key of the value.
+	 *
+	 * @return value of the value or 0 if no such key found.
+	 */
+	V get(const K & key)const
+	{
+		const Slot * slot=getSlot(key);
+		if(slot && slot->used && slot->assoc.first.gen==key.gen)
+			return slot->assoc.second;
+		if(overflow.empty())
+			return 0;
+		typename Overflow::const_iterator iter=overflow.find(key);
+		if(iter==overflow.end())
+			return 0;
+		return iter->second.second;
+	}
+
+	/** Checks of given key is in the storage.
+	 * @param key Key object.
+	 *
+	 * @return true if given key is in the storage, false otherwise.
+	 */
+	bool contains(const K & key)const
+	{
+		const Slot * slot=getSlot(key);
+		if(slot && slot->used && slot->assoc.first.gen==key.gen)
+			return true;
+		return !overflow.empty() && overflow.find(key)!=overflow.end();
+	}
+
+	/** Removes association.
+	 * @param key Key of the value.
+	 *
+	 * This method doesn't invalidate iterators, except one which points
+	 * to the removed element.
+	 *
+	 * @return Value of the key or 0 if not found (and not removed).
+	 */
+	V remove(const K & key)
+	{
+		Slot * slot=getSlot(key);
+		if(slot && slot->used && slot->assoc.first.gen==key.gen)
+		{
+			V old=slot->assoc.second;
+			slot->used=false;
+			slot->assoc.second=V();
+			--count;
+			return old;
+		}
+		typename Overflow::iterator iter=overflow.find(key);
+		if(iter==overflow.end())
+			return 0;
+		V old=iter->second.second;
+		overflow.erase(iter);
+		--count;
+		return old;
+	}
+
+	/** Number of elements.
+	 *
+	 * @return Elements count.
+	 */
+	size_t size()const
+	{
+		return count;
+	}
+
+	/** Returns iterator to first element.
+	 *
+	 * @return Iterator instance.
+	 */
+	Iterator begin()
+	{
+		return Iterator(slots.begin(), slots.end(), overflow.begin());
+	}
+
+	/** Returns const iterator to first element.
+	 *
+	 * @return ConstIterator instance.
+	 */
+	ConstIterator begin()const
+	{
+		return ConstIterator(slots.begin(), slots.end(), overflow.begin());
+	}
+
+	/** Returns iterator to end iterator.
+	 *
+	 * @return Iterator instance.
+	 */
+	Iterator end()
+	{
+		return Iterator(slots.end(), slots.end(), overflow.end());
+	}
+
+	/** Returns const iterator to end iterator.
+	 *
+	 * @return ConstIterator instance.
+	 */
+	ConstIterator end()const
+	{
+		return ConstIterator(slots.end(), slots.end(), overflow.end());
+	}
+};
 #endif
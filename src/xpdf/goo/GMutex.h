@@ -21,6 +21,12 @@
 // gUnlockMutex(&m);
 // ...
 // gDestroyMutex(&m);
+//
+// Atomic counters:
+//
+// int n;
+// gAtomicIncrement(&n);   returns the new value
+// gAtomicDecrement(&n);   returns the new value
 
 #ifdef WIN32
 
@@ -33,6 +39,9 @@ typedef CRITICAL_SECTION GMutex;
 #define gLockMutex(m) EnterCriticalSection(m)
 #define gUnlockMutex(m) LeaveCriticalSection(m)
 
+#define gAtomicIncrement(x) InterlockedIncrement((LONG *)(x))
+#define gAtomicDecrement(x) InterlockedDecrement((LONG *)(x))
+
 #else // assume pthreads
 
 #include <pthread.h>
@@ -44,6 +53,9 @@ typedef pthread_mutex_t GMutex;
 #define gLockMutex(m) pthread_mutex_lock(m)
 #define gUnlockMutex(m) pthread_mutex_unlock(m)
 
+#define gAtomicIncrement(x) __sync_add_and_fetch(x, 1)
+#define gAtomicDecrement(x) __sync_sub_and_fetch(x, 1)
+
 #endif
 
 #endif
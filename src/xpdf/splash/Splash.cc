@@ -13,6 +13,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "goo/gmem.h"
 #include "splash/SplashErrorCodes.h"
 #include "splash/SplashMath.h"
@@ -39,6 +42,213 @@ static inline Guchar div255(int x) {
   return (Guchar)((x + (x >> 8) + 0x80) >> 8);
 }
 
+//------------------------------------------------------------------------
+// RGB8/BGR8 span kernels
+//------------------------------------------------------------------------
+
+// These compute the same values as Splash::pipeRun does for the
+// corresponding pipe configurations (see SplashPipeSpanCtrl).  Colors
+// are in the byte order of the bitmap.
+
+// Get the source color <cSrc> in the byte order of the bitmap.
+static inline void getSpanColorRGB8(SplashColorMode mode,
+				    SplashColorPtr cSrc, SplashColorPtr c) {
+  if (mode == splashModeBGR8) {
+    c[0] = cSrc[2];
+    c[1] = cSrc[1];
+    c[2] = cSrc[0];
+  } else {
+    c[0] = cSrc[0];
+    c[1] = cSrc[1];
+    c[2] = cSrc[2];
+  }
+}
+
+// Fill <n> pixels with an opaque color.
+static inline void fillSpanRGB8(SplashColorPtr p, Guchar *alpha, int n,
+				SplashColorPtr c) {
+  int len, done, k;
+
+  len = 3 * n;
+  if (c[0] == c[1] && c[1] == c[2]) {
+    memset(p, c[0], len);
+  } else {
+    // fill the first pixel and copy the pattern in doubling blocks
+    p[0] = c[0];
+    p[1] = c[1];
+    p[2] = c[2];
+    for (done = 3; done < len; done += k) {
+      k = (done < len - done) ? done : len - done;
+      memcpy(p + done, p, k);
+    }
+  }
+  if (alpha) {
+    memset(alpha, 255, n);
+  }
+}
+
+// Composite a color with source alpha <aSrc> over one pixel.
+static inline void blendPixelRGB8(SplashColorPtr p, Guchar *alpha,
+				  Guchar aSrc, SplashColorPtr c) {
+  Guchar aResult;
+
+  if (alpha) {
+    aResult = aSrc + *alpha - div255(aSrc * *alpha);
+    *alpha = aResult;
+    if (aResult == 0) {
+      p[0] = p[1] = p[2] = 0;
+      return;
+    }
+  } else {
+    aResult = 255;
+  }
+  p[0] = (Guchar)(((aResult - aSrc) * p[0] + aSrc * c[0]) / aResult);
+  p[1] = (Guchar)(((aResult - aSrc) * p[1] + aSrc * c[1]) / aResult);
+  p[2] = (Guchar)(((aResult - aSrc) * p[2] + aSrc * c[2]) / aResult);
+}
+
+#ifdef __SSE2__
+// Divide 16-bit lanes (in [0, 255*255]) by 255, rounding down like the
+// integer division does.
+static inline __m128i spanDiv255Floor(__m128i x) {
+  return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)),
+				      _mm_srli_epi16(x, 8)), 8);
+}
+
+// Load 4 pixels (12 bytes) into the low bytes of a vector.
+static inline __m128i spanLoad4RGB8(SplashColorPtr p) {
+  int v;
+
+  memcpy(&v, p + 8, 4);
+  return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+			    _mm_cvtsi32_si128(v));
+}
+
+// Store the low 12 bytes of a vector (4 pixels).
+static inline void spanStore4RGB8(SplashColorPtr p, __m128i x) {
+  int v;
+
+  _mm_storel_epi64((__m128i *)p, x);
+  v = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+  memcpy(p + 8, &v, 4);
+}
+#endif
+
+// SSE2 version of blendSpanRGB8, returns the number of pixels it
+// blended (the rest is left for the generic code).  The results are
+// exactly those of the generic code: the quotients of the alpha blend
+// are exact enough in single precision to be truncated.
+static inline int blendSpanRGB8Fast(SplashColorPtr p, Guchar *alpha, int n,
+				    Guchar aSrc, SplashColorPtr c) {
+  int i = 0;
+
+#ifdef __SSE2__
+  __m128i zero = _mm_setzero_si128();
+  unsigned short s[48];
+  int j;
+
+  // aSrc * c for 16 pixels, as 16-bit lanes in the byte order of the
+  // bitmap
+  for (j = 0; j < 48; ++j) {
+    s[j] = (unsigned short)(aSrc * c[j % 3]);
+  }
+  if (alpha) {
+    __m128i aSrc16 = _mm_set1_epi16(aSrc);
+    __m128 aSrcF = _mm_set1_ps((float)aSrc);
+    __m128 oneF = _mm_set1_ps(1);
+    __m128 sA = _mm_cvtepi32_ps(_mm_setr_epi32(s[0], s[1], s[2], s[3]));
+    __m128 sB = _mm_cvtepi32_ps(_mm_setr_epi32(s[4], s[5], s[6], s[7]));
+    __m128 sC = _mm_cvtepi32_ps(_mm_setr_epi32(s[8], s[9], s[10], s[11]));
+    for (; i + 4 <= n; i += 4, p += 12, alpha += 4) {
+      int v;
+
+      // aResult = aSrc + aDest - div255(aSrc * aDest)
+      memcpy(&v, alpha, 4);
+      __m128i aDest = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero);
+      __m128i t = _mm_mullo_epi16(aDest, aSrc16);
+      t = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)),
+				       _mm_set1_epi16(0x80)), 8);
+      __m128i aResult = _mm_sub_epi16(_mm_add_epi16(aSrc16, aDest), t);
+      v = _mm_cvtsi128_si32(_mm_packus_epi16(aResult, aResult));
+      memcpy(alpha, &v, 4);
+
+      // the bytes of 4 pixels are in 3 vectors of 4 lanes, each lane
+      // needs the result alpha of its pixel
+      __m128 aR = _mm_cvtepi32_ps(_mm_unpacklo_epi16(aResult, zero));
+      __m128 aRA = _mm_shuffle_ps(aR, aR, _MM_SHUFFLE(1, 0, 0, 0));
+      __m128 aRB = _mm_shuffle_ps(aR, aR, _MM_SHUFFLE(2, 2, 1, 1));
+      __m128 aRC = _mm_shuffle_ps(aR, aR, _MM_SHUFFLE(3, 3, 3, 2));
+      __m128i x = spanLoad4RGB8(p);
+      __m128i lo = _mm_unpacklo_epi8(x, zero);
+      __m128i hi = _mm_unpackhi_epi8(x, zero);
+      __m128 pA = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+      __m128 pB = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+      __m128 pC = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+
+      // ((aResult - aSrc) * p + aSrc * c) / aResult, the result alpha
+      // is 0 only if aSrc is 0 and the color becomes 0 then
+      pA = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(aRA, aSrcF), pA), sA),
+		      _mm_max_ps(aRA, oneF));
+      pB = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(aRB, aSrcF), pB), sB),
+		      _mm_max_ps(aRB, oneF));
+      pC = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(aRC, aSrcF), pC), sC),
+		      _mm_max_ps(aRC, oneF));
+      lo = _mm_packs_epi32(_mm_cvttps_epi32(pA), _mm_cvttps_epi32(pB));
+      hi = _mm_packs_epi32(_mm_cvttps_epi32(pC), zero);
+      spanStore4RGB8(p, _mm_packus_epi16(lo, hi));
+    }
+  } else {
+    // 16 pixels are 3 vectors, so the color pattern repeats
+    __m128i aDest = _mm_set1_epi16(255 - aSrc);
+    __m128i sv[6];
+    for (j = 0; j < 6; ++j) {
+      sv[j] = _mm_loadu_si128((const __m128i *)(s + 8 * j));
+    }
+    for (; i + 16 <= n; i += 16, p += 48) {
+      for (j = 0; j < 3; ++j) {
+	__m128i x = _mm_loadu_si128((const __m128i *)(p + 16 * j));
+	__m128i lo = _mm_unpacklo_epi8(x, zero);
+	__m128i hi = _mm_unpackhi_epi8(x, zero);
+	lo = spanDiv255Floor(_mm_add_epi16(_mm_mullo_epi16(lo, aDest),
+					   sv[2 * j]));
+	hi = spanDiv255Floor(_mm_add_epi16(_mm_mullo_epi16(hi, aDest),
+					   sv[2 * j + 1]));
+	_mm_storeu_si128((__m128i *)(p + 16 * j), _mm_packus_epi16(lo, hi));
+      }
+    }
+  }
+#endif
+  return i;
+}
+
+// Composite a color with constant source alpha <aSrc> over <n> pixels.
+static inline void blendSpanRGB8(SplashColorPtr p, Guchar *alpha, int n,
+				 Guchar aSrc, SplashColorPtr c) {
+  int aDest, s0, s1, s2, i;
+
+  i = blendSpanRGB8Fast(p, alpha, n, aSrc, c);
+  p += 3 * i;
+  if (alpha) {
+    for (alpha += i; i < n; ++i) {
+      blendPixelRGB8(p, alpha, aSrc, c);
+      p += 3;
+      ++alpha;
+    }
+  } else {
+    // the result alpha is 255, so this is a plain linear blend
+    aDest = 255 - aSrc;
+    s0 = aSrc * c[0];
+    s1 = aSrc * c[1];
+    s2 = aSrc * c[2];
+    for (; i < n; ++i) {
+      p[0] = (Guchar)((aDest * p[0] + s0) / 255);
+      p[1] = (Guchar)((aDest * p[1] + s1) / 255);
+      p[2] = (Guchar)((aDest * p[2] + s2) / 255);
+      p += 3;
+    }
+  }
+}
+
 //------------------------------------------------------------------------
 // SplashPipe
 //------------------------------------------------------------------------
@@ -77,6 +287,9 @@ struct SplashPipe {
   GBool noTransparency;
   SplashPipeResultColorCtrl resultColorCtrl;
 
+  // span kernel
+  SplashPipeSpanCtrl spanCtrl;
+
   // non-isolated group correction
   int nonIsolatedGroup;
 };
@@ -212,6 +425,18 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y,
   } else {
     pipe->nonIsolatedGroup = 0;
   }
+
+  // span kernel
+  pipe->spanCtrl = splashPipeSpanGeneric;
+  if ((bitmap->mode == splashModeRGB8 || bitmap->mode == splashModeBGR8) &&
+      !pipe->pattern && !state->blendFunc) {
+    if (pipe->noTransparency) {
+      pipe->spanCtrl = splashPipeSpanSolidRGB8;
+    } else if (!state->softMask && !state->inNonIsolatedGroup &&
+	       !nonIsolatedGroup) {
+      pipe->spanCtrl = splashPipeSpanAlphaRGB8;
+    }
+  }
 }
 
 inline void Splash::pipeRun(SplashPipe *pipe) {
@@ -676,7 +901,29 @@ inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y) {
 
 inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 			     GBool noClip) {
-  int x;
+  int x, x2;
+
+  if (pipe->spanCtrl != splashPipeSpanGeneric) {
+    if (noClip) {
+      drawSpanRGB8(pipe, x0, x1, y);
+      updateModX(x0);
+      updateModX(x1);
+      updateModY(y);
+    } else {
+      // draw the runs of pixels inside the clip region
+      for (x = x0; x <= x1; ++x) {
+	if (state->clip->test(x, y)) {
+	  for (x2 = x + 1; x2 <= x1 && state->clip->test(x2, y); ++x2) ;
+	  drawSpanRGB8(pipe, x, x2 - 1, y);
+	  updateModX(x);
+	  updateModX(x2 - 1);
+	  updateModY(y);
+	  x = x2;
+	}
+      }
+    }
+    return;
+  }
 
   pipeSetXY(pipe, x0, y);
   if (noClip) {
@@ -699,6 +946,27 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
   }
 }
 
+// Draw the pixels from <x0> to <x1> on line <y> with the span kernel
+// (the caller does the clipping and updates the modified region).
+inline void Splash::drawSpanRGB8(SplashPipe *pipe, int x0, int x1, int y) {
+  SplashColor c;
+  SplashColorPtr p;
+  Guchar *alpha;
+
+  getSpanColorRGB8(bitmap->mode, pipe->cSrc, c);
+  p = &bitmap->data[y * bitmap->rowSize + 3 * x0];
+  alpha = bitmap->alpha ? &bitmap->alpha[y * bitmap->width + x0] : NULL;
+  if (pipe->spanCtrl == splashPipeSpanSolidRGB8) {
+    fillSpanRGB8(p, alpha, x1 - x0 + 1, c);
+  } else {
+    blendSpanRGB8(p, alpha, x1 - x0 + 1,
+		  pipe->usesShape
+		    ? (Guchar)splashRound(pipe->aInput * pipe->shape)
+		    : pipe->aSrc,
+		  c);
+  }
+}
+
 inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
 #if splashAASize == 4
   static int bitCount4[16] = { 0, 1, 1, 2, 1, 2, 2, 3,
@@ -710,6 +978,11 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
   int xx, yy, t;
 #endif
   int x;
+  Guchar aSrc[splashAASize * splashAASize + 1];
+  SplashColor c;
+  SplashColorPtr q;
+  Guchar *alpha;
+  int xMin, xMax;
 
 #if splashAASize == 4
   p0 = aaBuf->getDataPtr() + (x0 >> 1);
@@ -717,6 +990,62 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
   p2 = p1 + aaBuf->getRowSize();
   p3 = p2 + aaBuf->getRowSize();
 #endif
+
+  if (pipe->spanCtrl == splashPipeSpanAlphaRGB8) {
+    // source alpha for each coverage value
+    for (t = 0; t <= splashAASize * splashAASize; ++t) {
+      aSrc[t] = pipe->usesShape
+	          ? (Guchar)splashRound(pipe->aInput * aaGamma[t])
+	          : pipe->aSrc;
+    }
+    getSpanColorRGB8(bitmap->mode, pipe->cSrc, c);
+    q = &bitmap->data[y * bitmap->rowSize + 3 * x0];
+    alpha = bitmap->alpha ? &bitmap->alpha[y * bitmap->width + x0] : NULL;
+    xMin = x1 + 1;
+    xMax = x0 - 1;
+    for (x = x0; x <= x1; ++x) {
+
+      // compute the shape value
+#if splashAASize == 4
+      if (x & 1) {
+	t = bitCount4[*p0 & 0x0f] + bitCount4[*p1 & 0x0f] +
+	    bitCount4[*p2 & 0x0f] + bitCount4[*p3 & 0x0f];
+	++p0; ++p1; ++p2; ++p3;
+      } else {
+	t = bitCount4[*p0 >> 4] + bitCount4[*p1 >> 4] +
+	    bitCount4[*p2 >> 4] + bitCount4[*p3 >> 4];
+      }
+#else
+      t = 0;
+      for (yy = 0; yy < splashAASize; ++yy) {
+	for (xx = 0; xx < splashAASize; ++xx) {
+	  p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() +
+	      ((x * splashAASize + xx) >> 3);
+	  t += (*p >> (7 - ((x * splashAASize + xx) & 7))) & 1;
+	}
+      }
+#endif
+
+      if (t != 0) {
+	blendPixelRGB8(q, alpha, aSrc[t], c);
+	if (x < xMin) {
+	  xMin = x;
+	}
+	xMax = x;
+      }
+      q += 3;
+      if (alpha) {
+	++alpha;
+      }
+    }
+    if (xMin <= xMax) {
+      updateModX(xMin);
+      updateModX(xMax);
+      updateModY(y);
+    }
+    return;
+  }
+
   pipeSetXY(pipe, x0, y);
   for (x = x0; x <= x1; ++x) {
 
@@ -1644,6 +1973,8 @@ SplashError Splash::fillChar(SplashCoord x, SplashCoord y,
   err = fillGlyph2(x0, y0, &glyph);
   if (glyph.freeData) {
     gfree(glyph.data);
+  } else {
+    font->releaseGlyph(&glyph);
   }
   return err;
 }
@@ -1666,6 +1997,10 @@ SplashError Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph) {
   int alpha0, alpha;
   Guchar *p;
   int x1, y1, xx, xx1, yy;
+  SplashColor c;
+  SplashColorPtr q;
+  Guchar *aq;
+  Guchar aSrc;
 
   if ((clipRes = state->clip->testRect(x0 - glyph->x,
 				       y0 - glyph->y,
@@ -1679,17 +2014,41 @@ SplashError Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph) {
 	pipeInit(&pipe, x0 - glyph->x, y0 - glyph->y,
 		 state->fillPattern, NULL, state->fillAlpha, gTrue, gFalse);
 	p = glyph->data;
-	for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
-	  pipeSetXY(&pipe, x0 - glyph->x, y1);
-	  for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; ++xx, ++x1) {
-	    alpha = *p++;
-	    if (alpha != 0) {
-	      pipe.shape = (SplashCoord)(alpha / 255.0);
-	      pipeRun(&pipe);
-	      updateModX(x1);
-	      updateModY(y1);
-	    } else {
-	      pipeIncX(&pipe);
+	if (pipe.spanCtrl == splashPipeSpanAlphaRGB8) {
+	  getSpanColorRGB8(bitmap->mode, pipe.cSrc, c);
+	  for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
+	    x1 = x0 - glyph->x;
+	    q = &bitmap->data[y1 * bitmap->rowSize + 3 * x1];
+	    aq = bitmap->alpha ? &bitmap->alpha[y1 * bitmap->width + x1]
+	                       : (Guchar *)NULL;
+	    for (xx = 0; xx < glyph->w; ++xx, ++x1) {
+	      alpha = *p++;
+	      if (alpha != 0) {
+		aSrc = (Guchar)splashRound(pipe.aInput *
+					   (SplashCoord)(alpha / 255.0));
+		blendPixelRGB8(q, aq, aSrc, c);
+		updateModX(x1);
+		updateModY(y1);
+	      }
+	      q += 3;
+	      if (aq) {
+		++aq;
+	      }
+	    }
+	  }
+	} else {
+	  for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
+	    pipeSetXY(&pipe, x0 - glyph->x, y1);
+	    for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; ++xx, ++x1) {
+	      alpha = *p++;
+	      if (alpha != 0) {
+		pipe.shape = (SplashCoord)(alpha / 255.0);
+		pipeRun(&pipe);
+		updateModX(x1);
+		updateModY(y1);
+	      } else {
+		pipeIncX(&pipe);
+	      }
 	    }
 	  }
 	}
@@ -2781,16 +3140,52 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
   SplashPipe pipe;
   SplashColor pixel;
   Guchar alpha;
-  Guchar *ap;
+  Guchar *ap, *aq;
+  SplashColorPtr sp, q;
+  GBool rows;
   int x, y;
 
   if (src->mode != bitmap->mode) {
     return splashErrModeMismatch;
   }
 
+  // the span kernels read the source rows directly, which is possible
+  // if the whole rectangle is inside the source bitmap (getPixel
+  // leaves the pixel unchanged otherwise)
+  rows = w > 0 && h > 0 && xSrc >= 0 && ySrc >= 0 &&
+         xSrc + w <= src->width && ySrc + h <= src->height;
+
   if (src->alpha) {
     pipeInit(&pipe, xDest, yDest, NULL, pixel, state->fillAlpha,
 	     gTrue, nonIsolated);
+    if (pipe.spanCtrl == splashPipeSpanAlphaRGB8 && rows) {
+      // the source pixels are in the byte order of the bitmap
+      for (y = 0; y < h; ++y) {
+	sp = &src->data[(ySrc + y) * src->rowSize + 3 * xSrc];
+	ap = &src->alpha[(ySrc + y) * src->width + xSrc];
+	q = &bitmap->data[(yDest + y) * bitmap->rowSize + 3 * xDest];
+	aq = bitmap->alpha
+	       ? &bitmap->alpha[(yDest + y) * bitmap->width + xDest]
+	       : (Guchar *)NULL;
+	for (x = 0; x < w; ++x) {
+	  alpha = *ap++;
+	  if (noClip || state->clip->test(xDest + x, yDest + y)) {
+	    blendPixelRGB8(q, aq,
+			   (Guchar)splashRound(pipe.aInput *
+					       (SplashCoord)(alpha / 255.0)),
+			   sp);
+	    updateModX(xDest + x);
+	    updateModY(yDest + y);
+	  }
+	  sp += 3;
+	  q += 3;
+	  if (aq) {
+	    ++aq;
+	  }
+	}
+      }
+      return splashOk;
+    }
     for (y = 0; y < h; ++y) {
       pipeSetXY(&pipe, xDest, yDest + y);
       ap = src->getAlphaPtr() + (ySrc + y) * src->getWidth() + xSrc;
@@ -2812,6 +3207,21 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
   } else {
     pipeInit(&pipe, xDest, yDest, NULL, pixel, state->fillAlpha,
 	     gFalse, nonIsolated);
+    if (pipe.spanCtrl == splashPipeSpanSolidRGB8 && noClip && rows) {
+      // opaque source - copy the rows
+      for (y = 0; y < h; ++y) {
+	memcpy(&bitmap->data[(yDest + y) * bitmap->rowSize + 3 * xDest],
+	       &src->data[(ySrc + y) * src->rowSize + 3 * xSrc], 3 * w);
+	if (bitmap->alpha) {
+	  memset(&bitmap->alpha[(yDest + y) * bitmap->width + xDest],
+		 255, w);
+	}
+	updateModY(yDest + y);
+      }
+      updateModX(xDest);
+      updateModX(xDest + w - 1);
+      return splashOk;
+    }
     for (y = 0; y < h; ++y) {
       pipeSetXY(&pipe, xDest, yDest + y);
       for (x = 0; x < w; ++x) {
@@ -61,6 +61,16 @@ enum SplashPipeResultColorCtrl {
 #endif
 };
 
+// Span kernels used by drawSpan, drawAALine and fillGlyph2 instead of
+// running the pipe for each pixel.  The kernel is selected by pipeInit.
+enum SplashPipeSpanCtrl {
+  splashPipeSpanGeneric,	// pipeRun for each pixel
+  splashPipeSpanSolidRGB8,	// opaque fixed color, RGB8/BGR8
+  splashPipeSpanAlphaRGB8	// fixed color with source alpha or shape,
+				//   no blend function, soft mask or group
+				//   correction, RGB8/BGR8
+};
+
 //------------------------------------------------------------------------
 // Splash
 //------------------------------------------------------------------------
@@ -250,6 +260,7 @@ private:
   void drawAAPixel(SplashPipe *pipe, int x, int y);
   void drawSpan(SplashPipe *pipe, int x0, int x1, int y, GBool noClip);
   void drawAALine(SplashPipe *pipe, int x0, int x1, int y);
+  void drawSpanRGB8(SplashPipe *pipe, int x0, int x1, int y);
   void transform(SplashCoord *matrix, SplashCoord xi, SplashCoord yi,
 		 SplashCoord *xo, SplashCoord *yo);
   void updateModX(int x);
@@ -233,6 +233,18 @@ struct SplashFTFontPath {
 };
 
 SplashPath *SplashFTFont::getGlyphPath(int c) {
+  SplashPath *path;
+
+  if (!fontFile->isShared()) {
+    return makeGlyphPath(c);
+  }
+  fontFile->lock();
+  path = makeGlyphPath(c);
+  fontFile->unlock();
+  return path;
+}
+
+SplashPath *SplashFTFont::makeGlyphPath(int c) {
   static FT_Outline_Funcs outlineFuncs = {
 #if FREETYPE_MINOR <= 1
     (int (*)(FT_Vector *, void *))&glyphPathMoveTo,
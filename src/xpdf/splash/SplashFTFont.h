@@ -47,6 +47,9 @@ public:
 
 private:
 
+  // Build the glyph path for getGlyphPath.
+  SplashPath *makeGlyphPath(int c);
+
   FT_Size sizeObj;
   FT_Matrix matrix;
   FT_Matrix textMatrix;
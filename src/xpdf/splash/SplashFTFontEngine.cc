@@ -12,28 +12,30 @@
 #pragma implementation
 #endif
 
-#include <stdio.h>
-#ifndef WIN32
-#  include <unistd.h>
-#endif
+#include <string.h>
 #include "goo/gmem.h"
 #include "goo/GString.h"
-#include "goo/gfile.h"
 #include "fofi/FoFiTrueType.h"
 #include "fofi/FoFiType1C.h"
 #include "splash/SplashFTFontFile.h"
 #include "splash/SplashFTFontEngine.h"
 
-#ifdef VMS
-#if (__VMS_VER < 70000000)
-extern "C" int unlink(char *filename);
-#endif
-#endif
-
 //------------------------------------------------------------------------
 
-static void fileWrite(void *stream, const char *data, int len) {
-  fwrite(data, 1, len, (FILE *)stream);
+struct BufWriter {
+  char *buf;
+  int len, size;
+};
+
+static void bufWrite(void *stream, const char *data, int len) {
+  BufWriter *out = (BufWriter *)stream;
+
+  if (out->len + len > out->size) {
+    out->size = 2 * out->size + len;
+    out->buf = (char *)grealloc(out->buf, out->size);
+  }
+  memcpy(out->buf + out->len, data, len);
+  out->len += len;
 }
 
 //------------------------------------------------------------------------
@@ -66,29 +68,25 @@ SplashFTFontEngine::~SplashFTFontEngine() {
 }
 
 SplashFontFile *SplashFTFontEngine::loadType1Font(SplashFontFileID *idA,
-						  char *fileName,
-						  GBool deleteFile,
+						  SplashFontSrc *src,
 						  char **enc) {
-  return SplashFTFontFile::loadType1Font(this, idA, fileName, deleteFile, enc);
+  return SplashFTFontFile::loadType1Font(this, idA, src, enc);
 }
 
 SplashFontFile *SplashFTFontEngine::loadType1CFont(SplashFontFileID *idA,
-						   char *fileName,
-						   GBool deleteFile,
+						   SplashFontSrc *src,
 						   char **enc) {
-  return SplashFTFontFile::loadType1Font(this, idA, fileName, deleteFile, enc);
+  return SplashFTFontFile::loadType1Font(this, idA, src, enc);
 }
 
 SplashFontFile *SplashFTFontEngine::loadOpenTypeT1CFont(SplashFontFileID *idA,
-							char *fileName,
-							GBool deleteFile,
+							SplashFontSrc *src,
 							char **enc) {
-  return SplashFTFontFile::loadType1Font(this, idA, fileName, deleteFile, enc);
+  return SplashFTFontFile::loadType1Font(this, idA, src, enc);
 }
 
 SplashFontFile *SplashFTFontEngine::loadCIDFont(SplashFontFileID *idA,
-						char *fileName,
-						GBool deleteFile) {
+						SplashFontSrc *src) {
   FoFiType1C *ff;
   Gushort *cidToGIDMap;
   int nCIDs;
@@ -98,15 +96,15 @@ SplashFontFile *SplashFTFontEngine::loadCIDFont(SplashFontFileID *idA,
   if (useCIDs) {
     cidToGIDMap = NULL;
     nCIDs = 0;
-  } else if ((ff = FoFiType1C::load(fileName))) {
+  } else if ((ff = src->isFile ? FoFiType1C::load(src->fileName->getCString())
+	                       : FoFiType1C::make(src->buf, src->bufLen))) {
     cidToGIDMap = ff->getCIDToGIDMap(&nCIDs);
     delete ff;
   } else {
     cidToGIDMap = NULL;
     nCIDs = 0;
   }
-  ret = SplashFTFontFile::loadCIDFont(this, idA, fileName, deleteFile,
-				      cidToGIDMap, nCIDs);
+  ret = SplashFTFontFile::loadCIDFont(this, idA, src, cidToGIDMap, nCIDs);
   if (!ret) {
     gfree(cidToGIDMap);
   }
@@ -114,8 +112,7 @@ SplashFontFile *SplashFTFontEngine::loadCIDFont(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFTFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
-							char *fileName,
-							GBool deleteFile) {
+							SplashFontSrc *src) {
   FoFiTrueType *ff;
   GBool isCID;
   Gushort *cidToGIDMap;
@@ -126,15 +123,15 @@ SplashFontFile *SplashFTFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
   nCIDs = 0;
   isCID = gFalse;
   if (!useCIDs) {
-    if ((ff = FoFiTrueType::load(fileName))) {
+    if ((ff = src->isFile ? FoFiTrueType::load(src->fileName->getCString())
+	                  : FoFiTrueType::make(src->buf, src->bufLen))) {
       if (ff->isOpenTypeCFF()) {
 	cidToGIDMap = ff->getCIDToGIDMap(&nCIDs);
       }
       delete ff;
     }
   }
-  ret = SplashFTFontFile::loadCIDFont(this, idA, fileName, deleteFile,
-				      cidToGIDMap, nCIDs);
+  ret = SplashFTFontFile::loadCIDFont(this, idA, src, cidToGIDMap, nCIDs);
   if (!ret) {
     gfree(cidToGIDMap);
   }
@@ -142,37 +139,29 @@ SplashFontFile *SplashFTFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFTFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
-						     char *fileName,
-						     GBool deleteFile,
+						     SplashFontSrc *src,
 						     Gushort *codeToGID,
 						     int codeToGIDLen) {
   FoFiTrueType *ff;
-  GString *tmpFileName;
-  FILE *tmpFile;
+  BufWriter out;
+  SplashFontSrc *ttfSrc;
   SplashFontFile *ret;
 
-  if (!(ff = FoFiTrueType::load(fileName))) {
+  if (!(ff = src->isFile ? FoFiTrueType::load(src->fileName->getCString())
+	                 : FoFiTrueType::make(src->buf, src->bufLen))) {
     return NULL;
   }
-  tmpFileName = NULL;
-  if (!openTempFile(&tmpFileName, &tmpFile, "wb", NULL)) {
-    delete ff;
-    return NULL;
-  }
-  ff->writeTTF(&fileWrite, tmpFile);
+
+  // the (possibly repaired) font is written to memory
+  out.buf = NULL;
+  out.len = out.size = 0;
+  ff->writeTTF(&bufWrite, &out);
   delete ff;
-  fclose(tmpFile);
-  ret = SplashFTFontFile::loadTrueTypeFont(this, idA,
-					   tmpFileName->getCString(),
-					   gTrue, codeToGID, codeToGIDLen);
-  if (ret) {
-    if (deleteFile) {
-      unlink(fileName);
-    }
-  } else {
-    unlink(tmpFileName->getCString());
-  }
-  delete tmpFileName;
+  ttfSrc = new SplashFontSrc();
+  ttfSrc->setBuf(out.buf, out.len, gTrue);
+  ret = SplashFTFontFile::loadTrueTypeFont(this, idA, ttfSrc,
+					   codeToGID, codeToGIDLen);
+  ttfSrc->unref();
   return ret;
 }
 
@@ -13,6 +13,7 @@
 #endif
 
 #include "goo/gmem.h"
+#include "goo/GString.h"
 #include "splash/SplashFTFontEngine.h"
 #include "splash/SplashFTFont.h"
 #include "splash/SplashFTFontFile.h"
@@ -21,17 +22,26 @@
 // SplashFTFontFile
 //------------------------------------------------------------------------
 
+// Create a FreeType face from a font file or from font data in memory
+// (the data must be kept until the face is released).
+static GBool newFace(FT_Library lib, SplashFontSrc *src, FT_Face *face) {
+  if (src->isFile) {
+    return !FT_New_Face(lib, src->fileName->getCString(), 0, face);
+  }
+  return !FT_New_Memory_Face(lib, (const FT_Byte *)src->buf, src->bufLen,
+			     0, face);
+}
+
 SplashFontFile *SplashFTFontFile::loadType1Font(SplashFTFontEngine *engineA,
 						SplashFontFileID *idA,
-						char *fileNameA,
-						GBool deleteFileA,
+						SplashFontSrc *srcA,
 						char **encA) {
   FT_Face faceA;
   Gushort *codeToGIDA;
   char *name;
   int i;
 
-  if (FT_New_Face(engineA->lib, fileNameA, 0, &faceA)) {
+  if (!newFace(engineA->lib, srcA, &faceA)) {
     return NULL;
   }
   codeToGIDA = (Gushort *)gmallocn(256, sizeof(int));
@@ -42,49 +52,47 @@ SplashFontFile *SplashFTFontFile::loadType1Font(SplashFTFontEngine *engineA,
     }
   }
 
-  return new SplashFTFontFile(engineA, idA, fileNameA, deleteFileA,
+  return new SplashFTFontFile(engineA, idA, srcA,
 			      faceA, codeToGIDA, 256, gFalse);
 }
 
 SplashFontFile *SplashFTFontFile::loadCIDFont(SplashFTFontEngine *engineA,
 					      SplashFontFileID *idA,
-					      char *fileNameA,
-					      GBool deleteFileA,
+					      SplashFontSrc *srcA,
 					      Gushort *codeToGIDA,
 					      int codeToGIDLenA) {
   FT_Face faceA;
 
-  if (FT_New_Face(engineA->lib, fileNameA, 0, &faceA)) {
+  if (!newFace(engineA->lib, srcA, &faceA)) {
     return NULL;
   }
 
-  return new SplashFTFontFile(engineA, idA, fileNameA, deleteFileA,
+  return new SplashFTFontFile(engineA, idA, srcA,
 			      faceA, codeToGIDA, codeToGIDLenA, gFalse);
 }
 
 SplashFontFile *SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA,
 						   SplashFontFileID *idA,
-						   char *fileNameA,
-						   GBool deleteFileA,
+						   SplashFontSrc *srcA,
 						   Gushort *codeToGIDA,
 						   int codeToGIDLenA) {
   FT_Face faceA;
 
-  if (FT_New_Face(engineA->lib, fileNameA, 0, &faceA)) {
+  if (!newFace(engineA->lib, srcA, &faceA)) {
     return NULL;
   }
 
-  return new SplashFTFontFile(engineA, idA, fileNameA, deleteFileA,
+  return new SplashFTFontFile(engineA, idA, srcA,
 			      faceA, codeToGIDA, codeToGIDLenA, gTrue);
 }
 
 SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA,
 				   SplashFontFileID *idA,
-				   char *fileNameA, GBool deleteFileA,
+				   SplashFontSrc *srcA,
 				   FT_Face faceA,
 				   Gushort *codeToGIDA, int codeToGIDLenA,
 				   GBool trueTypeA):
-  SplashFontFile(idA, fileNameA, deleteFileA)
+  SplashFontFile(idA, srcA)
 {
   engine = engineA;
   face = faceA;
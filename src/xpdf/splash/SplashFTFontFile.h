@@ -30,16 +30,15 @@ class SplashFTFontFile: public SplashFontFile {
 public:
 
   static SplashFontFile *loadType1Font(SplashFTFontEngine *engineA,
-				       SplashFontFileID *idA, char *fileNameA,
-				       GBool deleteFileA, char **encA);
+				       SplashFontFileID *idA,
+				       SplashFontSrc *srcA, char **encA);
   static SplashFontFile *loadCIDFont(SplashFTFontEngine *engineA,
-				     SplashFontFileID *idA, char *fileNameA,
-				     GBool deleteFileA,
+				     SplashFontFileID *idA,
+				     SplashFontSrc *srcA,
 				     Gushort *codeToCIDA, int codeToGIDLenA);
   static SplashFontFile *loadTrueTypeFont(SplashFTFontEngine *engineA,
 					  SplashFontFileID *idA,
-					  char *fileNameA,
-					  GBool deleteFileA,
+					  SplashFontSrc *srcA,
 					  Gushort *codeToGIDA,
 					  int codeToGIDLenA);
 
@@ -54,7 +53,7 @@ private:
 
   SplashFTFontFile(SplashFTFontEngine *engineA,
 		   SplashFontFileID *idA,
-		   char *fileNameA, GBool deleteFileA,
+		   SplashFontSrc *srcA,
 		   FT_Face faceA,
 		   Gushort *codeToGIDA, int codeToGIDLenA,
 		   GBool trueTypeA);
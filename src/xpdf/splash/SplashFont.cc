@@ -23,6 +23,7 @@ struct SplashFontCacheTag {
   int c;
   short xFrac, yFrac;		// x and y fractions
   int mru;			// valid bit (0x80000000) and MRU index
+  int refCnt;			// glyphs of shared fonts in use
   int x, y, w, h;		// offset and size of glyph
 };
 
@@ -46,6 +47,7 @@ SplashFont::SplashFont(SplashFontFile *fontFileA, SplashCoord *matA,
 
   cache = NULL;
   cacheTags = NULL;
+  refCnt = 1;
 
   xMin = yMin = xMax = yMax = 0;
 }
@@ -79,6 +81,7 @@ void SplashFont::initCache() {
 					     sizeof(SplashFontCacheTag));
   for (i = 0; i < cacheSets * cacheAssoc; ++i) {
     cacheTags[i].mru = i & (cacheAssoc - 1);
+    cacheTags[i].refCnt = 0;
   }
 }
 
@@ -92,8 +95,54 @@ SplashFont::~SplashFont() {
   }
 }
 
+void SplashFont::decRefCnt() {
+  if (!--refCnt) {
+    delete this;
+  }
+}
+
 GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 			   SplashGlyphBitmap *bitmap) {
+  int slot;
+  GBool ok;
+
+  if (!fontFile->isShared()) {
+    return lookupGlyph(c, xFrac, yFrac, bitmap);
+  }
+
+  // the glyph cache (and the font file) of a shared font may be used
+  // by more threads at once - the returned cache slot is pinned until
+  // releaseGlyph, so that no other thread replaces it
+  fontFile->lock();
+  ok = lookupGlyph(c, xFrac, yFrac, bitmap);
+  if (ok && (slot = getGlyphSlot(bitmap)) >= 0) {
+    ++cacheTags[slot].refCnt;
+  }
+  fontFile->unlock();
+  return ok;
+}
+
+void SplashFont::releaseGlyph(SplashGlyphBitmap *bitmap) {
+  int slot;
+
+  if (!fontFile->isShared() || (slot = getGlyphSlot(bitmap)) < 0) {
+    return;
+  }
+  fontFile->lock();
+  --cacheTags[slot].refCnt;
+  fontFile->unlock();
+}
+
+int SplashFont::getGlyphSlot(SplashGlyphBitmap *bitmap) {
+  if (bitmap->freeData || !cache || bitmap->data < cache ||
+      bitmap->data >= cache + cacheSets * cacheAssoc * glyphSize) {
+    return -1;
+  }
+  return (bitmap->data - cache) / glyphSize;
+}
+
+GBool SplashFont::lookupGlyph(int c, int xFrac, int yFrac,
+			      SplashGlyphBitmap *bitmap) {
   SplashGlyphBitmap bitmap2;
   int size;
   Guchar *p;
@@ -143,6 +192,16 @@ GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
     return gTrue;
   }
 
+  // the same if the slot to be replaced is still in use (shared fonts
+  // only)
+  for (j = 0; j < cacheAssoc; ++j) {
+    if ((cacheTags[i+j].mru & 0x7fffffff) == cacheAssoc - 1 &&
+	cacheTags[i+j].refCnt > 0) {
+      *bitmap = bitmap2;
+      return gTrue;
+    }
+  }
+
   // insert glyph pixmap in cache
   if (aa) {
     size = bitmap2.w * bitmap2.h;
@@ -48,6 +48,12 @@ public:
 
   SplashFontFile *getFontFile() { return fontFile; }
 
+  // Reference counting - only used for fonts of shared font files
+  // (see SplashFontFileCache), other fonts are owned by their
+  // SplashFontEngine.  Deletes the font when the count drops to zero.
+  void incRefCnt() { ++refCnt; }
+  void decRefCnt();
+
   // Return true if <this> matches the specified font file and matrix.
   GBool matches(SplashFontFile *fontFileA, SplashCoord *matA,
 		SplashCoord *textMatA) {
@@ -64,10 +70,15 @@ public:
   // the numerators of fractions in [0, 1), where the denominator is
   // splashFontFraction = 1 << splashFontFractionBits.  Subclasses
   // should override this to zero out xFrac and/or yFrac if they don't
-  // support fractional coordinates.
+  // support fractional coordinates.  Cached glyphs of shared fonts
+  // stay in their cache slot until releaseGlyph is called.
   virtual GBool getGlyph(int c, int xFrac, int yFrac,
 			 SplashGlyphBitmap *bitmap);
 
+  // Release a glyph returned by getGlyph (the caller still frees the
+  // data if freeData is set).
+  void releaseGlyph(SplashGlyphBitmap *bitmap);
+
   // Rasterize a glyph.  The <xFrac> and <yFrac> values are the same
   // as described for getGlyph.
   virtual GBool makeGlyph(int c, int xFrac, int yFrac,
@@ -83,8 +94,19 @@ public:
   void getBBox(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA)
     { *xMinA = xMin; *yMinA = yMin; *xMaxA = xMax; *yMaxA = yMax; }
 
+  // Return the size of the glyph bitmap cache, in bytes.
+  int getCacheSize()
+    { return cache ? cacheSets * cacheAssoc * glyphSize : 0; }
+
 protected:
 
+  // Glyph cache lookup for getGlyph.
+  GBool lookupGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bitmap);
+
+  // Return the cache slot of a glyph returned by lookupGlyph, or -1 if
+  // the glyph is not cached.
+  int getGlyphSlot(SplashGlyphBitmap *bitmap);
+
   SplashFontFile *fontFile;
   SplashCoord mat[4];		// font transform matrix
 				//   (text space -> device space)
@@ -99,6 +121,7 @@ protected:
   int glyphSize;		// size of glyph bitmaps, in bytes
   int cacheSets;		// number of sets in cache
   int cacheAssoc;		// cache associativity (glyphs per set)
+  int refCnt;			// reference count (shared fonts only)
 };
 
 #endif
@@ -16,10 +16,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#ifndef WIN32
-#  include <unistd.h>
-#endif
 #include "goo/gmem.h"
+#include "goo/GList.h"
 #include "goo/GString.h"
 #include "splash/SplashMath.h"
 #include "splash/SplashT1FontEngine.h"
@@ -29,11 +27,16 @@
 #include "splash/SplashFont.h"
 #include "splash/SplashFontEngine.h"
 
-#ifdef VMS
-#if (__VMS_VER < 70000000)
-extern "C" int unlink(char *filename);
-#endif
-#endif
+//------------------------------------------------------------------------
+
+// Font file from the SplashFontFileCache, together with the ID it was
+// requested with (the font file itself may carry the ID of another
+// document's font).
+struct SplashFontEngineSharedFile {
+  SplashFontFileID *id;
+  GBool ownID;			// id isn't the font file's own ID
+  SplashFontFile *fontFile;
+};
 
 //------------------------------------------------------------------------
 // SplashFontEngine
@@ -46,23 +49,25 @@ SplashFontEngine::SplashFontEngine(
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
 				   GBool enableFreeType,
 #endif
-				   GBool aa) {
+				   GBool aaA) {
   int i;
 
   for (i = 0; i < splashFontCacheSize; ++i) {
     fontCache[i] = NULL;
   }
+  sharedFiles = new GList();
+  aa = aaA;
 
 #if HAVE_T1LIB_H
   if (enableT1lib) {
-    t1Engine = SplashT1FontEngine::init(aa);
+    t1Engine = SplashT1FontEngine::init(aaA);
   } else {
     t1Engine = NULL;
   }
 #endif
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (enableFreeType) {
-    ftEngine = SplashFTFontEngine::init(aa);
+    ftEngine = SplashFTFontEngine::init(aaA);
   } else {
     ftEngine = NULL;
   }
@@ -70,13 +75,26 @@ SplashFontEngine::SplashFontEngine(
 }
 
 SplashFontEngine::~SplashFontEngine() {
+  SplashFontEngineSharedFile *sf;
+  SplashFont *font;
   int i;
 
   for (i = 0; i < splashFontCacheSize; ++i) {
-    if (fontCache[i]) {
-      delete fontCache[i];
+    if ((font = fontCache[i])) {
+      fontCache[i] = NULL;
+      freeFont(font);
     }
   }
+  // font files which were loaded but never used by a font
+  for (i = 0; i < sharedFiles->getLength(); ++i) {
+    sf = (SplashFontEngineSharedFile *)sharedFiles->get(i);
+    SplashFontFileCache::getCache()->releaseFontFile(sf->fontFile);
+    if (sf->ownID) {
+      delete sf->id;
+    }
+    delete sf;
+  }
+  delete sharedFiles;
 
 #if HAVE_T1LIB_H
   if (t1Engine) {
@@ -91,13 +109,23 @@ SplashFontEngine::~SplashFontEngine() {
 }
 
 SplashFontFile *SplashFontEngine::getFontFile(SplashFontFileID *id) {
+  SplashFontEngineSharedFile *sf;
   SplashFontFile *fontFile;
   int i;
 
+  for (i = 0; i < sharedFiles->getLength(); ++i) {
+    sf = (SplashFontEngineSharedFile *)sharedFiles->get(i);
+    if (sf->id->matches(id)) {
+      return sf->fontFile;
+    }
+  }
   for (i = 0; i < splashFontCacheSize; ++i) {
     if (fontCache[i]) {
       fontFile = fontCache[i]->getFontFile();
-      if (fontFile && fontFile->getID()->matches(id)) {
+      // IDs of shared font files belong to the engine which loaded
+      // them first
+      if (fontFile && !fontFile->isShared() &&
+	  fontFile->getID()->matches(id)) {
 	return fontFile;
       }
     }
@@ -106,29 +134,23 @@ SplashFontFile *SplashFontEngine::getFontFile(SplashFontFileID *id) {
 }
 
 SplashFontFile *SplashFontEngine::loadType1Font(SplashFontFileID *idA,
-						char *fileName,
-						GBool deleteFile, char **enc) {
+						SplashFontSrc *src,
+						char **enc) {
   SplashFontFile *fontFile;
 
   fontFile = NULL;
 #if HAVE_T1LIB_H
   if (!fontFile && t1Engine) {
-    fontFile = t1Engine->loadType1Font(idA, fileName, deleteFile, enc);
+    fontFile = t1Engine->loadType1Font(idA, src, enc);
   }
 #endif
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (!fontFile && ftEngine) {
-    fontFile = ftEngine->loadType1Font(idA, fileName, deleteFile, enc);
-  }
-#endif
-
-#ifndef WIN32
-  // delete the (temporary) font file -- with Unix hard link
-  // semantics, this will remove the last link; otherwise it will
-  // return an error, leaving the file to be deleted later (if
-  // loadXYZFont failed, the file will always be deleted)
-  if (deleteFile) {
-    unlink(fontFile ? fontFile->fileName->getCString() : fileName);
+    if (shareFontFile(src)) {
+      fontFile = loadSharedFontFile(splashFontFileType1, idA, src, enc, NULL, 0);
+    } else {
+      fontFile = ftEngine->loadType1Font(idA, src, enc);
+    }
   }
 #endif
 
@@ -136,30 +158,23 @@ SplashFontFile *SplashFontEngine::loadType1Font(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFontEngine::loadType1CFont(SplashFontFileID *idA,
-						 char *fileName,
-						 GBool deleteFile,
+						 SplashFontSrc *src,
 						 char **enc) {
   SplashFontFile *fontFile;
 
   fontFile = NULL;
 #if HAVE_T1LIB_H
   if (!fontFile && t1Engine) {
-    fontFile = t1Engine->loadType1CFont(idA, fileName, deleteFile, enc);
+    fontFile = t1Engine->loadType1CFont(idA, src, enc);
   }
 #endif
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (!fontFile && ftEngine) {
-    fontFile = ftEngine->loadType1CFont(idA, fileName, deleteFile, enc);
-  }
-#endif
-
-#ifndef WIN32
-  // delete the (temporary) font file -- with Unix hard link
-  // semantics, this will remove the last link; otherwise it will
-  // return an error, leaving the file to be deleted later (if
-  // loadXYZFont failed, the file will always be deleted)
-  if (deleteFile) {
-    unlink(fontFile ? fontFile->fileName->getCString() : fileName);
+    if (shareFontFile(src)) {
+      fontFile = loadSharedFontFile(splashFontFileType1C, idA, src, enc, NULL, 0);
+    } else {
+      fontFile = ftEngine->loadType1CFont(idA, src, enc);
+    }
   }
 #endif
 
@@ -167,25 +182,19 @@ SplashFontFile *SplashFontEngine::loadType1CFont(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFontEngine::loadOpenTypeT1CFont(SplashFontFileID *idA,
-						      char *fileName,
-						      GBool deleteFile,
+						      SplashFontSrc *src,
 						      char **enc) {
   SplashFontFile *fontFile;
 
   fontFile = NULL;
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (!fontFile && ftEngine) {
-    fontFile = ftEngine->loadOpenTypeT1CFont(idA, fileName, deleteFile, enc);
-  }
-#endif
-
-#ifndef WIN32
-  // delete the (temporary) font file -- with Unix hard link
-  // semantics, this will remove the last link; otherwise it will
-  // return an error, leaving the file to be deleted later (if
-  // loadXYZFont failed, the file will always be deleted)
-  if (deleteFile) {
-    unlink(fontFile ? fontFile->fileName->getCString() : fileName);
+    if (shareFontFile(src)) {
+      fontFile = loadSharedFontFile(splashFontFileOpenTypeT1C, idA, src, enc,
+					  NULL, 0);
+    } else {
+      fontFile = ftEngine->loadOpenTypeT1CFont(idA, src, enc);
+    }
   }
 #endif
 
@@ -193,24 +202,17 @@ SplashFontFile *SplashFontEngine::loadOpenTypeT1CFont(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFontEngine::loadCIDFont(SplashFontFileID *idA,
-					      char *fileName,
-					      GBool deleteFile) {
+					      SplashFontSrc *src) {
   SplashFontFile *fontFile;
 
   fontFile = NULL;
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (!fontFile && ftEngine) {
-    fontFile = ftEngine->loadCIDFont(idA, fileName, deleteFile);
-  }
-#endif
-
-#ifndef WIN32
-  // delete the (temporary) font file -- with Unix hard link
-  // semantics, this will remove the last link; otherwise it will
-  // return an error, leaving the file to be deleted later (if
-  // loadXYZFont failed, the file will always be deleted)
-  if (deleteFile) {
-    unlink(fontFile ? fontFile->fileName->getCString() : fileName);
+    if (shareFontFile(src)) {
+      fontFile = loadSharedFontFile(splashFontFileCID, idA, src, NULL, NULL, 0);
+    } else {
+      fontFile = ftEngine->loadCIDFont(idA, src);
+    }
   }
 #endif
 
@@ -218,24 +220,18 @@ SplashFontFile *SplashFontEngine::loadCIDFont(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
-						      char *fileName,
-						      GBool deleteFile) {
+						      SplashFontSrc *src) {
   SplashFontFile *fontFile;
 
   fontFile = NULL;
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (!fontFile && ftEngine) {
-    fontFile = ftEngine->loadOpenTypeCFFFont(idA, fileName, deleteFile);
-  }
-#endif
-
-#ifndef WIN32
-  // delete the (temporary) font file -- with Unix hard link
-  // semantics, this will remove the last link; otherwise it will
-  // return an error, leaving the file to be deleted later (if
-  // loadXYZFont failed, the file will always be deleted)
-  if (deleteFile) {
-    unlink(fontFile ? fontFile->fileName->getCString() : fileName);
+    if (shareFontFile(src)) {
+      fontFile = loadSharedFontFile(splashFontFileOpenTypeCFF, idA, src,
+					  NULL, NULL, 0);
+    } else {
+      fontFile = ftEngine->loadOpenTypeCFFFont(idA, src);
+    }
   }
 #endif
 
@@ -243,8 +239,7 @@ SplashFontFile *SplashFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
 }
 
 SplashFontFile *SplashFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
-						   char *fileName,
-						   GBool deleteFile,
+						   SplashFontSrc *src,
 						   Gushort *codeToGID,
 						   int codeToGIDLen) {
   SplashFontFile *fontFile;
@@ -252,8 +247,13 @@ SplashFontFile *SplashFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
   fontFile = NULL;
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (!fontFile && ftEngine) {
-    fontFile = ftEngine->loadTrueTypeFont(idA, fileName, deleteFile,
-					  codeToGID, codeToGIDLen);
+    if (shareFontFile(src)) {
+      fontFile = loadSharedFontFile(splashFontFileTrueType, idA, src, NULL,
+				    codeToGID, codeToGIDLen);
+    } else {
+      fontFile = ftEngine->loadTrueTypeFont(idA, src,
+					    codeToGID, codeToGIDLen);
+    }
   }
 #endif
 
@@ -261,16 +261,6 @@ SplashFontFile *SplashFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
     gfree(codeToGID);
   }
 
-#ifndef WIN32
-  // delete the (temporary) font file -- with Unix hard link
-  // semantics, this will remove the last link; otherwise it will
-  // return an error, leaving the file to be deleted later (if
-  // loadXYZFont failed, the file will always be deleted)
-  if (deleteFile) {
-    unlink(fontFile ? fontFile->fileName->getCString() : fileName);
-  }
-#endif
-
   return fontFile;
 }
 
@@ -278,7 +268,7 @@ SplashFont *SplashFontEngine::getFont(SplashFontFile *fontFile,
 				      SplashCoord *textMat,
 				      SplashCoord *ctm) {
   SplashCoord mat[4];
-  SplashFont *font;
+  SplashFont *font, *oldFont;
   int i, j;
 
   mat[0] = textMat[0] * ctm[0] + textMat[1] * ctm[2];
@@ -305,13 +295,92 @@ SplashFont *SplashFontEngine::getFont(SplashFontFile *fontFile,
       return font;
     }
   }
-  font = fontFile->makeFont(mat, textMat);
-  if (fontCache[splashFontCacheSize - 1]) {
-    delete fontCache[splashFontCacheSize - 1];
+  if (fontFile->isShared()) {
+    font = SplashFontFileCache::getCache()->getFont(fontFile, mat, textMat);
+  } else {
+    font = fontFile->makeFont(mat, textMat);
   }
+  // the new font is put to the cache before the last one is freed, so
+  // that a shared font file used by both of them is kept
+  oldFont = fontCache[splashFontCacheSize - 1];
   for (j = splashFontCacheSize - 1; j > 0; --j) {
     fontCache[j] = fontCache[j-1];
   }
   fontCache[0] = font;
+  if (oldFont) {
+    freeFont(oldFont);
+  }
   return font;
 }
+
+// Only fonts in memory (embedded fonts) are shared - font files on
+// disk are cheap to reload and their IDs carry the substitution info.
+GBool SplashFontEngine::shareFontFile(SplashFontSrc *src) {
+  return !src->isFile && SplashFontFileCache::getCache()->getMaxSize() > 0;
+}
+
+SplashFontFile *SplashFontEngine::loadSharedFontFile(
+				      SplashFontFileCacheKind kind,
+				      SplashFontFileID *idA,
+				      SplashFontSrc *src, char **enc,
+				      Gushort *codeToGID, int codeToGIDLen) {
+  SplashFontEngineSharedFile *sf;
+  SplashFontFile *fontFile;
+
+  if (!(fontFile = SplashFontFileCache::getCache()->loadFontFile(
+				    kind, aa, idA, src, enc,
+				    codeToGID, codeToGIDLen))) {
+    return NULL;
+  }
+  sf = new SplashFontEngineSharedFile;
+  sf->id = idA;
+  sf->ownID = fontFile->getID() != idA;
+  sf->fontFile = fontFile;
+  sharedFiles->append(sf);
+  if (sf->ownID) {
+    // cache hit - the font file has its own mapping
+    gfree(codeToGID);
+  }
+  return fontFile;
+}
+
+// Free a font which was removed from the font cache.  Shared font
+// files are released as soon as no cached font uses them, so that the
+// SplashFontFileCache can drop them.
+void SplashFontEngine::freeFont(SplashFont *font) {
+  SplashFontFile *fontFile;
+  int i;
+
+  fontFile = font->getFontFile();
+  if (!fontFile->isShared()) {
+    delete font;
+    return;
+  }
+  // sharedFiles keeps the font file alive
+  SplashFontFileCache::getCache()->releaseFont(font);
+  for (i = 0; i < splashFontCacheSize; ++i) {
+    if (fontCache[i] && fontCache[i]->getFontFile() == fontFile) {
+      return;
+    }
+  }
+  releaseSharedFile(fontFile);
+}
+
+// Release all references to a shared font file (it may have been
+// loaded more times with different IDs).
+void SplashFontEngine::releaseSharedFile(SplashFontFile *fontFile) {
+  SplashFontEngineSharedFile *sf;
+  int i;
+
+  for (i = sharedFiles->getLength() - 1; i >= 0; --i) {
+    sf = (SplashFontEngineSharedFile *)sharedFiles->get(i);
+    if (sf->fontFile == fontFile) {
+      sharedFiles->del(i);
+      if (sf->ownID) {
+	delete sf->id;
+      }
+      delete sf;
+      SplashFontFileCache::getCache()->releaseFontFile(fontFile);
+    }
+  }
+}
@@ -14,12 +14,15 @@
 #endif
 
 #include "goo/gtypes.h"
+#include "splash/SplashFontFileCache.h"
 
+class GList;
 class SplashT1FontEngine;
 class SplashFTFontEngine;
 class SplashDTFontEngine;
 class SplashDT4FontEngine;
 class SplashFontFile;
+class SplashFontSrc;
 class SplashFontFileID;
 class SplashFont;
 
@@ -50,19 +53,20 @@ public:
   // matching entry in the cache.
   SplashFontFile *getFontFile(SplashFontFileID *id);
 
-  // Load fonts - these create new SplashFontFile objects.
-  SplashFontFile *loadType1Font(SplashFontFileID *idA, char *fileName,
-				GBool deleteFile, char **enc);
-  SplashFontFile *loadType1CFont(SplashFontFileID *idA, char *fileName,
-				 GBool deleteFile, char **enc);
-  SplashFontFile *loadOpenTypeT1CFont(SplashFontFileID *idA, char *fileName,
-				      GBool deleteFile, char **enc);
-  SplashFontFile *loadCIDFont(SplashFontFileID *idA, char *fileName,
-			      GBool deleteFile);
-  SplashFontFile *loadOpenTypeCFFFont(SplashFontFileID *idA, char *fileName,
-				      GBool deleteFile);
-  SplashFontFile *loadTrueTypeFont(SplashFontFileID *idA, char *fileName,
-				   GBool deleteFile,
+  // Load fonts - these create new SplashFontFile objects.  Each of
+  // them takes its own reference to <src>, the caller keeps (and
+  // releases) its reference.  Fonts loaded from memory by FreeType
+  // are shared with other engines through the SplashFontFileCache.
+  SplashFontFile *loadType1Font(SplashFontFileID *idA, SplashFontSrc *src,
+				char **enc);
+  SplashFontFile *loadType1CFont(SplashFontFileID *idA, SplashFontSrc *src,
+				 char **enc);
+  SplashFontFile *loadOpenTypeT1CFont(SplashFontFileID *idA,
+				      SplashFontSrc *src, char **enc);
+  SplashFontFile *loadCIDFont(SplashFontFileID *idA, SplashFontSrc *src);
+  SplashFontFile *loadOpenTypeCFFFont(SplashFontFileID *idA,
+				      SplashFontSrc *src);
+  SplashFontFile *loadTrueTypeFont(SplashFontFileID *idA, SplashFontSrc *src,
 				   Gushort *codeToGID, int codeToGIDLen);
 
   // Get a font - this does a cache lookup first, and if not found,
@@ -78,7 +82,19 @@ public:
 
 private:
 
+  GBool shareFontFile(SplashFontSrc *src);
+  SplashFontFile *loadSharedFontFile(SplashFontFileCacheKind kind,
+				     SplashFontFileID *idA,
+				     SplashFontSrc *src, char **enc,
+				     Gushort *codeToGID, int codeToGIDLen);
+  void freeFont(SplashFont *font);
+  void releaseSharedFile(SplashFontFile *fontFile);
+
   SplashFont *fontCache[splashFontCacheSize];
+  GList *sharedFiles;		// font files from the SplashFontFileCache
+				//   used by fonts in fontCache
+				//   [SplashFontEngineSharedFile]
+  GBool aa;
 
 #if HAVE_T1LIB_H
   SplashT1FontEngine *t1Engine;
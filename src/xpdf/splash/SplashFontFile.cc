@@ -14,6 +14,7 @@
 #ifndef WIN32
 #  include <unistd.h>
 #endif
+#include "goo/gmem.h"
 #include "goo/GString.h"
 #include "splash/SplashFontFile.h"
 #include "splash/SplashFontFileID.h"
@@ -24,24 +25,94 @@ extern "C" int unlink(char *filename);
 #endif
 #endif
 
+//------------------------------------------------------------------------
+// SplashFontSrc
+//------------------------------------------------------------------------
+
+SplashFontSrc::SplashFontSrc() {
+  isFile = gFalse;
+  fileName = NULL;
+  buf = NULL;
+  bufLen = 0;
+  refCnt = 1;
+  deleteSrc = gFalse;
+}
+
+SplashFontSrc::~SplashFontSrc() {
+  if (deleteSrc) {
+    if (isFile) {
+      if (fileName) {
+	unlink(fileName->getCString());
+      }
+    } else {
+      gfree(buf);
+    }
+  }
+  if (fileName) {
+    delete fileName;
+  }
+}
+
+void SplashFontSrc::setFile(const GString *file, GBool del) {
+  setFile(file->getCString(), del);
+}
+
+void SplashFontSrc::setFile(const char *file, GBool del) {
+  isFile = gTrue;
+  fileName = new GString(file);
+  deleteSrc = del;
+}
+
+void SplashFontSrc::setBuf(char *bufA, int bufLenA, GBool del) {
+  isFile = gFalse;
+  buf = bufA;
+  bufLen = bufLenA;
+  deleteSrc = del;
+}
+
+void SplashFontSrc::ref() {
+  ++refCnt;
+}
+
+void SplashFontSrc::unref() {
+  if (!--refCnt) {
+    delete this;
+  }
+}
+
 //------------------------------------------------------------------------
 // SplashFontFile
 //------------------------------------------------------------------------
 
-SplashFontFile::SplashFontFile(SplashFontFileID *idA, char *fileNameA,
-			       GBool deleteFileA) {
+SplashFontFile::SplashFontFile(SplashFontFileID *idA, SplashFontSrc *srcA) {
   id = idA;
-  fileName = new GString(fileNameA);
-  deleteFile = deleteFileA;
+  src = srcA;
+  src->ref();
   refCnt = 0;
+  shared = gFalse;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 }
 
 SplashFontFile::~SplashFontFile() {
-  if (deleteFile) {
-    unlink(fileName->getCString());
-  }
-  delete fileName;
+  src->unref();
   delete id;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void SplashFontFile::lock() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+}
+
+void SplashFontFile::unlock() {
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
 }
 
 void SplashFontFile::incRefCnt() {
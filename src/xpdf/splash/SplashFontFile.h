@@ -16,11 +16,58 @@
 #include "goo/gtypes.h"
 #include "splash/SplashTypes.h"
 
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
 class GString;
 class SplashFontEngine;
 class SplashFont;
 class SplashFontFileID;
 
+//------------------------------------------------------------------------
+// SplashFontSrc
+//------------------------------------------------------------------------
+
+// Font data - either a font file or a memory buffer (e.g., a decoded
+// embedded font stream).  The source is reference counted: its
+// creator holds the first reference and each SplashFontFile loaded
+// from it holds another one.
+class SplashFontSrc {
+public:
+
+  SplashFontSrc();
+
+  // Use a font file.  If <del> is true, the file is deleted when the
+  // source is destroyed.
+  void setFile(const GString *file, GBool del);
+  void setFile(const char *file, GBool del);
+
+  // Use a memory buffer (allocated with gmalloc).  If <del> is true,
+  // the source takes over the buffer and frees it when it is
+  // destroyed.
+  void setBuf(char *bufA, int bufLenA, GBool del);
+
+  // Increment the reference count.
+  void ref();
+
+  // Decrement the reference count.  If the new value is zero, delete
+  // the SplashFontSrc object.
+  void unref();
+
+  GBool isFile;			// true for font files, false for buffers
+  GString *fileName;		// font file name
+  char *buf;			// font data
+  int bufLen;			// length of font data
+
+private:
+
+  ~SplashFontSrc();
+
+  int refCnt;
+  GBool deleteSrc;		// delete the file or free the buffer
+};
+
 //------------------------------------------------------------------------
 // SplashFontFile
 //------------------------------------------------------------------------
@@ -44,17 +91,31 @@ public:
   // the SplashFontFile object.
   void decRefCnt();
 
+  // Return true if this font file lives in the process-wide
+  // SplashFontFileCache.  Shared font files (and their SplashFonts)
+  // may be used by more threads - their glyphs are only rasterized
+  // with the font file locked.
+  GBool isShared() { return shared; }
+
+  // Lock/unlock the font file.  This serializes the use of the font
+  // (e.g., FreeType face) and of the glyph caches of its SplashFonts.
+  void lock();
+  void unlock();
+
 protected:
 
-  SplashFontFile(SplashFontFileID *idA, char *fileNameA,
-		 GBool deleteFileA);
+  SplashFontFile(SplashFontFileID *idA, SplashFontSrc *srcA);
 
   SplashFontFileID *id;
-  GString *fileName;
-  GBool deleteFile;
+  SplashFontSrc *src;
   int refCnt;
+  GBool shared;
+#if MULTITHREADED
+  GMutex mutex;
+#endif
 
   friend class SplashFontEngine;
+  friend class SplashFontFileCache;
 };
 
 #endif
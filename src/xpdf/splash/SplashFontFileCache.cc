@@ -0,0 +1,346 @@
+//========================================================================
+//
+// SplashFontFileCache.cc
+//
+//========================================================================
+
+#include <xpdf-aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GList.h"
+#include "goo/GString.h"
+#include "splash/SplashFTFontEngine.h"
+#include "splash/SplashFontFile.h"
+#include "splash/SplashFont.h"
+#include "splash/SplashFontFileCache.h"
+
+//------------------------------------------------------------------------
+
+struct SplashFontFileCacheEntry {
+  Guint hash;			// hash of the font data and params
+  SplashFontFileCacheKind kind;
+  GBool aa;
+  SplashFontSrc *src;		// font data the file was loaded from
+  GString *params;		// encoding or code-to-GID mapping
+  SplashFontFile *fontFile;
+  SplashFont *fonts[splashFontFileCacheFonts];	// scaled fonts
+				//   (most recently used first)
+  int users;			// references returned by loadFontFile
+  int size;			// size of the font data, params and glyph
+				//   caches of the scaled fonts
+};
+
+// FNV-1a hash.
+static Guint hashData(Guint h, const char *p, int len) {
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    h ^= (Guchar)p[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+static SplashFontFileCache sharedCache;
+
+//------------------------------------------------------------------------
+// SplashFontFileCache
+//------------------------------------------------------------------------
+
+SplashFontFileCache *SplashFontFileCache::getCache() {
+  return &sharedCache;
+}
+
+void SplashFontFileCache::lock() {
+#if MULTITHREADED
+  gLockMutex(&sharedCache.mutex);
+#endif
+}
+
+void SplashFontFileCache::unlock() {
+#if MULTITHREADED
+  gUnlockMutex(&sharedCache.mutex);
+#endif
+}
+
+SplashFontFileCache::SplashFontFileCache() {
+  entries = new GList();
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+  ftEngines[0] = ftEngines[1] = NULL;
+#endif
+  maxSize = splashFontFileCacheDefaultSize;
+  size = 0;
+  hits = misses = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+SplashFontFileCache::~SplashFontFileCache() {
+  trim(0);
+  // font files which are still in use keep their engine
+  if (entries->getLength() == 0) {
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+    if (ftEngines[0]) {
+      delete ftEngines[0];
+    }
+    if (ftEngines[1]) {
+      delete ftEngines[1];
+    }
+#endif
+    delete entries;
+#if MULTITHREADED
+    gDestroyMutex(&mutex);
+#endif
+  }
+}
+
+void SplashFontFileCache::setMaxSize(int maxSizeA) {
+  lock();
+  maxSize = maxSizeA;
+  trim(maxSize);
+  unlock();
+}
+
+void SplashFontFileCache::getStats(int *hitsA, int *missesA,
+				   int *nFilesA, int *sizeA) {
+  lock();
+  *hitsA = hits;
+  *missesA = misses;
+  *nFilesA = entries->getLength();
+  *sizeA = size;
+  unlock();
+}
+
+SplashFontFile *SplashFontFileCache::loadFontFile(
+				   SplashFontFileCacheKind kind, GBool aa,
+				   SplashFontFileID *idA, SplashFontSrc *src,
+				   char **enc,
+				   Gushort *codeToGID, int codeToGIDLen) {
+  SplashFontFileCacheEntry *entry;
+  SplashFontFile *fontFile;
+  GString *params;
+  Guint hash;
+  int i;
+
+  // the encoding and the code-to-GID mapping are baked into the font
+  // file, so they are part of the key
+  params = new GString();
+  if (enc) {
+    for (i = 0; i < 256; ++i) {
+      if (enc[i]) {
+	params->append(enc[i]);
+      }
+      params->append('\0');
+    }
+  }
+  if (codeToGID) {
+    params->append((char *)codeToGID, codeToGIDLen * sizeof(Gushort));
+  }
+  hash = hashData(2166136261U, src->buf, src->bufLen);
+  hash = hashData(hash, params->getCString(), params->getLength());
+
+  lock();
+
+  // look for a font file with the same data
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (SplashFontFileCacheEntry *)entries->get(i);
+    if (entry->hash == hash && entry->kind == kind && entry->aa == aa &&
+	entry->src->bufLen == src->bufLen &&
+	!memcmp(entry->src->buf, src->buf, src->bufLen) &&
+	!entry->params->cmp(params)) {
+      entries->del(i);
+      entries->insert(0, entry);
+      ++entry->users;
+      entry->fontFile->incRefCnt();
+      ++hits;
+      unlock();
+      delete params;
+      return entry->fontFile;
+    }
+  }
+  ++misses;
+
+  // load a new one
+  fontFile = NULL;
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+  i = aa ? 1 : 0;
+  if (!ftEngines[i]) {
+    ftEngines[i] = SplashFTFontEngine::init(aa);
+  }
+  if (ftEngines[i]) {
+    switch (kind) {
+    case splashFontFileType1:
+      fontFile = ftEngines[i]->loadType1Font(idA, src, enc);
+      break;
+    case splashFontFileType1C:
+      fontFile = ftEngines[i]->loadType1CFont(idA, src, enc);
+      break;
+    case splashFontFileOpenTypeT1C:
+      fontFile = ftEngines[i]->loadOpenTypeT1CFont(idA, src, enc);
+      break;
+    case splashFontFileCID:
+      fontFile = ftEngines[i]->loadCIDFont(idA, src);
+      break;
+    case splashFontFileOpenTypeCFF:
+      fontFile = ftEngines[i]->loadOpenTypeCFFFont(idA, src);
+      break;
+    case splashFontFileTrueType:
+      fontFile = ftEngines[i]->loadTrueTypeFont(idA, src,
+						codeToGID, codeToGIDLen);
+      break;
+    }
+  }
+#endif
+  if (!fontFile) {
+    unlock();
+    delete params;
+    return NULL;
+  }
+
+  entry = new SplashFontFileCacheEntry;
+  entry->hash = hash;
+  entry->kind = kind;
+  entry->aa = aa;
+  // keep the original data - the font file may have been loaded from
+  // a converted copy of it
+  entry->src = src;
+  src->ref();
+  entry->params = params;
+  entry->fontFile = fontFile;
+  for (i = 0; i < splashFontFileCacheFonts; ++i) {
+    entry->fonts[i] = NULL;
+  }
+  entry->users = 1;
+  entry->size = src->bufLen + params->getLength();
+  fontFile->shared = gTrue;
+  // one reference for the cache, one for the caller
+  fontFile->incRefCnt();
+  fontFile->incRefCnt();
+  entries->insert(0, entry);
+  size += entry->size;
+  trim(maxSize);
+  unlock();
+  return fontFile;
+}
+
+void SplashFontFileCache::releaseFontFile(SplashFontFile *fontFile) {
+  int i;
+
+  lock();
+  if ((i = findEntry(fontFile)) >= 0) {
+    --((SplashFontFileCacheEntry *)entries->get(i))->users;
+  }
+  fontFile->decRefCnt();
+  trim(maxSize);
+  unlock();
+}
+
+SplashFont *SplashFontFileCache::getFont(SplashFontFile *fontFile,
+					 SplashCoord *mat,
+					 SplashCoord *textMat) {
+  SplashFontFileCacheEntry *entry;
+  SplashFont *font;
+  int i, j;
+
+  lock();
+  if ((i = findEntry(fontFile)) < 0) {
+    // this shouldn't happen - the caller holds the font file
+    unlock();
+    return NULL;
+  }
+  entry = (SplashFontFileCacheEntry *)entries->get(i);
+  for (i = 0; i < splashFontFileCacheFonts; ++i) {
+    font = entry->fonts[i];
+    if (font && font->matches(fontFile, mat, textMat)) {
+      for (j = i; j > 0; --j) {
+	entry->fonts[j] = entry->fonts[j-1];
+      }
+      entry->fonts[0] = font;
+      font->incRefCnt();
+      unlock();
+      return font;
+    }
+  }
+  // the new font shares the font file with other threads' fonts
+  fontFile->lock();
+  font = fontFile->makeFont(mat, textMat);
+  fontFile->unlock();
+  if (entry->fonts[splashFontFileCacheFonts - 1]) {
+    entry->size -= entry->fonts[splashFontFileCacheFonts - 1]->getCacheSize();
+    size -= entry->fonts[splashFontFileCacheFonts - 1]->getCacheSize();
+    entry->fonts[splashFontFileCacheFonts - 1]->decRefCnt();
+  }
+  for (j = splashFontFileCacheFonts - 1; j > 0; --j) {
+    entry->fonts[j] = entry->fonts[j-1];
+  }
+  entry->fonts[0] = font;
+  font->incRefCnt();
+  entry->size += font->getCacheSize();
+  size += font->getCacheSize();
+  trim(maxSize);
+  unlock();
+  return font;
+}
+
+void SplashFontFileCache::releaseFont(SplashFont *font) {
+  lock();
+  font->decRefCnt();
+  unlock();
+}
+
+void SplashFontFileCache::flush() {
+  lock();
+  trim(0);
+  unlock();
+}
+
+int SplashFontFileCache::findEntry(SplashFontFile *fontFile) {
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    if (((SplashFontFileCacheEntry *)entries->get(i))->fontFile ==
+	fontFile) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void SplashFontFileCache::freeEntry(SplashFontFileCacheEntry *entry) {
+  int i;
+
+  size -= entry->size;
+  for (i = 0; i < splashFontFileCacheFonts; ++i) {
+    if (entry->fonts[i]) {
+      entry->fonts[i]->decRefCnt();
+    }
+  }
+  entry->fontFile->decRefCnt();
+  entry->src->unref();
+  delete entry->params;
+  delete entry;
+}
+
+// Drop unused font files, least recently used first, until the size
+// of the font data is at most <maxSizeA> (zero drops all unused font
+// files).  Must be called with the cache locked.
+void SplashFontFileCache::trim(int maxSizeA) {
+  SplashFontFileCacheEntry *entry;
+  int i;
+
+  for (i = entries->getLength() - 1;
+       i >= 0 && (size > maxSizeA || maxSizeA == 0);
+       --i) {
+    entry = (SplashFontFileCacheEntry *)entries->get(i);
+    if (entry->users == 0) {
+      entries->del(i);
+      freeEntry(entry);
+    }
+  }
+}
@@ -0,0 +1,139 @@
+//========================================================================
+//
+// SplashFontFileCache.h
+//
+//========================================================================
+
+#ifndef SPLASHFONTFILECACHE_H
+#define SPLASHFONTFILECACHE_H
+
+#include <xpdf-aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "splash/SplashTypes.h"
+
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
+class GList;
+class GString;
+class SplashFTFontEngine;
+class SplashFontFile;
+class SplashFontFileID;
+class SplashFontSrc;
+class SplashFont;
+struct SplashFontFileCacheEntry;
+
+//------------------------------------------------------------------------
+
+// default limit for the font data kept in the cache (bytes)
+#define splashFontFileCacheDefaultSize (32 * 1024 * 1024)
+
+// number of scaled fonts kept for each font file
+#define splashFontFileCacheFonts 16
+
+enum SplashFontFileCacheKind {
+  splashFontFileType1,
+  splashFontFileType1C,
+  splashFontFileOpenTypeT1C,
+  splashFontFileCID,
+  splashFontFileOpenTypeCFF,
+  splashFontFileTrueType
+};
+
+//------------------------------------------------------------------------
+// SplashFontFileCache
+//------------------------------------------------------------------------
+
+// Process-wide cache of font files loaded from memory (i.e., embedded
+// font programs), keyed by the font data.  Documents which embed the
+// same font share one parsed font file and its scaled fonts (with
+// their glyph caches), no matter which SplashFontEngine (output
+// device) renders them.  The cache loads the fonts with its own
+// FreeType engines, so the shared font files outlive the engines which
+// asked for them.
+//
+// Font files which are used by some engine stay in the cache, unused
+// ones are dropped in LRU order when the size of the cached font data
+// (font programs and glyph caches of their scaled fonts) exceeds the
+// limit.  Engines release font files which are not used by any font
+// in their font cache.
+class SplashFontFileCache {
+public:
+
+  // Return the process-wide cache.
+  static SplashFontFileCache *getCache();
+
+  // Lock/unlock the cache.  The cache entries and the reference
+  // counts of shared font files and their fonts are used only with the
+  // cache locked; glyphs are rasterized with the font file locked (see
+  // SplashFontFile::lock).
+  static void lock();
+  static void unlock();
+
+  SplashFontFileCache();
+  ~SplashFontFileCache();
+
+  // Set the limit for the cached font data, in bytes.  Zero disables
+  // sharing of font files.
+  void setMaxSize(int maxSizeA);
+  int getMaxSize() { return maxSize; }
+
+  // Get the cache statistics: number of hits and misses of
+  // loadFontFile, number of cached font files and size of their data
+  // (including glyph caches).
+  void getStats(int *hitsA, int *missesA, int *nFilesA, int *sizeA);
+
+  // Find a font file with the same data (and encoding or code-to-GID
+  // mapping) or load a new one.  <src> must be a memory source.  The
+  // font file is returned with a reference for the caller which has
+  // to be released by releaseFontFile.  If a new font file is loaded,
+  // it takes over <idA> and <codeToGID> like the SplashFontEngine load
+  // functions do; a cached font file has a different ID and the caller
+  // keeps both.  Returns NULL if the font can't be loaded.
+  SplashFontFile *loadFontFile(SplashFontFileCacheKind kind, GBool aa,
+			       SplashFontFileID *idA, SplashFontSrc *src,
+			       char **enc,
+			       Gushort *codeToGID, int codeToGIDLen);
+
+  // Release a font file returned by loadFontFile.
+  void releaseFontFile(SplashFontFile *fontFile);
+
+  // Get a scaled font of a shared font file - this does a lookup
+  // first, and if not found, creates a new SplashFont object.  The
+  // font is returned with a reference for the caller which has to be
+  // released by releaseFont.
+  SplashFont *getFont(SplashFontFile *fontFile,
+		      SplashCoord *mat, SplashCoord *textMat);
+
+  // Release a font returned by getFont.
+  void releaseFont(SplashFont *font);
+
+  // Drop all unused font files.
+  void flush();
+
+private:
+
+  int findEntry(SplashFontFile *fontFile);
+  void freeEntry(SplashFontFileCacheEntry *entry);
+  void trim(int maxSizeA);
+
+  GList *entries;		// cached font files [SplashFontFileCacheEntry]
+				//   (most recently used first)
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+  SplashFTFontEngine *ftEngines[2];	// engines for aa = gFalse/gTrue
+#endif
+  int maxSize;			// limit for the cached font data
+  int size;			// size of the cached font data
+  int hits, misses;		// loadFontFile statistics
+#if MULTITHREADED
+  GMutex mutex;
+#endif
+};
+
+#endif
@@ -24,12 +24,6 @@
 #include "splash/SplashT1FontFile.h"
 #include "splash/SplashT1FontEngine.h"
 
-#ifdef VMS
-#if (__VMS_VER < 70000000)
-extern "C" int unlink(char *filename);
-#endif
-#endif
-
 //------------------------------------------------------------------------
 
 int SplashT1FontEngine::t1libInitCount = 0;
@@ -82,22 +76,43 @@ SplashT1FontEngine::~SplashT1FontEngine() {
 }
 
 SplashFontFile *SplashT1FontEngine::loadType1Font(SplashFontFileID *idA,
-						  char *fileName,
-						  GBool deleteFile,
+						  SplashFontSrc *src,
 						  char **enc) {
-  return SplashT1FontFile::loadType1Font(this, idA, fileName, deleteFile, enc);
+  GString *tmpFileName;
+  FILE *tmpFile;
+  SplashFontSrc *fileSrc;
+  SplashFontFile *ret;
+
+  if (src->isFile) {
+    return SplashT1FontFile::loadType1Font(this, idA, src, enc);
+  }
+
+  // t1lib reads fonts only from files
+  tmpFileName = NULL;
+  if (!openTempFile(&tmpFileName, &tmpFile, "wb", NULL)) {
+    return NULL;
+  }
+  fileWrite(tmpFile, src->buf, src->bufLen);
+  fclose(tmpFile);
+  fileSrc = new SplashFontSrc();
+  fileSrc->setFile(tmpFileName, gTrue);
+  delete tmpFileName;
+  ret = SplashT1FontFile::loadType1Font(this, idA, fileSrc, enc);
+  fileSrc->unref();
+  return ret;
 }
 
 SplashFontFile *SplashT1FontEngine::loadType1CFont(SplashFontFileID *idA,
-						   char *fileName,
-						   GBool deleteFile,
+						   SplashFontSrc *src,
 						   char **enc) {
   FoFiType1C *ff;
   GString *tmpFileName;
   FILE *tmpFile;
+  SplashFontSrc *fileSrc;
   SplashFontFile *ret;
 
-  if (!(ff = FoFiType1C::load(fileName))) {
+  if (!(ff = src->isFile ? FoFiType1C::load(src->fileName->getCString())
+	                 : FoFiType1C::make(src->buf, src->bufLen))) {
     return NULL;
   }
   tmpFileName = NULL;
@@ -108,16 +123,11 @@ SplashFontFile *SplashT1FontEngine::loadType1CFont(SplashFontFileID *idA,
   ff->convertToType1(NULL, NULL, gTrue, &fileWrite, tmpFile);
   delete ff;
   fclose(tmpFile);
-  ret = SplashT1FontFile::loadType1Font(this, idA, tmpFileName->getCString(),
-					gTrue, enc);
-  if (ret) {
-    if (deleteFile) {
-      unlink(fileName);
-    }
-  } else {
-    unlink(tmpFileName->getCString());
-  }
+  fileSrc = new SplashFontSrc();
+  fileSrc->setFile(tmpFileName, gTrue);
   delete tmpFileName;
+  ret = SplashT1FontFile::loadType1Font(this, idA, fileSrc, enc);
+  fileSrc->unref();
   return ret;
 }
 
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <t1lib.h>
 #include "goo/gmem.h"
+#include "goo/GString.h"
 #include "splash/SplashT1FontEngine.h"
 #include "splash/SplashT1Font.h"
 #include "splash/SplashT1FontFile.h"
@@ -25,8 +26,7 @@
 
 SplashFontFile *SplashT1FontFile::loadType1Font(SplashT1FontEngine *engineA,
 						SplashFontFileID *idA,
-						char *fileNameA,
-						GBool deleteFileA,
+						SplashFontSrc *srcA,
 						char **encA) {
   int t1libIDA;
   char **encTmp;
@@ -36,7 +36,7 @@ SplashFontFile *SplashT1FontFile::loadType1Font(SplashT1FontEngine *engineA,
   int i;
 
   // load the font file
-  if ((t1libIDA = T1_AddFont(fileNameA)) < 0) {
+  if ((t1libIDA = T1_AddFont(srcA->fileName->getCString())) < 0) {
     return NULL;
   }
   T1_LoadFont(t1libIDA);
@@ -63,15 +63,15 @@ SplashFontFile *SplashT1FontFile::loadType1Font(SplashT1FontEngine *engineA,
   encTmp[256] = "custom";
   T1_ReencodeFont(t1libIDA, encTmp);
 
-  return new SplashT1FontFile(engineA, idA, fileNameA, deleteFileA,
+  return new SplashT1FontFile(engineA, idA, srcA,
 			      t1libIDA, encTmp, encStrTmp);
 }
 
 SplashT1FontFile::SplashT1FontFile(SplashT1FontEngine *engineA,
 				   SplashFontFileID *idA,
-				   char *fileNameA, GBool deleteFileA,
+				   SplashFontSrc *srcA,
 				   int t1libIDA, char **encA, char *encStrA):
-  SplashFontFile(idA, fileNameA, deleteFileA)
+  SplashFontFile(idA, srcA)
 {
   engine = engineA;
   t1libID = t1libIDA;
@@ -28,7 +28,7 @@ public:
 
   static SplashFontFile *loadType1Font(SplashT1FontEngine *engineA,
 				       SplashFontFileID *idA,
-				       char *fileNameA, GBool deleteFileA,
+				       SplashFontSrc *srcA,
 				       char **encA);
 
   virtual ~SplashT1FontFile();
@@ -42,7 +42,7 @@ private:
 
   SplashT1FontFile(SplashT1FontEngine *engineA,
 		   SplashFontFileID *idA,
-		   char *fileNameA, GBool deleteFileA,
+		   SplashFontSrc *srcA,
 		   int t1libIDA, char **encA, char *encStrA);
 
   SplashT1FontEngine *engine;
@@ -23,6 +23,10 @@
 
 #include "xpdf/Object.h"
 
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
 class XRef;
 
 //------------------------------------------------------------------------
@@ -40,9 +44,14 @@ public:
 
   Array * clone()const;
   
-  // Reference counting.
+  // Reference counting (atomic if MULTITHREADED, see Dict).
+#if MULTITHREADED
+  int incRef() { return gAtomicIncrement(&ref); }
+  int decRef() { return gAtomicDecrement(&ref); }
+#else
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
+#endif
 
   // Get number of elements.
   int getLength()const { return length; }
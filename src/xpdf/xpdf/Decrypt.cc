@@ -335,6 +335,47 @@ int DecryptStream::lookChar() {
   return c;
 }
 
+int DecryptStream::getBlock(char *blk, int size) {
+  Guchar in[16];
+  int n, m, i;
+
+  n = 0;
+  switch (algo) {
+  case cryptRC4:
+    if (size > 0 && state.rc4.buf != EOF) {
+      blk[n++] = (char)state.rc4.buf;
+      state.rc4.buf = EOF;
+    }
+    m = str->getBlock(blk + n, size - n);
+    for (i = 0; i < m; ++i, ++n) {
+      blk[n] = (char)rc4DecryptByte(state.rc4.state, &state.rc4.x,
+				    &state.rc4.y, (Guchar)blk[n]);
+    }
+    break;
+  case cryptAES:
+    while (n < size) {
+      if (state.aes.bufIdx == 16) {
+	if (str->getBlock((char *)in, 16) < 16) {
+	  break;
+	}
+	aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
+	if (state.aes.bufIdx == 16) {
+	  break;
+	}
+      }
+      m = 16 - state.aes.bufIdx;
+      if (m > size - n) {
+	m = size - n;
+      }
+      memcpy(blk + n, state.aes.buf + state.aes.bufIdx, m);
+      state.aes.bufIdx += m;
+      n += m;
+    }
+    break;
+  }
+  return n;
+}
+
 GBool DecryptStream::isBinary(GBool last)const {
   return str->isBinary(last);
 }
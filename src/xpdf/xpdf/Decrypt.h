@@ -92,6 +92,7 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GBool isBinary(GBool last)const;
   virtual Stream *getUndecodedStream() { return this; }
   virtual Stream *clone();
@@ -28,6 +28,10 @@
 
 #include "xpdf/Object.h"
 
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
@@ -49,9 +53,15 @@ public:
   // deep copier
   Dict * clone()const;
   
-  // Reference counting.
+  // Reference counting.  Objects may be shared by threads which render
+  // the same document, so the counter is atomic if MULTITHREADED.
+#if MULTITHREADED
+  int incRef() { return gAtomicIncrement(&ref); }
+  int decRef() { return gAtomicDecrement(&ref); }
+#else
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
+#endif
 
   // Get number of entries.
   int getLength()const { return length; }
@@ -4083,6 +4083,21 @@ GfxState *GfxState::save() {
   return newState;
 }
 
+GfxState *GfxState::copyWithSaves()const {
+  GfxState *state, *level;
+  const GfxState *s;
+
+  state = new GfxState(this, false);
+  level = state;
+  for (s = saved; s; s = s->saved) {
+    // saved states don't own a path (see restore())
+    level->saved = new GfxState(s, true);
+    level = level->saved;
+    level->path = NULL;
+  }
+  return state;
+}
+
 GfxState *GfxState::restore() {
   GfxState *oldState;
 
@@ -1181,6 +1181,11 @@ public:
   GfxState *save();
   GfxState *restore();
   GBool hasSaves() { return saved != NULL; }
+  const GfxState *getSaved()const { return saved; }
+
+  // Copy with the whole stack of saved states. The copy starts with an
+  // empty path.
+  GfxState *copyWithSaves()const;
 
   // Misc
   GBool parseBlendMode(const Object *obj, GfxBlendMode *mode);
@@ -462,9 +462,10 @@ private:
 #endif
 
 #if MULTITHREADED
-  GMutex mutex;
-  GMutex unicodeMapCacheMutex;
-  GMutex cMapCacheMutex;
+  // mutable because caches and lookups are done also from const methods
+  mutable GMutex mutex;
+  mutable GMutex unicodeMapCacheMutex;
+  mutable GMutex cMapCacheMutex;
 #endif
 };
 
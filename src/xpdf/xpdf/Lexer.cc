@@ -55,6 +55,9 @@ Lexer::Lexer(const XRef *xref, Stream *str) {
   strPtr = 0;
   freeArray = gTrue;
   curStr.streamReset();
+  lexStr.setStream(curStr.getStream());
+  rec = NULL;
+  tokPos = 0;
 }
 
 Lexer::Lexer(const XRef *xref, const Object *obj) {
@@ -72,7 +75,10 @@ Lexer::Lexer(const XRef *xref, const Object *obj) {
   if (streams->getLength() > 0) {
     streams->get(strPtr, &curStr);
     curStr.streamReset();
+    lexStr.setStream(curStr.getStream());
   }
+  rec = NULL;
+  tokPos = 0;
 }
 
 Lexer::~Lexer() {
@@ -83,19 +89,33 @@ Lexer::~Lexer() {
   if (freeArray) {
     delete streams;
   }
+  delete rec;
+}
+
+void Lexer::startRecord() {
+  if (!rec) {
+    rec = new GString();
+    lexStr.setRecord(rec);
+  }
 }
 
 int Lexer::getChar() {
   int c;
 
   c = EOF;
-  while (!curStr.isNone() && (c = curStr.streamGetChar()) == EOF) {
+  while (!curStr.isNone() && (c = lexStr.getChar()) == EOF) {
     curStr.streamClose();
     curStr.free();
+    lexStr.setStream(NULL);
     ++strPtr;
     if (strPtr < streams->getLength()) {
+      if (rec && rec->getLength() > 0 &&
+	  !isSpace(rec->getChar(rec->getLength() - 1) & 0xff)) {
+	rec->append('\n');
+      }
       streams->get(strPtr, &curStr);
       curStr.streamReset();
+      lexStr.setStream(curStr.getStream());
     }
   }
   return c;
@@ -105,7 +125,29 @@ int Lexer::lookChar() {
   if (curStr.isNone()) {
     return EOF;
   }
-  return curStr.streamLookChar();
+  return lexStr.lookChar();
+}
+
+//------------------------------------------------------------------------
+// LexerStream
+//------------------------------------------------------------------------
+
+int LexerStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = bufEnd - bufPtr;
+  if (n >= size) {
+    memcpy(blk, bufPtr, size);
+    bufPtr += size;
+    return size;
+  }
+  memcpy(blk, bufPtr, n);
+  bufPtr = bufEnd = buf;
+  m = str->getBlock(blk + n, size - n);
+  if (rec && m > 0) {
+    rec->append(blk + n, m);
+  }
+  return n + m;
 }
 
 Object *Lexer::getObj(Object *obj) {
@@ -122,6 +164,7 @@ Object *Lexer::getObj(Object *obj) {
   comment = gFalse;
   while (1) {
     if ((c = getChar()) == EOF) {
+      tokPos = lexStr.getRecordPos();
       return obj->initEOF();
     }
     if (comment) {
@@ -133,6 +176,9 @@ Object *Lexer::getObj(Object *obj) {
       break;
     }
   }
+  if (rec) {
+    tokPos = lexStr.getRecordPos() - 1;
+  }
 
   // start reading token
   switch (c) {
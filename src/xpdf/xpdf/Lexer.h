@@ -4,6 +4,10 @@
 //
 // Copyright 1996-2003 Glyph & Cog, LLC
 //
+// Changes:
+// Michal Hocko - Lexer reads input streams in blocks through LexerStream
+//               - Lexer can record the data read from its input streams
+//
 //========================================================================
 
 #ifndef LEXER_H
@@ -22,6 +26,59 @@ class XRef;
 
 extern char specialChars[256];
 #define tokBufSize 128		// size of token buffer
+#define lexBufSize 256		// size of input buffer
+
+//------------------------------------------------------------------------
+// LexerStream
+//
+// Reads the current Lexer input stream in blocks.  The Lexer returns
+// this stream from getStream, so that anybody reading the data directly
+// (e.g. inline images) continues right after the chars consumed by the
+// Lexer.  All chars fetched from the input streams can be recorded.
+//------------------------------------------------------------------------
+
+class LexerStream: public FilterStream {
+public:
+
+  LexerStream(): FilterStream(NULL) { bufPtr = bufEnd = buf; rec = NULL; }
+  virtual ~LexerStream() {}
+  void setStream(Stream *strA) { str = strA; bufPtr = bufEnd = buf; }
+  virtual StreamKind getKind()const { return str->getKind(); }
+  // Clones the underlying stream.  Like other stream clones, the clone
+  // contains the whole stream data and starts at its beginning, so
+  // neither the buffered chars nor the current position are copied.
+  virtual Stream *clone() { return str->clone(); }
+  virtual void reset() { bufPtr = bufEnd = buf; str->reset(); }
+  virtual int getChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
+  virtual int getPos()const { return str->getPos() - (int)(bufEnd - bufPtr); }
+  virtual void setPos(Guint pos, int dir = 0)
+    { bufPtr = bufEnd = buf; str->setPos(pos, dir); }
+  virtual GBool isBinary(GBool last = gTrue)const { return str->isBinary(last); }
+
+  // Append all chars fetched from now on to <recA> (NULL stops
+  // recording).
+  void setRecord(GString *recA) { rec = recA; }
+
+  // Get position of the next char in the record.
+  Guint getRecordPos()const
+    { return rec ? rec->getLength() - (Guint)(bufEnd - bufPtr) : 0; }
+
+private:
+
+  GBool fillBuf()
+    { bufPtr = buf; bufEnd = buf + str->getBlock(buf, lexBufSize);
+      if (rec && bufPtr < bufEnd) rec->append(buf, bufEnd - buf);
+      return bufPtr < bufEnd; }
+
+  char buf[lexBufSize];		// buffered chars of str
+  char *bufPtr;			// next char to read
+  char *bufEnd;			// end of buffered chars
+  GString *rec;			// record of fetched chars or NULL
+};
 
 //------------------------------------------------------------------------
 // Lexer
@@ -52,16 +109,28 @@ public:
 
   // Get stream.
   Stream *getStream()const
-    { return curStr.isNone() ? (Stream *)NULL : curStr.getStream(); }
+    { return curStr.isNone() ? (Stream *)NULL : (Stream *)&lexStr; }
 
   // Get current position in file.  This is only used for error
   // messages, so it returns an int instead of a Guint.
   int getPos()const
-    { return curStr.isNone() ? -1 : (int)curStr.streamGetPos(); }
+    { return curStr.isNone() ? -1 : lexStr.getPos(); }
 
   // Set position in file.
   void setPos(Guint pos, int dir = 0)
-    { if (!curStr.isNone()) curStr.streamSetPos(pos, dir); }
+    { if (!curStr.isNone()) lexStr.setPos(pos, dir); }
+
+  // Record all chars read from the input streams from now on.  A
+  // newline is inserted between two streams, if the first one does
+  // not end with a whitespace.
+  void startRecord();
+
+  // Get the recorded chars, NULL if not recording.
+  const GString *getRecord()const { return rec; }
+
+  // Get position of the object returned by the last getObj call in
+  // the record.
+  Guint getTokenPos()const { return tokPos; }
 
   // Returns true if <c> is a whitespace character.
   static GBool isSpace(int c);
@@ -78,8 +147,11 @@ private:
   Array *streams;		// array of input streams
   int strPtr;			// index of current stream
   Object curStr;		// current stream
+  LexerStream lexStr;		// buffered reader of the current stream
   GBool freeArray;		// should lexer free the streams array?
   char tokBuf[tokBufSize];	// temporary token buffer
+  GString *rec;			// recorded chars or NULL
+  Guint tokPos;			// record position of the last token
 };
 
 #endif
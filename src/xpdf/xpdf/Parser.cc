@@ -28,7 +28,9 @@ Parser::Parser(const XRef *xrefA, Lexer *lexerA, GBool allowStreamsA) {
   endOfActStream = 0;
   allowStreams = allowStreamsA;
   lexer->getObj(&buf1);
+  pos1 = lexer->getTokenPos();
   lexer->getObj(&buf2);
+  pos2 = lexer->getTokenPos();
 }
 
 Parser::~Parser() {
@@ -51,11 +53,7 @@ Object *Parser::getObj(Object *obj, const Guchar *fileKey,
 
   // refill buffer after inline image data
   if (inlineImg == 2) {
-    buf1.free();
-    buf2.free();
-    lexer->getObj(&buf1);
-    lexer->getObj(&buf2);
-    inlineImg = 0;
+    refill();
   }
 
   // array
@@ -228,6 +226,24 @@ Stream *Parser::makeStream(const Object *dict, const Guchar *fileKey,
   return str;
 }
 
+Guint Parser::getObjPos() {
+  // refill buffer after inline image data
+  if (inlineImg == 2) {
+    refill();
+  }
+  return pos1;
+}
+
+void Parser::refill() {
+  buf1.free();
+  buf2.free();
+  lexer->getObj(&buf1);
+  pos1 = lexer->getTokenPos();
+  lexer->getObj(&buf2);
+  pos2 = lexer->getTokenPos();
+  inlineImg = 0;
+}
+
 void Parser::shift() {
   if (inlineImg > 0) {
     if (inlineImg < 2) {
@@ -243,12 +259,14 @@ void Parser::shift() {
   }
   buf1.free();
   buf1 = buf2;
+  pos1 = pos2;
   if (inlineImg > 0)		// don't buffer inline image data
     buf2.initNull();
   else
   {
 	size_t pos = lexer->strIndex ();
 	lexer->getObj(&buf2);
+	pos2 = lexer->getTokenPos();
 	if (pos != lexer->strIndex())
 		endOfActStream = 2;
 	else if (0 < endOfActStream)
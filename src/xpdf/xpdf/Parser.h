@@ -44,6 +44,10 @@ WARN_UNUSED_RESULT
   // Get current position in file.
   int getPos()const { return lexer->getPos(); }
 
+  // Get position of the next object in the lexer record (see
+  // Lexer::startRecord).
+  Guint getObjPos();
+
   // End of actual stream
   bool eofOfActualStream () const { return (1 == endOfActStream); }
   // Get bext token -- be carefull, it need not point to real next object
@@ -56,6 +60,7 @@ private:
   Lexer *lexer;			// input stream
   GBool allowStreams;		// parse stream objects?
   Object buf1, buf2;		// next two tokens
+  Guint pos1, pos2;		// record positions of the next two tokens
   int inlineImg;		// set when inline image data is encountered
   size_t endOfActStream; // 1 means end of act stream
 
@@ -63,6 +68,7 @@ private:
 		     CryptAlgorithm encAlgorithm, int keyLength,
 		     int objNum, int objGen);
   void shift();
+  void refill();
 };
 
 #endif
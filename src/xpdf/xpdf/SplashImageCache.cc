@@ -0,0 +1,181 @@
+//========================================================================
+//
+// SplashImageCache.cc
+//
+//========================================================================
+
+#include <xpdf-aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "goo/gmem.h"
+#include "goo/GList.h"
+#include "xpdf/SplashImageCache.h"
+
+#if MULTITHREADED
+#  define lockCache   gLockMutex(&mutex)
+#  define unlockCache gUnlockMutex(&mutex)
+#else
+#  define lockCache
+#  define unlockCache
+#endif
+
+//------------------------------------------------------------------------
+// SplashImageCache
+//------------------------------------------------------------------------
+
+SplashImageCache::SplashImageCache(int maxSizeA) {
+  entries = new GList();
+  maxSize = maxSizeA;
+  size = 0;
+  hits = misses = 0;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+SplashImageCache::~SplashImageCache() {
+  clear();
+  delete entries;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void SplashImageCache::incRefCnt() {
+  lockCache;
+  ++refCnt;
+  unlockCache;
+}
+
+void SplashImageCache::decRefCnt() {
+  GBool done;
+
+  lockCache;
+  done = --refCnt == 0;
+  unlockCache;
+  if (done) {
+    delete this;
+  }
+}
+
+void SplashImageCache::setMaxSize(int maxSizeA) {
+  lockCache;
+  maxSize = maxSizeA;
+  trim();
+  unlockCache;
+}
+
+void SplashImageCache::getStats(int *hitsA, int *missesA,
+				int *nImagesA, int *sizeA) {
+  lockCache;
+  *hitsA = hits;
+  *missesA = misses;
+  *nImagesA = entries->getLength();
+  *sizeA = size;
+  unlockCache;
+}
+
+SplashImageCacheEntry *SplashImageCache::getImage(Ref ref) {
+  SplashImageCacheEntry *entry;
+  int i;
+
+  lockCache;
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (SplashImageCacheEntry *)entries->get(i);
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen) {
+      if (i > 0) {
+	entries->del(i);
+	entries->insert(0, entry);
+      }
+      ++entry->refCnt;
+      ++hits;
+      unlockCache;
+      return entry;
+    }
+  }
+  ++misses;
+  unlockCache;
+  return NULL;
+}
+
+SplashImageCacheEntry *SplashImageCache::addImage(Ref ref,
+						  char *buf, int len) {
+  SplashImageCacheEntry *entry;
+
+  entry = new SplashImageCacheEntry;
+  entry->ref = ref;
+  entry->buf = buf;
+  entry->len = len;
+  entry->refCnt = 1;
+  lockCache;
+  if (len <= maxSize) {
+    dropImage(ref);
+    ++entry->refCnt;
+    entries->insert(0, entry);
+    size += len;
+    trim();
+  }
+  unlockCache;
+  return entry;
+}
+
+void SplashImageCache::releaseImage(SplashImageCacheEntry *entry) {
+  lockCache;
+  unrefEntry(entry);
+  unlockCache;
+}
+
+void SplashImageCache::invalidate(Ref ref) {
+  lockCache;
+  dropImage(ref);
+  unlockCache;
+}
+
+void SplashImageCache::clear() {
+  lockCache;
+  while (entries->getLength() > 0) {
+    unrefEntry((SplashImageCacheEntry *)entries->del(0));
+  }
+  size = 0;
+  unlockCache;
+}
+
+// Must be called with the cache locked.
+void SplashImageCache::dropImage(Ref ref) {
+  SplashImageCacheEntry *entry;
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (SplashImageCacheEntry *)entries->get(i);
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen) {
+      entries->del(i);
+      size -= entry->len;
+      unrefEntry(entry);
+      break;
+    }
+  }
+}
+
+// Must be called with the cache locked.
+void SplashImageCache::unrefEntry(SplashImageCacheEntry *entry) {
+  if (!--entry->refCnt) {
+    gfree(entry->buf);
+    delete entry;
+  }
+}
+
+// Drop least recently used images until the cached data fit into the
+// limit.  Must be called with the cache locked.
+void SplashImageCache::trim() {
+  SplashImageCacheEntry *entry;
+
+  while (size > maxSize && entries->getLength() > 0) {
+    entry = (SplashImageCacheEntry *)entries->del(entries->getLength() - 1);
+    size -= entry->len;
+    unrefEntry(entry);
+  }
+}
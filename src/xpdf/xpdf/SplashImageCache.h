@@ -0,0 +1,112 @@
+//========================================================================
+//
+// SplashImageCache.h
+//
+//========================================================================
+
+#ifndef SPLASHIMAGECACHE_H
+#define SPLASHIMAGECACHE_H
+
+#include <xpdf-aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "xpdf/Object.h"
+
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
+class GList;
+
+//------------------------------------------------------------------------
+
+// default limit for the decoded image data kept in the cache (bytes)
+#define splashImageCacheDefaultSize (64 * 1024 * 1024)
+
+//------------------------------------------------------------------------
+// SplashImageCacheEntry
+//------------------------------------------------------------------------
+
+// Decoded (unfiltered) data of an image XObject stream.
+struct SplashImageCacheEntry {
+  Ref ref;			// image XObject reference
+  char *buf;			// decoded stream data
+  int len;			// length of buf
+  int refCnt;			// cache + users of the data
+};
+
+//------------------------------------------------------------------------
+// SplashImageCache
+//------------------------------------------------------------------------
+
+// Cache of decoded image streams of one document, shared by all
+// SplashOutputDevs rendering the document (see
+// SplashOutputDev::setImageCache).  Images are keyed by their XObject
+// reference - the decoded data don't depend on the resolution or the
+// color mode, so they can be reused for every zoom level.  Whoever
+// changes the document has to invalidate the changed objects.
+//
+// Images are dropped in LRU order when the size of the cached data
+// exceeds the limit.  Entries returned by getImage/addImage stay
+// valid until they are released, even if they are dropped from the
+// cache meanwhile.
+class SplashImageCache {
+public:
+
+  // Create an empty cache.  Sets the initial reference count to 1.
+  SplashImageCache(int maxSizeA = splashImageCacheDefaultSize);
+
+  void incRefCnt();
+  void decRefCnt();
+
+  // Set the limit for the cached data, in bytes.
+  void setMaxSize(int maxSizeA);
+  int getMaxSize() { return maxSize; }
+
+  // Get the cache statistics: number of hits and misses of getImage,
+  // number of cached images and size of their data.
+  void getStats(int *hitsA, int *missesA, int *nImagesA, int *sizeA);
+
+  // Look up the image <ref>.  Returns NULL if it is not cached,
+  // otherwise the entry has to be released by releaseImage.
+  SplashImageCacheEntry *getImage(Ref ref);
+
+  // Add decoded data of the image <ref> (allocated with gmalloc, the
+  // cache takes them over).  Returns the entry which has to be
+  // released by releaseImage - the data are not kept in the cache if
+  // they don't fit there.
+  SplashImageCacheEntry *addImage(Ref ref, char *buf, int len);
+
+  // Release an entry returned by getImage or addImage.
+  void releaseImage(SplashImageCacheEntry *entry);
+
+  // Drop the image <ref> (if cached).
+  void invalidate(Ref ref);
+
+  // Drop all images.
+  void clear();
+
+private:
+
+  ~SplashImageCache();
+
+  void dropImage(Ref ref);
+  void unrefEntry(SplashImageCacheEntry *entry);
+  void trim();
+
+  GList *entries;		// cached images [SplashImageCacheEntry]
+				//   (most recently used first)
+  int maxSize;			// limit for the cached data
+  int size;			// size of the cached data
+  int hits, misses;		// getImage statistics
+  int refCnt;
+#if MULTITHREADED
+  GMutex mutex;
+#endif
+};
+
+#endif
@@ -35,14 +35,9 @@
 #include "splash/SplashFontFile.h"
 #include "splash/SplashFontFileID.h"
 #include "splash/Splash.h"
+#include "xpdf/SplashImageCache.h"
 #include "xpdf/SplashOutputDev.h"
 
-#ifdef VMS
-#if (__VMS_VER < 70000000)
-extern "C" int unlink(char *filename);
-#endif
-#endif
-
 //------------------------------------------------------------------------
 
 // Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
@@ -591,6 +586,8 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   setupScreenParams(72.0, 72.0);
   reverseVideo = reverseVideoA;
   splashColorCopy(paperColor, paperColorA);
+  bandDev = gFalse;
+  bandYMin = bandYMax = 0;
 
   xref = NULL;
 
@@ -600,6 +597,7 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   splash->clear(paperColor, 0);
 
   fontEngine = NULL;
+  imageCache = NULL;
 
   nT3Fonts = 0;
   t3GlyphStack = NULL;
@@ -671,6 +669,9 @@ SplashOutputDev::~SplashOutputDev() {
   if (fontEngine) {
     delete fontEngine;
   }
+  if (imageCache) {
+    imageCache->decRefCnt();
+  }
   if (splash) {
     delete splash;
   }
@@ -700,6 +701,17 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
     delete t3FontCache[i];
   }
   nT3Fonts = 0;
+  setImageCache(NULL);
+}
+
+void SplashOutputDev::setImageCache(SplashImageCache *imageCacheA) {
+  if (imageCacheA) {
+    imageCacheA->incRefCnt();
+  }
+  if (imageCache) {
+    imageCache->decRefCnt();
+  }
+  imageCache = imageCacheA;
 }
 
 void SplashOutputDev::startPage(int pageNum, GfxState *state) {
@@ -768,10 +780,15 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
   // apparently hardwires it to true
   splash->setStrokeAdjust(globalParams->getStrokeAdjust());
   splash->clear(paperColor, 0);
+  if (bandDev) {
+    // the page geometry is the same as for the whole page, only the
+    // rows of the band are rasterized
+    splash->clipToRect(0, bandYMin, w - 0.001, bandYMax - 0.001);
+  }
 }
 
 void SplashOutputDev::endPage() {
-  if (colorMode != splashModeMono1) {
+  if (colorMode != splashModeMono1 && !bandDev) {
     splash->compositeBackground(paperColor);
   }
 }
@@ -968,9 +985,10 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
   FoFiTrueType *ff;
   Ref embRef;
   Object refObj, strObj;
-  GString *tmpFileName, *substName; 
+  GString *substName;
   const GString *fileName;
-  FILE *tmpFile;
+  SplashFontSrc *fontsrc;
+  char *buf;
   Gushort *codeToGID;
   DisplayFontParam *dfp;
   CharCodeToUnicode *ctu;
@@ -979,11 +997,11 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
   SplashCoord mat[4];
   const char *name;
   Unicode uBuf[8];
-  int c, substIdx, n, code, cmap;
+  int substIdx, n, code, cmap, len, size;
 
   needFontUpdate = gFalse;
   font = NULL;
-  tmpFileName = NULL;
+  fontsrc = NULL;
   substIdx = -1;
   dfp = NULL;
 
@@ -1002,29 +1020,29 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 
   } else {
 
-    // if there is an embedded font, write it to disk
+    // if there is an embedded font, read it into memory -- the font
+    // engine takes over the buffer, so no temporary file is needed
     if (gfxFont->getEmbeddedFontID(&embRef)) {
-      if (!openTempFile(&tmpFileName, &tmpFile, "wb", NULL)) {
-	error(-1, "Couldn't create temporary font file");
-	goto err2;
-      }
       refObj.initRef(embRef.num, embRef.gen);
       refObj.fetch(xref, &strObj);
       refObj.free();
       if (!strObj.isStream()) {
 	error(-1, "Embedded font object is wrong type");
 	strObj.free();
-	fclose(tmpFile);
 	goto err2;
       }
       strObj.streamReset();
-      while ((c = strObj.streamGetChar()) != EOF) {
-	fputc(c, tmpFile);
-      }
+      buf = NULL;
+      len = size = 0;
+      do {
+	size = size ? 2 * size : 65536;
+	buf = (char *)grealloc(buf, size);
+	len += strObj.getStream()->getBlock(buf + len, size - len);
+      } while (len == size);
       strObj.streamClose();
       strObj.free();
-      fclose(tmpFile);
-      fileName = tmpFileName;
+      fontsrc = new SplashFontSrc();
+      fontsrc->setBuf(buf, len, gTrue);
 
     // if there is an external font file, use it
     } else if (!(fileName = gfxFont->getExtFontFile())) {
@@ -1078,14 +1096,17 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 	break;
       }
     }
+    if (!fontsrc) {
+      fontsrc = new SplashFontSrc();
+      fontsrc->setFile(fileName, gFalse);
+    }
 
     // load the font file
     switch (fontType) {
     case fontType1:
       if (!(fontFile = fontEngine->loadType1Font(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName,
+			   fontsrc,
 			   ((Gfx8BitFont *)gfxFont)->getEncoding()))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
@@ -1096,8 +1117,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
     case fontType1C:
       if (!(fontFile = fontEngine->loadType1CFont(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName,
+			   fontsrc,
 			   ((Gfx8BitFont *)gfxFont)->getEncoding()))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
@@ -1108,8 +1128,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
     case fontType1COT:
       if (!(fontFile = fontEngine->loadOpenTypeT1CFont(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName,
+			   fontsrc,
 			   ((Gfx8BitFont *)gfxFont)->getEncoding()))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
@@ -1119,7 +1138,9 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       break;
     case fontTrueType:
     case fontTrueTypeOT:
-      if ((ff = FoFiTrueType::load(fileName->getCString()))) {
+      if ((ff = fontsrc->isFile
+	          ? FoFiTrueType::load(fontsrc->fileName->getCString())
+	          : FoFiTrueType::make(fontsrc->buf, fontsrc->bufLen))) {
 	codeToGID = ((Gfx8BitFont *)gfxFont)->getCodeToGIDMap(ff);
 	n = 256;
 	delete ff;
@@ -1129,8 +1150,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       }
       if (!(fontFile = fontEngine->loadTrueTypeFont(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName,
+			   fontsrc,
 			   codeToGID, n))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
@@ -1142,8 +1162,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
     case fontCIDType0C:
       if (!(fontFile = fontEngine->loadCIDFont(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName))) {
+			   fontsrc))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
 	                         : "(unnamed)");
@@ -1153,8 +1172,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
     case fontCIDType0COT:
       if (!(fontFile = fontEngine->loadOpenTypeCFFFont(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName))) {
+			   fontsrc))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
 	                         : "(unnamed)");
@@ -1168,7 +1186,9 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       if (dfp) {
 	// create a CID-to-GID mapping, via Unicode
 	if ((ctu = ((GfxCIDFont *)gfxFont)->getToUnicode())) {
-	  if ((ff = FoFiTrueType::load(fileName->getCString()))) {
+	  if ((ff = fontsrc->isFile
+		      ? FoFiTrueType::load(fontsrc->fileName->getCString())
+		      : FoFiTrueType::make(fontsrc->buf, fontsrc->bufLen))) {
 	    // look for a Unicode cmap
 	    for (cmap = 0; cmap < ff->getNumCmaps(); ++cmap) {
 	      if ((ff->getCmapPlatform(cmap) == 3 &&
@@ -1207,8 +1227,7 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       }
       if (!(fontFile = fontEngine->loadTrueTypeFont(
 			   id,
-			   fileName->getCString(),
-			   fileName == tmpFileName,
+			   fontsrc,
 			   codeToGID, n))) {
 	error(-1, "Couldn't create a font for '%s'",
 	      gfxFont->getName() ? gfxFont->getName()->getCString()
@@ -1260,17 +1279,16 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
   mat[2] = m21;  mat[3] = m22;
   font = fontEngine->getFont(fontFile, mat, splash->getMatrix());
 
-  if (tmpFileName) {
-    delete tmpFileName;
+  if (fontsrc) {
+    fontsrc->unref();
   }
   return;
 
  err2:
   delete id;
  err1:
-  if (tmpFileName) {
-    unlink(tmpFileName->getCString());
-    delete tmpFileName;
+  if (fontsrc) {
+    fontsrc->unref();
   }
   return;
 }
@@ -1733,6 +1751,7 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
   const double *ctm;
   SplashCoord mat[6];
   SplashOutImageMaskData imgMaskData;
+  SplashImageCacheEntry *cacheEntry;
 
   if (state->getFillColorSpace()->isNonMarking()) {
     return;
@@ -1746,6 +1765,7 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
+  str = getImageStream(ref, str, width, height, 1, 1, &cacheEntry);
   imgMaskData.imgStr = new ImageStream(str, width, 1, 1);
   imgMaskData.imgStr->reset();
   imgMaskData.invert = invert ? 0 : 1;
@@ -1764,6 +1784,7 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 
   delete imgMaskData.imgStr;
   str->close();
+  releaseImageStream(str, cacheEntry);
 }
 
 struct SplashOutImageData {
@@ -1969,6 +1990,7 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   SplashOutImageData imgData;
   SplashColorMode srcMode;
   SplashImageSource src;
+  SplashImageCacheEntry *cacheEntry;
   GfxGray gray;
   GfxRGB rgb;
 #if SPLASH_CMYK
@@ -1985,6 +2007,9 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
+  str = getImageStream(ref, str, width, height,
+		       colorMap->getNumPixelComps(), colorMap->getBits(),
+		       &cacheEntry);
   imgData.imgStr = new ImageStream(str, width,
 				   colorMap->getNumPixelComps(),
 				   colorMap->getBits());
@@ -2057,6 +2082,7 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   gfree(imgData.lookup);
   delete imgData.imgStr;
   str->close();
+  releaseImageStream(str, cacheEntry);
 }
 
 struct SplashOutMaskedImageData {
@@ -2165,6 +2191,7 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
   SplashOutMaskedImageData imgData;
   SplashOutImageMaskData imgMaskData;
   SplashColorMode srcMode;
+  SplashImageCacheEntry *cacheEntry;
   SplashBitmap *maskBitmap;
   Splash *maskSplash;
   SplashColor maskColor;
@@ -2229,6 +2256,9 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
     mat[4] = ctm[2] + ctm[4];
     mat[5] = ctm[3] + ctm[5];
 
+    str = getImageStream(ref, str, width, height,
+			 colorMap->getNumPixelComps(), colorMap->getBits(),
+			 &cacheEntry);
     imgData.imgStr = new ImageStream(str, width,
 				     colorMap->getNumPixelComps(),
 				     colorMap->getBits());
@@ -2294,6 +2324,7 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
     gfree(imgData.lookup);
     delete imgData.imgStr;
     str->close();
+    releaseImageStream(str, cacheEntry);
   }
 }
 
@@ -2308,6 +2339,7 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   SplashOutImageData imgData;
   SplashOutImageData imgMaskData;
   SplashColorMode srcMode;
+  SplashImageCacheEntry *cacheEntry;
   SplashBitmap *maskBitmap;
   Splash *maskSplash;
   SplashColor maskColor;
@@ -2361,6 +2393,9 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 
   //----- draw the source image
 
+  str = getImageStream(ref, str, width, height,
+		       colorMap->getNumPixelComps(), colorMap->getBits(),
+		       &cacheEntry);
   imgData.imgStr = new ImageStream(str, width,
 				   colorMap->getNumPixelComps(),
 				   colorMap->getBits());
@@ -2425,6 +2460,53 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   gfree(imgData.lookup);
   delete imgData.imgStr;
   str->close();
+  releaseImageStream(str, cacheEntry);
+}
+
+// Returns the stream to read the image data from: a memory stream with
+// the decoded data if the image <ref> is in the image cache, <str>
+// itself otherwise.  Images which aren't cached yet are decoded and
+// added to the cache first.  The returned stream has to be released by
+// releaseImageStream.
+Stream *SplashOutputDev::getImageStream(Object *ref, Stream *str,
+					int width, int height,
+					int nComps, int nBits,
+					SplashImageCacheEntry **entry) {
+  Object obj;
+  char *buf;
+  int rowSize, size;
+
+  *entry = NULL;
+  if (!imageCache || !ref || !ref->isRef()) {
+    return str;
+  }
+  if (!(*entry = imageCache->getImage(ref->getRef()))) {
+    // don't bother with images which don't fit into the cache
+    if (width <= 0 || height <= 0 ||
+	(double)width * nComps * nBits / 8 * height >
+	  imageCache->getMaxSize()) {
+      return str;
+    }
+    rowSize = (width * nComps * nBits + 7) >> 3;
+    size = rowSize * height;
+    buf = (char *)gmalloc(size);
+    str->reset();
+    // the stream may be shorter - keep what we get, so that the cached
+    // image looks the same as the uncached one
+    size = str->getBlock(buf, size);
+    str->close();
+    *entry = imageCache->addImage(ref->getRef(), buf, size);
+  }
+  obj.initNull();
+  return new MemStream((*entry)->buf, 0, (*entry)->len, &obj);
+}
+
+void SplashOutputDev::releaseImageStream(Stream *str,
+					 SplashImageCacheEntry *entry) {
+  if (entry) {
+    delete str;
+    imageCache->releaseImage(entry);
+  }
 }
 
 void SplashOutputDev::beginTransparencyGroup(GfxState *state, const double *bbox,
@@ -2725,6 +2807,69 @@ SplashBitmap *SplashOutputDev::takeBitmap() {
   return ret;
 }
 
+SplashOutputDev *SplashOutputDev::makeBandDev(int yMinA, int yMaxA) {
+  SplashOutputDev *dev;
+
+#if HAVE_T1LIB_H
+  // t1lib is not reentrant, so fonts can't be rasterized by several
+  // band devices at once
+  if (globalParams->getEnableT1lib()) {
+    return NULL;
+  }
+#endif
+  dev = new SplashOutputDev(colorMode, bitmapRowPad, reverseVideo,
+			    paperColor, bitmapTopDown, allowAntialias);
+  dev->vectorAntialias = vectorAntialias;
+  dev->bandDev = gTrue;
+  dev->bandYMin = yMinA;
+  dev->bandYMax = yMaxA;
+  return dev;
+}
+
+void SplashOutputDev::composeBands(SplashOutputDev **bands, int nBands) {
+  SplashBitmap *band;
+  int w, h, n, y, yMax, i;
+
+  w = bands[0]->bitmap->getWidth();
+  h = bands[0]->bitmap->getHeight();
+  screenParams = bands[0]->screenParams;
+  if (splash) {
+    delete splash;
+  }
+  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight()) {
+    if (bitmap) {
+      delete bitmap;
+    }
+    bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode,
+			      colorMode != splashModeMono1, bitmapTopDown);
+  }
+  splash = new Splash(bitmap, vectorAntialias, &screenParams);
+  splash->clear(paperColor, 0);
+
+  // bitmaps of the bands have the same format, so rows can be copied
+  n = bitmap->getRowSize() < 0 ? -bitmap->getRowSize()
+                               : bitmap->getRowSize();
+  for (i = 0; i < nBands; ++i) {
+    band = bands[i]->bitmap;
+    if (band->getWidth() != w || band->getHeight() != h ||
+	band->getMode() != colorMode) {
+      continue;
+    }
+    y = bands[i]->bandYMin < 0 ? 0 : bands[i]->bandYMin;
+    yMax = bands[i]->bandYMax > h ? h : bands[i]->bandYMax;
+    for (; y < yMax; ++y) {
+      memcpy(bitmap->getDataPtr() + y * bitmap->getRowSize(),
+	     band->getDataPtr() + y * band->getRowSize(), n);
+      if (bitmap->getAlphaPtr()) {
+	memcpy(bitmap->getAlphaPtr() + y * w,
+	       band->getAlphaPtr() + y * w, w);
+      }
+    }
+  }
+
+  endPage();
+}
+
 void SplashOutputDev::getModRegion(int *xMin, int *yMin,
 				   int *xMax, int *yMax) {
   splash->getModRegion(xMin, yMin, xMax, yMax);
@@ -2764,6 +2909,7 @@ SplashFont *SplashOutputDev::getFont(const GString *name, double *textMatA) {
   Ref ref;
   SplashOutFontFileID *id;
   SplashFontFile *fontFile;
+  SplashFontSrc *fontsrc;
   SplashFont *fontObj;
   FoFiTrueType *ff;
   Gushort *codeToGID;
@@ -2791,8 +2937,10 @@ SplashFont *SplashOutputDev::getFont(const GString *name, double *textMatA) {
   } else {
     dfp = globalParams->getDisplayFont(name);
     if (dfp && dfp->kind == displayFontT1) {
-      fontFile = fontEngine->loadType1Font(id, dfp->t1.fileName->getCString(),
-					   gFalse, winAnsiEncoding);
+      fontsrc = new SplashFontSrc();
+      fontsrc->setFile(dfp->t1.fileName, gFalse);
+      fontFile = fontEngine->loadType1Font(id, fontsrc, winAnsiEncoding);
+      fontsrc->unref();
     } else if (dfp && dfp->kind == displayFontTT) {
       if (!(ff = FoFiTrueType::load(dfp->tt.fileName->getCString()))) {
 	return NULL;
@@ -2817,9 +2965,10 @@ SplashFont *SplashOutputDev::getFont(const GString *name, double *textMatA) {
 	}
       }
       delete ff;
-      fontFile = fontEngine->loadTrueTypeFont(id,
-					      dfp->tt.fileName->getCString(),
-					      gFalse, codeToGID, 256);
+      fontsrc = new SplashFontSrc();
+      fontsrc->setFile(dfp->tt.fileName, gFalse);
+      fontFile = fontEngine->loadTrueTypeFont(id, fontsrc, codeToGID, 256);
+      fontsrc->unref();
     } else {
       return NULL;
     }
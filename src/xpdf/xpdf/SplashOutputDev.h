@@ -29,6 +29,8 @@ class SplashPattern;
 class SplashFontEngine;
 class SplashFont;
 class T3FontCache;
+class SplashImageCache;
+struct SplashImageCacheEntry;
 struct T3FontCacheTag;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
@@ -159,6 +161,11 @@ public:
 
   // Called to indicate that a new PDF document has been loaded.
   void startDoc(XRef *xrefA);
+
+  // Set the cache of decoded images for the current document (NULL to
+  // disable caching).  The device keeps a reference to the cache until
+  // it is replaced or the next startDoc call.
+  void setImageCache(SplashImageCache *imageCacheA);
  
   void setPaperColor(SplashColorPtr paperColorA);
 
@@ -177,6 +184,22 @@ public:
   // Get the Splash object.
   Splash *getSplash() { return splash; }
 
+  // Create a device with the same settings (color mode, bitmap format,
+  // paper color, anti-aliasing) for rendering rows <yMinA> (inclusive)
+  // to <yMaxA> (exclusive) of the page on another thread.  The band
+  // device renders the page with the same geometry as this device and
+  // clips to the band rows, so the rows are identical to the rows of a
+  // whole page rendering (the band bitmap has the size of the page).
+  // Band devices leave the paper color compositing to the device which
+  // composes the page (see composeBands).  Returns NULL if bands can't
+  // be rendered concurrently (t1lib is enabled).
+  SplashOutputDev *makeBandDev(int yMinA, int yMaxA);
+
+  // Compose the page from the band rows of <nBands> band devices which
+  // rendered the same page, and end the page (endPage) as if it was
+  // rendered by this device.
+  void composeBands(SplashOutputDev **bands, int nBands);
+
   // Get the modified region.
   void getModRegion(int *xMin, int *yMin, int *xMax, int *yMax);
 
@@ -215,6 +238,10 @@ private:
 			     Guchar *alphaLine);
   static GBool maskedImageSrc(void *data, SplashColorPtr line,
 			      Guchar *alphaLine);
+  Stream *getImageStream(Object *ref, Stream *str, int width, int height,
+			 int nComps, int nBits,
+			 SplashImageCacheEntry **entry);
+  void releaseImageStream(Stream *str, SplashImageCacheEntry *entry);
 
   SplashColorMode colorMode;
   int bitmapRowPad;
@@ -224,12 +251,15 @@ private:
   GBool reverseVideo;		// reverse video mode
   SplashColor paperColor;	// paper color
   SplashScreenParams screenParams;
+  GBool bandDev;		// renders a band of a composed page
+  int bandYMin, bandYMax;	// rows of the band (band devices only)
 
   XRef *xref;			// xref table for current document
 
   SplashBitmap *bitmap;
   Splash *splash;
   SplashFontEngine *fontEngine;
+  SplashImageCache *imageCache;	// decoded images of the current document
 
   T3FontCache *			// Type 3 font cache
     t3FontCache[splashOutT3FontCacheSize];
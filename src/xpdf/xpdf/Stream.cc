@@ -16,6 +16,9 @@
 //                * All FilterStream descendants creates same stream type
 //                  with cloned stream holder. If stream holder cloning fails,
 //                  also fails.
+//              - getBlock implementation for buffered streams and filters
+//              - FlateStream can inflate data by zlib, StreamPredictor
+//                decodes whole lines (with SSE2 kernels if available)
 //========================================================================
 
 #include <xpdf-aconf.h>
@@ -33,6 +36,12 @@
 #endif
 #include <string.h>
 #include <ctype.h>
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "xpdf/config.h"
@@ -76,6 +85,28 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getChar()) == EOF)
+      break;
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
+int Stream::getRawBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getRawChar()) == EOF)
+      break;
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -335,16 +366,30 @@ ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
   } else {
     imgLineSize = nVals;
   }
-  if (width > INT_MAX / nComps) {
+  if (width > INT_MAX / nComps || nVals > (INT_MAX - 7) / nBits) {
     // force a call to gmallocn(-1,...), which will throw an exception
     imgLineSize = -1;
   }
   imgLine = (Guchar *)gmallocn(imgLineSize, sizeof(Guchar));
+  rawLineSize = (nVals * nBits + 7) >> 3;
+  rawLine = (Guchar *)gmallocn(rawLineSize, sizeof(Guchar));
   imgIdx = nVals;
 }
 
 ImageStream::~ImageStream() {
   gfree(imgLine);
+  gfree(rawLine);
+}
+
+int ImageStream::readLine(Guchar *line) {
+  int n;
+
+  n = str->getBlock((char *)line, rawLineSize);
+  if (n < rawLineSize) {
+    // missing data are read as EOF (all bits set)
+    memset(line + n, 0xff, rawLineSize - n);
+  }
+  return n;
 }
 
 void ImageStream::reset() {
@@ -370,9 +415,14 @@ Guchar *ImageStream::getLine() {
   int c;
   int i;
 
+  if (nBits == 8) {
+    readLine(imgLine);
+    return imgLine;
+  }
+  readLine(rawLine);
   if (nBits == 1) {
     for (i = 0; i < nVals; i += 8) {
-      c = str->getChar();
+      c = rawLine[i >> 3];
       imgLine[i+0] = (Guchar)((c >> 7) & 1);
       imgLine[i+1] = (Guchar)((c >> 6) & 1);
       imgLine[i+2] = (Guchar)((c >> 5) & 1);
@@ -382,17 +432,14 @@ Guchar *ImageStream::getLine() {
       imgLine[i+6] = (Guchar)((c >> 1) & 1);
       imgLine[i+7] = (Guchar)(c & 1);
     }
-  } else if (nBits == 8) {
-    for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
-    }
   } else {
     bitMask = (1 << nBits) - 1;
     buf = 0;
     bits = 0;
+    c = 0;
     for (i = 0; i < nVals; ++i) {
       if (bits < nBits) {
-	buf = (buf << 8) | (str->getChar() & 0xff);
+	buf = (buf << 8) | rawLine[c++];
 	bits += 8;
       }
       imgLine[i] = (Guchar)((buf >> (bits - nBits)) & bitMask);
@@ -403,12 +450,7 @@ Guchar *ImageStream::getLine() {
 }
 
 void ImageStream::skipLine() {
-  int n, i;
-
-  n = (nVals * nBits + 7) >> 3;
-  for (i = 0; i < n; ++i) {
-    str->getChar();
-  }
+  readLine(rawLine);
 }
 
 //------------------------------------------------------------------------
@@ -424,6 +466,7 @@ void StreamPredictor::initContext(int predictorA,
   nComps = nCompsA;
   nBits = nBitsA;
   predLine = NULL;
+  prevLine = NULL;
   ok = gFalse;
 
   nVals = width * nComps;
@@ -438,6 +481,8 @@ void StreamPredictor::initContext(int predictorA,
   }
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  prevLine = (Guchar *)gmalloc(rowBytes);
+  memset(prevLine, 0, rowBytes);
   predIdx = rowBytes;
 
   ok = gTrue;
@@ -457,6 +502,7 @@ StreamPredictor::StreamPredictor(Stream * strA, PredictorContext & context)
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -477,13 +523,183 @@ int StreamPredictor::getChar() {
   return predLine[predIdx++];
 }
 
+int StreamPredictor::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
+  }
+  return n;
+}
+
+// PNG filter kernels.  All of them decode <len> bytes of <cur> in place,
+// <prev> is the previous (already decoded) line.  Both lines have <bpp>
+// zero bytes in front, so the left neighbour of the first pixel is 0.
+
+static void predUp(Guchar *cur, const Guchar *prev, int len) {
+  int i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(cur + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(prev + i));
+    _mm_storeu_si128((__m128i *)(cur + i), _mm_add_epi8(x, b));
+  }
+#endif
+  for (; i < len; ++i) {
+    cur[i] += prev[i];
+  }
+}
+
+#ifdef __SSE2__
+// pixels with 3 or 4 bytes are processed as one 32-bit lane
+static inline __m128i predLoad(const Guchar *p, int bpp) {
+  int v = 0;
+
+  memcpy(&v, p, bpp);
+  return _mm_cvtsi32_si128(v);
+}
+
+static inline void predStore(Guchar *p, __m128i x, int bpp) {
+  int v = _mm_cvtsi128_si32(x);
+
+  memcpy(p, &v, bpp);
+}
+
+static inline __m128i predAbs16(__m128i x) {
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline __m128i predSelect(__m128i mask, __m128i x, __m128i y) {
+  return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+#endif
+
+// returns number of bytes which are left for the generic code
+static int predSubFast(Guchar *cur, int len, int bpp) {
+  int i = 0;
+
+#ifdef __SSE2__
+  if (bpp == 3 || bpp == 4) {
+    __m128i a = _mm_setzero_si128();
+    for (; i + bpp <= len; i += bpp) {
+      a = _mm_add_epi8(predLoad(cur + i, bpp), a);
+      predStore(cur + i, a, bpp);
+    }
+  }
+#endif
+  return i;
+}
+
+static void predSub(Guchar *cur, int len, int bpp) {
+  int i;
+
+  for (i = predSubFast(cur, len, bpp); i < len; ++i) {
+    cur[i] += cur[i - bpp];
+  }
+}
+
+static int predAverageFast(Guchar *cur, const Guchar *prev, int len,
+			   int bpp) {
+  int i = 0;
+
+#ifdef __SSE2__
+  if (bpp == 3 || bpp == 4) {
+    __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (; i + bpp <= len; i += bpp) {
+      __m128i b = predLoad(prev + i, bpp);
+      // (a + b) >> 1 without overflow: avg rounds up
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+				 _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(predLoad(cur + i, bpp), avg);
+      predStore(cur + i, a, bpp);
+    }
+  }
+#endif
+  return i;
+}
+
+static void predAverage(Guchar *cur, const Guchar *prev, int len, int bpp) {
+  int i;
+
+  for (i = predAverageFast(cur, prev, len, bpp); i < len; ++i) {
+    cur[i] += (cur[i - bpp] + prev[i]) >> 1;
+  }
+}
+
+static int predPaethFast(Guchar *cur, const Guchar *prev, int len, int bpp) {
+  int i = 0;
+
+#ifdef __SSE2__
+  if (bpp == 3 || bpp == 4) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;
+    for (; i + bpp <= len; i += bpp) {
+      __m128i b = _mm_unpacklo_epi8(predLoad(prev + i, bpp), zero);
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = predAbs16(_mm_add_epi16(pa, pb));
+      pa = predAbs16(pa);
+      pb = predAbs16(pb);
+      __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      // ties are broken in favour of a, then b
+      __m128i nearest = predSelect(_mm_cmpeq_epi16(smallest, pa), a,
+			  predSelect(_mm_cmpeq_epi16(smallest, pb), b, c));
+      __m128i x = _mm_add_epi8(predLoad(cur + i, bpp),
+			       _mm_packus_epi16(nearest, nearest));
+      predStore(cur + i, x, bpp);
+      a = _mm_unpacklo_epi8(x, zero);
+      c = b;
+    }
+  }
+#endif
+  return i;
+}
+
+static void predPaeth(Guchar *cur, const Guchar *prev, int len, int bpp) {
+  int left, up, upLeft, p, pa, pb, pc;
+  int i;
+
+  for (i = predPaethFast(cur, prev, len, bpp); i < len; ++i) {
+    left = cur[i - bpp];
+    up = prev[i];
+    upLeft = prev[i - bpp];
+    p = left + up - upLeft;
+    if ((pa = p - left) < 0)
+      pa = -pa;
+    if ((pb = p - up) < 0)
+      pb = -pb;
+    if ((pc = p - upLeft) < 0)
+      pc = -pc;
+    if (pa <= pb && pa <= pc)
+      cur[i] += left;
+    else if (pb <= pc)
+      cur[i] += up;
+    else
+      cur[i] += upLeft;
+  }
+}
+
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  Guchar *line;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
+  int len, n;
   int i, j, k, kk;
 
   // get PNG optimum predictor number
@@ -496,56 +712,42 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = str->getRawChar()) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
-    }
+  // the last line becomes the previous one and the raw line is read
+  // into the other buffer
+  line = prevLine;
+  prevLine = predLine;
+  predLine = line;
+  len = rowBytes - pixBytes;
+  n = str->getRawBlock((char *)predLine + pixBytes, len);
+  if (n == 0) {
+    predLine = prevLine;
+    prevLine = line;
+    return gFalse;
+  }
+  if (n < len) {
+    // this ought to return false, but some (broken) PDF files contain
+    // truncated image data, and Adobe apparently reads the last partial
+    // line - the rest of the line is kept from the previous one
+    memcpy(predLine + pixBytes + n, prevLine + pixBytes + n, len - n);
+  }
+
+  // apply PNG (byte) predictor
+  switch (curPred) {
+  case 11:			// PNG sub
+    predSub(predLine + pixBytes, n, pixBytes);
+    break;
+  case 12:			// PNG up
+    predUp(predLine + pixBytes, prevLine + pixBytes, n);
+    break;
+  case 13:			// PNG average
+    predAverage(predLine + pixBytes, prevLine + pixBytes, n, pixBytes);
+    break;
+  case 14:			// PNG Paeth
+    predPaeth(predLine + pixBytes, prevLine + pixBytes, n, pixBytes);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    break;
   }
 
   // apply TIFF (component) predictor
@@ -558,9 +760,7 @@ GBool StreamPredictor::getNextLine() {
 	predLine[i] ^= inBuf >> nComps;
       }
     } else if (nBits == 8) {
-      for (i = pixBytes; i < rowBytes; ++i) {
-	predLine[i] += predLine[i - nComps];
-      }
+      predSub(predLine + pixBytes, len, nComps);
     } else {
       memset(upLeftBuf, 0, nComps + 1);
       bitMask = (1 << nBits) - 1;
@@ -601,21 +801,80 @@ GBool StreamPredictor::getNextLine() {
 // FileStream
 //------------------------------------------------------------------------
 
+#if MULTITHREADED
+#  define lockFile   gLockMutex(&lock->mutex)
+#  define unlockFile gUnlockMutex(&lock->mutex)
+#else
+#  define lockFile
+#  define unlockFile
+#endif
+
 FileStream::FileStream(FILE *fA, Guint startA, GBool limitedA,
 		       Guint lengthA, const Object *dictA):
     BaseStream(dictA) {
   f = fA;
+#if MULTITHREADED
+  lock = new FileStreamLock;
+  gInitMutex(&lock->mutex);
+  lock->refCnt = 1;
+#endif
+  start = startA;
+  limited = limitedA;
+  length = lengthA;
+  buf = NULL;
+  bufSize = 0;
+  // limited stream never reads more than its length
+  bufLimit = (limited && lengthA < maxBufSize) ? lengthA : maxBufSize;
+  if (bufLimit < fileStreamBufSize) {
+    bufLimit = fileStreamBufSize;
+  }
+  fillSize = fileStreamBufSize;
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+  savePos = 0;
+  saved = gFalse;
+}
+
+#if MULTITHREADED
+FileStream::FileStream(FILE *fA, Guint startA, GBool limitedA,
+		       Guint lengthA, const Object *dictA,
+		       FileStreamLock *lockA):
+    BaseStream(dictA) {
+  f = fA;
+  lock = lockA;
+  gAtomicIncrement(&lock->refCnt);
   start = startA;
   limited = limitedA;
   length = lengthA;
+  buf = NULL;
+  bufSize = 0;
+  bufLimit = (limited && lengthA < maxBufSize) ? lengthA : maxBufSize;
+  if (bufLimit < fileStreamBufSize) {
+    bufLimit = fileStreamBufSize;
+  }
+  fillSize = fileStreamBufSize;
   bufPtr = bufEnd = buf;
   bufPos = start;
   savePos = 0;
   saved = gFalse;
 }
+#endif
 
 FileStream::~FileStream() {
   close();
+  gfree(buf);
+#if MULTITHREADED
+  if (gAtomicDecrement(&lock->refCnt) == 0) {
+    gDestroyMutex(&lock->mutex);
+    delete lock;
+  }
+#endif
+}
+
+Guint FileStream::maxBufSize = fileStreamMaxBufSize;
+
+void FileStream::setMaxBufSize(Guint size) {
+  maxBufSize = (size < fileStreamBufSize) ? fileStreamBufSize : size;
 }
 
 // creates memory stream from start with length bytes
@@ -623,6 +882,7 @@ FileStream::~FileStream() {
 Stream * FileStream::clone()
 {
    size_t l=length;
+   lockFile;
    // stores current position
    long currPos=ftell(f);
 
@@ -647,6 +907,7 @@ Stream * FileStream::clone()
    if(!buffer)
    {
       fseek(f, currPos, SEEK_SET);
+      unlockFile;
       return NULL;
    }
 
@@ -659,12 +920,14 @@ Stream * FileStream::clone()
       // unable to get all data
       gfree(buffer);
       fseek(f, currPos, SEEK_SET);
+      unlockFile;
       return NULL;
    }
    buffer[l]='\0';
 
    // restores this stream to state before reading
    fseek(f, currPos, SEEK_SET);
+   unlockFile;
 
    // clones stream dictionary and Memory stream from read buffer
    // which is forced to be deallocated by clonedStream
@@ -680,10 +943,15 @@ Stream * FileStream::clone()
 
 Stream *FileStream::makeSubStream(Guint startA, GBool limitedA,
                                   Guint lengthA, const Object *dictA) {
+#if MULTITHREADED
+  return new FileStream(f, startA, limitedA, lengthA, dictA, lock);
+#else
   return new FileStream(f, startA, limitedA, lengthA, dictA);
+#endif
 }
 
 void FileStream::reset() {
+  lockFile;
 #if HAVE_FSEEKO
   savePos = (Guint)ftello(f);
   fseeko(f, start, SEEK_SET);
@@ -694,13 +962,16 @@ void FileStream::reset() {
   savePos = (Guint)ftell(f);
   fseek(f, start, SEEK_SET);
 #endif
+  unlockFile;
   saved = gTrue;
   bufPtr = bufEnd = buf;
   bufPos = start;
+  fillSize = fileStreamBufSize;
 }
 
 void FileStream::close() {
   if (saved) {
+    lockFile;
 #if HAVE_FSEEKO
     fseeko(f, savePos, SEEK_SET);
 #elif HAVE_FSEEK64
@@ -708,6 +979,7 @@ void FileStream::close() {
 #else
     fseek(f, savePos, SEEK_SET);
 #endif
+    unlockFile;
     saved = gFalse;
   }
 }
@@ -720,22 +992,63 @@ GBool FileStream::fillBuf() {
   if (limited && bufPos >= start + length) {
     return gFalse;
   }
-  if (limited && bufPos + fileStreamBufSize > start + length) {
+  if (limited && bufPos + fillSize > start + length) {
     n = start + length - bufPos;
   } else {
-    n = fileStreamBufSize;
+    n = fillSize;
+  }
+  if ((Guint)n > bufSize) {
+    buf = (char *)grealloc(buf, n);
+    bufSize = n;
   }
+  lockFile;
+#if MULTITHREADED
+  // another stream sharing the file handle may have moved it
+#if HAVE_FSEEKO
+  fseeko(f, bufPos, SEEK_SET);
+#elif HAVE_FSEEK64
+  fseek64(f, bufPos, SEEK_SET);
+#else
+  fseek(f, bufPos, SEEK_SET);
+#endif
+#endif
   n = fread(buf, 1, n, f);
+  unlockFile;
+  bufPtr = buf;
   bufEnd = buf + n;
+  // sequential reading - read more next time
+  if (fillSize < bufLimit) {
+    fillSize = (2 * fillSize < bufLimit) ? 2 * fillSize : bufLimit;
+  }
   if (bufPtr >= bufEnd) {
     return gFalse;
   }
   return gTrue;
 }
 
+int FileStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = bufEnd - bufPtr;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void FileStream::setPos(Guint pos, int dir) {
   Guint size;
 
+  lockFile;
   if (dir >= 0) {
 #if HAVE_FSEEKO
     fseeko(f, pos, SEEK_SET);
@@ -773,13 +1086,16 @@ void FileStream::setPos(Guint pos, int dir) {
     bufPos = (Guint)ftell(f);
 #endif
   }
+  unlockFile;
   bufPtr = bufEnd = buf;
+  fillSize = fileStreamBufSize;
 }
 
 void FileStream::moveStart(int delta) {
   start += delta;
   bufPtr = bufEnd = buf;
   bufPos = start;
+  fillSize = fileStreamBufSize;
 }
 
 //------------------------------------------------------------------------
@@ -849,6 +1165,22 @@ void MemStream::reset() {
 void MemStream::close() {
 }
 
+int MemStream::getBlock(char *blk, int size) {
+  int n;
+
+  n = bufEnd - bufPtr;
+  if (n > size) {
+    n = size;
+  }
+  if (n > 0) {
+    memcpy(blk, bufPtr, n);
+    bufPtr += n;
+  } else {
+    n = 0;
+  }
+  return n;
+}
+
 void MemStream::setPos(Guint pos, int dir) {
   Guint i;
 
@@ -1028,6 +1360,19 @@ int ASCIIHexStream::lookChar() {
   return buf;
 }
 
+int ASCIIHexStream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = ASCIIHexStream::lookChar()) == EOF) {
+      break;
+    }
+    buf = EOF;
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 GString *ASCIIHexStream::getPSFilter(int psLevel, const char *indent)const {
   GString *s;
 
@@ -1121,6 +1466,19 @@ int ASCII85Stream::lookChar() {
   return b[index];
 }
 
+int ASCII85Stream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = ASCII85Stream::lookChar()) == EOF) {
+      break;
+    }
+    ++index;
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 GString *ASCII85Stream::getPSFilter(int psLevel,const char *indent)const {
   GString *s;
 
@@ -1225,6 +1583,34 @@ int LZWStream::lookChar() {
   return seqBuf[seqIndex];
 }
 
+int LZWStream::getBlock(char *blk, int size) {
+  if (pred) {
+    return pred->getBlock(blk, size);
+  }
+  return getRawBlock(blk, size);
+}
+
+int LZWStream::getRawBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size && !eof) {
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+    }
+    m = seqLength - seqIndex;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, seqBuf + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
+}
+
 int LZWStream::getRawChar() {
   if (eof) {
     return EOF;
@@ -1387,6 +1773,25 @@ void RunLengthStream::reset() {
   eof = gFalse;
 }
 
+int RunLengthStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = bufEnd - bufPtr;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 GString *RunLengthStream::getPSFilter(int psLevel,const char *indent)const {
   GString *s;
 
@@ -1406,7 +1811,7 @@ GBool RunLengthStream::isBinary(GBool last)const {
 
 GBool RunLengthStream::fillBuf() {
   int c;
-  int n, i;
+  int n;
 
   if (eof)
     return gFalse;
@@ -1416,14 +1821,14 @@ GBool RunLengthStream::fillBuf() {
     return gFalse;
   }
   if (c < 0x80) {
-    n = c + 1;
-    for (i = 0; i < n; ++i)
-      buf[i] = (char)str->getChar();
+    if ((n = str->getBlock(buf, c + 1)) == 0) {
+      eof = gTrue;
+      return gFalse;
+    }
   } else {
     n = 0x101 - c;
     c = str->getChar();
-    for (i = 0; i < n; ++i)
-      buf[i] = (char)c;
+    memset(buf, (char)c, n);
   }
   bufPtr = buf;
   bufEnd = buf + n;
@@ -4173,6 +4578,26 @@ FlateHuffmanTab FlateStream::fixedDistCodeTab = {
   flateFixedDistCodeTabCodes, 5
 };
 
+#ifdef ENABLE_ZLIB
+// size of the compressed data buffer of the zlib decoder
+#define flateZlibBufSize 16384
+
+struct FlateZlib {
+  z_stream zstr;
+  Guchar inBuf[flateZlibBufSize];
+};
+
+GBool FlateStream::zlibInflate = gTrue;
+#else
+GBool FlateStream::zlibInflate = gFalse;
+#endif
+
+void FlateStream::setZlibInflate(GBool enable) {
+#ifdef ENABLE_ZLIB
+  zlibInflate = enable;
+#endif
+}
+
 FlateStream::FlateStream(Stream *strA, int predictor, int columns,
 			 int colors, int bits):
     FilterStream(strA) {
@@ -4196,6 +4621,7 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns,
   }
   litCodeTab.codes = NULL;
   distCodeTab.codes = NULL;
+  zlib = NULL;
   memset(buf, 0, flateWindow);
 }
 
@@ -4224,6 +4650,12 @@ FlateStream::~FlateStream() {
   if (distCodeTab.codes != fixedDistCodeTab.codes) {
     gfree(distCodeTab.codes);
   }
+#ifdef ENABLE_ZLIB
+  if (zlib) {
+    inflateEnd(&zlib->zstr);
+    delete zlib;
+  }
+#endif
   if (pred) {
     delete pred;
   }
@@ -4263,6 +4695,32 @@ void FlateStream::reset() {
     return;
   }
 
+#ifdef ENABLE_ZLIB
+  if (zlibInflate) {
+    // header is already consumed so raw deflate data follow (this also
+    // means that adler32 checksum is ignored as by the built-in decoder)
+    if (!zlib) {
+      zlib = new FlateZlib;
+      memset(&zlib->zstr, 0, sizeof(z_stream));
+      if (inflateInit2(&zlib->zstr, -MAX_WBITS) != Z_OK) {
+	error(getPos(), "Couldn't initialize zlib for flate stream");
+	delete zlib;
+	zlib = NULL;
+      }
+    } else {
+      inflateReset(&zlib->zstr);
+    }
+    if (zlib) {
+      zlib->zstr.next_in = zlib->inBuf;
+      zlib->zstr.avail_in = 0;
+    }
+  } else if (zlib) {
+    inflateEnd(&zlib->zstr);
+    delete zlib;
+    zlib = NULL;
+  }
+#endif
+
   eof = gFalse;
 }
 
@@ -4298,6 +4756,37 @@ int FlateStream::lookChar() {
   return c;
 }
 
+int FlateStream::getBlock(char *blk, int size) {
+  if (pred) {
+    return pred->getBlock(blk, size);
+  }
+  return getRawBlock(blk, size);
+}
+
+int FlateStream::getRawBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    // output buffer is circular so copy up to its end at most
+    m = flateWindow - index;
+    if (m > remain)
+      m = remain;
+    if (m > size - n)
+      m = size - n;
+    memcpy(blk + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
 int FlateStream::getRawChar() {
   int c;
 
@@ -4335,6 +4824,10 @@ void FlateStream::readSome() {
   int i, j, k;
   int c;
 
+  if (zlib) {
+    readSomeZlib();
+    return;
+  }
   if (endOfBlock) {
     if (!startBlock())
       return;
@@ -4394,6 +4887,42 @@ err:
   remain = 0;
 }
 
+void FlateStream::readSomeZlib() {
+#ifdef ENABLE_ZLIB
+  z_stream *zstr = &zlib->zstr;
+  int n, ret;
+
+  // readSome is called only when there is nothing left in the buffer,
+  // so it is filled from its beginning
+  index = 0;
+  zstr->next_out = buf;
+  zstr->avail_out = flateWindow;
+  while (zstr->avail_out > 0) {
+    if (zstr->avail_in == 0) {
+      if ((n = str->getBlock((char *)zlib->inBuf, flateZlibBufSize)) <= 0) {
+	error(getPos(), "Unexpected end of file in flate stream");
+	endOfBlock = eof = gTrue;
+	break;
+      }
+      zstr->next_in = zlib->inBuf;
+      zstr->avail_in = n;
+    }
+    ret = inflate(zstr, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      endOfBlock = eof = gTrue;
+      break;
+    }
+    if (ret != Z_OK) {
+      error(getPos(), "Bad data in flate stream: %s",
+	    zstr->msg ? zstr->msg : "unknown error");
+      endOfBlock = eof = gTrue;
+      break;
+    }
+  }
+  remain = flateWindow - zstr->avail_out;
+#endif
+}
+
 GBool FlateStream::startBlock() {
   int blockHdr;
   int c;
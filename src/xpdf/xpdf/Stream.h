@@ -15,6 +15,13 @@
 //              - All filter stream using StremPredictor stores PredictorContext
 //                to enable cloning
 //              - dictionary modificator access methods
+//              - FileStream read buffer is allocated dynamically and grows
+//                while stream is read sequentially (maximum is configurable
+//                by FileStream::setMaxBufSize)
+//              - getBlock method for reading decoded data in blocks
+//              - FlateStream can use zlib for inflating (ENABLE_ZLIB, see
+//                FlateStream::setZlibInflate), StreamPredictor works on
+//                whole lines (SSE2 versions of PNG filters if available)
 //
 //========================================================================
 
@@ -31,6 +38,10 @@
 #include "goo/gtypes.h"
 #include "xpdf/Object.h"
 
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
 class BaseStream;
 
 //------------------------------------------------------------------------
@@ -78,9 +89,14 @@ public:
   // Destructor.
   virtual ~Stream();
 
-  // Reference counting.
+  // Reference counting (atomic if MULTITHREADED, see Dict).
+#if MULTITHREADED
+  int incRef() { return gAtomicIncrement(&ref); }
+  int decRef() { return gAtomicDecrement(&ref); }
+#else
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
+#endif
 
   // Get kind of stream.
   virtual StreamKind getKind()const = 0;
@@ -100,10 +116,22 @@ public:
   // Peek at next char in stream.
   virtual int lookChar() = 0;
 
+  // Get next <size> chars from stream into <blk>.  Returns the number
+  // of chars read, which is less than <size> only at the end of the
+  // stream.  The default implementation calls getChar for each char,
+  // filters which keep decoded data in a buffer provide faster
+  // implementations.
+  virtual int getBlock(char *blk, int size);
+
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Get next <size> chars from stream without using the predictor.
+  // This is only used by StreamPredictor.  The default implementation
+  // calls getRawChar for each char.
+  virtual int getRawBlock(char *blk, int size);
+
   // Get next line from stream.
   virtual char *getLine(char *buf, int size);
 
@@ -251,6 +279,9 @@ public:
 
 private:
 
+  // Reads raw data of one line into <line> (rawLineSize bytes).
+  int readLine(Guchar *line);
+
   Stream *str;			// base stream
   int width;			// pixels per line
   int nComps;			// components per pixel
@@ -258,6 +289,8 @@ private:
   int nVals;			// components per line
   Guchar *imgLine;		// line buffer
   int imgIdx;			// current index in imgLine
+  Guchar *rawLine;		// raw (packed) line buffer
+  int rawLineSize;		// bytes per raw line
 };
 
 //------------------------------------------------------------------------
@@ -290,6 +323,7 @@ public:
 
   int lookChar();
   int getChar();
+  int getBlock(char *blk, int size);
 
 private:
 
@@ -304,6 +338,7 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *prevLine;		// previous line buffer
   int predIdx;			// current index in predLine
   GBool ok;
 
@@ -315,7 +350,19 @@ private:
 // FileStream
 //------------------------------------------------------------------------
 
+// size of the first read of FileStream after reset/seek
 #define fileStreamBufSize 256
+// default maximum size of FileStream read buffer
+#define fileStreamMaxBufSize (64 * 1024)
+
+#if MULTITHREADED
+// Lock of a file handle shared by a FileStream and its substreams (see
+// makeSubStream). The file is positioned and read with it held.
+struct FileStreamLock {
+  GMutex mutex;
+  int refCnt;
+};
+#endif
 
 class FileStream: virtual public BaseStream {
 public:
@@ -336,25 +383,46 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos()const { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart()const { return start; }
   virtual void moveStart(int delta);
 
+  // Sets maximum size of the read buffer for newly created streams. 
+  // Each read after reset or seek starts with fileStreamBufSize bytes and
+  // the read size doubles for each following read up to this value.
+  static void setMaxBufSize(Guint size);
+  static Guint getMaxBufSize() { return maxBufSize; }
+
 protected:
 
+#if MULTITHREADED
+  // Creates a substream sharing the file handle and its lock.
+  FileStream(FILE *fA, Guint startA, GBool limitedA,
+	     Guint lengthA, const Object *dictA, FileStreamLock *lockA);
+#endif
+
   GBool fillBuf();
 
   FILE *f;
+#if MULTITHREADED
+  FileStreamLock *lock;
+#endif
   Guint start;
   GBool limited;
   Guint length;
-  char buf[fileStreamBufSize];
+  char *buf;			// allocated lazily in fillBuf
+  Guint bufSize;		// allocated size of buf
+  Guint bufLimit;		// maximum size of buf for this stream
+  Guint fillSize;		// number of bytes to read by next fillBuf
   char *bufPtr;
   char *bufEnd;
   Guint bufPos;
   int savePos;
   GBool saved;
+
+  static Guint maxBufSize;
 };
 
 //------------------------------------------------------------------------
@@ -376,6 +444,7 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos()const { return (int)(bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart()const { return start; }
@@ -440,6 +509,7 @@ public:
   virtual int getChar()
     { int c = lookChar(); buf = EOF; return c; }
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -464,6 +534,7 @@ public:
   virtual int getChar()
     { int ch = lookChar(); ++index; return ch; }
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -490,7 +561,9 @@ public:
   virtual int getChar();
   virtual Stream * clone();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual int getRawChar();
+  virtual int getRawBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -537,6 +610,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -735,6 +809,8 @@ struct FlateDecode {
   int first;			// first length/distance
 };
 
+struct FlateZlib;
+
 class FlateStream: public FilterStream {
 public:
 
@@ -746,10 +822,19 @@ public:
   virtual Stream * clone();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual int getRawChar();
+  virtual int getRawBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
+  // Selects decoder used by streams when they are reset - zlib if
+  // <enable> is true, the built-in one otherwise.  zlib is used by
+  // default if compiled with ENABLE_ZLIB, the built-in decoder is
+  // always used otherwise.
+  static void setZlibInflate(GBool enable);
+  static GBool getZlibInflate() { return zlibInflate; }
+
 private:
   PredictorContext predContext; // creation context for predictor
 
@@ -767,7 +852,9 @@ private:
   int blockLen;			// remaining length of uncompressed block
   GBool endOfBlock;		// set when end of block is reached
   GBool eof;			// set when end of stream is reached
+  FlateZlib *zlib;		// zlib decoder state (NULL if not used)
 
+  static GBool zlibInflate;	// use zlib for newly reset streams
   static int			// code length code reordering
     codeLenCodeMap[flateMaxCodeLenCodes];
   static FlateDecode		// length decoding info
@@ -780,6 +867,7 @@ private:
     fixedDistCodeTab;
 
   void readSome();
+  void readSomeZlib();
   GBool startBlock();
   void loadFixedCodes();
   GBool readDynamicCodes();
@@ -116,7 +116,7 @@ public:
 #if TEXTOUT_WORD_LIST
   int getLength()const { return len; }
   Unicode getChar(int idx)const { return text[idx]; }
-  const GString *getText()const;
+  GString *getText()const;
   const GString *getFontName()const { return font->fontName; }
   void getColor(double *r, double *g, double *b)const
     { *r = colorR; *g = colorG; *b = colorB; }
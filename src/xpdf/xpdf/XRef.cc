@@ -215,8 +215,19 @@ Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
 // XRef
 //------------------------------------------------------------------------
 
+#if MULTITHREADED
+#  define lockObjStr   gLockMutex(&objStrMutex)
+#  define unlockObjStr gUnlockMutex(&objStrMutex)
+#else
+#  define lockObjStr
+#  define unlockObjStr
+#endif
+
 static const char * PDFHEADER="%PDF-";
-XRef::XRef(BaseStream *strA):entries(NULL), streamEnds(NULL), objStr(NULL) {
+XRef::XRef(BaseStream *strA):entries(NULL), numObjects(0), streamEnds(NULL), objStr(NULL) {
+#if MULTITHREADED
+  gInitMutex(&objStrMutex);
+#endif
   // inits stream and initializes internals
   str = strA;
 
@@ -260,6 +271,7 @@ void XRef::initInternals(Guint pos)
   ok = gTrue;
   setErrCode(errNone);
   size = 0;
+  numObjects = 0;
   entries = NULL;
   streamEnds = NULL;
   streamEndsLen = 0;
@@ -309,6 +321,14 @@ void XRef::initInternals(Guint pos)
   // indirect objects from it
   Dict *d = (Dict *)getTrailerDict()->getDict();
   d->setXRef(this);
+
+  // counts just not free entries, entries don't change until next
+  // initInternals call
+  for (int i = 0; i < size; ++i) {
+    if (entries[i].type != xrefEntryFree) {
+      ++numObjects;
+    }
+  }
 }
 
 void XRef::destroyInternals()
@@ -334,6 +354,9 @@ void XRef::destroyInternals()
 
 XRef::~XRef() {
   destroyInternals();
+#if MULTITHREADED
+  gDestroyMutex(&objStrMutex);
+#endif
 }
 
 // Read the 'startxref' position.
@@ -954,6 +977,7 @@ GBool XRef::okToAddNotes(GBool ignoreOwnerPW)const {
 Object *XRef::fetch(int num, int gen, Object *obj)const {
   XRefEntry *e;
   Parser *parser;
+  ObjectStream *newObjStr;
   Object obj1, obj2, obj3;
   GBool failed = gFalse;
 
@@ -1010,18 +1034,27 @@ Object *XRef::fetch(int num, int gen, Object *obj)const {
     if (gen != 0) {
       goto err_no_obj;
     }
-    if (!objStr || objStr->getObjStrNum() != (int)e->offset) {
-      if (objStr) {
-	delete objStr;
-      }
-      objStr = new ObjectStream(this, e->offset);
-      if (!objStr->isOk()) {
-	delete objStr;
-	objStr = NULL;
-	goto err_damaged;
-      }
+    lockObjStr;
+    if (objStr && objStr->getObjStrNum() == (int)e->offset) {
+      objStr->getObject(e->gen, num, obj);
+      unlockObjStr;
+      break;
+    }
+    unlockObjStr;
+    // the object stream is read without the lock, because reading
+    // fetches other objects
+    newObjStr = new ObjectStream(this, e->offset);
+    if (!newObjStr->isOk()) {
+      delete newObjStr;
+      goto err_damaged;
+    }
+    newObjStr->getObject(e->gen, num, obj);
+    lockObjStr;
+    if (objStr) {
+      delete objStr;
     }
-    objStr->getObject(e->gen, num, obj);
+    objStr = newObjStr;
+    unlockObjStr;
     break;
 
   default:
@@ -1113,7 +1146,7 @@ int XRef::getRootGen()const
 RefState XRef::knowsRef(const Ref &ref)const
 {
    // boundary checking
-   if(ref.num<0 || ref.num>size)
+   if(ref.num<0 || ref.num>=size)
       return UNUSED_REF;
 
    switch(entries[ref.num].type)
@@ -20,6 +20,8 @@
 //              - maxObj field added which contains the maximum present 
 //                indirect object number
 //              - pdfVersion and getPDFVersion added
+//              - numObjects field added which caches number of real objects
+//                counted when xref table is parsed
 //
 //========================================================================
 
@@ -35,6 +37,10 @@
 #include "goo/gtypes.h"
 #include "xpdf/Object.h"
 
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+
 class Dict;
 class Stream;
 class Parser;
@@ -117,13 +123,7 @@ public:
   // Return the number of objects in the xref table.
   virtual int getNumObjects()const
   { 
-     int count=0;
-     for(int i=0; i<size; i++)
-        // counts just not free entries
-        if(entries[i].type != xrefEntryFree)
-           count++;
-
-     return count; 
+     return numObjects; 
   }
 
   /** Ckecks if given reference is known.
@@ -161,6 +161,7 @@ protected:
 				//   at beginning of file)
   XRefEntry *entries;		// xref entries
   int size;			// size of <entries> array
+  int numObjects;		// number of not free entries in <entries>
   mutable GBool ok;		// true if xref table is valid
   mutable int errCode;		// error code (if <ok> is false)
   Guint lastXRefPos;		// offset of last xref table
@@ -173,6 +174,10 @@ protected:
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
   mutable ObjectStream *objStr;	// cached object stream
+#if MULTITHREADED
+  mutable GMutex objStrMutex;	// protects objStr (fetch may be called
+				//   by several threads)
+#endif
   GBool useEncrypt;		// true if we want to decrypt content
   // TODO where is this field initialized ???
   GBool encrypted;		// Flag whether document is encrypted.
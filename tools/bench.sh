@@ -36,7 +36,11 @@ usage()
 	echo "name and _results suffix which will contain file_info and file_result"
 	echo "files."
 	echo "The first one contains information about document, the later results from"
-	echo "the benchmarks"
+	echo "the benchmarks. Each attempt also stores machine readable results into"
+	echo "file_N.json file which can be compared by bench_compare.py script."
+	echo
+	echo "BENCH_OPTS environment variable may contain additional benchmark options"
+	echo "(e.g. \"-w 1 -r 5\" for one warmup round and 5 measured rounds)."
 	exit 1
 }
 
@@ -84,7 +88,7 @@ do
 		./file_info "$f" > "$OUT/${OUTNAME}_info" || continue
 		for i in `seq $ATEMPTS`
 		do
-			"./$b" "$f" >> "$OUT/${OUTNAME}${BENCH_SUFFIX}"
+			"./$b" $BENCH_OPTS -j "$OUT/${OUTNAME}_$i.json" "$f" >> "$OUT/${OUTNAME}${BENCH_SUFFIX}"
 			echo -n "$i "
 		done
 		echo
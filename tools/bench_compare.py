@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+# PDFedit - free program for PDF document manipulation.
+# Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+#                                        Jozef Misutka,
+#                                        Martin Petricek
+#                   Former team members: Miroslav Jahoda
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program (in doc/LICENSE.GPL); if not, write to the
+# Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+# MA  02111-1307  USA
+#
+# Project is hosted on http://sourceforge.net/projects/pdfedit
+
+"""Compares two benchmark runs stored in JSON format (see tools/bench.sh).
+
+Both parameters can be either a JSON file produced by a benchmark -j option
+or a directory which is searched recursively for such files (e.g. the
+<bench>_results directories created by tools/bench.sh). Results with the same
+benchmark, file and result name are compared. If there are more attempts for
+the same result, the best one (the lowest value) is used to suppress noise.
+
+Exit status is 1 if there is at least one regression, 0 otherwise.
+"""
+
+import json
+import optparse
+import os
+import sys
+
+def load_file(path, results):
+	f = open(path)
+	try:
+		data = json.load(f)
+	finally:
+		f.close()
+	bench = data.get("bench", "")
+	doc = os.path.basename(data.get("file", ""))
+	for res in data.get("results", []):
+		if not res.get("count"):
+			continue
+		key = (bench, doc, res["name"])
+		prev = results.get(key)
+		if prev is None:
+			results[key] = res
+			continue
+		for field in ("min", "mean", "p50", "p95", "p99", "allocs"):
+			if field in res and res[field] < prev.get(field, res[field]):
+				prev[field] = res[field]
+
+def load(path):
+	results = {}
+	if os.path.isdir(path):
+		for root, dirs, files in os.walk(path):
+			for name in sorted(files):
+				if name.endswith(".json"):
+					load_file(os.path.join(root, name), results)
+	else:
+		load_file(path, results)
+	return results
+
+def main():
+	parser = optparse.OptionParser(usage="%prog [options] baseline current")
+	parser.add_option("-f", "--field", default="p50",
+			help="compared value: min, mean, p50, p95, p99 (default p50)")
+	parser.add_option("-t", "--threshold", type="float", default=5.0,
+			help="relative slowdown in percents reported as regression (default 5)")
+	parser.add_option("-m", "--min-delta", type="float", default=0.01,
+			help="ignore absolute differences smaller than this (ms, default 0.01)")
+	parser.add_option("-a", "--all", action="store_true", default=False,
+			help="print all compared results, not only regressions and improvements")
+	(opts, args) = parser.parse_args()
+	if len(args) != 2:
+		parser.error("baseline and current results expected")
+
+	base = load(args[0])
+	curr = load(args[1])
+	regressions = 0
+	fmt = "%-60s %12s %12s %9s  %s"
+	print(fmt % ("bench/file/result", "baseline", "current", "change", ""))
+	for key in sorted(set(base.keys()) & set(curr.keys())):
+		old = base[key].get(opts.field)
+		new = curr[key].get(opts.field)
+		if old is None or new is None:
+			continue
+		delta = new - old
+		change = (delta / old * 100.0) if old > 0 else 0.0
+		mark = ""
+		if abs(delta) >= opts.min_delta:
+			if change > opts.threshold:
+				mark = "REGRESSION"
+				regressions += 1
+			elif change < -opts.threshold:
+				mark = "improvement"
+		if mark or opts.all:
+			print(fmt % ("/".join(key), "%.4f" % old, "%.4f" % new,
+					"%+.1f%%" % change, mark))
+
+	for key in sorted(set(base.keys()) ^ set(curr.keys())):
+		where = "current" if key in base else "baseline"
+		print("%s: missing in %s" % ("/".join(key), where))
+
+	print("%d regression(s) in %s" % (regressions, opts.field))
+	if regressions:
+		return 1
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main())